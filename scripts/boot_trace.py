@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+Decode the boot trace of OpenHC32Boot.
+
+The trace can be decoded from:
+- a memory dump of the trace, e.g. 'pyocd cmd -c "savemem 0x200F0000 532 trace.bin"',
+  or the 'ret_sram.bin' file of the native build
+- a host serial capture containing the "trace: " lines printed after a failed boot
+
+The layout must match modules/boot_trace.h.
+
+Usage:
+  boot_trace.py --dump trace.bin
+  boot_trace.py --log capture.log
+"""
+import re
+import sys
+import zlib
+import struct
+import argparse
+
+MAGIC = 0x5442484F
+VERSION = 1
+HEADER_FORMAT = "<IHHHHII"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+ENTRY_FORMAT = "<IBBHII"
+ENTRY_SIZE = struct.calcsize(ENTRY_FORMAT)
+CRC_OFFSET = 16
+
+EVENTS = {
+    1: "boot",
+    2: "stage enter",
+    3: "stage exit",
+    4: "sd init error",
+    5: "sd read error",
+    6: "flash program error",
+    7: "flash erase error",
+    8: "pre-check fail",
+    9: "fault",
+    10: "fault pc",
+    11: "fault address",
+    12: "update",
+    13: "jump",
+    14: "sd reads",
+    15: "sd time",
+    16: "integrity",
+    17: "slot",
+}
+
+STAGES = ["screen init", "mount", "hash", "erase", "write", "pre-check", "verify", "receive", "signature"]
+
+TRACE_LINE_PATTERN = re.compile(r"trace: (\d+) (\d+) (\d+) 0x([0-9A-Fa-f]+) 0x([0-9A-Fa-f]+)")
+
+def describe(event: int, detail: int, arg0: int, arg1: int) -> str:
+    """Describe an entry in human readable form."""
+    name = EVENTS.get(event, f"unknown event {event}")
+    if event == 1:
+        return f"{name}: clock={arg0} Hz, {'kept' if arg1 else 'reset'} trace"
+    if event in (2, 3):
+        stage = STAGES[detail] if detail < len(STAGES) else f"stage {detail}"
+        return f"{name}: {stage}"
+    if event == 4:
+        return f"{name}: {'SDCARD_GetCardCSD' if arg1 else 'SDCARD_Init'} rc={detail} err={arg0}"
+    if event == 5:
+        return f"{name}: rc={detail} err={arg0} sector={arg1}"
+    if event == 6:
+        return f"{name}: rc={detail} @ 0x{arg0:08X} data=0x{arg1:08X}"
+    if event == 7:
+        return f"{name}: rc={detail} sector @ 0x{arg0:08X}"
+    if event == 8:
+        return f"{name}: check #{detail}"
+    if event == 9:
+        return f"{name}: CFSR=0x{arg0:08X} HFSR=0x{arg1:08X}"
+    if event == 10:
+        return f"{name}: PC=0x{arg0:08X} LR=0x{arg1:08X}"
+    if event == 11:
+        return f"{name}: {'BFAR' if detail else 'MMFAR'}=0x{arg0:08X}"
+    if event == 12:
+        return f"{name}: {'applied' if detail else 'failed'}"
+    if event == 13:
+        return f"{name}: app @ 0x{arg0:08X}"
+    if event == 14:
+        return f"{name}: {arg0} sectors requested, {arg1} device reads, {detail} retries"
+    if event == 15:
+        return f"{name}: {arg0} us busy, {arg1} cache hits, {detail} timeouts"
+    if event == 16:
+        results = ["mismatch", "passed", "verified before", "no metadata"]
+        result = results[detail] if detail < len(results) else f"result {detail}"
+        return f"{name}: {result}, {arg0} bytes"
+    if event == 17:
+        return f"{name}: {'rolled back' if detail else 'activated'}, app @ 0x{arg0:08X}, sequence {arg1}"
+    return f"{name}: detail={detail} arg0=0x{arg0:08X} arg1=0x{arg1:08X}"
+
+def decode_dump(data: bytes) -> list:
+    """
+    Decode a memory dump of the trace.
+    returns a list of (boot, timestamp_us, event, detail, arg0, arg1) tuples, oldest first
+    """
+    if len(data) < HEADER_SIZE:
+        raise ValueError("dump is too short")
+
+    magic, version, entry_size, capacity, boot_count, head, crc = struct.unpack_from(HEADER_FORMAT, data)
+    if magic != MAGIC:
+        raise ValueError(f"bad magic 0x{magic:08X}, trace not initialized")
+    if version != VERSION or entry_size != ENTRY_SIZE:
+        raise ValueError(f"unsupported trace version {version} / entry size {entry_size}")
+
+    size = HEADER_SIZE + (capacity * entry_size)
+    if len(data) < size:
+        raise ValueError(f"dump is too short, need {size} bytes")
+
+    expected_crc = zlib.crc32(data[HEADER_SIZE:size], zlib.crc32(data[:CRC_OFFSET]))
+    if crc != expected_crc:
+        raise ValueError(f"bad CRC 0x{crc:08X}, expected 0x{expected_crc:08X}")
+
+    entries = []
+    count = min(head, capacity)
+    for i in range(head - count, head):
+        offset = HEADER_SIZE + ((i % capacity) * entry_size)
+        timestamp, event, detail, boot, arg0, arg1 = struct.unpack_from(ENTRY_FORMAT, data, offset)
+        entries.append((boot, timestamp, event, detail, arg0, arg1))
+
+    return entries
+
+def decode_log(lines) -> list:
+    """Decode the trace lines of a host serial capture, as (boot, timestamp_us, event, detail, arg0, arg1) tuples."""
+    entries = []
+    for line in lines:
+        match = TRACE_LINE_PATTERN.search(line)
+        if match is not None:
+            timestamp, event, detail = (int(match.group(i)) for i in range(1, 4))
+            entries.append((None, timestamp, event, detail, int(match.group(4), 16), int(match.group(5), 16)))
+
+    return entries
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the OpenHC32Boot boot trace")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--dump", help="memory dump of the trace")
+    source.add_argument("--log", help="host serial capture")
+    args = parser.parse_args()
+
+    try:
+        if args.dump is not None:
+            with open(args.dump, "rb") as f:
+                entries = decode_dump(f.read())
+        else:
+            with open(args.log, "r", errors="replace") as f:
+                entries = decode_log(f)
+    except ValueError as e:
+        print(f"error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    for boot, timestamp, event, detail, arg0, arg1 in entries:
+        prefix = f"#{boot:<5} " if boot is not None else ""
+        print(f"{prefix}{timestamp / 1000:>10.3f} ms  {describe(event, detail, arg0, arg1)}")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""
+Decode the host serial output of a bootloader built with LOG_TOKENIZED=1.
+
+Usage:
+  log_decode.py --dict .pio/build/<env>/log_tokens.json < capture.bin
+  log_decode.py --src src --port /dev/ttyUSB0 --baud 115200
+"""
+import sys
+import argparse
+from os import path
+
+sys.path.insert(0, path.dirname(path.abspath(__file__)))
+from log_tokens import build_dictionary, read_dictionary
+
+# marker bytes, must match logging::tokens::marker
+MARKER_TOKEN = 0x01
+MARKER_NUMBER = 0x02
+
+class Decoder:
+    """Decode a tokenized log byte stream. Plain text passes through unchanged."""
+
+    def __init__(self, dictionary: dict):
+        self.dictionary = dictionary
+        self.pending = bytearray()
+
+    def feed(self, data: bytes) -> bytes:
+        """Feed received bytes, returns the decoded output available so far."""
+        self.pending += data
+        out = bytearray()
+
+        while len(self.pending) > 0:
+            marker = self.pending[0]
+            if marker == MARKER_TOKEN:
+                if len(self.pending) < 3:
+                    break
+
+                token = self.pending[1] | (self.pending[2] << 8)
+                out += self.dictionary.get(token, f"<unknown token 0x{token:04X}>".encode("ascii"))
+                del self.pending[:3]
+            elif marker == MARKER_NUMBER:
+                decoded = self.decode_number()
+                if decoded is None:
+                    break
+
+                out += decoded
+            else:
+                out.append(marker)
+                del self.pending[:1]
+
+        return bytes(out)
+
+    def decode_number(self):
+        """Decode a number record at the start of the pending data, or None if incomplete."""
+        if len(self.pending) < 3:
+            return None
+
+        base = self.pending[1]
+
+        # LEB128 varint
+        number = 0
+        shift = 0
+        i = 2
+        while True:
+            if i >= len(self.pending):
+                return None
+
+            b = self.pending[i]
+            number |= (b & 0x7F) << shift
+            shift += 7
+            i += 1
+            if (b & 0x80) == 0:
+                break
+
+        del self.pending[:i]
+
+        # same formatting as logging::formatters::format_number
+        if base == 16:
+            return f"{number:08X}".encode("ascii")
+        elif base == 2:
+            return f"{number:b}".encode("ascii")
+        else:
+            return f"{number}".encode("ascii")
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode tokenized OpenHC32Boot log output")
+    dict_source = parser.add_mutually_exclusive_group(required=True)
+    dict_source.add_argument("--dict", help="token dictionary (log_tokens.json) created by the build")
+    dict_source.add_argument("--src", help="source directory to build the token dictionary from")
+    parser.add_argument("--port", help="serial port to read from. reads stdin if not set")
+    parser.add_argument("--baud", type=int, default=115200, help="serial port baud rate")
+    args = parser.parse_args()
+
+    dictionary = read_dictionary(args.dict) if args.dict is not None else build_dictionary(args.src)
+    decoder = Decoder(dictionary)
+    out = sys.stdout.buffer
+
+    if args.port is not None:
+        import serial # pyserial
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            while True:
+                out.write(decoder.feed(port.read(256)))
+                out.flush()
+    else:
+        while True:
+            data = sys.stdin.buffer.read1(256)
+            if len(data) == 0:
+                break
+
+            out.write(decoder.feed(data))
+            out.flush()
+
+if __name__ == "__main__":
+    main()
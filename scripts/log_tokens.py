@@ -0,0 +1,120 @@
+import sys
+import re
+import json
+from os import path, walk
+
+# LOG_STR("...") call sites, with C escape sequences in the string
+LOG_STR_REGEX = re.compile(r'LOG_STR\(\s*"((?:[^"\\]|\\.)*)"\s*\)')
+
+# C escape sequences allowed in log strings
+C_ESCAPES = {
+    "n": "\n",
+    "r": "\r",
+    "t": "\t",
+    "0": "\0",
+    "\\": "\\",
+    "\"": "\"",
+    "'": "'",
+}
+
+def unescape_c_string(s: str) -> bytes:
+    """Resolve the escape sequences of a C string literal."""
+    out = bytearray()
+    i = 0
+    while i < len(s):
+        c = s[i]
+        if c != "\\":
+            out += c.encode("ascii")
+            i += 1
+            continue
+
+        esc = s[i + 1]
+        if esc == "x":
+            match = re.match(r"[0-9a-fA-F]+", s[i + 2:])
+            out.append(int(match.group(0), 16) & 0xFF)
+            i += 2 + len(match.group(0))
+        elif esc in C_ESCAPES:
+            out += C_ESCAPES[esc].encode("ascii")
+            i += 2
+        else:
+            raise ValueError(f"unsupported escape sequence '\\{esc}' in log string '{s}'")
+
+    return bytes(out)
+
+def token_hash(s: bytes) -> int:
+    """Calculate the token of a string. Must match logging::tokens::hash()."""
+    # 32 bit FNV-1a
+    h = 2166136261
+    for b in s:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+
+    # xor-fold to 16 bits
+    return ((h >> 16) ^ (h & 0xFFFF)) & 0xFFFF
+
+def build_dictionary(src_dir: str) -> dict:
+    """
+    Build the token dictionary from all LOG_STR() call sites in the source directory.
+    Raises a ValueError if two different strings map to the same token.
+    """
+    dictionary = {}
+    for root, _, files in walk(src_dir):
+        for file in sorted(files):
+            if not file.endswith((".c", ".cpp", ".h")):
+                continue
+
+            file_path = path.join(root, file)
+            with open(file_path, "r", encoding="utf-8", errors="replace") as f:
+                content = f.read()
+
+            for match in LOG_STR_REGEX.finditer(content):
+                string = unescape_c_string(match.group(1))
+                token = token_hash(string)
+
+                if token in dictionary and dictionary[token] != string:
+                    raise ValueError(f"token collision 0x{token:04X}: {dictionary[token]!r} and {string!r} (in {file_path}). rephrase one of the strings")
+
+                dictionary[token] = string
+
+    return dictionary
+
+def write_dictionary(dictionary: dict, out_path: str):
+    """Write the token dictionary as json."""
+    with open(out_path, "w") as f:
+        json.dump({
+            "version": 1,
+            "tokens": { f"0x{token:04X}": string.decode("ascii") for token, string in sorted(dictionary.items()) }
+        }, f, indent=2)
+
+def read_dictionary(dict_path: str) -> dict:
+    """Read a token dictionary written by write_dictionary()."""
+    with open(dict_path, "r") as f:
+        content = json.load(f)
+
+    return { int(token, 16): string.encode("ascii") for token, string in content["tokens"].items() }
+
+
+# when run by PlatformIO, emit the dictionary next to firmware.bin
+try:
+    Import("env")
+except NameError:
+    env = None
+
+if env is not None:
+    def emit_log_tokens(source, target, env):
+        """Create the token dictionary for the firmware binary."""
+        firmware_bin = target[0].get_abspath()
+        dict_path = path.join(path.dirname(firmware_bin), "log_tokens.json")
+
+        try:
+            dictionary = build_dictionary(env.subst("$PROJECT_SRC_DIR"))
+        except ValueError as e:
+            sys.stderr.write(f"Error: {e}\n")
+            sys.exit(1)
+
+        write_dictionary(dictionary, dict_path)
+        print(f"Wrote {len(dictionary)} log tokens to '{dict_path}'")
+
+    env.AddPostAction(
+        path.join(env.get("BUILD_DIR"), env.get("PROGNAME") + ".bin"),
+        env.VerboseAction(emit_log_tokens, "Creating log token dictionary")
+    )
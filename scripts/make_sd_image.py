@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+Create a FAT32 SD card image for the native build.
+
+The image has no partition table, and all files are placed in the root directory
+using their upper-case 8.3 name.
+
+Usage:
+  make_sd_image.py sd.img .pio/build/<env>/firmware.bin:FIRMWARE.BIN [<file>[:<name>] ...]
+"""
+import struct
+import argparse
+from os import path
+
+SECTOR_SIZE = 512
+SECTORS_PER_CLUSTER = 1
+RESERVED_SECTORS = 32
+FAT_COUNT = 2
+ROOT_CLUSTER = 2
+END_OF_CHAIN = 0x0FFFFFFF
+
+# FAT32 needs at least 65525 clusters
+MIN_SIZE_MB = 34
+
+def to_83_name(name: str) -> bytes:
+    """Convert a file name to a 8.3 directory entry name."""
+    name = name.upper()
+    base, _, ext = name.partition(".")
+    if len(base) == 0 or len(base) > 8 or len(ext) > 3:
+        raise ValueError(f"'{name}' is not a valid 8.3 file name")
+
+    return (base.ljust(8) + ext.ljust(3)).encode("ascii")
+
+def build_boot_sector(total_sectors: int, fat_size: int) -> bytes:
+    """Build the FAT32 volume boot record."""
+    bs = bytearray(SECTOR_SIZE)
+    bs[0:3] = b"\xEB\x58\x90"
+    bs[3:11] = b"MSWIN4.1"
+    struct.pack_into("<HBHBHHBHHHII", bs, 11,
+        SECTOR_SIZE,            # bytes per sector
+        SECTORS_PER_CLUSTER,    # sectors per cluster
+        RESERVED_SECTORS,       # reserved sectors
+        FAT_COUNT,              # number of FATs
+        0,                      # root entries (FAT32: 0)
+        0,                      # total sectors 16 (FAT32: 0)
+        0xF8,                   # media descriptor
+        0,                      # FAT size 16 (FAT32: 0)
+        63,                     # sectors per track
+        255,                    # number of heads
+        0,                      # hidden sectors
+        total_sectors)          # total sectors 32
+    struct.pack_into("<IHHIHH", bs, 36,
+        fat_size,               # FAT size 32
+        0,                      # ext flags
+        0,                      # version
+        ROOT_CLUSTER,           # root cluster
+        1,                      # FSInfo sector
+        6)                      # backup boot sector
+    struct.pack_into("<BBBI", bs, 64, 0x80, 0, 0x29, 0x4E415449)
+    bs[71:82] = b"NATIVE     "
+    bs[82:90] = b"FAT32   "
+    bs[510:512] = b"\x55\xAA"
+    return bytes(bs)
+
+def make_image(image_path: str, files: list, size_mb: int):
+    """
+    Create the image.
+    files is a list of (name, content) tuples.
+    """
+    total_sectors = (max(size_mb, MIN_SIZE_MB) * 1024 * 1024) // SECTOR_SIZE
+
+    # FAT size according to the FAT specification
+    fat_size = -(-(total_sectors - RESERVED_SECTORS) // (((256 * SECTORS_PER_CLUSTER) + FAT_COUNT) // 2))
+    data_start = RESERVED_SECTORS + (FAT_COUNT * fat_size)
+    cluster_size = SECTOR_SIZE * SECTORS_PER_CLUSTER
+
+    fat = [0x0FFFFFF8, 0x0FFFFFFF, END_OF_CHAIN]
+    root_dir = bytearray()
+    file_data = []
+
+    # allocate contiguous cluster chains after the root directory
+    for name, content in files:
+        cluster_count = -(-len(content) // cluster_size)
+        first_cluster = len(fat) if cluster_count > 0 else 0
+        for i in range(cluster_count):
+            fat.append(END_OF_CHAIN if i == cluster_count - 1 else len(fat) + 1)
+
+        entry = bytearray(32)
+        entry[0:11] = to_83_name(name)
+        entry[11] = 0x20 # archive
+        struct.pack_into("<H", entry, 20, first_cluster >> 16)
+        struct.pack_into("<H", entry, 26, first_cluster & 0xFFFF)
+        struct.pack_into("<I", entry, 28, len(content))
+        root_dir += entry
+        file_data.append((first_cluster, content))
+
+    if len(root_dir) > cluster_size:
+        raise ValueError("too many files for the root directory")
+
+    with open(image_path, "wb") as f:
+        f.truncate(total_sectors * SECTOR_SIZE)
+
+        boot_sector = build_boot_sector(total_sectors, fat_size)
+        f.seek(0)
+        f.write(boot_sector)
+        f.seek(6 * SECTOR_SIZE)
+        f.write(boot_sector)
+
+        fat_bytes = b"".join(struct.pack("<I", entry) for entry in fat)
+        for i in range(FAT_COUNT):
+            f.seek((RESERVED_SECTORS + (i * fat_size)) * SECTOR_SIZE)
+            f.write(fat_bytes)
+
+        def cluster_offset(cluster: int) -> int:
+            return (data_start + ((cluster - 2) * SECTORS_PER_CLUSTER)) * SECTOR_SIZE
+
+        f.seek(cluster_offset(ROOT_CLUSTER))
+        f.write(root_dir)
+
+        for first_cluster, content in file_data:
+            if first_cluster != 0:
+                f.seek(cluster_offset(first_cluster))
+                f.write(content)
+
+def main():
+    parser = argparse.ArgumentParser(description="Create a FAT32 SD card image for the native build")
+    parser.add_argument("image", help="path of the image to create")
+    parser.add_argument("files", nargs="*", help="files to add, as <path>[:<name in image>]")
+    parser.add_argument("--size", type=int, default=64, help=f"image size in MB, at least {MIN_SIZE_MB}")
+    args = parser.parse_args()
+
+    files = []
+    for spec in args.files:
+        file_path, _, name = spec.partition(":")
+        with open(file_path, "rb") as f:
+            files.append((name if name != "" else path.basename(file_path), f.read()))
+
+    make_image(args.image, files, args.size)
+
+if __name__ == "__main__":
+    main()
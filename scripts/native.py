@@ -0,0 +1,8 @@
+Import("env")
+
+# build_flags only reach the compiler, the linker has to produce a 32-bit executable as well
+env.Append(
+    LINKFLAGS=[
+        "-m32"
+    ]
+)
@@ -0,0 +1,774 @@
+#!/usr/bin/env python3
+"""
+Pack an application binary into an OpenHC32Boot update image.
+
+The image starts with an image header, followed by the application data, optionally compressed.
+Copy the image to the SD card as the firmware update file (FIRMWARE.BIN by default).
+The layout must match modules/image_format.h.
+
+A delta image (--delta-from) only holds the changes against the application installed on the printer,
+and is rejected by the bootloader if any other application is installed. --hash must match the METADATA_HASH
+the bootloader was built with.
+
+Images carry a manifest with the load address, the hash and the per-sector CRC32s of the application by default,
+so the bootloader doesn't have to read the whole file to hash it, and keeps flash sectors that don't change.
+--load-address must match APP_BASE_ADDRESS of the bootloader, and --hash its METADATA_HASH.
+
+With --staged, the output is not an update file but the contents of the staging slot, for the application to
+write to flash at STAGING_SLOT_ADDRESS (see modules/staging_format.h): the application binary, followed by the
+trailer at STAGING_TRAILER_ADDRESS. --hash must match METADATA_HASH of the bootloader.
+
+With --sparse, the image only holds the segments of the application, leaving out runs of 0xFF bytes. The bootloader
+leaves the flash between the segments erased, so less is read, erased and programmed.
+Besides binaries, the application can be read from Intel HEX or ELF files (by extension), the gaps between their
+sections filled with 0xFF. They must not hold data below --load-address.
+
+With --key, the application data is encrypted with AES-128 in CTR mode, using the IMAGE_KEY of the bootloader
+(or the key programmed to its OTP area) as 32 hex digits. The bootloader must be built with ENABLE_ENCRYPTED_IMAGES.
+Each image gets a random nonce, unless --nonce is given.
+
+With --sign-key, the image carries an ECDSA P-256 signature of the application, made with the private key in the given
+file (64 hex digits, created by --new-sign-key). The bootloader must be built with ENABLE_SIGNED_IMAGES and the
+IMAGE_PUBLIC_KEY printed when signing. Keep the key file secret: anyone holding it can sign firmware for the printers.
+
+Every packed image is decoded again and compared with the application binary before it is written.
+
+Usage:
+  pack_image.py .pio/build/<env>/firmware.bin FIRMWARE.BIN
+  pack_image.py --window-bits 10 firmware.bin FIRMWARE.BIN
+  pack_image.py --uncompressed firmware.bin FIRMWARE.BIN
+  pack_image.py --delta-from installed.bin --hash crc32 firmware.bin FIRMWARE.BIN
+  pack_image.py --load-address 0x8000 firmware.bin FIRMWARE.BIN
+  pack_image.py --staged firmware.bin staged.bin
+  pack_image.py --sparse firmware.elf FIRMWARE.BIN
+  pack_image.py --key 2B7E151628AED2A6ABF7158809CF4F3C firmware.bin FIRMWARE.BIN
+  pack_image.py --sign-key image_key.txt firmware.bin FIRMWARE.BIN
+"""
+import os
+import sys
+import hmac
+import zlib
+import bisect
+import struct
+import hashlib
+import argparse
+
+MAGIC = 0x4942484F
+VERSION = 1
+HEADER_FORMAT = "<IHHIIIB3x"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+DELTA_HEADER_FORMAT = "<IIB3x32s32s"
+DELTA_HEADER_SIZE = struct.calcsize(DELTA_HEADER_FORMAT)
+
+MANIFEST_FORMAT = "<IHBx32s"
+MANIFEST_SIZE = struct.calcsize(MANIFEST_FORMAT)
+
+SPARSE_HEADER_FORMAT = "<H2x"
+SEGMENT_FORMAT = "<II"
+
+ENCRYPTION_HEADER_FORMAT = "<12s4s"
+
+SIGNATURE_FORMAT = "<32s32s"
+
+FLAG_COMPRESSED = 1 << 0
+FLAG_DELTA = 1 << 1
+FLAG_MANIFEST = 1 << 2
+FLAG_SPARSE = 1 << 3
+FLAG_ENCRYPTED = 1 << 4
+FLAG_SIGNED = 1 << 5
+
+# the APP_BASE_ADDRESS of the full profile
+DEFAULT_LOAD_ADDRESS = 0x6000
+
+HASH_TYPES = {"crc32": 1, "sha256": 2}
+
+MIN_WINDOW_BITS = 8
+MAX_WINDOW_BITS = 16
+DEFAULT_WINDOW_BITS = 12
+
+MIN_MATCH = 4
+
+# number of earlier positions tried per match search
+MAX_CHAIN = 32
+
+# deltas are applied and manifests describe the application one flash sector at a time, see image_format.h
+SECTOR_SIZE = 8192
+MAX_SECTORS = 64
+
+# sparse images hold at most this many segments, see IMAGE_MAX_SEGMENTS
+MAX_SEGMENTS = 32
+
+# shortest run of 0xFF bytes left out of sparse images, shorter runs cost less than a segment
+MIN_GAP = 64
+
+# size of the SD card sectors the bootloader reads the image in
+SD_SECTOR_SIZE = 512
+
+# shortest copy of a delta, shorter copies are stored as literals
+MIN_COPY = 8
+
+# number of source positions tried per copy search
+MAX_CANDIDATES = 16
+
+# staging slot layout, see modules/staging_format.h
+STAGING_MAGIC = 0x5342484F
+STAGING_SLOT_ADDRESS = 0x40000
+STAGING_TRAILER_ADDRESS = 0x7C000
+STAGING_SLOT_SIZE = STAGING_TRAILER_ADDRESS - STAGING_SLOT_ADDRESS
+STAGING_TRAILER_FORMAT = "<IIB3x32s"
+
+def write_length(out: bytearray, length: int):
+    """Write the extra bytes of a literal count or match length of 15 or more."""
+    length -= 15
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+def write_sequence(out: bytearray, literals: bytes, offset: int, match_length: int):
+    """Write a sequence. a match_length of 0 writes the literals only, ending the data."""
+    literal_count = len(literals)
+    match_code = match_length - MIN_MATCH if match_length > 0 else 0
+    out.append((min(literal_count, 15) << 4) | min(match_code, 15))
+    if literal_count >= 15:
+        write_length(out, literal_count)
+    out += literals
+
+    if match_length > 0:
+        out += struct.pack("<H", offset)
+        if match_code >= 15:
+            write_length(out, match_code)
+
+def compress(data: bytes, window_bits: int) -> bytes:
+    """Compress data using greedy matching on hash chains of 4 byte prefixes."""
+    window_size = 1 << window_bits
+    out = bytearray()
+    heads = {}
+    previous = [0] * len(data)
+    literal_start = 0
+    i = 0
+
+    def insert(position: int):
+        key = data[position:position + MIN_MATCH]
+        previous[position] = heads.get(key, -1)
+        heads[key] = position
+
+    while i + MIN_MATCH <= len(data):
+        best_length = 0
+        best_offset = 0
+        candidate = heads.get(data[i:i + MIN_MATCH], -1)
+        chain = 0
+        while candidate >= 0 and (i - candidate) <= window_size and chain < MAX_CHAIN:
+            length = 0
+            while i + length < len(data) and data[candidate + length] == data[i + length]:
+                length += 1
+            if length > best_length:
+                best_length = length
+                best_offset = i - candidate
+            candidate = previous[candidate]
+            chain += 1
+
+        if best_length < MIN_MATCH:
+            insert(i)
+            i += 1
+            continue
+
+        write_sequence(out, data[literal_start:i], best_offset, best_length)
+        for position in range(i, min(i + best_length, len(data) - MIN_MATCH + 1)):
+            insert(position)
+        i += best_length
+        literal_start = i
+
+    if literal_start < len(data) or len(data) == 0:
+        write_sequence(out, data[literal_start:], 0, 0)
+
+    return bytes(out)
+
+def decompress(stream: bytes, size: int, window_bits: int) -> bytes:
+    """Decompress data. Must match image::decoder."""
+    window_size = 1 << window_bits
+    out = bytearray()
+    i = 0
+
+    def read_length(length: int) -> int:
+        nonlocal i
+        while True:
+            byte = stream[i]
+            i += 1
+            length += byte
+            if byte != 255:
+                return length
+
+    while len(out) < size:
+        token = stream[i]
+        i += 1
+        literal_count = token >> 4
+        if literal_count == 15:
+            literal_count = read_length(literal_count)
+        out += stream[i:i + literal_count]
+        i += literal_count
+        if len(out) >= size:
+            break
+
+        offset = struct.unpack_from("<H", stream, i)[0]
+        i += 2
+        match_length = token & 0x0F
+        if match_length == 15:
+            match_length = read_length(match_length)
+        match_length += MIN_MATCH
+        if offset == 0 or offset > window_size or offset > len(out):
+            raise ValueError(f"invalid match offset {offset} at output position {len(out)}")
+        for _ in range(match_length):
+            out.append(out[-offset])
+
+    if len(out) != size:
+        raise ValueError(f"decoded {len(out)} bytes, expected {size}")
+    return bytes(out)
+
+def image_hash(app: bytes, hash_type: str) -> bytes:
+    """
+    Hash the application the way the bootloader hashes the update file for the update metadata (modules/hash).
+    """
+    if hash_type == "crc32":
+        # each byte is written to the CRC peripheral as a 32 bit word. no final xor
+        words = bytearray(len(app) * 4)
+        words[0::4] = app
+        return struct.pack("<I", zlib.crc32(words) ^ 0xFFFFFFFF)
+
+    return hashlib.sha256(app).digest()
+
+AES_SBOX = bytes.fromhex(
+    "637c777bf26b6fc53001672bfed7ab76ca82c97dfa5947f0add4a2af9ca472c0"
+    "b7fd9326363ff7cc34a5e5f171d8311504c723c31896059a071280e2eb27b275"
+    "09832c1a1b6e5aa0523bd6b329e32f8453d100ed20fcb15b6acbbe394a4c58cf"
+    "d0efaafb434d338545f9027f503c9fa851a3408f929d38f5bcb6da2110fff3d2"
+    "cd0c13ec5f974417c4a77e3d645d197360814fdc222a908846eeb814de5e0bdb"
+    "e0323a0a4906245cc2d3ac629195e479e7c8376d8dd54ea96c56f4ea657aae08"
+    "ba78252e1ca6b4c6e8dd741f4bbd8b8a703eb5664803f60e613557b986c11d9e"
+    "e1f8981169d98e949b1e87e9ce5528df8ca1890dbfe6426841992d0fb054bb16")
+
+def aes_xtime(x: int) -> int:
+    """Multiply by x in GF(2^8)."""
+    return ((x << 1) ^ (0x1B if x & 0x80 else 0)) & 0xFF
+
+def aes_expand_key(key: bytes) -> list:
+    """Expand an AES-128 key into the 11 round keys."""
+    words = [list(key[i:i + 4]) for i in range(0, 16, 4)]
+    rcon = 1
+    for i in range(4, 44):
+        t = list(words[i - 1])
+        if i % 4 == 0:
+            t = [AES_SBOX[t[1]] ^ rcon, AES_SBOX[t[2]], AES_SBOX[t[3]], AES_SBOX[t[0]]]
+            rcon = aes_xtime(rcon)
+        words.append([a ^ b for a, b in zip(words[i - 4], t)])
+    return [sum(words[i:i + 4], []) for i in range(0, 44, 4)]
+
+def aes_encrypt_block(round_keys: list, block: bytes) -> bytes:
+    """Encrypt one 16 byte block, the state column by column as in FIPS-197."""
+    state = [b ^ k for b, k in zip(block, round_keys[0])]
+    for round_number in range(1, 11):
+        # SubBytes and ShiftRows: row r of column c moves to column c - r
+        state = [AES_SBOX[state[(((i // 4) + (i % 4)) % 4) * 4 + (i % 4)]] for i in range(16)]
+        if round_number < 10:
+            mixed = []
+            for column in range(0, 16, 4):
+                a = state[column:column + 4]
+                total = a[0] ^ a[1] ^ a[2] ^ a[3]
+                mixed += [a[row] ^ total ^ aes_xtime(a[row] ^ a[(row + 1) % 4]) for row in range(4)]
+            state = mixed
+        state = [b ^ k for b, k in zip(state, round_keys[round_number])]
+    return bytes(state)
+
+def aes_ctr(key: bytes, nonce: bytes, data: bytes, offset: int = 0) -> bytes:
+    """
+    Encrypt or decrypt data found at an offset of the application data, in CTR mode.
+    Must match aes::apply_ctr: the counter block of the 16 bytes at offset n is the nonce followed by n / 16, big endian.
+    """
+    round_keys = aes_expand_key(key)
+    out = bytearray()
+    position = offset
+    while len(out) < len(data):
+        counter, skip = divmod(position, 16)
+        key_stream = aes_encrypt_block(round_keys, nonce + struct.pack(">I", counter))[skip:]
+        chunk = data[len(out):len(out) + len(key_stream)]
+        out += bytes(a ^ b for a, b in zip(chunk, key_stream))
+        position += len(chunk)
+    return bytes(out)
+
+def key_check(key: bytes) -> bytes:
+    """The first 4 bytes of the encryption of 16 zero bytes, telling the bootloader whether it has the key."""
+    return aes_encrypt_block(aes_expand_key(key), bytes(16))[:4]
+
+def decrypt_in_pieces(key: bytes, nonce: bytes, data: bytes) -> bytes:
+    """Decrypt the way the bootloader does, in pieces not aligned to the AES blocks, to check the stream continues."""
+    sizes = [1, 15, 17, 509, 512, 3]
+    out = bytearray()
+    i = 0
+    while len(out) < len(data):
+        piece = data[len(out):len(out) + sizes[i % len(sizes)]]
+        out += aes_ctr(key, nonce, piece, len(out))
+        i += 1
+    return bytes(out)
+
+# the NIST P-256 curve, y^2 = x^3 - 3x + b mod p, with the base point g of order n
+P256_P = 0xFFFFFFFF00000001000000000000000000000000FFFFFFFFFFFFFFFFFFFFFFFF
+P256_N = 0xFFFFFFFF00000000FFFFFFFFFFFFFFFFBCE6FAADA7179E84F3B9CAC2FC632551
+P256_B = 0x5AC635D8AA3A93E7B3EBBD55769886BC651D06B0CC53B0F63BCE3C3E27D2604B
+P256_G = (0x6B17D1F2E12C4247F8BCE6E563A440F277037D812DEB33A0F4A13945D898C296,
+          0x4FE342E2FE1A7F9B8EE7EB4A7C0F9E162BCE33576B315ECECBB6406837BF51F5)
+
+def p256_add(a: tuple, b: tuple) -> tuple:
+    """Add two points in affine coordinates, None being the point at infinity."""
+    if a is None:
+        return b
+    if b is None:
+        return a
+    if a[0] == b[0] and (a[1] + b[1]) % P256_P == 0:
+        return None
+    if a == b:
+        slope = (3 * a[0] * a[0] - 3) * pow(2 * a[1], -1, P256_P)
+    else:
+        slope = (b[1] - a[1]) * pow(b[0] - a[0], -1, P256_P)
+    x = (slope * slope - a[0] - b[0]) % P256_P
+    return x, (slope * (a[0] - x) - a[1]) % P256_P
+
+def p256_multiply(k: int, point: tuple) -> tuple:
+    """Multiply a point by a number."""
+    result = None
+    for bit in bin(k)[2:]:
+        result = p256_add(result, result)
+        if bit == "1":
+            result = p256_add(result, point)
+    return result
+
+def public_key(private_key: int) -> bytes:
+    """The public key of a private key, as IMAGE_PUBLIC_KEY wants it: x followed by y, big endian."""
+    x, y = p256_multiply(private_key, P256_G)
+    return x.to_bytes(32, "big") + y.to_bytes(32, "big")
+
+def ecdsa_sign(private_key: int, digest: bytes) -> bytes:
+    """
+    Sign a digest using ECDSA on P-256, r followed by s, big endian.
+    The nonce is derived from the key and the digest (RFC 6979), so the same application always gets the same signature.
+    """
+    e = int.from_bytes(digest, "big") % P256_N
+    x = private_key.to_bytes(32, "big") + e.to_bytes(32, "big")
+    k_hmac, v = bytes(32), b"\x01" * 32
+    k_hmac = hmac.new(k_hmac, v + b"\x00" + x, hashlib.sha256).digest()
+    v = hmac.new(k_hmac, v, hashlib.sha256).digest()
+    k_hmac = hmac.new(k_hmac, v + b"\x01" + x, hashlib.sha256).digest()
+    v = hmac.new(k_hmac, v, hashlib.sha256).digest()
+    while True:
+        v = hmac.new(k_hmac, v, hashlib.sha256).digest()
+        k = int.from_bytes(v, "big")
+        if 0 < k < P256_N:
+            r = p256_multiply(k, P256_G)[0] % P256_N
+            s = (pow(k, -1, P256_N) * (e + r * private_key)) % P256_N
+            if r != 0 and s != 0:
+                return r.to_bytes(32, "big") + s.to_bytes(32, "big")
+        k_hmac = hmac.new(k_hmac, v + b"\x00", hashlib.sha256).digest()
+        v = hmac.new(k_hmac, v, hashlib.sha256).digest()
+
+def ecdsa_verify(key: bytes, digest: bytes, signature: bytes) -> bool:
+    """Verify a signature the way ecdsa::verify does."""
+    r, s = int.from_bytes(signature[:32], "big"), int.from_bytes(signature[32:], "big")
+    if not (0 < r < P256_N and 0 < s < P256_N):
+        return False
+    w = pow(s, -1, P256_N)
+    e = int.from_bytes(digest, "big") % P256_N
+    point = (int.from_bytes(key[:32], "big"), int.from_bytes(key[32:], "big"))
+    total = p256_add(p256_multiply((e * w) % P256_N, P256_G), p256_multiply((r * w) % P256_N, point))
+    return total is not None and total[0] % P256_N == r
+
+def read_sign_key(path: str, create: bool) -> int:
+    """Read a private key of 64 hex digits from a file. with create, a new random key is written to the file first."""
+    if create:
+        private_key = int.from_bytes(os.urandom(40), "big") % (P256_N - 1) + 1
+        with open(path, "x") as f:
+            f.write(f"{private_key:064X}\n")
+        os.chmod(path, 0o600)
+
+    with open(path, "r") as f:
+        text = f.read().strip()
+    if len(text) != 64:
+        raise ValueError("sign key must be 64 hex digits")
+    private_key = int(text, 16)
+    if not 0 < private_key < P256_N:
+        raise ValueError("sign key out of range")
+    return private_key
+
+def write_number(out: bytearray, number: int):
+    """Write a LEB128 number."""
+    while number >= 0x80:
+        out.append((number & 0x7F) | 0x80)
+        number >>= 7
+    out.append(number)
+
+def copy_bound(position: int, length: int) -> int:
+    """Get the lowest source offset a copy to position may start at, so the delta can be applied in place."""
+    sector_start = position - (position % SECTOR_SIZE)
+    return position if position + length > sector_start + SECTOR_SIZE else sector_start
+
+def match_length(source: bytes, offset: int, target: bytes, position: int) -> int:
+    """Get the number of equal bytes of source at offset and target at position."""
+    limit = min(len(source) - offset, len(target) - position)
+    length = 0
+    while length + 64 <= limit and source[offset + length:offset + length + 64] == target[position + length:position + length + 64]:
+        length += 64
+    while length < limit and source[offset + length] == target[position + length]:
+        length += 1
+    return length
+
+def diff(source: bytes, target: bytes) -> bytes:
+    """
+    Create the delta rebuilding target from source, using greedy matching on 8 byte prefixes.
+    Copies that would read from already rewritten sectors are cut short or skipped.
+    """
+    index = {}
+    for offset in range(len(source) - MIN_COPY + 1):
+        index.setdefault(source[offset:offset + MIN_COPY], []).append(offset)
+
+    out = bytearray()
+    literal_start = 0
+    shift = 0
+    position = 0
+    while position + MIN_COPY <= len(target):
+        # try the offset of the last copy first, code that didn't change moved by the same amount
+        candidates = index.get(target[position:position + MIN_COPY], [])
+        start = bisect.bisect_left(candidates, position - (position % SECTOR_SIZE))
+        tries = candidates[start:start + MAX_CANDIDATES]
+        if 0 <= position + shift < len(source):
+            tries = [position + shift] + tries
+
+        best_length = 0
+        best_offset = 0
+        for offset in tries:
+            length = match_length(source, offset, target, position)
+            if offset < copy_bound(position, length):
+                # cut the copy off at the end of the sector
+                length = min(length, SECTOR_SIZE - (position % SECTOR_SIZE))
+                if offset < copy_bound(position, length):
+                    continue
+            if length > best_length:
+                best_length = length
+                best_offset = offset
+
+        if best_length < MIN_COPY:
+            position += 1
+            continue
+
+        write_number(out, position - literal_start)
+        out += target[literal_start:position]
+        write_number(out, best_length)
+        write_number(out, best_offset)
+        shift = best_offset - position
+        position += best_length
+        literal_start = position
+
+    if literal_start < len(target):
+        write_number(out, len(target) - literal_start)
+        out += target[literal_start:]
+
+    return bytes(out)
+
+def patch(source: bytes, delta: bytes, size: int) -> bytes:
+    """Apply a delta. Must match image::patcher."""
+    out = bytearray()
+    i = 0
+
+    def read_number() -> int:
+        nonlocal i
+        number = 0
+        shift = 0
+        while True:
+            byte = delta[i]
+            i += 1
+            number |= (byte & 0x7F) << shift
+            shift += 7
+            if byte & 0x80 == 0:
+                return number
+
+    while len(out) < size:
+        literal_count = read_number()
+        out += delta[i:i + literal_count]
+        i += literal_count
+        if len(out) >= size:
+            break
+
+        length = read_number()
+        offset = read_number()
+        if offset + length > len(source) or offset < copy_bound(len(out), length):
+            raise ValueError(f"invalid copy from {offset} at output position {len(out)}")
+        out += source[offset:offset + length]
+
+    if len(out) != size or i != len(delta):
+        raise ValueError(f"patched {len(out)} bytes, expected {size}")
+    return bytes(out)
+
+def read_hex(path: str) -> dict:
+    """Read the data records of an Intel HEX file, as {address: bytes}."""
+    records = {}
+    base = 0
+    with open(path, "r") as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            raw = bytes.fromhex(line[1:]) if line.startswith(":") else b""
+            if len(raw) < 5 or len(raw) != raw[0] + 5 or sum(raw) & 0xFF != 0:
+                raise ValueError(f"{path}:{number}: invalid record")
+
+            length, address, record_type = raw[0], (raw[1] << 8) | raw[2], raw[3]
+            data = raw[4:4 + length]
+            if record_type == 0x00:
+                records[base + address] = data
+            elif record_type == 0x01:
+                break
+            elif record_type == 0x02:
+                base = int.from_bytes(data, "big") << 4
+            elif record_type == 0x04:
+                base = int.from_bytes(data, "big") << 16
+    return records
+
+def read_elf(path: str) -> dict:
+    """Read the loadable segments of a 32-bit little endian ELF file, at their load (physical) addresses."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        raise ValueError(f"{path}: not a 32-bit little endian ELF file")
+
+    records = {}
+    phoff, = struct.unpack_from("<I", elf, 28)
+    phentsize, phnum = struct.unpack_from("<HH", elf, 42)
+    for i in range(phnum):
+        p_type, p_offset, _, p_paddr, p_filesz = struct.unpack_from("<IIIII", elf, phoff + i * phentsize)
+        # PT_LOAD, without the zero-initialized part that isn't in flash
+        if p_type == 1 and p_filesz > 0:
+            records[p_paddr] = elf[p_offset:p_offset + p_filesz]
+    return records
+
+def read_app(path: str, load_address: int) -> bytes:
+    """Read the application, flattened to a binary starting at the load address if it is an Intel HEX or ELF file."""
+    if path.lower().endswith((".hex", ".ihex")):
+        records = read_hex(path)
+    elif path.lower().endswith(".elf"):
+        records = read_elf(path)
+    else:
+        with open(path, "rb") as f:
+            return f.read()
+
+    if not records:
+        raise ValueError(f"{path}: no data")
+    if min(records) < load_address:
+        raise ValueError(f"{path}: data at 0x{min(records):X}, below the load address 0x{load_address:X}")
+
+    app = bytearray(b"\xff" * (max(address + len(data) for address, data in records.items()) - load_address))
+    for address, data in records.items():
+        app[address - load_address:address - load_address + len(data)] = data
+    return bytes(app)
+
+def find_segments(app: bytes) -> list:
+    """Split the application into segments, leaving out runs of at least MIN_GAP 0xFF bytes, as (offset, length)."""
+    segments = []
+    start = None
+    gap = 0
+    for offset, byte in enumerate(app):
+        if byte != 0xFF:
+            if start is None:
+                start = offset
+            elif gap >= MIN_GAP:
+                segments.append((start, offset - gap - start))
+                start = offset
+            gap = 0
+        else:
+            gap += 1
+    if start is not None:
+        segments.append((start, len(app) - gap - start))
+    if not segments:
+        raise ValueError("application is all 0xFF")
+
+    # the bootloader has a fixed segment table, so the shortest gaps are closed until the segments fit it
+    while len(segments) > MAX_SEGMENTS:
+        i = min(range(len(segments) - 1), key=lambda i: segments[i + 1][0] - (segments[i][0] + segments[i][1]))
+        segments[i:i + 2] = [(segments[i][0], segments[i + 1][0] + segments[i + 1][1] - segments[i][0])]
+    return segments
+
+def unsparse(data: bytes, segments: list, size: int) -> bytes:
+    """Rebuild the application from the segment data. Must match image::read_sparse."""
+    app = bytearray(b"\xff" * size)
+    position = 0
+    end = 0
+    for offset, length in segments:
+        if length == 0 or offset < end or offset + length > size:
+            raise ValueError(f"invalid segment at {offset}, {length} bytes")
+        app[offset:offset + length] = data[position:position + length]
+        position += length
+        end = offset + length
+    if position != len(data):
+        raise ValueError(f"segments hold {position} bytes, expected {len(data)}")
+    return bytes(app)
+
+def build_manifest(app: bytes, load_address: int, hash_type: str) -> bytes:
+    """Build the manifest of an application binary, followed by the CRC32 of each sector as programmed."""
+    # the bootloader pads the application with 0xFF to whole words
+    programmed = app + b"\xff" * (-len(app) % 4)
+    sectors = [programmed[start:start + SECTOR_SIZE] for start in range(0, len(programmed), SECTOR_SIZE)]
+    if len(sectors) > MAX_SECTORS:
+        raise ValueError(f"application too large for a manifest, {len(sectors)} sectors")
+
+    manifest = struct.pack(MANIFEST_FORMAT, load_address, len(sectors), HASH_TYPES[hash_type], image_hash(app, hash_type))
+    return manifest + b"".join(struct.pack("<I", zlib.crc32(sector)) for sector in sectors)
+
+def pack(app: bytes, compressed: bool, window_bits: int, source: bytes = None, hash_type: str = "sha256", load_address: int = None, sparse: bool = False,
+         key: bytes = None, nonce: bytes = None, sign_key: int = None) -> bytes:
+    """
+    Build the image of an application binary. with a source, build a delta image against it.
+    with a load address, add a manifest. sparse images only hold the segments of the application.
+    with a key, encrypt the application data using the nonce. with a sign key, sign the application.
+    """
+    data = app
+    flags = 0
+    delta_header = b""
+    sparse_header = b""
+    if sparse:
+        if source is not None:
+            raise ValueError("sparse images can't be delta images")
+        segments = find_segments(app)
+        data = b"".join(app[offset:offset + length] for offset, length in segments)
+        if unsparse(data, segments, len(app)) != app:
+            raise ValueError("segments do not rebuild the application")
+        flags |= FLAG_SPARSE
+        sparse_header = struct.pack(SPARSE_HEADER_FORMAT, len(segments)) + b"".join(struct.pack(SEGMENT_FORMAT, *segment) for segment in segments)
+
+    if source is not None:
+        data = diff(source, app)
+        if patch(source, data, len(app)) != app:
+            raise ValueError("delta does not rebuild the application")
+        flags |= FLAG_DELTA
+        delta_header = struct.pack(DELTA_HEADER_FORMAT, len(source), len(data), HASH_TYPES[hash_type],
+                                   image_hash(source, hash_type), image_hash(app, hash_type))
+
+    if compressed:
+        raw = data
+        data = compress(raw, window_bits)
+        if decompress(data, len(raw), window_bits) != raw:
+            raise ValueError("compressed data does not decode to the application")
+        flags |= FLAG_COMPRESSED
+    else:
+        window_bits = 0
+
+    encryption_header = b""
+    if key is not None:
+        plain = data
+        data = aes_ctr(key, nonce, plain)
+        if decrypt_in_pieces(key, nonce, data) != plain:
+            raise ValueError("encrypted data does not decrypt to the application data")
+        flags |= FLAG_ENCRYPTED
+        encryption_header = struct.pack(ENCRYPTION_HEADER_FORMAT, nonce, key_check(key))
+
+    # the signature is over the update metadata hash, which the bootloader calculates from the data before erasing
+    signature = b""
+    if sign_key is not None:
+        if hash_type != "sha256":
+            raise ValueError("signed images require the sha256 hash")
+        digest = image_hash(app, hash_type)
+        signature = ecdsa_sign(sign_key, digest)
+        if not ecdsa_verify(public_key(sign_key), digest, signature):
+            raise ValueError("signature does not verify")
+        flags |= FLAG_SIGNED
+        signature = struct.pack(SIGNATURE_FORMAT, signature[:32], signature[32:])
+
+    manifest = b""
+    if load_address is not None:
+        flags |= FLAG_MANIFEST
+        manifest = build_manifest(app, load_address, hash_type)
+
+    # the header CRC32 ends the header when there is a manifest
+    header_size = HEADER_SIZE + len(delta_header) + len(sparse_header) + len(encryption_header) + len(signature) + len(manifest) + (4 if manifest else 0)
+
+    # plain application data is read in SD card sectors straight from the file, so it starts on a sector boundary
+    padding = (-header_size % SD_SECTOR_SIZE) if flags & (FLAG_COMPRESSED | FLAG_DELTA) == 0 else 0
+    header_size += padding
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, header_size, flags, len(app), len(data), window_bits) + delta_header + sparse_header + encryption_header + signature + manifest + bytes(padding)
+    if manifest:
+        header += struct.pack("<I", zlib.crc32(header))
+    return header + data
+
+def pack_staged(app: bytes, hash_type: str) -> bytes:
+    """Build the contents of the staging slot: the application, then the trailer at the end of the slot."""
+    if len(app) == 0 or len(app) > STAGING_SLOT_SIZE:
+        raise ValueError(f"application does not fit the staging slot, {len(app)} bytes")
+
+    trailer = struct.pack(STAGING_TRAILER_FORMAT, STAGING_MAGIC, len(app), HASH_TYPES[hash_type], image_hash(app, hash_type))
+    trailer += struct.pack("<I", zlib.crc32(trailer))
+    return app + b"\xff" * (STAGING_SLOT_SIZE - len(app)) + trailer
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack an application binary into an OpenHC32Boot update image")
+    parser.add_argument("app", help="path of the application binary, or an Intel HEX (.hex) or ELF (.elf) file")
+    parser.add_argument("image", help="path of the image to create")
+    parser.add_argument("--uncompressed", action="store_true", help="store the application data uncompressed")
+    parser.add_argument("--window-bits", type=int, default=DEFAULT_WINDOW_BITS,
+                        help=f"log2 of the compression window size, {MIN_WINDOW_BITS} to {MAX_WINDOW_BITS}. "
+                             "must not be larger than COMPRESSED_IMAGE_WINDOW_BITS of the bootloader")
+    parser.add_argument("--delta-from", metavar="INSTALLED",
+                        help="path of the application binary installed on the printer. creates a delta image against it")
+    parser.add_argument("--hash", choices=HASH_TYPES.keys(), default="sha256",
+                        help="hash type of delta images and the manifest, must match METADATA_HASH of the bootloader")
+    parser.add_argument("--load-address", type=lambda value: int(value, 0), default=DEFAULT_LOAD_ADDRESS,
+                        help=f"address the application is built for, must match APP_BASE_ADDRESS of the bootloader. default 0x{DEFAULT_LOAD_ADDRESS:X}")
+    parser.add_argument("--no-manifest", action="store_true", help="don't add a manifest")
+    parser.add_argument("--sparse", action="store_true",
+                        help="leave out runs of 0xFF bytes, requires ENABLE_SPARSE_IMAGES of the bootloader")
+    parser.add_argument("--key", type=bytes.fromhex,
+                        help="encrypt the application data with this AES-128 key, 32 hex digits. requires ENABLE_ENCRYPTED_IMAGES of the bootloader")
+    parser.add_argument("--nonce", type=bytes.fromhex, help="nonce of the encryption, 24 hex digits. random by default")
+    parser.add_argument("--sign-key", metavar="KEY_FILE",
+                        help="sign the application with the private key in this file, 64 hex digits. requires ENABLE_SIGNED_IMAGES of the bootloader")
+    parser.add_argument("--new-sign-key", action="store_true", help="create a new private key in the --sign-key file first")
+    parser.add_argument("--staged", action="store_true",
+                        help="create the contents of the staging slot instead of an update file, see modules/staging_format.h")
+    args = parser.parse_args()
+
+    if args.window_bits < MIN_WINDOW_BITS or args.window_bits > MAX_WINDOW_BITS:
+        print(f"window bits must be between {MIN_WINDOW_BITS} and {MAX_WINDOW_BITS}", file=sys.stderr)
+        sys.exit(1)
+
+    if args.key is not None and len(args.key) != 16:
+        print("key must be 32 hex digits", file=sys.stderr)
+        sys.exit(1)
+    if args.nonce is not None and len(args.nonce) != 12:
+        print("nonce must be 24 hex digits", file=sys.stderr)
+        sys.exit(1)
+
+    if args.new_sign_key and args.sign_key is None:
+        print("--new-sign-key requires --sign-key", file=sys.stderr)
+        sys.exit(1)
+    if args.sign_key is not None and args.staged:
+        print("staged updates can't be signed", file=sys.stderr)
+        sys.exit(1)
+    sign_key = read_sign_key(args.sign_key, args.new_sign_key) if args.sign_key is not None else None
+
+    app = read_app(args.app, args.load_address)
+
+    source = None
+    if args.delta_from:
+        with open(args.delta_from, "rb") as f:
+            source = f.read()
+
+    if args.staged:
+        image = pack_staged(app, args.hash)
+    else:
+        image = pack(app, not args.uncompressed, args.window_bits, source, args.hash, None if args.no_manifest else args.load_address, args.sparse,
+                     args.key, args.nonce or os.urandom(12), sign_key)
+    with open(args.image, "wb") as f:
+        f.write(image)
+
+    print(f"{args.app}: {len(app)} bytes -> {args.image}: {len(image)} bytes ({(100.0 * len(image)) / max(len(app), 1):.1f} %)")
+    if sign_key is not None:
+        print(f"signed, IMAGE_PUBLIC_KEY \"{public_key(sign_key).hex().upper()}\"")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""
+Convert the boot timing summary of a bootloader built with ENABLE_PROFILER=1 to CSV.
+
+The bootloader version is taken from the firmware ID line ("OpenHC32Boot A:... V:...") preceding the summary,
+so captures of different releases can be collected in a single file.
+Every summary in the capture results in one set of rows, numbered by the 'boot' column.
+
+Usage:
+  profile_to_csv.py capture.log > profile.csv
+  profile_to_csv.py --append profile.csv < capture.log
+"""
+import re
+import sys
+import csv
+import argparse
+from os import path
+
+# must match the output of profiler::print()
+PROFILE_PREFIX = "profile:"
+FWID_PATTERN = re.compile(r"OpenHC32Boot A:(\S+) V:(\S+)")
+COLUMNS = ["version", "boot", "stage", "cycles", "ms", "bytes", "mb_per_s"]
+
+def parse_value(value: str):
+    """Parse a summary value, '-' means not available."""
+    return "" if value == "-" else value
+
+def parse(lines) -> list:
+    """Parse the summary lines of a capture into a list of rows."""
+    rows = []
+    version = "unknown"
+    boot = -1
+
+    for line in lines:
+        fwid = FWID_PATTERN.search(line)
+        if fwid is not None:
+            version = fwid.group(2)
+            continue
+
+        index = line.find(PROFILE_PREFIX)
+        if index < 0:
+            continue
+
+        fields = line[index + len(PROFILE_PREFIX):].split()
+        if len(fields) != 5:
+            print(f"skipping malformed line: {line.strip()}", file=sys.stderr)
+            continue
+
+        # header starts a new summary
+        if fields[0] == "stage":
+            boot += 1
+            continue
+
+        stage, cycles, ms, size, rate = fields
+        rows.append({
+            "version": version,
+            "boot": max(boot, 0),
+            "stage": stage,
+            "cycles": parse_value(cycles),
+            "ms": parse_value(ms),
+            "bytes": parse_value(size),
+            "mb_per_s": parse_value(rate),
+        })
+
+    return rows
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert the bootloader boot timing summary to CSV")
+    parser.add_argument("capture", nargs="?", help="host serial capture, stdin if omitted")
+    parser.add_argument("--append", metavar="CSV", help="append to a CSV file instead of writing to stdout")
+    args = parser.parse_args()
+
+    if args.capture is not None:
+        with open(args.capture, "r", errors="replace") as f:
+            rows = parse(f)
+    else:
+        rows = parse(sys.stdin)
+
+    if len(rows) == 0:
+        print("no profile summary found", file=sys.stderr)
+        sys.exit(1)
+
+    if args.append is not None:
+        write_header = not path.exists(args.append) or path.getsize(args.append) == 0
+        with open(args.append, "a", newline="") as f:
+            writer = csv.DictWriter(f, fieldnames=COLUMNS)
+            if write_header:
+                writer.writeheader()
+            writer.writerows(rows)
+    else:
+        writer = csv.DictWriter(sys.stdout, fieldnames=COLUMNS)
+        writer.writeheader()
+        writer.writerows(rows)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,316 @@
+#!/usr/bin/env python3
+"""
+Upload an update file to OpenHC32Boot over the host serial.
+
+Start the upload, then reset the printer: the bootloader listens for the uploader for SERIAL_UPDATE_WAIT
+milliseconds after it starts. The update file is the same as on the SD card, e.g. made by pack_image.py.
+The bootloader must be built with ENABLE_SERIAL_UPDATE, and the protocol must match modules/serial_update_format.h.
+
+The baud rate is raised up to --max-baud, as far as the bootloader, the serial adapter and the wiring allow.
+With --native, the native build is started instead of opening a serial port, receiving the upload on its stdin.
+Requires pyserial, unless --native is used.
+
+Usage:
+  serial_upload.py --port /dev/ttyUSB0 FIRMWARE.BIN
+  serial_upload.py --port COM3 --max-baud 460800 --verbose FIRMWARE.BIN
+  serial_upload.py --native .pio/build/native/program FIRMWARE.BIN
+"""
+import os
+import sys
+import time
+import zlib
+import queue
+import struct
+import argparse
+import threading
+import subprocess
+
+FRAME_SYNC = 0xA5
+FRAME_HELLO = ord("H")
+FRAME_BAUD = ord("B")
+FRAME_PING = ord("P")
+FRAME_BEGIN = ord("S")
+FRAME_READ = ord("R")
+FRAME_DATA = ord("D")
+FRAME_END = ord("E")
+
+HELLO_MAGIC = 0x5542484F
+PROTOCOL_VERSION = 1
+HELLO_FORMAT = "<IB3xI"
+CHUNK_SIZE = 512
+MAX_PAYLOAD = 4 + CHUNK_SIZE
+
+RESULT_INSTALLED = 0
+
+DEFAULT_BAUD = 115200
+BAUD_RATES = [2000000, 1500000, 1000000, 921600, 500000, 460800, 250000, 230400, 115200]
+
+HELLO_INTERVAL = 0.1
+DEFAULT_UPDATE_TIMEOUT = 500
+
+
+class PortTransport:
+    """a serial port, using pyserial"""
+
+    def __init__(self, port, baudrate):
+        import serial
+        self.serial = serial.Serial(port, baudrate, timeout=0)
+
+    def write(self, data):
+        self.serial.write(data)
+        self.serial.flush()
+
+    def read(self):
+        return self.serial.read(self.serial.in_waiting or 1)
+
+    def set_baudrate(self, baudrate):
+        self.serial.flush()
+        self.serial.baudrate = baudrate
+
+    def close(self):
+        self.serial.close()
+        return None
+
+
+class NativeTransport:
+    """the host serial of the native build, over its stdin and stdout"""
+
+    def __init__(self, binary):
+        env = dict(os.environ)
+        env["NATIVE_USART2_RX"] = "/dev/stdin"
+        self.process = subprocess.Popen([binary], stdin=subprocess.PIPE, stdout=subprocess.PIPE, env=env)
+        self.output = queue.Queue()
+        threading.Thread(target=self._pump, daemon=True).start()
+
+    def _pump(self):
+        while True:
+            data = self.process.stdout.read1(4096)
+            self.output.put(data)
+            if not data:
+                break
+
+    def write(self, data):
+        try:
+            self.process.stdin.write(data)
+            self.process.stdin.flush()
+        except BrokenPipeError:
+            pass
+
+    def read(self):
+        try:
+            return self.output.get(timeout=0.01)
+        except queue.Empty:
+            return b""
+
+    def set_baudrate(self, baudrate):
+        # the native build only models the transfer time of the baud rate
+        pass
+
+    def close(self):
+        try:
+            self.process.stdin.close()
+        except BrokenPipeError:
+            pass
+        return self.process.wait()
+
+
+class Link:
+    """frames over a transport. bytes outside of frames are the log output of the bootloader"""
+
+    def __init__(self, transport, verbose):
+        self.transport = transport
+        self.verbose = verbose
+        self.buffer = bytearray()
+        self.line = bytearray()
+        self.frames = []
+
+    def send(self, frame_type, payload=b""):
+        header = struct.pack("<BH", frame_type, len(payload))
+        crc = zlib.crc32(header + payload)
+        self.transport.write(bytes([FRAME_SYNC]) + header + payload + struct.pack("<I", crc))
+
+    def _log(self, data):
+        for byte in data:
+            if byte == ord("\n"):
+                if self.verbose:
+                    print("< " + self.line.decode("ascii", "replace").rstrip())
+                self.line.clear()
+            else:
+                self.line.append(byte)
+
+    def _parse(self):
+        while self.buffer:
+            start = self.buffer.find(FRAME_SYNC)
+            if start < 0:
+                self._log(self.buffer)
+                self.buffer.clear()
+                return
+            self._log(self.buffer[:start])
+            del self.buffer[:start]
+
+            if len(self.buffer) < 4:
+                return
+            frame_type, length = struct.unpack_from("<BH", self.buffer, 1)
+            if length <= MAX_PAYLOAD:
+                if len(self.buffer) < 4 + length + 4:
+                    return
+                payload = bytes(self.buffer[4:4 + length])
+                (crc,) = struct.unpack_from("<I", self.buffer, 4 + length)
+                if crc == zlib.crc32(self.buffer[1:4] + payload):
+                    self.frames.append((frame_type, payload))
+                    del self.buffer[:4 + length + 4]
+                    continue
+
+            # not a frame after all
+            self._log(self.buffer[:1])
+            del self.buffer[:1]
+
+    def poll(self):
+        """receive what has arrived, return the next frame or None"""
+        if not self.frames:
+            data = self.transport.read()
+            if data:
+                self.buffer += data
+                self._parse()
+        return self.frames.pop(0) if self.frames else None
+
+    def receive(self, timeout, frame_types):
+        """wait for a frame of one of the types, dropping others"""
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            frame = self.poll()
+            if frame is not None and frame[0] in frame_types:
+                return frame
+        return None
+
+
+def connect(link, wait):
+    """send HELLO until the bootloader answers, return its window size"""
+    hello = struct.pack(HELLO_FORMAT, HELLO_MAGIC, 0, 0)
+    deadline = time.monotonic() + wait
+    while time.monotonic() < deadline:
+        link.send(FRAME_HELLO, hello)
+        frame = link.receive(HELLO_INTERVAL, [FRAME_HELLO])
+        if frame is None or len(frame[1]) < struct.calcsize(HELLO_FORMAT):
+            continue
+
+        magic, version, window_size = struct.unpack_from(HELLO_FORMAT, frame[1])
+        if magic != HELLO_MAGIC:
+            continue
+        if version != PROTOCOL_VERSION:
+            raise RuntimeError(f"bootloader speaks protocol version {version}, expected {PROTOCOL_VERSION}")
+        return window_size
+
+    raise RuntimeError("no answer from the bootloader, reset the printer while uploading")
+
+
+def raise_baudrate(link, baudrate, max_baudrate, update_timeout):
+    """try baud rates from max_baudrate down, return the one both sides use"""
+    # between one and two SERIAL_UPDATE_TIMEOUTs: the bootloader gave up on a baud rate, but still listens for the next try
+    baud_timeout = update_timeout * 1.5 / 1000
+    for candidate in [b for b in BAUD_RATES if baudrate < b <= max_baudrate]:
+        link.send(FRAME_BAUD, struct.pack("<I", candidate))
+        frame = link.receive(baud_timeout, [FRAME_BAUD])
+        if frame is None or len(frame[1]) < 4 or struct.unpack_from("<I", frame[1])[0] != candidate:
+            continue
+
+        link.transport.set_baudrate(candidate)
+        ping = os.urandom(4)
+        link.send(FRAME_PING, ping)
+        frame = link.receive(baud_timeout, [FRAME_PING])
+        if frame is not None and frame[1] == ping:
+            return candidate
+
+        # the bootloader went back as well, without the PING
+        link.transport.set_baudrate(baudrate)
+        link.buffer.clear()
+        link.frames.clear()
+
+    return baudrate
+
+
+def upload(link, data, timeout):
+    """serve READs of the bootloader until it sends END, return the result, the bytes sent and the READs sent again"""
+    link.send(FRAME_BEGIN, struct.pack("<I", len(data)))
+    sent = 0
+    retries = 0
+    window = (0, 0)
+    request = None
+    while True:
+        if request is None:
+            frame = link.receive(timeout, [FRAME_READ, FRAME_END])
+            if frame is None:
+                raise RuntimeError("bootloader stopped reading")
+        else:
+            frame = link.poll()
+
+        if frame is not None and frame[0] == FRAME_END:
+            return frame[1][0] if frame[1] else None, sent, retries
+        if frame is not None and frame[0] == FRAME_READ and len(frame[1]) >= 8:
+            # a READ inside the previous window means a chunk was lost, the rest of the window is abandoned.
+            # a READ before it starts another pass over the file
+            offset, length = struct.unpack_from("<II", frame[1])
+            if window[0] <= offset < window[1]:
+                retries += 1
+            window = (offset, offset + length)
+            request = [offset, min(offset + length, len(data))]
+
+        if request is not None:
+            offset = request[0]
+            chunk = data[offset:min(offset + CHUNK_SIZE, request[1])]
+            link.send(FRAME_DATA, struct.pack("<I", offset) + chunk)
+            request[0] += len(chunk)
+            sent += len(chunk)
+            if request[0] >= request[1]:
+                request = None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Upload an update file to OpenHC32Boot over the host serial")
+    parser.add_argument("file", help="update file, e.g. FIRMWARE.BIN")
+    target = parser.add_mutually_exclusive_group(required=True)
+    target.add_argument("--port", help="serial port of the printer")
+    target.add_argument("--native", metavar="BINARY", help="run the native build instead")
+    parser.add_argument("--baud", type=int, default=DEFAULT_BAUD, help="HOST_SERIAL_BAUD of the bootloader")
+    parser.add_argument("--max-baud", type=int, default=max(BAUD_RATES), help="highest baud rate to try")
+    parser.add_argument("--update-timeout", type=int, default=DEFAULT_UPDATE_TIMEOUT, help="SERIAL_UPDATE_TIMEOUT of the bootloader")
+    parser.add_argument("--wait", type=float, default=60, help="seconds to wait for the bootloader")
+    parser.add_argument("--timeout", type=float, default=10, help="seconds to wait for the next READ")
+    parser.add_argument("--verbose", action="store_true", help="print the log output of the bootloader")
+    args = parser.parse_args()
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+
+    transport = NativeTransport(args.native) if args.native else PortTransport(args.port, args.baud)
+    link = Link(transport, args.verbose)
+    try:
+        window_size = connect(link, args.wait)
+        baudrate = raise_baudrate(link, args.baud, args.max_baud, args.update_timeout)
+        print(f"connected at {baudrate} baud, window of {window_size} bytes")
+
+        start = time.monotonic()
+        result, sent, retries = upload(link, data, args.timeout)
+        elapsed = time.monotonic() - start
+        print(f"{sent} of {len(data)} bytes sent in {elapsed:.1f} s ({sent / 1024 / elapsed:.1f} KB/s), {retries} retries")
+    finally:
+        if args.native:
+            # the rest of the boot, until the native build exits
+            while True:
+                output = transport.read()
+                if not output and transport.process.poll() is not None and transport.output.empty():
+                    break
+                link.buffer += output
+                link._parse()
+        transport.close()
+
+    if result != RESULT_INSTALLED:
+        print("update failed, see the bootloader log", file=sys.stderr)
+        return 1
+
+    print("update installed")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -35,14 +35,139 @@ constexpr int host_allowed_baud_rates[] = {
 constexpr int host_baud = HOST_SERIAL_BAUD;
 static_assert(contains(host_allowed_baud_rates, host_baud), "HOST_SERIAL_BAUD must be a valid baud rate");
 
+// asynchronous logging requires the host serial, and a buffer size that allows cheap wrap-around
+#if LOG_ASYNC == 1
+  static_assert(HAS_SERIAL(HOST_SERIAL), "LOG_ASYNC requires HOST_SERIAL");
+  static_assert(LOG_BUFFER_SIZE >= 64 && LOG_BUFFER_SIZE <= 32768, "LOG_BUFFER_SIZE must be between 64 and 32768");
+  static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "LOG_BUFFER_SIZE must be a power of 2");
+  static_assert(LOG_OVERFLOW == LOG_OVERFLOW_BLOCK || LOG_OVERFLOW == LOG_OVERFLOW_DROP || LOG_OVERFLOW == LOG_OVERFLOW_DROP_DEBUG, "LOG_OVERFLOW must be a valid overflow policy");
+#endif
+
+// the profiler prints its summary to the host serial
+#if ENABLE_PROFILER == 1
+  static_assert(HAS_SERIAL(HOST_SERIAL), "ENABLE_PROFILER requires HOST_SERIAL");
+#endif
+
+// the benchmark results are printed to the host serial
+#if IS_PROFILE(BENCHMARK)
+  static_assert(HAS_SERIAL(HOST_SERIAL), "the BENCHMARK profile requires HOST_SERIAL");
+#endif
+
+// the decoder window must be within the limits of the image format
+#if ENABLE_COMPRESSED_IMAGES == 1
+  static_assert(COMPRESSED_IMAGE_WINDOW_BITS >= IMAGE_MIN_WINDOW_BITS && COMPRESSED_IMAGE_WINDOW_BITS <= IMAGE_MAX_WINDOW_BITS, "COMPRESSED_IMAGE_WINDOW_BITS must be between 8 and 16");
+#endif
+
+// delta images are checked against the update metadata of the installed application
+#if ENABLE_DELTA_IMAGES == 1
+  static_assert(STORE_UPDATE_METADATA == 1, "ENABLE_DELTA_IMAGES requires STORE_UPDATE_METADATA");
+  static_assert(METADATA_HASH != HASH_NONE, "ENABLE_DELTA_IMAGES requires a METADATA_HASH");
+#endif
+static_assert(IMAGE_HASH_CRC32 == HASH_CRC32 && IMAGE_HASH_SHA256 == HASH_SHA256, "image hash types must match METADATA_HASH");
+
+// encrypted images need a key, built in or in one of the 60 blocks of the OTP area
+#if ENABLE_ENCRYPTED_IMAGES == 1
+  #if IMAGE_KEY_SOURCE == IMAGE_KEY_BUILD
+    #if !defined(IMAGE_KEY)
+      #error "ENABLE_ENCRYPTED_IMAGES with IMAGE_KEY_BUILD requires IMAGE_KEY"
+    #endif
+    static_assert(sizeof(IMAGE_KEY) == 33, "IMAGE_KEY must be 32 hex digits");
+  #elif IMAGE_KEY_SOURCE == IMAGE_KEY_OTP
+    static_assert(IMAGE_KEY_OTP_BLOCK >= 0 && IMAGE_KEY_OTP_BLOCK <= 59, "IMAGE_KEY_OTP_BLOCK must be between 0 and 59");
+  #else
+    #error "IMAGE_KEY_SOURCE must be IMAGE_KEY_BUILD or IMAGE_KEY_OTP"
+  #endif
+#endif
+
+// the signature covers the SHA-256 metadata hash, and only applications with metadata written by a verified update boot
+#if ENABLE_SIGNED_IMAGES == 1
+  #if !defined(IMAGE_PUBLIC_KEY)
+    #error "ENABLE_SIGNED_IMAGES requires IMAGE_PUBLIC_KEY"
+  #endif
+  static_assert(sizeof(IMAGE_PUBLIC_KEY) == 129, "IMAGE_PUBLIC_KEY must be 128 hex digits");
+  static_assert(STORE_UPDATE_METADATA == 1, "ENABLE_SIGNED_IMAGES requires STORE_UPDATE_METADATA");
+  static_assert(METADATA_HASH == HASH_SHA256, "ENABLE_SIGNED_IMAGES requires METADATA_HASH HASH_SHA256");
+  static_assert(APP_INTEGRITY_CHECK != APP_INTEGRITY_CHECK_OFF, "ENABLE_SIGNED_IMAGES requires an APP_INTEGRITY_CHECK");
+  static_assert(ENABLE_STAGED_UPDATES == 0, "ENABLE_SIGNED_IMAGES is not available with ENABLE_STAGED_UPDATES");
+#endif
+
+// the image manifest describes the application in flash sectors
+static_assert(IMAGE_SECTOR_SIZE == flash::erase_sector_size, "IMAGE_SECTOR_SIZE must match the erase sector size");
+static_assert(((512ul * 1024ul) / IMAGE_SECTOR_SIZE) <= IMAGE_MAX_SECTORS, "IMAGE_MAX_SECTORS must cover the largest flash");
+
+// the sector CRC32s are kept in the stored update metadata
+#if METADATA_SECTOR_CRCS == 1
+  static_assert(STORE_UPDATE_METADATA == 1, "METADATA_SECTOR_CRCS requires STORE_UPDATE_METADATA");
+#endif
+
+// staged updates are checked against their hash, and installed once, tracked by the update metadata
+#if ENABLE_STAGED_UPDATES == 1
+  static_assert(STORE_UPDATE_METADATA == 1, "ENABLE_STAGED_UPDATES requires STORE_UPDATE_METADATA");
+  static_assert(METADATA_HASH != HASH_NONE, "ENABLE_STAGED_UPDATES requires a METADATA_HASH");
+  static_assert(APP_BASE_ADDRESS < STAGING_SLOT_ADDRESS, "APP_BASE_ADDRESS must be below the staging slot");
+  static_assert(STAGING_SLOT_ADDRESS % flash::erase_sector_size == 0 && STAGING_TRAILER_ADDRESS % flash::erase_sector_size == 0, "the staging slot must be sector aligned");
+  static_assert(STAGING_TRAILER_ADDRESS + (2 * flash::erase_sector_size) <= 0x80000, "the staging trailer must not share the sector of the update metadata");
+#endif
+
+// each slot keeps its update metadata, and the slot to roll back to is checked against its hash
+#if ENABLE_AB_SLOTS == 1
+  static_assert(STORE_UPDATE_METADATA == 1, "ENABLE_AB_SLOTS requires STORE_UPDATE_METADATA");
+  static_assert(METADATA_HASH != HASH_NONE, "ENABLE_AB_SLOTS requires a METADATA_HASH");
+  static_assert(ENABLE_DELTA_IMAGES == 0, "ENABLE_AB_SLOTS is not available with ENABLE_DELTA_IMAGES");
+  static_assert(ENABLE_STAGED_UPDATES == 0, "ENABLE_AB_SLOTS is not available with ENABLE_STAGED_UPDATES");
+  static_assert(APP_BASE_ADDRESS < SLOT_B_ADDRESS, "APP_BASE_ADDRESS must be below slot B");
+  static_assert(SLOT_B_ADDRESS % flash::erase_sector_size == 0 && SLOT_RECORD_ADDRESS_0 % flash::erase_sector_size == 0 && SLOT_RECORD_ADDRESS_1 % flash::erase_sector_size == 0, "the slots must be sector aligned");
+  static_assert(SLOT_B_ADDRESS + (SLOT_B_ADDRESS - APP_BASE_ADDRESS) <= SLOT_RECORD_ADDRESS_0, "slot B must end before the slot records");
+  static_assert(SLOT_BOOT_ATTEMPTS >= 1 && SLOT_BOOT_ATTEMPTS <= 32, "SLOT_BOOT_ATTEMPTS must be between 1 and 32");
+#endif
+
+// serial updates are received over the host serial, and their result is told from the stored update metadata
+#if ENABLE_SERIAL_UPDATE == 1
+  static_assert(HAS_SERIAL(HOST_SERIAL), "ENABLE_SERIAL_UPDATE requires HOST_SERIAL");
+  #if !defined(HOST_SERIAL_RX)
+    #error "ENABLE_SERIAL_UPDATE requires HOST_SERIAL_RX"
+  #endif
+  static_assert(STORE_UPDATE_METADATA == 1, "ENABLE_SERIAL_UPDATE requires STORE_UPDATE_METADATA");
+  static_assert(SERIAL_UPDATE_WINDOW_SIZE >= SERIAL_CHUNK_SIZE && SERIAL_UPDATE_WINDOW_SIZE <= 65536 && SERIAL_UPDATE_WINDOW_SIZE % SERIAL_CHUNK_SIZE == 0, "SERIAL_UPDATE_WINDOW_SIZE must be a multiple of SERIAL_CHUNK_SIZE, up to 64 KB");
+  static_assert(SERIAL_UPDATE_MAX_BAUD >= HOST_SERIAL_BAUD, "SERIAL_UPDATE_MAX_BAUD must not be below HOST_SERIAL_BAUD");
+#endif
+
+// the integrity check compares the application with the hash in the stored update metadata
+static_assert(APP_INTEGRITY_CHECK == APP_INTEGRITY_CHECK_OFF || APP_INTEGRITY_CHECK == APP_INTEGRITY_CHECK_ONCE || APP_INTEGRITY_CHECK == APP_INTEGRITY_CHECK_ALWAYS, "APP_INTEGRITY_CHECK must be a valid mode");
+#if APP_INTEGRITY_CHECK != APP_INTEGRITY_CHECK_OFF
+  static_assert(STORE_UPDATE_METADATA == 1, "APP_INTEGRITY_CHECK requires STORE_UPDATE_METADATA");
+  static_assert(METADATA_HASH != HASH_NONE, "APP_INTEGRITY_CHECK requires a METADATA_HASH");
+#endif
+
+// the boot trace must fit into the retention SRAM
+#if ENABLE_BOOT_TRACE == 1
+  static_assert(BOOT_TRACE_ADDRESS >= 0x200F0000ul && (BOOT_TRACE_ADDRESS + sizeof(boot_trace_t)) <= 0x200F1000ul, "BOOT_TRACE_ADDRESS must be in the retention SRAM");
+  static_assert((BOOT_TRACE_ADDRESS % 4) == 0, "BOOT_TRACE_ADDRESS must be 4-byte aligned");
+#endif
+
+// screen serial should use a baud rate the USART divider can hit with 8 MHz PCLK1
+#if IS_SCREEN(SCREEN_DWIN)
+  constexpr int screen_allowed_baud_rates[] = {
+    115200, 230400, 460800, 921600
+  };
+  constexpr int screen_baud = SCREEN_SERIAL_BAUD;
+  static_assert(contains(screen_allowed_baud_rates, screen_baud), "SCREEN_SERIAL_BAUD must be a valid baud rate");
+#endif
+
 // pins should not be reused
 constexpr gpio::pin_t sdio_pins[] = SDIO_PINS;
 constexpr gpio::pin_t loose_pins[] = {
   #if HAS_SERIAL(HOST_SERIAL)
     HOST_SERIAL_TX,
+    #if defined(HOST_SERIAL_RX)
+      HOST_SERIAL_RX,
+    #endif
   #endif
   #if HAS_SERIAL(SCREEN_SERIAL)
     SCREEN_SERIAL_TX,
+    #if defined(SCREEN_SERIAL_RX)
+      SCREEN_SERIAL_RX,
+    #endif
   #endif
   #if defined(BEEPER_PIN)
     BEEPER_PIN,
@@ -62,8 +187,37 @@ constexpr gpio::pin_t debug_pins[] = {
   gpio::PB4,  // NJTRST
 };
 
-static_assert(!containsAny(debug_pins, sdio_pins), "Debug interface pins must not be used");
-static_assert(!containsAny(debug_pins, loose_pins), "Debug interface pins must not be used");
+// unless they are released from the debug interface by COMPAT_DISABLE_DEBUG_PORT
+constexpr uint32_t debug_pin_masks[] = {
+  COMPAT_DBG_SWDIO,
+  COMPAT_DBG_SWCLK,
+  COMPAT_DBG_JTDI,
+  COMPAT_DBG_JTDO,
+  COMPAT_DBG_NJTRST,
+};
+
+#if defined(COMPAT_DISABLE_DEBUG_PORT)
+  constexpr uint32_t released_debug_pins = COMPAT_DISABLE_DEBUG_PORT;
+#else
+  constexpr uint32_t released_debug_pins = 0;
+#endif
+
+template <int N>
+constexpr bool uses_debug_pins(const gpio::pin_t (&pins)[N])
+{
+  for (size_t i = 0; i < sizeof(debug_pins) / sizeof(debug_pins[0]); ++i)
+  {
+    if ((released_debug_pins & debug_pin_masks[i]) == 0 && contains(pins, debug_pins[i]))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static_assert(!uses_debug_pins(sdio_pins), "Debug interface pins must not be used");
+static_assert(!uses_debug_pins(loose_pins), "Debug interface pins must not be used");
 
 
 // SDIO pins must be valid for either 1-bit, 4-bit or 8-bit bus width
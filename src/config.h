@@ -3,8 +3,9 @@
 #include "config/boards.h"
 
 // configuration profile
-// one of [ TINY, SMALL, FULL ]
-// use SMALL unless you know what you're doing
+// one of [ TINY, SMALL, FULL, BENCHMARK ]
+// use SMALL unless you know what you're doing.
+// BENCHMARK does not apply updates, but measures SD, flash and serial throughput
 #ifndef CONFIG_PROFILE
   #define CONFIG_PROFILE CONFIG_PROFILE_SMALL
 #endif
@@ -1,5 +1,6 @@
 //
 // Select DWIN screen in portrait mode and 272x480 resolution
+// switching to 460800 baud after the handshake, if the board has a screen RX pin
 //
 #pragma once
 #ifndef SCREEN_DRIVER
@@ -11,3 +12,6 @@
 #ifndef SCREEN_DIMENSIONS
   #define SCREEN_DIMENSIONS { 272, 480 }
 #endif
+#ifndef SCREEN_SERIAL_BAUD
+  #define SCREEN_SERIAL_BAUD 460800
+#endif
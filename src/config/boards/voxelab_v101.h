@@ -16,9 +16,15 @@
 #ifndef HOST_SERIAL_TX
   #define HOST_SERIAL_TX gpio::PA9
 #endif
+#ifndef HOST_SERIAL_RX
+  #define HOST_SERIAL_RX gpio::PA15
+#endif
 #ifndef SCREEN_SERIAL_TX
   #define SCREEN_SERIAL_TX gpio::PC0
 #endif
+#ifndef SCREEN_SERIAL_RX
+  #define SCREEN_SERIAL_RX gpio::PC1
+#endif
 
 // Beeper pin
 #ifndef BEEPER_PIN
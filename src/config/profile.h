@@ -7,6 +7,8 @@
   #include "profiles/small.h"
 #elif IS_PROFILE(TINY)
   #include "profiles/tiny.h"
+#elif IS_PROFILE(BENCHMARK)
+  #include "profiles/benchmark.h"
 #else
   #error "Unknown configuration profile"
 #endif
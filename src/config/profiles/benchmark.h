@@ -0,0 +1,23 @@
+//
+// OpenHC32Boot benchmark profile, measuring SD, hash, flash and serial throughput on the target.
+// results are printed to the host serial as "bench: " lines, then the bootloader halts.
+// NOT for production use: updates are never applied, and the first flash sector after the installed
+// application is erased and programmed as a scratch area. the flash benchmark is skipped if there is no such
+// sector below the update metadata and the staging slot, or no update metadata to find the end of the application.
+//
+#pragma once
+#include "../../config_options.h"
+#include "../board.h"
+
+// the results are info messages
+#ifndef LOG_LEVEL
+  #define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// log synchronously, so no log output is sent during a measurement
+#ifndef LOG_ASYNC
+  #define LOG_ASYNC 0
+#endif
+
+// everything else matches the full feature profile
+#include "full.h"
@@ -35,6 +35,80 @@
   #define FIRMWARE_UPDATE_FILE "FIRMWARE.BIN"
 #endif
 
+// accept raw binaries only. compressed images need the decoder and its 4 KB window
+#ifndef ENABLE_COMPRESSED_IMAGES
+  #define ENABLE_COMPRESSED_IMAGES 0
+#endif
+#ifndef COMPRESSED_IMAGE_WINDOW_BITS
+  #define COMPRESSED_IMAGE_WINDOW_BITS 12
+#endif
+
+// no delta images. the patcher takes about 2KB of flash, and its sector buffer 8KB of RAM
+#ifndef ENABLE_DELTA_IMAGES
+  #define ENABLE_DELTA_IMAGES 0
+#endif
+
+// ignore the image manifest, always hashing the whole update file
+#ifndef ENABLE_IMAGE_MANIFEST
+  #define ENABLE_IMAGE_MANIFEST 0
+#endif
+
+// no sparse images
+#ifndef ENABLE_SPARSE_IMAGES
+  #define ENABLE_SPARSE_IMAGES 0
+#endif
+
+// don't accept encrypted images, as there is no key to build in by default
+#ifndef ENABLE_ENCRYPTED_IMAGES
+  #define ENABLE_ENCRYPTED_IMAGES 0
+#endif
+#ifndef IMAGE_KEY_SOURCE
+  #define IMAGE_KEY_SOURCE IMAGE_KEY_BUILD
+#endif
+#ifndef IMAGE_KEY_OTP_BLOCK
+  #define IMAGE_KEY_OTP_BLOCK 0
+#endif
+
+// accept unsigned images, as there is no public key to build in by default
+#ifndef ENABLE_SIGNED_IMAGES
+  #define ENABLE_SIGNED_IMAGES 0
+#endif
+
+// don't keep the CRC32 of each application sector in the metadata
+#ifndef METADATA_SECTOR_CRCS
+  #define METADATA_SECTOR_CRCS 0
+#endif
+
+// don't reserve the upper half of the flash for updates staged by the application
+#ifndef ENABLE_STAGED_UPDATES
+  #define ENABLE_STAGED_UPDATES 0
+#endif
+
+// keep a single application slot
+#ifndef ENABLE_AB_SLOTS
+  #define ENABLE_AB_SLOTS 0
+#endif
+#ifndef SLOT_BOOT_ATTEMPTS
+  #define SLOT_BOOT_ATTEMPTS 3
+#endif
+
+// don't listen for serial updates, so the boot isn't delayed
+#ifndef ENABLE_SERIAL_UPDATE
+  #define ENABLE_SERIAL_UPDATE 0
+#endif
+#ifndef SERIAL_UPDATE_WAIT
+  #define SERIAL_UPDATE_WAIT 100
+#endif
+#ifndef SERIAL_UPDATE_TIMEOUT
+  #define SERIAL_UPDATE_TIMEOUT 500
+#endif
+#ifndef SERIAL_UPDATE_WINDOW_SIZE
+  #define SERIAL_UPDATE_WINDOW_SIZE 4096
+#endif
+#ifndef SERIAL_UPDATE_MAX_BAUD
+  #define SERIAL_UPDATE_MAX_BAUD 2000000
+#endif
+
 // store last update metadata in flash
 #ifndef STORE_UPDATE_METADATA
   #define STORE_UPDATE_METADATA 1
@@ -55,6 +129,36 @@
   #define LOG_LEVEL LOG_LEVEL_DEBUG
 #endif
 
+// log synchronously. LOG_ASYNC keeps debug logging from slowing down the update, at the cost of the log buffer.
+// if the buffer overflows, only debug messages are dropped
+#ifndef LOG_ASYNC
+  #define LOG_ASYNC 0
+#endif
+#ifndef LOG_BUFFER_SIZE
+  #define LOG_BUFFER_SIZE 1024
+#endif
+#ifndef LOG_OVERFLOW
+  #define LOG_OVERFLOW LOG_OVERFLOW_DROP_DEBUG
+#endif
+
+// log debug strings as plain text
+#ifndef LOG_TOKENIZED
+  #define LOG_TOKENIZED 0
+#endif
+
+// don't profile the boot stages
+#ifndef ENABLE_PROFILER
+  #define ENABLE_PROFILER 0
+#endif
+
+// don't record a boot trace. ENABLE_BOOT_TRACE keeps the stages and errors of the last boots in the retention SRAM
+#ifndef ENABLE_BOOT_TRACE
+  #define ENABLE_BOOT_TRACE 0
+#endif
+#ifndef BOOT_TRACE_ADDRESS
+  #define BOOT_TRACE_ADDRESS BOOT_TRACE_DEFAULT_ADDRESS
+#endif
+
 // enable printing chip ID
 #ifndef PRINT_CHIPID
   #define PRINT_CHIPID 1
@@ -80,6 +184,12 @@
   #define PRE_CHECK_LEVEL PRE_CHECK_FULL
 #endif
 
+// don't check the application before jumping to it.
+// APP_INTEGRITY_CHECK_ONCE checks the whole application once after each update
+#ifndef APP_INTEGRITY_CHECK
+  #define APP_INTEGRITY_CHECK APP_INTEGRITY_CHECK_OFF
+#endif
+
 // skip nothing
 #ifndef SKIP_USART_DEINIT
   #define SKIP_USART_DEINIT 0
@@ -107,8 +217,10 @@
   #endif
 #endif
 
-// full config will take about 22KB of flash, so 
-// the app can start at 0x6000
+// the app starts at 0x6000, leaving the bootloader 24KB of flash.
+// the optional image formats and diagnostics each add 0.5 to 2KB, so move the app to 0x8000,
+// the 32KB limit of the bootloader, when enabling several of them.
+// check_fwid.py fails the build if the bootloader doesn't fit below APP_BASE_ADDRESS
 #ifndef APP_BASE_ADDRESS
   #define APP_BASE_ADDRESS 0x6000ul
 #endif
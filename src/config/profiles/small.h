@@ -16,15 +16,21 @@
   #define LOG_LEVEL LOG_LEVEL_INFO
 #endif
 
+// log synchronously, info and error messages are few enough
+// that the log buffer is not worth the space
+#ifndef LOG_ASYNC
+  #define LOG_ASYNC 0
+#endif
+
 // disable the fault handler, removing the fault handler code
 #ifndef ENABLE_FAULT_HANDLER
   #define ENABLE_FAULT_HANDLER 0
 #endif
 
-// small config takes < 16KB of flash, so
-// the app can start at 0x4000
+// with the time base, scheduler, beeper and DWIN batching, small config
+// no longer fits in 16KB of flash, so the app starts at 0x6000
 #ifndef APP_BASE_ADDRESS
-  #define APP_BASE_ADDRESS 0x4000
+  #define APP_BASE_ADDRESS 0x6000
 #endif
 
 // everything else matches the full feature profile
@@ -21,6 +21,56 @@
   #define METADATA_HASH HASH_CRC32
 #endif
 
+// accept raw binaries only, removing the decoder
+#ifndef ENABLE_COMPRESSED_IMAGES
+  #define ENABLE_COMPRESSED_IMAGES 0
+#endif
+
+// no delta images, removing the patcher and its sector buffer
+#ifndef ENABLE_DELTA_IMAGES
+  #define ENABLE_DELTA_IMAGES 0
+#endif
+
+// ignore the image manifest, always hashing the whole update file
+#ifndef ENABLE_IMAGE_MANIFEST
+  #define ENABLE_IMAGE_MANIFEST 0
+#endif
+
+// no sparse images, removing the segment table
+#ifndef ENABLE_SPARSE_IMAGES
+  #define ENABLE_SPARSE_IMAGES 0
+#endif
+
+// no encrypted images, removing the AES driver
+#ifndef ENABLE_ENCRYPTED_IMAGES
+  #define ENABLE_ENCRYPTED_IMAGES 0
+#endif
+
+// no signed images, removing the ECDSA verification
+#ifndef ENABLE_SIGNED_IMAGES
+  #define ENABLE_SIGNED_IMAGES 0
+#endif
+
+// don't keep sector CRC32s in the metadata
+#ifndef METADATA_SECTOR_CRCS
+  #define METADATA_SECTOR_CRCS 0
+#endif
+
+// don't install updates staged by the application
+#ifndef ENABLE_STAGED_UPDATES
+  #define ENABLE_STAGED_UPDATES 0
+#endif
+
+// keep a single application slot
+#ifndef ENABLE_AB_SLOTS
+  #define ENABLE_AB_SLOTS 0
+#endif
+
+// no serial updates, removing the receive window
+#ifndef ENABLE_SERIAL_UPDATE
+  #define ENABLE_SERIAL_UPDATE 0
+#endif
+
 // don't log the update metadata
 #ifndef LOG_METADATA
   #define LOG_METADATA 0
@@ -31,6 +81,11 @@
   #define LOG_LEVEL LOG_LEVEL_NONE
 #endif
 
+// log synchronously, removing the log buffer
+#ifndef LOG_ASYNC
+  #define LOG_ASYNC 0
+#endif
+
 // don't print chip ID
 #ifndef PRINT_CHIPID
   #define PRINT_CHIPID 0
@@ -41,6 +96,11 @@
   #define ENABLE_FAULT_HANDLER 0
 #endif
 
+// disable the boot trace, removing the trace code
+#ifndef ENABLE_BOOT_TRACE
+  #define ENABLE_BOOT_TRACE 0
+#endif
+
 // disable bootloader protection, removing
 // the MPU code
 #ifndef ENABLE_BOOTLOADER_PROTECTION
@@ -57,6 +117,11 @@
   #define PRE_CHECK_LEVEL PRE_CHECK_MINIMAL
 #endif
 
+// don't check the whole application, removing the integrity check code
+#ifndef APP_INTEGRITY_CHECK
+  #define APP_INTEGRITY_CHECK APP_INTEGRITY_CHECK_OFF
+#endif
+
 // enable all space-saving skips
 #ifndef SKIP_USART_DEINIT
   #define SKIP_USART_DEINIT 1
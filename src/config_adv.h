@@ -7,6 +7,10 @@
 //define HOST_SERIAL_TX gpio::PA9
 //define HOST_SERIAL_BAUD 115200
 
+// host serial RX pin
+// if not defined, the host serial is only used for output
+//define HOST_SERIAL_RX gpio::PA15
+
 // screen implementation to use
 // possible values: [ NONE, DWIN ]
 //define SCREEN_DRIVER SCREEN_DWIN
@@ -16,6 +20,15 @@
   //define SCREEN_SERIAL 1
   //define SCREEN_SERIAL_TX gpio::PC0
 
+  // DWIN screen serial RX pin
+  // if not defined, the screen is driven without feedback and the baud rate is never changed
+  //define SCREEN_SERIAL_RX gpio::PC1
+
+  // DWIN screen baud rate to switch to after the handshake.
+  // if the screen doesn't respond at this baud rate, 115200 baud is used
+  // possible values: [ 115200, 230400, 460800, 921600 ]
+  //define SCREEN_SERIAL_BAUD 460800
+
   // DWIN screen orientation
   // possible values: [ portrait, landscape, portrait_inverted, landscape_inverted]
   //define SCREEN_ORIENTATION portrait
@@ -47,6 +60,113 @@
 // possible values: [ 0, 1 ]
 //define LOG_METADATA 1
 
+// accept compressed update images, created using scripts/pack_image.py.
+// raw binaries are always accepted
+// possible values: [ 0, 1 ]
+//define ENABLE_COMPRESSED_IMAGES 1
+
+// log2 of the largest window size of compressed images. the decoder needs a RAM buffer of this size
+// possible values: [ 8 - 16 ]
+//define COMPRESSED_IMAGE_WINDOW_BITS 12
+
+// accept delta images, created using scripts/pack_image.py --delta-from.
+// a delta image rebuilds the application from the installed one, and is applied one flash sector at a time,
+// using a RAM buffer of one sector. requires STORE_UPDATE_METADATA and a METADATA_HASH
+// possible values: [ 0, 1 ]
+//define ENABLE_DELTA_IMAGES 1
+
+// use the manifest of update images, created by scripts/pack_image.py. with a manifest, the hash of the update
+// is taken from the image header instead of reading the whole file, and flash sectors already holding their part
+// of the update are neither erased nor written. the written application is checked against the hash instead.
+// images with a manifest are accepted either way
+// possible values: [ 0, 1 ]
+//define ENABLE_IMAGE_MANIFEST 1
+
+// accept sparse images, created using scripts/pack_image.py --sparse. a sparse image only holds the segments of the
+// application, and the flash between them is left erased: sectors without a segment are only erased if they aren't
+// already. adds a RAM table of IMAGE_MAX_SEGMENTS segments
+// possible values: [ 0, 1 ]
+//define ENABLE_SPARSE_IMAGES 1
+
+// accept encrypted images, created using scripts/pack_image.py --key. the application data is decrypted with AES-128
+// in CTR mode by the AES peripheral while it is read, and the update metadata hash is that of the decrypted application.
+// images that aren't encrypted are accepted either way
+// possible values: [ 0, 1 ]
+//define ENABLE_ENCRYPTED_IMAGES 0
+
+// where the key of encrypted images comes from:
+// - BUILD: IMAGE_KEY, built into the bootloader
+// - OTP: IMAGE_KEY_OTP_BLOCK of the one-time programmable area of the flash, programmed once per printer
+// possible values: [ BUILD, OTP ]
+//define IMAGE_KEY_SOURCE IMAGE_KEY_BUILD
+
+// the key of encrypted images with IMAGE_KEY_BUILD, as 32 hex digits. pass the same key to pack_image.py --key
+//define IMAGE_KEY "000102030405060708090A0B0C0D0E0F"
+
+// the 16 byte block of the OTP area holding the key of encrypted images with IMAGE_KEY_OTP
+// possible values: [ 0 - 59 ]
+//define IMAGE_KEY_OTP_BLOCK 0
+
+// only accept images signed using scripts/pack_image.py --sign-key, rejecting raw binaries and unsigned images.
+// the signature is an ECDSA signature on the NIST P-256 curve of the update metadata hash, checked before the flash is
+// erased. the hash is always taken from the application as read from the image, so with ENABLE_IMAGE_MANIFEST the file
+// is still read twice, and all sectors are rewritten. the written application is then checked against the hash, and is
+// only booted if the metadata was written.
+// requires STORE_UPDATE_METADATA, METADATA_HASH HASH_SHA256 and an APP_INTEGRITY_CHECK.
+// not available with ENABLE_STAGED_UPDATES
+// possible values: [ 0, 1 ]
+//define ENABLE_SIGNED_IMAGES 0
+
+// the public key of signed images, as 128 hex digits: x followed by y, big endian.
+// printed by pack_image.py --sign-key. built into the bootloader region, so flash write protection covers it
+//define IMAGE_PUBLIC_KEY "BC25E215415A29BC9AC83E6FFEA8FE31828CFA788B49CDD069CD081C565D4AB4DE80236048DD61494C8E53DEC9984365FCA5A76E80464AFFEB49C29464396187"
+
+// keep the CRC32 of each flash sector of the installed application in the update metadata, calculated using the
+// CRC peripheral once the application is written. updates with a manifest then compare their sectors against it
+// instead of reading the flash.
+// adds IMAGE_MAX_SECTORS words to the metadata. requires STORE_UPDATE_METADATA
+// possible values: [ 0, 1 ]
+//define METADATA_SECTOR_CRCS 1
+
+// install updates the application staged in the upper half of the flash, see modules/staging_format.h.
+// only on MCUs with 512 KB of flash, and the application must then end before the staging slot, also when updating
+// from the SD card. a staged update is installed before the update file is checked.
+// requires STORE_UPDATE_METADATA and a METADATA_HASH
+// possible values: [ 0, 1 ]
+//define ENABLE_STAGED_UPDATES 0
+
+// split the application flash into two slots, see modules/slots_format.h. updates are written to the slot that isn't
+// running, which then boots unconfirmed and is rolled back after SLOT_BOOT_ATTEMPTS boots unless the application
+// confirms it. updates must be built for the slot they are written to. only on MCUs with 512 KB of flash,
+// slot A is the only one otherwise. requires STORE_UPDATE_METADATA and a METADATA_HASH.
+// not available with ENABLE_DELTA_IMAGES or ENABLE_STAGED_UPDATES
+// possible values: [ 0, 1 ]
+//define ENABLE_AB_SLOTS 0
+
+// boots of an unconfirmed slot before it is rolled back
+// possible values: [ 1 - 32 ]
+//define SLOT_BOOT_ATTEMPTS 3
+
+// accept update files uploaded over the host serial using scripts/serial_upload.py, see modules/serial_update_format.h.
+// on every boot, the bootloader listens for the host for SERIAL_UPDATE_WAIT milliseconds before the SD card is checked.
+// requires HOST_SERIAL_RX and STORE_UPDATE_METADATA
+// possible values: [ 0, 1 ]
+//define ENABLE_SERIAL_UPDATE 0
+
+// time to listen for the host on every boot, in milliseconds
+//define SERIAL_UPDATE_WAIT 100
+
+// time to wait for a frame of the host during the upload, in milliseconds. pass it to serial_upload.py --update-timeout
+//define SERIAL_UPDATE_TIMEOUT 500
+
+// bytes of the update file received in one go, between erasing and programming the flash.
+// uses a RAM buffer of this size. must be a multiple of 512 (SERIAL_CHUNK_SIZE)
+// possible values: [ 512 - 65536 ]
+//define SERIAL_UPDATE_WINDOW_SIZE 4096
+
+// highest baud rate the host may switch to for the upload
+//define SERIAL_UPDATE_MAX_BAUD 2000000
+
 // path of the firmware update file. must be all uppercase
 //define FIRMWARE_UPDATE_FILE "FIRMWARE.BIN"
 
@@ -68,6 +188,40 @@
 // possible values: [ DEBUG, INFO, ERROR, OFF ]
 //define LOG_LEVEL LOG_LEVEL_DEBUG
 
+// send log output to the host serial asynchronously, using a buffer drained by the TX interrupt
+// possible values: [ 0, 1 ]
+//define LOG_ASYNC 1
+
+// size of the asynchronous log buffer, in bytes. must be a power of 2
+//define LOG_BUFFER_SIZE 1024
+
+// what to do when the asynchronous log buffer is full
+// possible values: [ BLOCK, DROP, DROP_DEBUG ]
+// - BLOCK: wait until there is space in the buffer
+// - DROP: drop the message, the number of dropped messages is reported on flush
+// - DROP_DEBUG: like DROP for debug messages, BLOCK for all others
+//define LOG_OVERFLOW LOG_OVERFLOW_DROP_DEBUG
+
+// replace debug log strings with 16 bit tokens and send debug numbers as varints.
+// saves flash and serial time, but the host serial output must be decoded using scripts/log_decode.py
+// and the log_tokens.json dictionary created next to firmware.bin
+// possible values: [ 0, 1 ]
+//define LOG_TOKENIZED 0
+
+// profile the boot stages using the DWT cycle counter, and print a timing summary to the host serial before the jump.
+// the summary can be converted to CSV using scripts/profile_to_csv.py
+// possible values: [ 0, 1 ]
+//define ENABLE_PROFILER 0
+
+// record boot events into a trace ring in retention SRAM, which survives a reset.
+// if the previous boot didn't reach the application, its trace is printed to the host serial.
+// the application can read the trace too, see modules/boot_trace.h
+// possible values: [ 0, 1 ]
+//define ENABLE_BOOT_TRACE 1
+
+// address of the boot trace, must be in the retention SRAM (0x200F0000 - 0x200F0FFF)
+//define BOOT_TRACE_ADDRESS BOOT_TRACE_DEFAULT_ADDRESS
+
 // print the chip ID information
 //define PRINT_CHIPID 1
 
@@ -89,6 +243,15 @@
 // possible values: [ MINIMAL, EXTENDED, FULL ]
 //define PRE_CHECK_LEVEL PRE_CHECK_FULL
 
+// check the whole application against the hash in the stored update metadata before jumping to it.
+// requires STORE_UPDATE_METADATA and a METADATA_HASH
+// possible values: [ OFF, ONCE, ALWAYS ]
+// - OFF: only check the vector table, see PRE_CHECK_LEVEL
+// - ONCE: check until the check passed once after an update, then mark the application as verified in flash.
+//         the mark is erased with the metadata by the next update
+// - ALWAYS: check on every boot
+//define APP_INTEGRITY_CHECK APP_INTEGRITY_CHECK_ONCE
+
 // skip deinitialization of the USART peripheral on boot and before jumping to the application
 // may cause issues with the application, so enable with caution
 //define SKIP_USART_DEINIT 0
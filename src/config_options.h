@@ -34,6 +34,13 @@
 
 #define IS_LOG_LEVEL(level) (LOG_LEVEL <= level)
 
+//
+// Log Buffer Overflow Policies
+//
+#define LOG_OVERFLOW_BLOCK 0
+#define LOG_OVERFLOW_DROP 1
+#define LOG_OVERFLOW_DROP_DEBUG 2
+
 //
 // pre-jump checks
 //
@@ -44,6 +51,19 @@
 
 #define IS_PRE_CHECK_LEVEL(level) (PRE_CHECK_LEVEL <= level && PRE_CHECK_LEVEL != PRE_CHECK_NONE)
 
+//
+// application integrity check
+//
+#define APP_INTEGRITY_CHECK_OFF 0
+#define APP_INTEGRITY_CHECK_ONCE 1
+#define APP_INTEGRITY_CHECK_ALWAYS 2
+
+//
+// key of encrypted images
+//
+#define IMAGE_KEY_BUILD 0
+#define IMAGE_KEY_OTP 1
+
 //
 // Compatibility
 //
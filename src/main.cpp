@@ -20,18 +20,18 @@ void on_progress(const flash::update_stage stage, const int done, const int tota
   strcat(status_str, " of ");
   logging::formatters::format_number(status_str + strlen(status_str), total, 10);
 
-  // print the status to the host serial only
+  // print the status to the host serial only, through the log so it stays in order with buffered log output
   // screen already shows the progress bar with the status message
-  #if HAS_SERIAL(HOST_SERIAL)
-    hostSerial.write(status_str);
-    hostSerial.write("\n");
-  #endif
-  
+  logging::log(status_str, /*to_screen*/ false);
+  logging::log("\n", /*to_screen*/ false);
+
   // print the status to the screen
   screen.showProgress(done, total, status_str);
   screen.flush();
 }
 
+// unit tests of the native build bring their own main()
+#ifndef PIO_UNIT_TESTING
 int main()
 {
   #if WAIT_FOR_DEBUGGER == 1
@@ -42,21 +42,28 @@ int main()
   #endif
 
   runtime_checks::run();
+  trace::init();
 
   // initialize system
   fault_handler::init();
   sysclock::apply();
+  timebase::init();
   compat::apply();
+  profiler::init();
   
   // initialize serial and ui
   #if HAS_SERIAL(HOST_SERIAL) 
     hostSerial.init(HOST_SERIAL_BAUD);
   #endif
+  logging::init();
 
+  profiler::begin(profiler::stage::screen_init);
   screen.init();
+  profiler::end(profiler::stage::screen_init);
 
   // print firmware identification message as early as possible
   fwid::print();
+  trace::print_previous();
   beep::beep(100);
 
   #if ENABLE_BOOTLOADER_PROTECTION == 1
@@ -78,19 +85,55 @@ int main()
     chipid::print();
   #endif
 
+  #if IS_PROFILE(BENCHMARK)
+    // run the benchmarks instead of the update, then halt
+    benchmark::run();
+    screen.flush(/*force*/ true);
+    logging::flush();
+    while (true)
+    {
+      __WFI();
+    }
+  #endif
+
   // get the firmware file
-  logging::log("checking ");
-  logging::log(FIRMWARE_UPDATE_FILE);
-  logging::log("\n");
-  
   flash::update_metadata metadata;
-  if (sd::get_update_file(metadata, FIRMWARE_UPDATE_FILE))
+
+  // an update staged by the application is installed before the update file is checked
+  #if ENABLE_STAGED_UPDATES == 1
+    const bool is_staged = staging::get_update(metadata);
+  #else
+    constexpr bool is_staged = false;
+  #endif
+
+  // so is an update uploaded by a host listening on the host serial
+  #if ENABLE_SERIAL_UPDATE == 1
+    const bool is_serial = !is_staged && serial_update::get_update(metadata);
+  #else
+    constexpr bool is_serial = false;
+  #endif
+
+  if (!is_staged && !is_serial)
+  {
+    logging::log("checking ");
+    logging::log(FIRMWARE_UPDATE_FILE);
+    logging::log("\n");
+  }
+
+  if (is_staged || is_serial || sd::get_update_file(metadata, FIRMWARE_UPDATE_FILE))
   {
     // print new firmware metadata to info
     metadata.log("update");
 
+    // an update is written to the slot it is built for
+    #if ENABLE_AB_SLOTS == 1
+      const uint32_t update_base_address = slots::get_update_base(image::get_target_address());
+    #else
+      constexpr uint32_t update_base_address = APP_BASE_ADDRESS;
+    #endif
+
     #if STORE_UPDATE_METADATA == 1
-      const flash::update_metadata *stored_metadata = flash::update_metadata::get_stored();
+      const flash::update_metadata *stored_metadata = flash::update_metadata::get_stored(update_base_address);
       stored_metadata->log("flash");
 
       // check if we've already flashed this firmware
@@ -101,32 +144,142 @@ int main()
       else
     #endif
 
+    #if ENABLE_AB_SLOTS == 1
+      // the running application stays intact, so the update must be built for the other slot
+      if (!slots::can_update(update_base_address))
+      {
+        logging::error("update not for inactive slot\n");
+      }
+      else
+    #endif
+
+    #if ENABLE_SIGNED_IMAGES == 1
+      // only updates signed with IMAGE_PUBLIC_KEY are installed. the hash was taken from the application as read from the
+      // image, so the signature covers the data written. checked once the update is known to be installed, so booting
+      // with the same update file still inserted doesn't pay for it
+      if (!image::is_signed_hash(metadata.hash))
+      {
+        trace::record(BOOT_TRACE_EVENT_UPDATE, 2);
+        logging::error("update rejected\n");
+      }
+      else
+    #endif
+
     {
       // apply the update
-      if(!flash::apply_firmware_update(APP_BASE_ADDRESS, metadata, &on_progress))
+      if(!flash::apply_firmware_update(update_base_address, metadata, &on_progress))
       {
+        trace::record(BOOT_TRACE_EVENT_UPDATE, 0);
         logging::error("update failed\n");
-        beep::beep(500, 999);
-        ASSERT(false, "update failed");
+
+        // the active slot is untouched, so it is booted. the update is tried again on the next boot
+        #if ENABLE_AB_SLOTS != 1
+          #if ENABLE_SERIAL_UPDATE == 1
+            if (is_serial)
+            {
+              serial_update::end(false);
+            }
+          #endif
+
+          screen.flush(/*force*/ true);
+          beep::beep(500, 999);
+          beep::wait();
+          ASSERT(false, "update failed");
+        #endif
       }
       else
       {
+        trace::record(BOOT_TRACE_EVENT_UPDATE, 1);
         logging::log("update applied\n");
+
+        // boot the new application, if it passes the pre-checks. it is rolled back unless it confirms itself
+        #if ENABLE_AB_SLOTS == 1
+          if (leap::pre_check(update_base_address))
+          {
+            slots::activate(update_base_address);
+          }
+        #endif
       }
     }
+
+    // the staged update is installed now, so it isn't checked again
+    #if ENABLE_STAGED_UPDATES == 1
+      if (is_staged)
+      {
+        staging::clear();
+      }
+    #endif
+
+    // tell the host if the uploaded application is installed now
+    #if ENABLE_SERIAL_UPDATE == 1
+      if (is_serial)
+      {
+        serial_update::end(metadata.equals(flash::update_metadata::get_stored(update_base_address)));
+      }
+    #endif
   }
 
+  // SD card is no longer used
+  sd::log_io_stats();
+  image::log_stats();
+
   // log application jump
   logging::log("jumping to app\n");
 
-  // run pre-checks on the application
-  if (!leap::pre_check(APP_BASE_ADDRESS))
+  #if ENABLE_AB_SLOTS == 1
+    // boot the active slot, unless it is unconfirmed and out of boot attempts or fails the pre-checks,
+    // and the other slot holds an intact application to roll back to
+    uint32_t app_base_address = slots::get_active_base();
+    const bool may_boot = slots::count_boot();
+    bool pre_check_ok = may_boot && leap::pre_check(app_base_address);
+    if (!pre_check_ok && slots::can_roll_back() && leap::pre_check(slots::get_other_base()) && slots::roll_back())
+    {
+      app_base_address = slots::get_active_base();
+      pre_check_ok = true;
+    }
+    else if (!may_boot)
+    {
+      // nothing to roll back to, so the unconfirmed slot is booted anyway
+      pre_check_ok = leap::pre_check(app_base_address);
+    }
+  #else
+    // an interrupted update leaves the application partly erased or written, so it is not booted
+    // until an update completes. slots are only activated once their update completed
+    #if STORE_UPDATE_METADATA == 1
+      if (flash::is_update_in_progress(APP_BASE_ADDRESS))
+      {
+        trace::record(BOOT_TRACE_EVENT_UPDATE, 0);
+        logging::error("update incomplete\n");
+        screen.flush(/*force*/ true);
+        beep::beep(500, 999);
+        beep::wait();
+        ASSERT(false, "update incomplete");
+      }
+    #endif
+
+    // run pre-checks on the application
+    constexpr uint32_t app_base_address = APP_BASE_ADDRESS;
+    const bool pre_check_ok = leap::pre_check(app_base_address);
+  #endif
+
+  // print the boot timing summary, including the pre-checks
+  profiler::print();
+
+  if (!pre_check_ok)
   {
     logging::log("pre-check fail! skip jump\n");
+    screen.flush(/*force*/ true);
     beep::beep(250, 999);
+    beep::wait();
     ASSERT(false, "pre-check fail");
   }
 
+  trace::record(BOOT_TRACE_EVENT_JUMP, 0, app_base_address);
+
+  // make sure all messages are out before the serials are released
+  screen.flush(/*force*/ true);
+  logging::deinit();
+
   // deinitialize serial to prevent interference with the application
   #if HAS_SERIAL(HOST_SERIAL)
     hostSerial.deinit();
@@ -135,9 +288,14 @@ int main()
     screenSerial.deinit();
   #endif
 
+  // silence the beeper and stop the time base, so no tick is taken by the application
+  beep::stop();
+  timebase::deinit();
+
   // restore the clock configuration
   sysclock::restore();
 
   // jump to the application
-  leap::jump(APP_BASE_ADDRESS);
+  leap::jump(app_base_address);
 }
+#endif // PIO_UNIT_TESTING
@@ -2,16 +2,25 @@
 
 #include "modules/fault_handler.h"
 #include "modules/flash.h"
+#include "modules/image.h"
 #include "modules/leap.h"
 #include "modules/screen.h"
 #include "modules/sd.h"
+#include "modules/staging.h"
+#include "modules/slots.h"
+#include "modules/serial_update.h"
 #include "modules/serial.h"
 #include "modules/log.h"
 #include "modules/chipid.h"
 #include "modules/beep.h"
 #include "modules/mpu.h"
 #include "modules/sysclock.h"
+#include "modules/timebase.h"
+#include "modules/scheduler.h"
 #include "modules/assert.h"
 #include "modules/compat.h"
 #include "modules/flash_wp.h"
 #include "modules/fwid.h"
+#include "modules/profiler.h"
+#include "modules/trace.h"
+#include "modules/benchmark.h"
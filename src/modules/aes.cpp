@@ -0,0 +1,234 @@
+#include "aes.h"
+
+#if ENABLE_ENCRYPTED_IMAGES == 1
+#include <hc32_ddl.h>
+#include <string.h>
+#include <algorithm>
+
+namespace aes
+{
+  #if IMAGE_KEY_SOURCE == IMAGE_KEY_BUILD
+    /**
+     * @brief IMAGE_KEY, parsed at compile time
+     */
+    struct parsed_key
+    {
+      key_t bytes;
+    };
+
+    constexpr bool is_hex_digit(const char c)
+    {
+      return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    constexpr uint8_t hex_digit(const char c)
+    {
+      return c <= '9' ? c - '0' : (c <= 'F' ? c - 'A' + 10 : c - 'a' + 10);
+    }
+
+    constexpr bool is_hex_key(const char (&hex)[(2 * block_size) + 1])
+    {
+      for (uint32_t i = 0; i < 2 * block_size; i++)
+      {
+        if (!is_hex_digit(hex[i]))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    constexpr parsed_key parse_key(const char (&hex)[(2 * block_size) + 1])
+    {
+      parsed_key key = {};
+      for (uint32_t i = 0; i < block_size; i++)
+      {
+        key.bytes[i] = static_cast<uint8_t>((hex_digit(hex[2 * i]) << 4) | hex_digit(hex[(2 * i) + 1]));
+      }
+      return key;
+    }
+
+    static_assert(is_hex_key(IMAGE_KEY), "IMAGE_KEY must be 32 hex digits");
+    constexpr parsed_key build_key = parse_key(IMAGE_KEY);
+  #elif IMAGE_KEY_SOURCE == IMAGE_KEY_OTP
+    /**
+     * @brief start of the OTP area, made of 16 byte blocks
+     */
+    constexpr uint32_t otp_address = 0x03000C00ul;
+  #endif
+
+  namespace state
+  {
+    /**
+     * @brief the nonce of the CTR stream, and the counter of the block the peripheral works on
+     */
+    uint8_t nonce[12];
+    uint32_t counter = 0;
+
+    /**
+     * @brief the key stream of the current block, and the number of its bytes used
+     */
+    uint32_t key_stream[block_size / 4];
+    uint32_t used = block_size;
+
+    /**
+     * @brief bytes of the next block to leave unused, after seeking into the middle of it
+     */
+    uint32_t skip = 0;
+  } // namespace state
+
+  bool get_image_key(key_t &key)
+  {
+    #if IMAGE_KEY_SOURCE == IMAGE_KEY_BUILD
+      memcpy(key, build_key.bytes, block_size);
+      return true;
+    #else
+      #ifdef NATIVE_BUILD
+        const uint8_t *otp_key = native_otp_base() + (IMAGE_KEY_OTP_BLOCK * block_size);
+      #else
+        const uint8_t *otp_key = reinterpret_cast<const uint8_t *>(otp_address + (IMAGE_KEY_OTP_BLOCK * block_size));
+      #endif
+      memcpy(key, otp_key, block_size);
+
+      // the OTP area is erased until it is programmed
+      return std::any_of(key, key + block_size, [](const uint8_t byte) { return byte != 0xFF; });
+    #endif
+  }
+
+  /**
+   * @brief wait until the peripheral finished the current block
+   */
+  void wait_for_ready()
+  {
+    while (bM4_AES_CR_START != 0) { /* nada */ }
+  }
+
+  /**
+   * @brief write 16 bytes to 4 registers, first byte to the least significant byte of the first register
+   */
+  void write_words(volatile uint32_t *reg, const uint8_t *bytes)
+  {
+    for (uint32_t i = 0; i < block_size / 4; i++)
+    {
+      uint32_t word;
+      memcpy(&word, bytes + (i * 4), sizeof(word));
+      *(reg++) = word;
+    }
+  }
+
+  /**
+   * @brief enable the peripheral and load the key
+   */
+  void load_key(const key_t &key)
+  {
+    PWC_Fcg0PeriphClockCmd(PWC_FCG0_PERIPH_AES, Enable);
+    wait_for_ready();
+    write_words(&M4_AES->KR0, key);
+  }
+
+  /**
+   * @brief start encrypting a block. the result is read from the data registers once the peripheral is ready
+   */
+  void start_block(const uint8_t block[block_size])
+  {
+    write_words(&M4_AES->DR0, block);
+    bM4_AES_CR_MODE = 0; // encrypt
+    bM4_AES_CR_START = 1;
+  }
+
+  /**
+   * @brief start encrypting the counter block of the current counter
+   */
+  void start_counter_block()
+  {
+    uint8_t block[block_size];
+    memcpy(block, state::nonce, sizeof(state::nonce));
+    block[12] = static_cast<uint8_t>(state::counter >> 24);
+    block[13] = static_cast<uint8_t>(state::counter >> 16);
+    block[14] = static_cast<uint8_t>(state::counter >> 8);
+    block[15] = static_cast<uint8_t>(state::counter);
+    start_block(block);
+  }
+
+  /**
+   * @brief take the key stream of the block in the peripheral, and start the next one
+   */
+  void next_key_stream()
+  {
+    wait_for_ready();
+    volatile uint32_t *dr = &M4_AES->DR0;
+    for (uint32_t i = 0; i < block_size / 4; i++)
+    {
+      state::key_stream[i] = *(dr++);
+    }
+
+    state::counter++;
+    start_counter_block();
+
+    state::used = state::skip;
+    state::skip = 0;
+  }
+
+  void encrypt_block(const key_t &key, const uint8_t input[block_size], uint8_t output[block_size])
+  {
+    load_key(key);
+    start_block(input);
+    wait_for_ready();
+
+    volatile uint32_t *dr = &M4_AES->DR0;
+    for (uint32_t i = 0; i < block_size; i += 4)
+    {
+      const uint32_t word = *(dr++);
+      memcpy(output + i, &word, sizeof(word));
+    }
+  }
+
+  void start_ctr(const key_t &key, const uint8_t nonce[12], const uint32_t offset)
+  {
+    load_key(key);
+    memcpy(state::nonce, nonce, sizeof(state::nonce));
+    seek_ctr(offset);
+  }
+
+  void seek_ctr(const uint32_t offset)
+  {
+    // the block in flight is dropped
+    wait_for_ready();
+    state::counter = offset / block_size;
+    start_counter_block();
+
+    // the next call takes the key stream of this block, but starts offset % block_size bytes into it
+    state::used = block_size;
+    state::skip = offset % block_size;
+  }
+
+  void apply_ctr(uint8_t *data, const uint32_t size)
+  {
+    const uint8_t *key_stream = reinterpret_cast<const uint8_t *>(state::key_stream);
+    uint32_t i = 0;
+    while (i < size)
+    {
+      if (state::used == block_size)
+      {
+        next_key_stream();
+      }
+
+      // whole blocks a word at a time
+      if (state::used == 0 && (size - i) >= block_size && (reinterpret_cast<uintptr_t>(data + i) & 3u) == 0)
+      {
+        uint32_t *words = reinterpret_cast<uint32_t *>(data + i);
+        words[0] ^= state::key_stream[0];
+        words[1] ^= state::key_stream[1];
+        words[2] ^= state::key_stream[2];
+        words[3] ^= state::key_stream[3];
+        state::used = block_size;
+        i += block_size;
+        continue;
+      }
+
+      data[i++] ^= key_stream[state::used++];
+    }
+  }
+} // namespace aes
+
+#endif // ENABLE_ENCRYPTED_IMAGES == 1
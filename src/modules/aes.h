@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include "../config.h"
+
+namespace aes
+{
+  #if ENABLE_ENCRYPTED_IMAGES == 1
+    /**
+     * @brief size of an AES block and of the key. the AES peripheral only supports AES-128
+     */
+    constexpr uint32_t block_size = 16;
+
+    typedef uint8_t key_t[block_size];
+
+    /**
+     * @brief get the key of encrypted images from IMAGE_KEY_SOURCE
+     * @param key the key
+     * @return false if the key isn't programmed (IMAGE_KEY_OTP only)
+     */
+    bool get_image_key(key_t &key);
+
+    /**
+     * @brief encrypt a single block
+     * @param key the key
+     * @param input the block to encrypt
+     * @param output the encrypted block. may be the same as input
+     * @note ends a CTR stream started before
+     */
+    void encrypt_block(const key_t &key, const uint8_t input[block_size], uint8_t output[block_size]);
+
+    /**
+     * @brief start a CTR stream, see image_format.h for the counter blocks
+     * @param key the key
+     * @param nonce the first 12 bytes of the counter blocks
+     * @param offset offset of the first byte to apply the stream to
+     */
+    void start_ctr(const key_t &key, const uint8_t nonce[12], const uint32_t offset);
+
+    /**
+     * @brief continue the CTR stream at another offset
+     * @param offset offset of the next byte to apply the stream to
+     */
+    void seek_ctr(const uint32_t offset);
+
+    /**
+     * @brief encrypt or decrypt the next bytes with the CTR stream.
+     * the peripheral computes the key stream one block ahead, so it works on the next block while the current one is
+     * applied, and on the first block of the next call while the caller uses the data
+     * @param data the data, encrypted or decrypted in place
+     * @param size the size of the data
+     */
+    void apply_ctr(uint8_t *data, const uint32_t size);
+  #endif
+} // namespace aes
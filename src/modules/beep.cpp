@@ -1,22 +1,211 @@
 #include "beep.h"
 #include "delay.h"
+#include "timebase.h"
 #include "../config.h"
+#include "../util.h"
 
 namespace beep
 {
-  void beep(const uint32_t duration, const uint32_t repeat)
+  #if defined(BEEPER_PIN)
+    constexpr gpio::pin_t beeper = BEEPER_PIN;
+
+    struct pattern
+    {
+      /**
+       * @brief duration of each beep, in milliseconds
+       */
+      uint16_t duration;
+
+      /**
+       * @brief number of beeps left to play
+       */
+      uint16_t repeat;
+
+      /**
+       * @brief silence after each beep, in milliseconds
+       */
+      uint16_t gap;
+    };
+
+    namespace queue
+    {
+      /**
+       * @brief number of patterns that can be queued
+       */
+      constexpr uint8_t size = 4;
+
+      /**
+       * @brief queued patterns, as a ring buffer
+       */
+      pattern patterns[size];
+
+      /**
+       * @brief index of the oldest queued pattern, and number of queued patterns
+       */
+      volatile uint8_t head = 0, count = 0;
+    } // namespace queue
+
+    namespace sequencer
+    {
+      /**
+       * @brief the pattern currently playing
+       */
+      pattern current = {};
+
+      /**
+       * @brief is the buzzer on?
+       */
+      bool is_on = false;
+
+      /**
+       * @brief milliseconds left of the current beep or gap
+       */
+      uint16_t remaining = 0;
+
+      /**
+       * @brief is anything playing or queued?
+       */
+      volatile bool active = false;
+
+      /**
+       * @brief advance the sequencer by one millisecond
+       * @note called on the time base tick
+       */
+      void tick()
+      {
+        if (remaining > 0 && --remaining > 0)
+        {
+          return;
+        }
+
+        // beep is over, start the gap
+        if (is_on)
+        {
+          beeper.low();
+          is_on = false;
+          remaining = current.gap;
+          if (remaining > 0)
+          {
+            return;
+          }
+        }
+
+        // gap is over, start the next beep
+        if (current.repeat == 0)
+        {
+          if (queue::count == 0)
+          {
+            active = false;
+            return;
+          }
+
+          current = queue::patterns[queue::head];
+          queue::head = (queue::head + 1) % queue::size;
+          queue::count = queue::count - 1;
+        }
+
+        current.repeat--;
+        beeper.high();
+        is_on = true;
+        remaining = current.duration;
+      }
+    } // namespace sequencer
+
+    /**
+     * @brief play a pattern, waiting until it is done
+     */
+    void play_blocking(const pattern &beeps)
+    {
+      for (uint16_t i = 0; i < beeps.repeat; i++)
+      {
+        beeper.high();
+        delay::ms(beeps.duration);
+        beeper.low();
+        delay::ms(beeps.gap);
+      }
+    }
+
+    /**
+     * @brief is the sequencer still playing?
+     */
+    bool is_active()
+    {
+      return sequencer::active;
+    }
+  #endif
+
+  void play(const uint16_t duration, const uint16_t repeat, const uint16_t gap)
   {
     #if defined(BEEPER_PIN)
-      constexpr gpio::pin_t beeper = BEEPER_PIN;
+      if (repeat == 0 || duration == 0)
+      {
+        return;
+      }
 
+      const pattern queued = { duration, repeat, gap };
       beeper.asOutput();
-      
-      for (uint32_t i = 0; i < repeat; i++)
+      if (!timebase::is_running())
       {
-        beeper.high();
-        delay::ms(duration);
-        beeper.low();
-        delay::ms(duration);
+        play_blocking(queued);
+        return;
+      }
+
+      // wait for room in the queue
+      while (queue::count >= queue::size)
+      {
+        delay::ms(1);
+      }
+
+      const uint32_t primask = __get_PRIMASK();
+      __disable_irq();
+
+      queue::patterns[(queue::head + queue::count) % queue::size] = queued;
+      queue::count = queue::count + 1;
+      if (!sequencer::active)
+      {
+        sequencer::active = true;
+        timebase::set_tick_handler(&sequencer::tick);
+      }
+
+      if (primask == 0)
+      {
+        __enable_irq();
+      }
+    #endif
+  }
+
+  void beep(const uint32_t duration, const uint32_t repeat)
+  {
+    play(minimum(duration, 0xFFFFul), minimum(repeat, 0xFFFFul), minimum(duration, 0xFFFFul));
+  }
+
+  void wait()
+  {
+    #if defined(BEEPER_PIN)
+      while (is_active() && timebase::is_running())
+      {
+        delay::ms(1);
+      }
+    #endif
+  }
+
+  void stop()
+  {
+    #if defined(BEEPER_PIN)
+      const uint32_t primask = __get_PRIMASK();
+      __disable_irq();
+
+      timebase::set_tick_handler(nullptr);
+      queue::count = 0;
+      sequencer::current.repeat = 0;
+      sequencer::remaining = 0;
+      sequencer::is_on = false;
+      sequencer::active = false;
+      beeper.low();
+
+      if (primask == 0)
+      {
+        __enable_irq();
       }
     #endif
   }
@@ -1,11 +1,33 @@
 #pragma once
+#include <stdint.h>
 
 namespace beep
 {
   /**
-   * @brief Beep the buzzer
+   * @brief Beep the buzzer, without waiting for the beeps to finish
    * @param duration the duration of the beep in milliseconds
    * @param repeat the number of times to repeat the beep
+   * @note the beeps are played on the time base tick, after any beeps queued before.
+   *       without a running time base, this blocks until the beeps are played
    */
   void beep(const uint32_t duration = 500, const uint32_t repeat = 1);
+
+  /**
+   * @brief Beep the buzzer with a pattern, without waiting for the beeps to finish
+   * @param duration the duration of each beep in milliseconds
+   * @param repeat the number of beeps
+   * @param gap the silence after each beep in milliseconds
+   */
+  void play(const uint16_t duration, const uint16_t repeat, const uint16_t gap);
+
+  /**
+   * @brief wait until all queued beeps are played
+   */
+  void wait();
+
+  /**
+   * @brief silence the buzzer and drop all queued beeps
+   * @note must be called before jumping to the application
+   */
+  void stop();
 } // namespace beep
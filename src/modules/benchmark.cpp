@@ -0,0 +1,725 @@
+#include "benchmark.h"
+#include "../config.h"
+
+#if IS_PROFILE(BENCHMARK)
+#include <hc32_ddl.h>
+#include <string.h>
+#include "aes.h"
+#include "ecdsa.h"
+#include "flash.h"
+#include "hash.h"
+#include "image.h"
+#include "log.h"
+#include "sd.h"
+#include "screen.h"
+#include "serial.h"
+#include "staging_format.h"
+#include "../util.h"
+
+namespace benchmark
+{
+  /**
+   * @brief shared buffer, large enough for multi-block SD reads
+   */
+  constexpr size_t buffer_size = 4096;
+  uint8_t buffer[buffer_size] __attribute__((aligned(4)));
+
+  /**
+   * @brief measures elapsed time using the DWT cycle counter.
+   * measurements must stay below one CYCCNT period (~21 s at 200 MHz)
+   */
+  class stopwatch
+  {
+  public:
+    stopwatch() : start(DWT->CYCCNT) {}
+
+    uint32_t elapsed_cycles() const
+    {
+      return DWT->CYCCNT - start;
+    }
+
+    uint32_t elapsed_us() const
+    {
+      return elapsed_cycles() / (SystemCoreClock / 1000000ul);
+    }
+
+  private:
+    const uint32_t start;
+  };
+
+  /**
+   * @brief a result line
+   */
+  class result
+  {
+  public:
+    result(const char *test)
+    {
+      strcpy(line, "bench: ");
+      strcat(line, test);
+    }
+
+    result &add(const char *key, const char *value)
+    {
+      strcat(line, " ");
+      strcat(line, key);
+      strcat(line, "=");
+      strcat(line, value);
+      return *this;
+    }
+
+    result &add(const char *key, const uint32_t value)
+    {
+      char str[11];
+      logging::formatters::format_number(str, value, 10);
+      return add(key, str);
+    }
+
+    /**
+     * @brief add duration and, if bytes is not 0, size and throughput
+     */
+    result &add_timing(const uint32_t bytes, const uint32_t us)
+    {
+      if (bytes != 0)
+      {
+        add("bytes", bytes);
+      }
+      add("us", us);
+
+      // bytes per microsecond equals MB/s
+      if (bytes != 0 && us != 0)
+      {
+        char str[16];
+        logging::formatters::format_fixed_3(str, static_cast<uint32_t>((static_cast<uint64_t>(bytes) * 1000ull) / us));
+        add("mb_s", str);
+      }
+      return *this;
+    }
+
+    void print()
+    {
+      strcat(line, "\n");
+      logging::log(line, /*to_screen*/ false);
+
+      // don't let buffered log output interfere with the next measurement
+      logging::flush();
+    }
+
+  private:
+    char line[160];
+  };
+
+  namespace sd_read
+  {
+    constexpr en_sdioc_clk_freq_t clocks[] = {
+      SdiocClk400K,
+      SdiocClk20M,
+      SdiocClk25M,
+      SdiocClk40M,
+      SdiocClk50M,
+    };
+
+    constexpr int widths[] = { 1, 4, 8 };
+
+    /**
+     * @brief raw sequential read from the start of the card, at every clock and bus width
+     */
+    void run()
+    {
+      for (const en_sdioc_clk_freq_t clock : clocks)
+      {
+        for (const int width : widths)
+        {
+          if (width > sdio::bus_width)
+          {
+            continue;
+          }
+
+          result r("sd_read");
+          r.add("clock_khz", static_cast<uint32_t>(clock) / 1000).add("width", width);
+          if (!sdio::reinit(clock, width))
+          {
+            r.add("error", 1).print();
+            continue;
+          }
+
+          // keep the slow identification clock from taking too long
+          const uint32_t total = clock == SdiocClk400K ? 16384 : 262144;
+          constexpr uint16_t blocks_per_read = buffer_size / 512;
+
+          const stopwatch sw;
+          bool ok = true;
+          for (uint32_t sector = 0; ok && sector < (total / 512); sector += blocks_per_read)
+          {
+            ok = sdio::read_blocks(sector, blocks_per_read, buffer);
+          }
+          const uint32_t us = sw.elapsed_us();
+
+          if (ok)
+          {
+            r.add_timing(total, us);
+          }
+          else
+          {
+            r.add("error", 2);
+          }
+          r.print();
+        }
+      }
+
+      // restore the configuration used for FatFs
+      sdio::reinit(sdio::default_clock, sdio::bus_width);
+    }
+  } // namespace sd_read
+
+  namespace file_read
+  {
+    constexpr uint32_t chunk_sizes[] = { 64, 512, 2048, 4096 };
+
+    /**
+     * @brief Petit FatFs read throughput of the firmware update file, for several chunk sizes
+     */
+    void run()
+    {
+      static FATFS fs;
+      FRESULT res = pf_mount(&fs);
+      if (res != FR_OK)
+      {
+        result("pf_read").add("error", res).print();
+        return;
+      }
+
+      for (const uint32_t chunk_size : chunk_sizes)
+      {
+        result r("pf_read");
+        r.add("chunk", chunk_size);
+
+        // re-opening rewinds the file
+        res = pf_open(FIRMWARE_UPDATE_FILE);
+        if (res != FR_OK)
+        {
+          r.add("error", res).print();
+          return;
+        }
+
+        const uint32_t total = minimum(fs.fsize, 262144ul);
+        uint32_t bytes = 0;
+        const stopwatch sw;
+        while (bytes < total)
+        {
+          UINT bytes_read = 0;
+          res = pf_read(buffer, chunk_size, &bytes_read);
+          if (res != FR_OK || bytes_read == 0)
+          {
+            break;
+          }
+          bytes += bytes_read;
+        }
+        const uint32_t us = sw.elapsed_us();
+
+        if (res != FR_OK)
+        {
+          r.add("error", res);
+        }
+        else
+        {
+          r.add_timing(bytes, us);
+        }
+        r.print();
+      }
+    }
+  } // namespace file_read
+
+  namespace copy
+  {
+    /**
+     * @brief cost of copying sector data, as done for partial sector reads of the SD card
+     */
+    void run()
+    {
+      constexpr uint32_t total = 65536;
+      constexpr uint32_t chunk_size = 512;
+
+      const stopwatch sw;
+      for (uint32_t bytes = 0; bytes < total; bytes += chunk_size)
+      {
+        memcpy(buffer + (buffer_size / 2), buffer + (bytes % (buffer_size / 2)), chunk_size);
+      }
+      const uint32_t cycles = sw.elapsed_cycles();
+
+      result("memcpy").add("chunk", chunk_size).add_timing(total, cycles / (SystemCoreClock / 1000000ul)).add("cycles_per_kb", cycles / (total / 1024)).print();
+    }
+  } // namespace copy
+
+  #if ENABLE_COMPRESSED_IMAGES == 1
+    namespace decompress
+    {
+      /**
+       * @brief each sequence of the synthetic stream has 8 literals and a 24 byte match, 8 bytes back
+       */
+      constexpr uint32_t sequence_size = 1 + 8 + 2 + 1;
+      constexpr uint32_t sequence_output = 8 + 24;
+      constexpr uint32_t sequence_count = buffer_size / sequence_size;
+      constexpr uint32_t stream_size = sequence_count * sequence_size;
+
+      image::decoder decoder;
+      uint32_t stream_position = 0;
+
+      /**
+       * @brief serve the stream from the shared buffer
+       */
+      FRESULT read_stream(void *data, UINT size, UINT *bytes_read)
+      {
+        *bytes_read = minimum(size, stream_size - stream_position);
+        memcpy(data, buffer + stream_position, *bytes_read);
+        stream_position += *bytes_read;
+        return FR_OK;
+      }
+
+      /**
+       * @brief cost of decoding compressed images, decoding a synthetic stream in RAM
+       */
+      void run()
+      {
+        // build the stream
+        uint8_t *stream = buffer;
+        for (uint32_t i = 0; i < sequence_count; i++)
+        {
+          *stream++ = (8 << 4) | 15;
+          for (uint32_t j = 0; j < 8; j++)
+          {
+            *stream++ = static_cast<uint8_t>((i * 8) + j);
+          }
+          *stream++ = 8;
+          *stream++ = 0;
+          *stream++ = 24 - 4 - 15;
+        }
+
+        constexpr uint32_t repeat = 6;
+        constexpr uint32_t app_size = sequence_count * sequence_output;
+        uint8_t output[512];
+        uint32_t total = 0;
+        bool ok = true;
+
+        const stopwatch sw;
+        for (uint32_t i = 0; ok && i < repeat; i++)
+        {
+          stream_position = 0;
+          ok = decoder.start(&read_stream, 0, app_size, IMAGE_MIN_WINDOW_BITS);
+          for (UINT bytes_read = sizeof(output); ok && bytes_read == sizeof(output); total += bytes_read)
+          {
+            ok = decoder.read(output, sizeof(output), bytes_read);
+          }
+        }
+        const uint32_t cycles = sw.elapsed_cycles();
+
+        result r("decompress");
+        if (ok && total == repeat * app_size)
+        {
+          r.add("ratio_pct", (stream_size * 100) / app_size).add_timing(total, cycles / (SystemCoreClock / 1000000ul)).add("cycles_per_kb", cycles / (total / 1024));
+        }
+        else
+        {
+          r.add("error", 1);
+        }
+        r.print();
+      }
+    } // namespace decompress
+  #endif
+
+  #if ENABLE_ENCRYPTED_IMAGES == 1
+    namespace decrypt
+    {
+      /**
+       * @brief cost of decrypting encrypted images, applying the AES key stream to 512 byte chunks in RAM as image::read does
+       */
+      void run()
+      {
+        constexpr uint32_t total = 65536;
+        constexpr uint32_t chunk_size = 512;
+        const aes::key_t key = {};
+        const uint8_t nonce[12] = {};
+
+        const stopwatch sw;
+        aes::start_ctr(key, nonce, 0);
+        for (uint32_t bytes = 0; bytes < total; bytes += chunk_size)
+        {
+          aes::apply_ctr(buffer, chunk_size);
+        }
+        const uint32_t cycles = sw.elapsed_cycles();
+
+        result("decrypt").add_timing(total, cycles / (SystemCoreClock / 1000000ul)).add("cycles_per_kb", cycles / (total / 1024)).print();
+      }
+    } // namespace decrypt
+  #endif
+
+  #if ENABLE_SIGNED_IMAGES == 1
+    namespace signature
+    {
+      /**
+       * @brief cost of checking the signature of signed images. the result doesn't matter, every signature with r and s
+       * in range takes the full verification. done by the CPU alone, so the time at the 200 MHz the MCU can run at is
+       * projected from the cycles
+       */
+      void run()
+      {
+        uint8_t digest[ecdsa::number_size];
+        uint8_t signature[2 * ecdsa::number_size];
+        memset(digest, 0xA5, sizeof(digest));
+        memset(signature, 0x5A, sizeof(signature));
+
+        const stopwatch sw;
+        const bool valid = ecdsa::verify(digest, signature);
+        const uint32_t cycles = sw.elapsed_cycles();
+
+        result("ecdsa").add("clock_khz", SystemCoreClock / 1000)
+                       .add("cycles", cycles)
+                       .add("us", cycles / (SystemCoreClock / 1000000ul))
+                       .add("us_at_200mhz", cycles / 200)
+                       .add("valid", valid ? 1 : 0)
+                       .print();
+      }
+    } // namespace signature
+  #endif
+
+  namespace hashing
+  {
+    /**
+     * @brief throughput of the configured metadata hash
+     */
+    void run()
+    {
+      #if METADATA_HASH != HASH_NONE
+        #if METADATA_HASH == HASH_CRC32
+          result r("crc32");
+        #elif METADATA_HASH == HASH_SHA256
+          result r("sha256");
+        #endif
+
+        constexpr uint32_t total = 65536;
+        constexpr uint32_t chunk_size = 512;
+        memset(buffer, 0xA5, chunk_size);
+
+        const stopwatch sw;
+        bool ok = hash::start();
+        for (uint32_t bytes = 0; ok && bytes < total; bytes += chunk_size)
+        {
+          ok = hash::push_data(buffer, chunk_size);
+        }
+
+        hash::hash_t hash;
+        ok = ok && hash::get_hash(hash);
+        const uint32_t us = sw.elapsed_us();
+
+        if (ok)
+        {
+          r.add_timing(total, us);
+        }
+        else
+        {
+          r.add("error", 1);
+        }
+        r.print();
+      #endif
+    }
+
+    /**
+     * @brief cost of the application integrity check, hashing 100 KB straight from flash.
+     * reported for the current system clock, as ms per 100 KB
+     */
+    void run_flash()
+    {
+      #if METADATA_HASH != HASH_NONE
+        result r("verify");
+        r.add("clock", SystemCoreClock);
+
+        constexpr uint32_t total = 100 * 1024;
+        const uint32_t size = minimum(flash::get_flash_size(), total);
+
+        const stopwatch sw;
+        const uint8_t *data = flash::at<uint8_t>(0);
+        bool ok = hash::start();
+        for (uint32_t offset = 0; ok && offset < size; offset += hash::chunk_size)
+        {
+          ok = hash::push_data(data + offset, minimum(size - offset, hash::chunk_size));
+        }
+
+        hash::hash_t hash;
+        ok = ok && hash::get_hash(hash);
+        const uint32_t us = sw.elapsed_us();
+
+        if (ok)
+        {
+          char ms_per_100kb[16];
+          logging::formatters::format_fixed_3(ms_per_100kb, static_cast<uint32_t>((static_cast<uint64_t>(us) * total) / size));
+          r.add_timing(size, us).add("ms_per_100kb", ms_per_100kb);
+        }
+        else
+        {
+          r.add("error", 1);
+        }
+        r.print();
+      #endif
+    }
+  } // namespace hashing
+
+  namespace efm
+  {
+    enum class strategy
+    {
+      /**
+       * @brief EFM_SingleProgramRB per word, as used for updates
+       */
+      single_rb,
+
+      /**
+       * @brief EFM_SingleProgram per word, without read-back
+       */
+      single,
+
+      /**
+       * @brief EFM_SequenceProgram per 512 byte block
+       */
+      sequence,
+    };
+
+    const char *const strategy_names[] = { "single_rb", "single", "sequence" };
+
+    constexpr uint32_t block_size = 512;
+    constexpr uint32_t words_per_sector = flash::erase_sector_size / 4;
+
+    /**
+     * @brief program the scratch sector using a strategy
+     * @return true if the sector holds the expected data afterwards
+     */
+    bool program(const uint32_t sector_address, const strategy strategy)
+    {
+      uint32_t *words = reinterpret_cast<uint32_t *>(buffer);
+      for (uint32_t block = 0; block < flash::erase_sector_size; block += block_size)
+      {
+        const uint32_t block_address = sector_address + block;
+        for (uint32_t i = 0; i < (block_size / 4); i++)
+        {
+          words[i] = block_address + (i * 4);
+        }
+
+        switch (strategy)
+        {
+        case strategy::single_rb:
+          for (uint32_t i = 0; i < (block_size / 4); i++)
+          {
+            if (EFM_SingleProgramRB(block_address + (i * 4), words[i]) != Ok)
+            {
+              return false;
+            }
+          }
+          break;
+        case strategy::single:
+          for (uint32_t i = 0; i < (block_size / 4); i++)
+          {
+            EFM_SingleProgram(block_address + (i * 4), words[i]);
+          }
+          break;
+        case strategy::sequence:
+          EFM_SequenceProgram(block_address, block_size, words);
+          break;
+        }
+      }
+
+      // verify
+      const uint32_t *flash_words = flash::at<uint32_t>(sector_address);
+      for (uint32_t i = 0; i < words_per_sector; i++)
+      {
+        if (flash_words[i] != sector_address + (i * 4))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /**
+     * @brief get the scratch sector: the first sector after the installed application, as stored in the update
+     * metadata. it must end before the sector holding the update metadata and markers, and before the staging slot
+     * @return the sector address, or 0 if there is no such sector
+     */
+    uint32_t get_scratch_address()
+    {
+      #if STORE_UPDATE_METADATA == 1
+        // without metadata, the end of the application isn't known
+        const flash::update_metadata *stored = flash::update_metadata::get_stored(APP_BASE_ADDRESS);
+        if (stored->app_size == 0xFFFFFFFF)
+        {
+          return 0;
+        }
+
+        const uint32_t app_end_address = APP_BASE_ADDRESS + stored->app_size;
+        const uint32_t scratch_address = (app_end_address + flash::erase_sector_size - 1) & ~(flash::erase_sector_size - 1);
+
+        const uint32_t flash_end_address = flash::get_app_area_end(APP_BASE_ADDRESS) - 1;
+        uint32_t free_end_address = flash::update_metadata::get_update_marker_address(flash_end_address) & ~(flash::erase_sector_size - 1);
+        #if ENABLE_STAGED_UPDATES == 1
+          free_end_address = minimum(free_end_address, static_cast<uint32_t>(STAGING_SLOT_ADDRESS));
+        #endif
+
+        return app_end_address >= APP_BASE_ADDRESS && scratch_address + flash::erase_sector_size <= free_end_address ? scratch_address : 0;
+      #else
+        return 0;
+      #endif
+    }
+
+    /**
+     * @brief erase time per sector and program time per word for every strategy,
+     * using the free sector after the installed application as scratch area
+     */
+    void run()
+    {
+      const uint32_t scratch_address = get_scratch_address();
+      if (scratch_address == 0)
+      {
+        logging::error("no free flash sector after the app\n");
+        result("efm_erase").add("error", 1).print();
+        return;
+      }
+
+      EFM_Unlock();
+      EFM_FlashCmd(Enable);
+      while (EFM_GetFlagStatus(EFM_FLAG_RDY) != Set) { /* nada */ }
+
+      for (const strategy strategy : { strategy::single_rb, strategy::single, strategy::sequence })
+      {
+        const char *name = strategy_names[static_cast<int>(strategy)];
+
+        // erase
+        result erase_result("efm_erase");
+        erase_result.add("strategy", name);
+        {
+          const stopwatch sw;
+          const en_result_t rc = EFM_SectorErase(scratch_address);
+          const uint32_t us = sw.elapsed_us();
+          if (rc != Ok)
+          {
+            erase_result.add("error", rc).print();
+            break;
+          }
+          erase_result.add("us", us).print();
+        }
+
+        // program
+        result program_result("efm_program");
+        program_result.add("strategy", name).add("words", words_per_sector);
+        {
+          const stopwatch sw;
+          const bool ok = program(scratch_address, strategy);
+          const uint32_t us = sw.elapsed_us();
+
+          char ns_per_word[11];
+          logging::formatters::format_number(ns_per_word, static_cast<uint32_t>((static_cast<uint64_t>(us) * 1000ull) / words_per_sector), 10);
+          program_result.add_timing(flash::erase_sector_size, us).add("ns_per_word", ns_per_word);
+          if (!ok)
+          {
+            program_result.add("error", 1);
+          }
+          program_result.print();
+        }
+      }
+
+      // leave the scratch sector erased
+      EFM_SectorErase(scratch_address);
+      EFM_Lock();
+    }
+  } // namespace efm
+
+  namespace serial
+  {
+    constexpr uint32_t total = 2048;
+
+    #if HAS_SERIAL(HOST_SERIAL)
+      /**
+       * @brief host serial throughput, sending lines of dots
+       */
+      void run_host()
+      {
+        const stopwatch sw;
+        for (uint32_t i = 0; i < total; i++)
+        {
+          hostSerial.put((i % 64) == 63 ? '\n' : '.');
+        }
+        hostSerial.flush();
+        const uint32_t us = sw.elapsed_us();
+
+        result("host_serial").add("baud", HOST_SERIAL_BAUD).add_timing(total, us).print();
+      }
+    #endif
+
+    #if HAS_SERIAL(SCREEN_SERIAL)
+      /**
+       * @brief screen serial throughput, sending zero bytes the screen ignores outside of a frame.
+       * also measures a full screen clear
+       */
+      void run_screen()
+      {
+        {
+          const stopwatch sw;
+          for (uint32_t i = 0; i < total; i++)
+          {
+            screenSerial.put(0);
+          }
+          screenSerial.flush();
+          const uint32_t us = sw.elapsed_us();
+
+          result("screen_serial").add_timing(total, us).print();
+        }
+
+        {
+          const stopwatch sw;
+          screen.clear();
+          screen.flush(/*force*/ true);
+          const uint32_t us = sw.elapsed_us();
+
+          result("screen_clear").add("us", us).print();
+        }
+      }
+    #endif
+
+    void run()
+    {
+      #if HAS_SERIAL(HOST_SERIAL)
+        run_host();
+      #endif
+      #if HAS_SERIAL(SCREEN_SERIAL)
+        run_screen();
+      #endif
+    }
+  } // namespace serial
+
+  void run()
+  {
+    logging::log("running benchmarks\n");
+    logging::flush();
+
+    result("system").add("clock_khz", SystemCoreClock / 1000).add("version", BOOTLOADER_VERSION).print();
+    sd_read::run();
+    file_read::run();
+    copy::run();
+    #if ENABLE_COMPRESSED_IMAGES == 1
+      decompress::run();
+    #endif
+    #if ENABLE_ENCRYPTED_IMAGES == 1
+      decrypt::run();
+    #endif
+    #if ENABLE_SIGNED_IMAGES == 1
+      signature::run();
+    #endif
+    hashing::run();
+    hashing::run_flash();
+    efm::run();
+    serial::run();
+
+    logging::log("benchmarks done\n");
+  }
+} // namespace benchmark
+
+#else
+  void benchmark::run() {}
+#endif // IS_PROFILE(BENCHMARK)
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace benchmark
+{
+  /**
+   * @brief run all benchmarks and print the results to the host serial.
+   * format: one line per result, "bench: <test> <key>=<value> ...".
+   * durations are in microseconds (us=), throughput in MB/s (mb_s=), errors are reported as error=<code>
+   * @note erases and programs a scratch sector right before the last flash sector
+   */
+  void run();
+} // namespace benchmark
@@ -0,0 +1,236 @@
+/**
+ * OpenHC32Boot boot trace ABI.
+ *
+ * the bootloader records timestamped events of its boots into a ring buffer in retained RAM.
+ * the ring is not cleared on reset, so the next boot and the application can read what happened,
+ * e.g. after an update failed or the application didn't start.
+ *
+ * this header is self-contained, so the application can include it to read the trace.
+ * by default, the trace is located at the start of the retention SRAM (Ret_SRAM, 0x200F0000).
+ * the application must not use the memory occupied by the trace if it wants to read it.
+ *
+ * reading the trace:
+ * 1. check magic, version and entry_size
+ * 2. check crc, the CRC32 (as used by zip / zlib) over the trace, excluding the crc field
+ * 3. the newest entry is at entries[(head - 1) % capacity], the oldest of the min(head, capacity)
+ *    valid entries at entries[(head - min(head, capacity)) % capacity]
+ * entries of the current boot have boot == boot_count.
+ */
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief default address of the trace, start of the retention SRAM
+ */
+#define BOOT_TRACE_DEFAULT_ADDRESS 0x200F0000ul
+
+/**
+ * @brief trace magic value, "OHBT"
+ */
+#define BOOT_TRACE_MAGIC 0x5442484Ful
+
+/**
+ * @brief trace layout version. incremented on incompatible changes
+ */
+#define BOOT_TRACE_VERSION 1
+
+/**
+ * @brief number of entries in the ring
+ */
+#define BOOT_TRACE_CAPACITY 32
+
+/**
+ * @brief boot trace event types
+ */
+enum boot_trace_event
+{
+  /**
+   * @brief the bootloader started.
+   * arg0: SystemCoreClock, arg1: 1 if the trace was kept from the previous boot, 0 if it was reset
+   */
+  BOOT_TRACE_EVENT_BOOT = 1,
+
+  /**
+   * @brief a boot stage was entered. detail: stage (BOOT_TRACE_STAGE_*)
+   */
+  BOOT_TRACE_EVENT_STAGE_ENTER = 2,
+
+  /**
+   * @brief a boot stage was exited. detail: stage (BOOT_TRACE_STAGE_*)
+   */
+  BOOT_TRACE_EVENT_STAGE_EXIT = 3,
+
+  /**
+   * @brief initializing the SD card failed.
+   * detail: DDL result code, arg0: u32ErrorCode of the SD handle, arg1: 0 = SDCARD_Init, 1 = SDCARD_GetCardCSD
+   */
+  BOOT_TRACE_EVENT_SD_INIT_ERROR = 4,
+
+  /**
+   * @brief reading from the SD card failed. detail: DDL result code, arg0: u32ErrorCode of the SD handle, arg1: sector
+   */
+  BOOT_TRACE_EVENT_SD_READ_ERROR = 5,
+
+  /**
+   * @brief programming a flash word failed. detail: DDL result code, arg0: address, arg1: data
+   */
+  BOOT_TRACE_EVENT_FLASH_ERROR = 6,
+
+  /**
+   * @brief erasing a flash sector failed. detail: DDL result code, arg0: sector address
+   */
+  BOOT_TRACE_EVENT_ERASE_ERROR = 7,
+
+  /**
+   * @brief a pre-jump check failed. detail: index of the failed check
+   */
+  BOOT_TRACE_EVENT_PRE_CHECK_FAIL = 8,
+
+  /**
+   * @brief a hard fault occurred. arg0: SCB->CFSR, arg1: SCB->HFSR
+   */
+  BOOT_TRACE_EVENT_FAULT = 9,
+
+  /**
+   * @brief program counter and link register of a hard fault. arg0: stacked PC, arg1: stacked LR
+   */
+  BOOT_TRACE_EVENT_FAULT_PC = 10,
+
+  /**
+   * @brief fault address of a hard fault. detail: 0 = MMFAR, 1 = BFAR, arg0: fault address
+   */
+  BOOT_TRACE_EVENT_FAULT_ADDRESS = 11,
+
+  /**
+   * @brief the firmware update was applied (detail 1), failed (detail 0) or was rejected for its signature (detail 2)
+   */
+  BOOT_TRACE_EVENT_UPDATE = 12,
+
+  /**
+   * @brief the bootloader jumps to the application. arg0: application base address
+   */
+  BOOT_TRACE_EVENT_JUMP = 13,
+
+  /**
+   * @brief SD I/O counters at the end of the boot.
+   * detail: retries (saturated at 255), arg0: sectors requested by FatFs, arg1: block reads issued to the card
+   */
+  BOOT_TRACE_EVENT_SD_READS = 14,
+
+  /**
+   * @brief SD I/O counters at the end of the boot.
+   * detail: timeouts (saturated at 255), arg0: card busy time in microseconds, arg1: sector cache hits
+   */
+  BOOT_TRACE_EVENT_SD_TIME = 15,
+
+  /**
+   * @brief result of the application integrity check.
+   * detail: 0 = mismatch, 1 = passed, 2 = skipped as verified before, 3 = skipped without metadata, arg0: application size
+   */
+  BOOT_TRACE_EVENT_INTEGRITY = 16,
+
+  /**
+   * @brief the slot record changed.
+   * detail: 0 = activated, 1 = rolled back, arg0: base address of the new active slot, arg1: record sequence
+   */
+  BOOT_TRACE_EVENT_SLOT = 17,
+};
+
+/**
+ * @brief boot stages
+ */
+enum boot_trace_stage
+{
+  BOOT_TRACE_STAGE_SCREEN_INIT = 0,
+  BOOT_TRACE_STAGE_MOUNT = 1,
+  BOOT_TRACE_STAGE_HASH = 2,
+  BOOT_TRACE_STAGE_ERASE = 3,
+  BOOT_TRACE_STAGE_WRITE = 4,
+  BOOT_TRACE_STAGE_PRE_CHECK = 5,
+  BOOT_TRACE_STAGE_VERIFY = 6,
+  BOOT_TRACE_STAGE_RECEIVE = 7,
+  BOOT_TRACE_STAGE_SIGNATURE = 8,
+};
+
+/**
+ * @brief a trace entry
+ */
+typedef struct boot_trace_entry
+{
+  /**
+   * @brief approximate time since the bootloader started, in microseconds
+   */
+  uint32_t timestamp_us;
+
+  /**
+   * @brief event type, one of boot_trace_event
+   */
+  uint8_t event;
+
+  /**
+   * @brief event specific detail
+   */
+  uint8_t detail;
+
+  /**
+   * @brief lower 16 bits of the boot count of the boot that recorded the entry
+   */
+  uint16_t boot;
+
+  /**
+   * @brief event specific arguments
+   */
+  uint32_t arg0;
+  uint32_t arg1;
+} boot_trace_entry_t;
+
+/**
+ * @brief the trace, located at BOOT_TRACE_DEFAULT_ADDRESS unless configured otherwise
+ */
+typedef struct boot_trace
+{
+  /**
+   * @brief BOOT_TRACE_MAGIC if the trace was initialized
+   */
+  uint32_t magic;
+
+  /**
+   * @brief BOOT_TRACE_VERSION
+   */
+  uint16_t version;
+
+  /**
+   * @brief sizeof(boot_trace_entry_t)
+   */
+  uint16_t entry_size;
+
+  /**
+   * @brief number of entries in the ring, BOOT_TRACE_CAPACITY
+   */
+  uint16_t capacity;
+
+  /**
+   * @brief lower 16 bits of the number of boots recorded since the trace was initialized
+   */
+  uint16_t boot_count;
+
+  /**
+   * @brief total number of entries ever written. the next entry is written at entries[head % capacity]
+   */
+  uint32_t head;
+
+  /**
+   * @brief CRC32 over the trace, excluding this field
+   */
+  uint32_t crc;
+
+  /**
+   * @brief the entries
+   */
+  boot_trace_entry_t entries[BOOT_TRACE_CAPACITY];
+} boot_trace_t;
+
+#ifdef __cplusplus
+  static_assert(sizeof(boot_trace_entry_t) == 16, "boot_trace_entry_t ABI changed");
+  static_assert(sizeof(boot_trace_t) == 20 + (16 * BOOT_TRACE_CAPACITY), "boot_trace_t ABI changed");
+#endif
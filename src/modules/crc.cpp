@@ -0,0 +1,53 @@
+#include "crc.h"
+
+#if ENABLE_IMAGE_MANIFEST == 1 || ENABLE_SERIAL_UPDATE == 1 || ENABLE_BOOT_TRACE == 1
+namespace crc
+{
+  /**
+   * @brief CRC32 of each nibble, for the reflected polynomial 0xEDB88320
+   */
+  static const uint32_t nibbles[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+
+  uint32_t crc32(uint32_t crc, const uint8_t *data, const uint32_t size)
+  {
+    crc = ~crc;
+    for (uint32_t i = 0; i < size; i++)
+    {
+      crc ^= data[i];
+      crc = (crc >> 4) ^ nibbles[crc & 0x0F];
+      crc = (crc >> 4) ^ nibbles[crc & 0x0F];
+    }
+    return ~crc;
+  }
+} // namespace crc
+#endif // ENABLE_IMAGE_MANIFEST == 1 || ENABLE_SERIAL_UPDATE == 1 || ENABLE_BOOT_TRACE == 1
+
+#if ENABLE_IMAGE_MANIFEST == 1 || METADATA_SECTOR_CRCS == 1 || ENABLE_STAGED_UPDATES == 1 || ENABLE_AB_SLOTS == 1
+#include <hc32_ddl.h>
+
+// CRC32 with reflected input and output, see hash/crc32.cpp
+#define CRC_CONFIG_CRC32_REFLECTED ((uint32_t)((0x1ul << 1u) | (0x1ul << 2u) | (0x1ul << 3u)))
+
+namespace crc
+{
+  uint32_t calculate(const uint32_t *words, const uint32_t count)
+  {
+    PWC_Fcg0PeriphClockCmd(PWC_FCG0_PERIPH_CRC, Enable);
+    M4_CRC->CR = CRC_CONFIG_CRC32_REFLECTED;
+    M4_CRC->RESLT = 0xFFFFFFFF;
+
+    // a word is fed least significant byte first, so this is the CRC32 of the bytes in memory
+    for (uint32_t i = 0; i < count; i++)
+    {
+      M4_CRC->DAT0 = words[i];
+    }
+
+    // the final xor is left to software
+    return ~static_cast<uint32_t>(M4_CRC->RESLT);
+  }
+} // namespace crc
+
+#endif // ENABLE_IMAGE_MANIFEST == 1 || METADATA_SECTOR_CRCS == 1 || ENABLE_STAGED_UPDATES == 1 || ENABLE_AB_SLOTS == 1
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include "../config.h"
+
+namespace crc
+{
+  #if ENABLE_IMAGE_MANIFEST == 1 || METADATA_SECTOR_CRCS == 1 || ENABLE_STAGED_UPDATES == 1 || ENABLE_AB_SLOTS == 1
+    /**
+     * @brief calculate the CRC32 of words using the CRC peripheral
+     * @param words the words, e.g. straight from flash
+     * @param count number of words
+     * @return the CRC32 of the bytes of the words, as calculated by zlib
+     * @note don't use while a METADATA_HASH session using the CRC peripheral is running
+     */
+    uint32_t calculate(const uint32_t *words, const uint32_t count);
+  #endif
+
+  #if ENABLE_IMAGE_MANIFEST == 1 || ENABLE_SERIAL_UPDATE == 1 || ENABLE_BOOT_TRACE == 1
+    /**
+     * @brief update a CRC32 with data in software, 4 bits at a time
+     * @param crc the CRC32 of the data before, 0 to start
+     * @param data the data
+     * @param size the size of the data, in bytes
+     * @return the CRC32 including the data, as calculated by zlib
+     * @note for data read while the CRC peripheral may be busy with the update metadata hash
+     */
+    uint32_t crc32(uint32_t crc, const uint8_t *data, const uint32_t size);
+  #endif
+} // namespace crc
@@ -1,17 +1,41 @@
 #pragma once
 #include <hc32_ddl.h>
+#include "timebase.h"
 
-namespace delay 
+namespace delay
 {
   /**
-   * @brief Delay for a number of milliseconds
-   * @param ms the number of milliseconds to delay
+   * @brief Delay for a number of microseconds
+   * @param us the number of microseconds to delay
+   * @note falls back to a calibrated busy loop if the time base is not running
    */
-  inline void ms(const uint32_t ms) { Ddl_Delay1ms(ms); }
+  inline void us(const uint32_t us)
+  {
+    if (!timebase::is_running())
+    {
+      Ddl_Delay1us(us);
+      return;
+    }
+
+    const timebase::deadline deadline(us);
+    while (!deadline.expired())
+    {
+      __NOP();
+    }
+  }
 
   /**
-   * @brief Delay for a number of microseconds
-   * @param us the number of microseconds to delay
+   * @brief Delay for a number of milliseconds
+   * @param ms the number of milliseconds to delay. must be less than ~35 minutes
    */
-  inline void us(const uint32_t us) { Ddl_Delay1us(us); }
+  inline void ms(const uint32_t ms)
+  {
+    if (!timebase::is_running())
+    {
+      Ddl_Delay1ms(ms);
+      return;
+    }
+
+    us(ms * 1000ul);
+  }
 } // namespace delay
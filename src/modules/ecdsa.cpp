@@ -0,0 +1,486 @@
+#include "ecdsa.h"
+
+#if ENABLE_SIGNED_IMAGES == 1
+#include <string.h>
+
+namespace ecdsa
+{
+  /**
+   * @brief number of 32 bit words of a number
+   */
+  constexpr uint32_t word_count = number_size / 4;
+
+  /**
+   * @brief a 256 bit number, least significant word first
+   */
+  typedef uint32_t number_t[word_count];
+
+  /**
+   * @brief a prime modulus, with the constants of the Montgomery multiplication (R = 2^256)
+   */
+  struct modulus
+  {
+    /**
+     * @brief the modulus
+     */
+    number_t m;
+
+    /**
+     * @brief R^2 mod m, to convert numbers to Montgomery form
+     */
+    number_t r2;
+
+    /**
+     * @brief -m^-1 mod 2^32
+     */
+    uint32_t inverse;
+  };
+
+  /**
+   * @brief the prime of the field of the curve
+   */
+  constexpr modulus p = {
+    { 0xFFFFFFFFul, 0xFFFFFFFFul, 0xFFFFFFFFul, 0x00000000ul, 0x00000000ul, 0x00000000ul, 0x00000001ul, 0xFFFFFFFFul },
+    { 0x00000003ul, 0x00000000ul, 0xFFFFFFFFul, 0xFFFFFFFBul, 0xFFFFFFFEul, 0xFFFFFFFFul, 0xFFFFFFFDul, 0x00000004ul },
+    0x00000001ul,
+  };
+
+  /**
+   * @brief the order of the base point
+   */
+  constexpr modulus n = {
+    { 0xFC632551ul, 0xF3B9CAC2ul, 0xA7179E84ul, 0xBCE6FAADul, 0xFFFFFFFFul, 0xFFFFFFFFul, 0x00000000ul, 0xFFFFFFFFul },
+    { 0xBE79EEA2ul, 0x83244C95ul, 0x49BD6FA6ul, 0x4699799Cul, 0x2B6BEC59ul, 0x2845B239ul, 0xF3D95620ul, 0x66E12D94ul },
+    0xEE00BC4Ful,
+  };
+
+  /**
+   * @brief a point in affine coordinates
+   */
+  struct affine_point
+  {
+    number_t x;
+    number_t y;
+  };
+
+  /**
+   * @brief the base point
+   */
+  constexpr affine_point base_point = {
+    { 0xD898C296ul, 0xF4A13945ul, 0x2DEB33A0ul, 0x77037D81ul, 0x63A440F2ul, 0xF8BCE6E5ul, 0xE12C4247ul, 0x6B17D1F2ul },
+    { 0x37BF51F5ul, 0xCBB64068ul, 0x6B315ECEul, 0x2BCE3357ul, 0x7C0F9E16ul, 0x8EE7EB4Aul, 0xFE1A7F9Bul, 0x4FE342E2ul },
+  };
+
+  /**
+   * @brief IMAGE_PUBLIC_KEY, parsed at compile time
+   */
+  constexpr bool is_hex_digit(const char c)
+  {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+  }
+
+  constexpr uint32_t hex_digit(const char c)
+  {
+    return c <= '9' ? c - '0' : (c <= 'F' ? c - 'A' + 10 : c - 'a' + 10);
+  }
+
+  constexpr bool is_hex_key(const char (&hex)[(4 * number_size) + 1])
+  {
+    for (uint32_t i = 0; i < 4 * number_size; i++)
+    {
+      if (!is_hex_digit(hex[i]))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief parse a big endian number of 2 * number_size hex digits
+   */
+  constexpr void parse_number(const char *hex, uint32_t (&number)[word_count])
+  {
+    for (uint32_t i = 0; i < 2 * number_size; i++)
+    {
+      const uint32_t word = word_count - 1 - (i / 8);
+      number[word] = (number[word] << 4) | hex_digit(hex[i]);
+    }
+  }
+
+  constexpr affine_point parse_key(const char (&hex)[(4 * number_size) + 1])
+  {
+    affine_point key = {};
+    parse_number(hex, key.x);
+    parse_number(hex + (2 * number_size), key.y);
+    return key;
+  }
+
+  static_assert(is_hex_key(IMAGE_PUBLIC_KEY), "IMAGE_PUBLIC_KEY must be 128 hex digits");
+  constexpr affine_point public_key = parse_key(IMAGE_PUBLIC_KEY);
+
+  /**
+   * @brief read a big endian number
+   */
+  void read_number(number_t &number, const uint8_t *bytes)
+  {
+    for (uint32_t i = 0; i < word_count; i++)
+    {
+      const uint8_t *word = bytes + ((word_count - 1 - i) * 4);
+      number[i] = (static_cast<uint32_t>(word[0]) << 24) | (static_cast<uint32_t>(word[1]) << 16) | (static_cast<uint32_t>(word[2]) << 8) | word[3];
+    }
+  }
+
+  bool is_zero(const number_t &a)
+  {
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < word_count; i++)
+    {
+      bits |= a[i];
+    }
+    return bits == 0;
+  }
+
+  /**
+   * @brief is a greater than or equal to b?
+   */
+  bool is_at_least(const number_t &a, const number_t &b)
+  {
+    for (uint32_t i = word_count; i-- > 0;)
+    {
+      if (a[i] != b[i])
+      {
+        return a[i] > b[i];
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief r = a + b
+   * @return the carry
+   */
+  uint32_t add(number_t &r, const number_t &a, const number_t &b)
+  {
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < word_count; i++)
+    {
+      carry += static_cast<uint64_t>(a[i]) + b[i];
+      r[i] = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+    return static_cast<uint32_t>(carry);
+  }
+
+  /**
+   * @brief r = a - b
+   * @return the borrow
+   */
+  uint32_t sub(number_t &r, const number_t &a, const number_t &b)
+  {
+    uint64_t borrow = 0;
+    for (uint32_t i = 0; i < word_count; i++)
+    {
+      const uint64_t difference = static_cast<uint64_t>(a[i]) - b[i] - borrow;
+      r[i] = static_cast<uint32_t>(difference);
+      borrow = (difference >> 32) & 1;
+    }
+    return static_cast<uint32_t>(borrow);
+  }
+
+  /**
+   * @brief r = a + b mod m, for a and b below m
+   */
+  void mod_add(number_t &r, const number_t &a, const number_t &b, const modulus &m)
+  {
+    if (add(r, a, b) != 0 || is_at_least(r, m.m))
+    {
+      sub(r, r, m.m);
+    }
+  }
+
+  /**
+   * @brief r = a - b mod m, for a and b below m
+   */
+  void mod_sub(number_t &r, const number_t &a, const number_t &b, const modulus &m)
+  {
+    if (sub(r, a, b) != 0)
+    {
+      add(r, r, m.m);
+    }
+  }
+
+  /**
+   * @brief Montgomery multiplication, r = a * b / R mod m, for a and b below m
+   */
+  void mont_mul(number_t &r, const number_t &a, const number_t &b, const modulus &m)
+  {
+    // coarsely integrated operand scanning: add a * b[i], then add the multiple of m that clears the lowest word
+    uint32_t t[word_count + 2] = {};
+    for (uint32_t i = 0; i < word_count; i++)
+    {
+      uint64_t carry = 0;
+      for (uint32_t j = 0; j < word_count; j++)
+      {
+        carry += t[j] + (static_cast<uint64_t>(a[j]) * b[i]);
+        t[j] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+      }
+      carry += t[word_count];
+      t[word_count] = static_cast<uint32_t>(carry);
+      t[word_count + 1] = static_cast<uint32_t>(carry >> 32);
+
+      const uint32_t u = t[0] * m.inverse;
+      carry = (t[0] + (static_cast<uint64_t>(u) * m.m[0])) >> 32;
+      for (uint32_t j = 1; j < word_count; j++)
+      {
+        carry += t[j] + (static_cast<uint64_t>(u) * m.m[j]);
+        t[j - 1] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+      }
+      carry += t[word_count];
+      t[word_count - 1] = static_cast<uint32_t>(carry);
+      t[word_count] = t[word_count + 1] + static_cast<uint32_t>(carry >> 32);
+    }
+
+    // the result is below 2 * m
+    number_t &result = *reinterpret_cast<number_t *>(t);
+    if (t[word_count] != 0 || is_at_least(result, m.m))
+    {
+      sub(result, result, m.m);
+    }
+    memcpy(r, result, sizeof(number_t));
+  }
+
+  /**
+   * @brief convert a number below m to Montgomery form
+   */
+  void to_mont(number_t &r, const number_t &a, const modulus &m)
+  {
+    mont_mul(r, a, m.r2, m);
+  }
+
+  /**
+   * @brief convert a number from Montgomery form
+   */
+  void from_mont(number_t &r, const number_t &a, const modulus &m)
+  {
+    const number_t one = { 1 };
+    mont_mul(r, a, one, m);
+  }
+
+  /**
+   * @brief r = a^-1 mod m in Montgomery form, as a^(m - 2) since m is prime
+   */
+  void mont_inverse(number_t &r, const number_t &a, const modulus &m)
+  {
+    const number_t two = { 2 };
+    number_t exponent;
+    sub(exponent, m.m, two);
+
+    // the top bit of both moduli is set
+    number_t result;
+    memcpy(result, a, sizeof(number_t));
+    for (uint32_t bit = (32 * word_count) - 1; bit-- > 0;)
+    {
+      mont_mul(result, result, result, m);
+      if ((exponent[bit / 32] >> (bit % 32)) & 1)
+      {
+        mont_mul(result, result, a, m);
+      }
+    }
+    memcpy(r, result, sizeof(number_t));
+  }
+
+  /**
+   * @brief a point in Jacobian coordinates (x / z^2, y / z^3), in Montgomery form. z is 0 for the point at infinity
+   */
+  struct point
+  {
+    number_t x;
+    number_t y;
+    number_t z;
+  };
+
+  /**
+   * @brief r = 2 * a, using a = -3 of the curve
+   */
+  void point_double(point &r, const point &a)
+  {
+    number_t delta, gamma, beta, alpha, t1, t2;
+    mont_mul(delta, a.z, a.z, p);
+    mont_mul(gamma, a.y, a.y, p);
+    mont_mul(beta, a.x, gamma, p);
+
+    // alpha = 3 * (x - delta) * (x + delta)
+    mod_sub(t1, a.x, delta, p);
+    mod_add(t2, a.x, delta, p);
+    mont_mul(alpha, t1, t2, p);
+    mod_add(t1, alpha, alpha, p);
+    mod_add(alpha, t1, alpha, p);
+
+    // z = (y + z)^2 - gamma - delta
+    mod_add(r.z, a.y, a.z, p);
+    mont_mul(r.z, r.z, r.z, p);
+    mod_sub(r.z, r.z, gamma, p);
+    mod_sub(r.z, r.z, delta, p);
+
+    // x = alpha^2 - 8 * beta
+    mod_add(beta, beta, beta, p);
+    mod_add(beta, beta, beta, p);
+    mod_add(t1, beta, beta, p);
+    mont_mul(r.x, alpha, alpha, p);
+    mod_sub(r.x, r.x, t1, p);
+
+    // y = alpha * (4 * beta - x) - 8 * gamma^2
+    mod_sub(t1, beta, r.x, p);
+    mont_mul(t2, gamma, gamma, p);
+    mod_add(t2, t2, t2, p);
+    mod_add(t2, t2, t2, p);
+    mod_add(t2, t2, t2, p);
+    mont_mul(r.y, alpha, t1, p);
+    mod_sub(r.y, r.y, t2, p);
+  }
+
+  /**
+   * @brief r = a + b
+   */
+  void point_add(point &r, const point &a, const point &b)
+  {
+    if (is_zero(a.z))
+    {
+      r = b;
+      return;
+    }
+    if (is_zero(b.z))
+    {
+      r = a;
+      return;
+    }
+
+    // u = x * z'^2 and s = y * z'^3 of both points
+    number_t z1z1, z2z2, u1, u2, s1, s2;
+    mont_mul(z1z1, a.z, a.z, p);
+    mont_mul(z2z2, b.z, b.z, p);
+    mont_mul(u1, a.x, z2z2, p);
+    mont_mul(u2, b.x, z1z1, p);
+    mont_mul(s1, a.y, b.z, p);
+    mont_mul(s1, s1, z2z2, p);
+    mont_mul(s2, b.y, a.z, p);
+    mont_mul(s2, s2, z1z1, p);
+
+    // the points are equal or opposite
+    number_t h, rr;
+    mod_sub(h, u2, u1, p);
+    mod_sub(rr, s2, s1, p);
+    if (is_zero(h))
+    {
+      if (is_zero(rr))
+      {
+        point_double(r, a);
+      }
+      else
+      {
+        memset(&r, 0, sizeof(r));
+      }
+      return;
+    }
+
+    // z = z1 * z2 * h
+    mont_mul(r.z, a.z, b.z, p);
+    mont_mul(r.z, r.z, h, p);
+
+    // x = rr^2 - h^3 - 2 * u1 * h^2
+    number_t hhh, v;
+    mont_mul(z1z1, h, h, p);
+    mont_mul(hhh, h, z1z1, p);
+    mont_mul(v, u1, z1z1, p);
+    mont_mul(r.x, rr, rr, p);
+    mod_sub(r.x, r.x, hhh, p);
+    mod_sub(r.x, r.x, v, p);
+    mod_sub(r.x, r.x, v, p);
+
+    // y = rr * (u1 * h^2 - x) - s1 * h^3
+    mod_sub(v, v, r.x, p);
+    mont_mul(r.y, rr, v, p);
+    mont_mul(s1, s1, hhh, p);
+    mod_sub(r.y, r.y, s1, p);
+  }
+
+  /**
+   * @brief convert an affine point to Jacobian coordinates
+   */
+  void to_point(point &r, const affine_point &a)
+  {
+    const number_t one = { 1 };
+    to_mont(r.x, a.x, p);
+    to_mont(r.y, a.y, p);
+    to_mont(r.z, one, p);
+  }
+
+  bool verify(const uint8_t digest[number_size], const uint8_t signature[2 * number_size])
+  {
+    number_t r, s, e;
+    read_number(r, signature);
+    read_number(s, signature + number_size);
+    read_number(e, digest);
+
+    // r and s must be between 1 and n - 1. the digest is below 2 * n
+    if (is_zero(r) || is_zero(s) || is_at_least(r, n.m) || is_at_least(s, n.m))
+    {
+      return false;
+    }
+    if (is_at_least(e, n.m))
+    {
+      sub(e, e, n.m);
+    }
+
+    // w = s^-1, u1 = e * w and u2 = r * w, mod n. as w is in Montgomery form, the products are not
+    number_t w, u1, u2;
+    to_mont(w, s, n);
+    mont_inverse(w, w, n);
+    mont_mul(u1, e, w, n);
+    mont_mul(u2, r, w, n);
+
+    // u1 * G + u2 * Q, adding G, Q or G + Q after each doubling as the bits of u1 and u2 tell (Shamir's trick)
+    point table[3];
+    to_point(table[0], base_point);
+    to_point(table[1], public_key);
+    point_add(table[2], table[0], table[1]);
+
+    point sum = {};
+    for (uint32_t bit = 32 * word_count; bit-- > 0;)
+    {
+      if (!is_zero(sum.z))
+      {
+        point_double(sum, sum);
+      }
+
+      const uint32_t index = ((u1[bit / 32] >> (bit % 32)) & 1) | (((u2[bit / 32] >> (bit % 32)) & 1) << 1);
+      if (index != 0)
+      {
+        point_add(sum, sum, table[index - 1]);
+      }
+    }
+
+    if (is_zero(sum.z))
+    {
+      return false;
+    }
+
+    // the signature is valid if the affine x of the sum, mod n, is r
+    number_t z_inverse, x;
+    mont_inverse(z_inverse, sum.z, p);
+    mont_mul(z_inverse, z_inverse, z_inverse, p);
+    mont_mul(x, sum.x, z_inverse, p);
+    from_mont(x, x, p);
+    if (is_at_least(x, n.m))
+    {
+      sub(x, x, n.m);
+    }
+
+    return memcmp(x, r, sizeof(number_t)) == 0;
+  }
+} // namespace ecdsa
+
+#endif // ENABLE_SIGNED_IMAGES == 1
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include "../config.h"
+
+namespace ecdsa
+{
+  #if ENABLE_SIGNED_IMAGES == 1
+    /**
+     * @brief size of a number on the NIST P-256 curve, as a coordinate of the public key or either half of a signature
+     */
+    constexpr uint32_t number_size = 32;
+
+    /**
+     * @brief verify an ECDSA signature on the NIST P-256 curve using IMAGE_PUBLIC_KEY.
+     * the public key is built into the bootloader, so flash write protection covers it
+     * @param digest the signed digest, a big endian number
+     * @param signature r followed by s, big endian numbers
+     * @return true if the signature is valid
+     * @note done by the CPU alone, taking a few million cycles. see the BENCHMARK profile
+     */
+    bool verify(const uint8_t digest[number_size], const uint8_t signature[2 * number_size]);
+  #endif
+} // namespace ecdsa
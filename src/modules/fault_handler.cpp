@@ -13,6 +13,8 @@
  */
 #include <hc32_ddl.h>
 #include "log.h"
+#include "screen.h"
+#include "trace.h"
 
 #define LOG_REGISTER(message, register) logging::log(message "0x"); logging::log(register, 16); logging::log("\n");
 
@@ -59,6 +61,18 @@ void print_stack_frame(const hardfault_stack_frame_t *stack_frame)
  */
 extern "C" void HardFault_Handler_C(const hardfault_stack_frame_t *stack_frame, const uint32_t lr_value)
 {
+    // record the fault in the boot trace first, so it is kept even if printing fails
+    trace::record(BOOT_TRACE_EVENT_FAULT, 0, SCB->CFSR, SCB->HFSR);
+    trace::record(BOOT_TRACE_EVENT_FAULT_PC, 0, stack_frame->pc, stack_frame->lr);
+    if ((SCB->CFSR & SCB_CFSR_MMARVALID_Msk) != 0)
+    {
+        trace::record(BOOT_TRACE_EVENT_FAULT_ADDRESS, 0, SCB->MMFAR);
+    }
+    if ((SCB->CFSR & SCB_CFSR_BFARVALID_Msk) != 0)
+    {
+        trace::record(BOOT_TRACE_EVENT_FAULT_ADDRESS, 1, SCB->BFAR);
+    }
+
     // print panic message:
     // - header
     logging::log("\n\n*** HARDFAULT ***\n");
@@ -93,6 +107,8 @@ extern "C" void HardFault_Handler_C(const hardfault_stack_frame_t *stack_frame,
     logging::log("***\n\n");
 
     // end panic message and halt
+    logging::flush();
+    screen.flush(/*force*/ true);
     __BKPT(0);
     __NVIC_SystemReset();
 }
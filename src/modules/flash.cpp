@@ -1,57 +1,63 @@
 #include "flash.h"
 #include <hc32_ddl.h>
+#include "crc.h"
+#include "image.h"
+#include "integrity.h"
 #include "log.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "screen.h"
+#include "staging_format.h"
+#include "../util.h"
 
 namespace flash
 {
   /**
-   * @brief buffer used for reading from the firmware update file
+   * @brief can sectors already holding their part of the application be kept?
    */
-  BYTE buffer[file_buffer_size];
+  #define HAS_KEPT_SECTORS (ENABLE_IMAGE_MANIFEST == 1 || ENABLE_STAGED_UPDATES == 1 || ENABLE_SPARSE_IMAGES == 1)
+
+  #if STORE_UPDATE_METADATA == 1
+    /**
+     * @brief value of the update marker while an update is in progress, "OHBU". programmed to 0 to clear it
+     */
+    constexpr uint32_t update_marker = 0x5542484Ful;
+    constexpr uint32_t update_marker_cleared = 0;
+  #endif
 
   /**
-   * @brief erase the flash sectors in the given range
-   * @param start the start address to erase
-   * @param end the end address to erase
-   * @param progress callback function to report the erase progress
+   * @brief buffer used for reading from the firmware update file.
+   * word-aligned, so full sectors are read into it directly and it can be programmed word by word
+   */
+  BYTE buffer[file_buffer_size] __attribute__((aligned(4)));
+
+  /**
+   * @brief erase a flash sector
+   * @param sector_address the start address of the sector
    * @return true if the erase was successful
    * @note assumes the flash is unlocked 
    */
-  bool erase(const uint32_t start, const uint32_t end, const progress_callback progress)
+  bool erase_sector(const uint32_t sector_address)
   {
-    // get sectors
-    const uint32_t start_sector = start / erase_sector_size; // inclusive
-    const uint32_t end_sector = end / erase_sector_size;     // inclusive
-
-    // calculate total sector count for progress calculation
-    const uint32_t total_sector_count = (end_sector - start_sector) + 1;
-
-    // erase sectors
-    for (uint32_t sector = start_sector; sector <= end_sector; sector++)
+    logging::debug(LOG_STR("erase sector "));
+    logging::debug(sector_address / erase_sector_size, 10);
+    logging::debug(LOG_STR(" @ 0x"));
+    logging::debug(sector_address, 16);
+    logging::debug(LOG_STR("\n"));
+
+    en_result_t rc = Ok;
+    if (!dry_run)
     {
-      // erase sector
-      const uint32_t sector_address = sector * erase_sector_size;
-      logging::debug("erase sector ");
-      logging::debug(sector, 10);
-      logging::debug(" @ 0x");
-      logging::debug(sector_address, 16);
-      logging::debug("\n");
-
-      en_result_t rc = Ok;
-      if (!dry_run)
-      {
-        rc = EFM_SectorErase(sector_address);
-      }
-
-      if (rc != Ok)
-      {
-        return false;
-      }
+      rc = EFM_SectorErase(sector_address);
+    }
 
-      // update progress
-      progress(update_stage::erase, sector - start_sector, total_sector_count);
+    if (rc != Ok)
+    {
+      trace::record(BOOT_TRACE_EVENT_ERASE_ERROR, rc, sector_address);
+      return false;
     }
 
+    profiler::add_bytes(profiler::stage::erase, erase_sector_size);
     return true;
   }
 
@@ -61,15 +67,16 @@ namespace flash
    * @param start_address the start address to write the data to
    * @param words_to_write the number of words to write
    * @return true if the write was successful
+   * @note the flash must be erased
    */
   bool write(const uint32_t start_address, const uint32_t *data, const uint32_t words_to_write)
   {
     // write the buffer to the flash
-    logging::debug("write ");
+    logging::debug(LOG_STR("write "));
     logging::debug(words_to_write, 10);
-    logging::debug(" words @ 0x");
+    logging::debug(LOG_STR(" words @ 0x"));
     logging::debug(start_address, 16);
-    logging::debug("\n");
+    logging::debug(LOG_STR("\n"));
 
     // start address must be on a 32-bit boundary
     if (start_address % 4 != 0)
@@ -80,6 +87,12 @@ namespace flash
 
     for(uint32_t i = 0, address = start_address; i < words_to_write; i++, address += 4)
     {
+      // the flash is erased, so words of all ones, e.g. in the gaps of sparse images, hold their value already
+      if (data[i] == 0xFFFFFFFF)
+      {
+        continue;
+      }
+
       en_result_t rc = Ok;
       if (!dry_run)
       {
@@ -88,6 +101,7 @@ namespace flash
 
       if (rc != Ok)
       {
+        trace::record(BOOT_TRACE_EVENT_FLASH_ERROR, rc, address, data[i]);
         logging::error("EFM_SingleProgramRB() err=");
         logging::error(rc, 10);
         logging::error("\n");
@@ -96,14 +110,14 @@ namespace flash
     }
 
     // verify write
-    // logging::debug("verify ");
+    // logging::debug(LOG_STR("verify "));
     // logging::debug(words_to_write, 10);
-    // logging::debug(" words @ 0x");
+    // logging::debug(LOG_STR(" words @ 0x"));
     // logging::debug(start_address, 16);
-    // logging::debug("\n");
-    if (!std::equal(data, data + words_to_write, reinterpret_cast<uint32_t *>(start_address)))
+    // logging::debug(LOG_STR("\n"));
+    if (!std::equal(data, data + words_to_write, at<uint32_t>(start_address)))
     {
-      logging::debug("verify failed\n");
+      logging::debug(LOG_STR("verify failed\n"));
       return false;
     }
 
@@ -111,146 +125,473 @@ namespace flash
   }
 
   /**
-   * @brief write the firmware update to the flash
-   * @param start the start address to write the update to
-   * @param end the end address to write the update to
-   * @param progress callback function to report the write progress
-   * @return true if the write was successful
-   * @note assumes the flash is unlocked
+   * @brief read the next block of the application from the update file
+   * @param block the buffer to read into, word-aligned and file_buffer_size bytes large
+   * @param bytes_read the number of bytes read, padded with 0xff to whole words. 0 at the end of the file
+   * @param did_pad set once the last block was padded
+   * @return true if the read was successful
    */
-  bool write_file(const uint32_t start, const uint32_t end, const progress_callback progress)
+  bool read_block(BYTE *block, UINT &bytes_read, bool &did_pad)
   {
-    const DWORD total_bytes = end - start;
-    bool did_pad = false;
-    for(DWORD total_bytes_written = 0;;)
+    bytes_read = 0;
+    if (!image::read(block, file_buffer_size, bytes_read))
+    {
+      return false;
+    }
+
+    // pad the buffer with 0xff if not aligned to 32-bit word
+    // only allowed at the end of the file
+    if((bytes_read % 4) != 0)
     {
-      // read the next block
-      UINT bytes_read = 0;
-      const FRESULT res = pf_read(buffer, file_buffer_size, &bytes_read);
-      if (res != FR_OK)
+      if (did_pad)
       {
-        logging::error("f_read() err=");
-        logging::error(res, 10);
-        logging::error("\n");
+        logging::error("attempted to pad data twice\n");
         return false;
       }
 
-      // check for end of file
-      if (bytes_read == 0)
+      while ((bytes_read % 4) != 0)
       {
-        break;
+        block[bytes_read++] = 0xff;
       }
 
-      // pad the buffer with 0xff if not aligned to 32-bit word
-      // only allowed at the end of the file
-      if((bytes_read % 4) != 0)
+      did_pad = true;
+    }
+
+    return true;
+  }
+
+  #if ENABLE_DELTA_IMAGES == 1
+    /**
+     * @brief buffer holding a patched flash sector until the sector is erased.
+     * delta images copy from the installed application, so a sector must be patched completely before it is erased
+     */
+    uint32_t sector_buffer[erase_sector_size / 4];
+  #endif
+
+  /**
+   * @brief reports the latest update progress through the progress callback, whenever the screen is ready for it.
+   * progress reported while the screen is busy is coalesced, so showing it never holds up the update
+   */
+  class progress_task : public scheduler::task
+  {
+  public:
+    progress_task(const progress_callback callback) : callback(callback) {}
+
+    /**
+     * @brief set the progress to show next
+     */
+    void report(const update_stage stage, const int done, const int total)
+    {
+      this->stage = stage;
+      this->done = done;
+      this->total = total;
+      pending = true;
+    }
+
+    /**
+     * @brief end the task once the last reported progress was shown
+     */
+    void finish()
+    {
+      finished = true;
+    }
+
+    scheduler::state step() override
+    {
+      // the update waits for the flash between its steps, so log output held back by the screen shows up meanwhile
+      screen.flush_deferred();
+
+      TASK_BEGIN();
+      while (true)
       {
-        if (did_pad)
+        TASK_WAIT_UNTIL(pending || finished);
+        if (!pending)
+        {
+          break;
+        }
+
+        TASK_WAIT_UNTIL(screen.is_ready());
+        pending = false;
+        callback(stage, done, total);
+      }
+      TASK_END();
+    }
+
+  private:
+    const progress_callback callback;
+    update_stage stage = update_stage::erase;
+    int done = 0;
+    int total = 0;
+    bool pending = false;
+    bool finished = false;
+  };
+
+  /**
+   * @brief erases the flash and writes the update file and metadata to it, one sector or block per step
+   * @note assumes the flash is unlocked
+   */
+  class update_task : public scheduler::task
+  {
+  public:
+    update_task(const uint32_t app_base_address, update_metadata &metadata, progress_task &progress) :
+      app_base_address(app_base_address),
+      program_end_address(app_base_address + metadata.app_size),
+      metadata(metadata),
+      progress(progress) {}
+
+    scheduler::state step() override
+    {
+      TASK_BEGIN();
+
+      #if HAS_KEPT_SECTORS
+        // find the sectors already holding their part of the application, while the stored metadata is still there
+        for (sector = 0; !image::is_delta() && sector * erase_sector_size < metadata.app_size; sector++)
+        {
+          #if STORE_UPDATE_METADATA == 1
+            // the sector holding the metadata is erased in any case, so the application in it is always written
+            if ((app_base_address / erase_sector_size) + sector >= get_metadata_start_address() / erase_sector_size)
+            {
+              break;
+            }
+          #endif
+
+          if (image::is_sector_unchanged(app_base_address, sector * erase_sector_size))
+          {
+            unchanged_sectors |= 1ull << sector;
+          }
+
+          TASK_YIELD();
+        }
+      #endif
+
+      begin_stage(profiler::stage::erase);
+      #if STORE_UPDATE_METADATA == 1
+        // erase the flash required for the metadata first, so an interrupted update leaves no metadata behind
+        // metadata is stored at the end of the flash
+        for (sector = get_metadata_start_address() / erase_sector_size; sector <= get_flash_end_address() / erase_sector_size; sector++)
         {
-          logging::error("attempted to pad data twice\n");
-          return false;
+          if (!erase_sector(sector * erase_sector_size))
+          {
+            return fail("metadata erase failed\n");
+          }
+
+          progress.report(update_stage::erase, sector - (get_metadata_start_address() / erase_sector_size), (get_flash_end_address() / erase_sector_size) - (get_metadata_start_address() / erase_sector_size) + 1);
+          TASK_YIELD();
         }
 
-        while ((bytes_read % 4) != 0)
+        // mark the update as in progress before the application is touched, so an interrupted update isn't booted
+        if (!write(get_update_marker_address(), &update_marker, 1))
         {
-          buffer[bytes_read++] = 0xff;
+          return fail("mark update failed\n");
         }
+      #endif
 
-        did_pad = true;
+      // erase the flash required for the application
+      // delta images copy from the installed application, so they erase each sector right before writing it instead
+      for (sector = app_base_address / erase_sector_size; !image::is_delta() && sector <= program_end_address / erase_sector_size; sector++)
+      {
+        #if STORE_UPDATE_METADATA == 1
+          // the sector holding the metadata is erased already, and keeps the update marker
+          if (sector >= get_metadata_start_address() / erase_sector_size)
+          {
+            break;
+          }
+        #endif
+
+        #if HAS_KEPT_SECTORS
+          // sectors already holding their part of the application are kept
+          if ((unchanged_sectors & (1ull << (sector - (app_base_address / erase_sector_size)))) != 0)
+          {
+            continue;
+          }
+        #endif
+
+        if (!erase_sector(sector * erase_sector_size))
+        {
+          return fail("app erase failed\n");
+        }
+
+        progress.report(update_stage::erase, sector - (app_base_address / erase_sector_size), (program_end_address / erase_sector_size) - (app_base_address / erase_sector_size) + 1);
+        TASK_YIELD();
       }
-      
-      // prepare start address for this block
-      const uint32_t block_address = start + total_bytes_written;
+      end_stage();
+
+      // write the firmware update to the flash
+      begin_stage(profiler::stage::write);
+      #if ENABLE_DELTA_IMAGES == 1
+        while (image::is_delta() && bytes_written < metadata.app_size)
+        {
+          // patch the next sector into RAM while the installed application is still in it
+          // the application starts on a sector boundary, so every sector is patched from its start
+          for (sector_bytes = 0; sector_bytes < erase_sector_size; sector_bytes += bytes_read)
+          {
+            if (!read_block(reinterpret_cast<BYTE *>(sector_buffer) + sector_bytes, bytes_read, did_pad))
+            {
+              return fail("write app failed\n");
+            }
+
+            if (bytes_read == 0)
+            {
+              break;
+            }
+
+            TASK_YIELD();
+          }
+
+          if (sector_bytes == 0)
+          {
+            break;
+          }
+
+          // then replace the sector.
+          // the erase time counts towards the write stage, so the stages are recorded in the boot trace once per update
+          sector = (app_base_address + bytes_written) / erase_sector_size;
+          if (sector < get_metadata_start_address() / erase_sector_size && !erase_sector(sector * erase_sector_size))
+          {
+            return fail("app erase failed\n");
+          }
+
+          if (!write(app_base_address + bytes_written, sector_buffer, sector_bytes / 4))
+          {
+            return fail("write app failed\n");
+          }
+
+          bytes_written += sector_bytes;
+          profiler::add_bytes(profiler::stage::write, sector_bytes);
+
+          progress.report(update_stage::write, bytes_written, program_end_address - app_base_address);
+          TASK_YIELD();
+        }
+      #endif
 
-      // write the block to the flash
-      if (!write(block_address, reinterpret_cast<uint32_t *>(buffer), bytes_read / 4))
+      // a delta image is complete at this point, so it reads nothing more
+      for (;;)
       {
-        return false;
+        #if HAS_KEPT_SECTORS
+          // skip the sectors that are kept
+          if ((bytes_written % erase_sector_size) == 0 && (unchanged_sectors & (1ull << (bytes_written / erase_sector_size))) != 0)
+          {
+            bytes_read = minimum(erase_sector_size, metadata.app_size - bytes_written);
+            if (!image::skip(bytes_read))
+            {
+              return fail("write app failed\n");
+            }
+
+            bytes_written += bytes_read;
+            progress.report(update_stage::write, bytes_written, program_end_address - app_base_address);
+            continue;
+          }
+        #endif
+
+        // read the next block
+        if (!read_block(buffer, bytes_read, did_pad))
+        {
+          return fail("write app failed\n");
+        }
+
+        // check for end of file
+        if (bytes_read == 0)
+        {
+          break;
+        }
+
+        // write the block to the flash
+        if (!write(app_base_address + bytes_written, reinterpret_cast<uint32_t *>(buffer), bytes_read / 4))
+        {
+          return fail("write app failed\n");
+        }
+
+        bytes_written += bytes_read;
+        profiler::add_bytes(profiler::stage::write, bytes_read);
+
+        progress.report(update_stage::write, bytes_written, program_end_address - app_base_address);
+        TASK_YIELD();
       }
+      end_stage();
+
+      #if METADATA_SECTOR_CRCS == 1
+        // read back the CRC32 of each sector as written, kept or patched
+        for (sector = 0; sector < IMAGE_MAX_SECTORS; sector++)
+        {
+          if (sector * erase_sector_size >= metadata.app_size)
+          {
+            metadata.sector_crcs[sector] = 0xFFFFFFFF;
+            continue;
+          }
+
+          // the sector as programmed, padded to whole words
+          bytes_read = minimum(erase_sector_size, metadata.app_size - (sector * erase_sector_size));
+          metadata.sector_crcs[sector] = crc::calculate(at<uint32_t>(app_base_address + (sector * erase_sector_size)), (bytes_read + 3) / 4);
+          TASK_YIELD();
+        }
+      #endif
+
+      #if STORE_UPDATE_METADATA == 1 && METADATA_HASH != HASH_NONE
+        // the metadata hash was taken from the image, and not all of the application may have been written.
+        // the hash of signed images is always checked, so the file can't change after it was hashed.
+        // delta images were patched from the flash a second time, so the result is checked before it is booted
+        if ((image::has_app_hash() || image::is_delta() || ENABLE_SIGNED_IMAGES == 1) && !integrity::matches(app_base_address, metadata))
+        {
+          return fail("app verify failed\n");
+        }
+      #endif
+
+      #if STORE_UPDATE_METADATA == 1
+        // write the metadata
+        if (!write(get_metadata_start_address(), metadata.get_data(), metadata.get_word_count()))
+        {
+          return fail("write metadata failed\n");
+        }
 
-      // increment total bytes written
-      total_bytes_written += bytes_read;
+        // the update is complete now
+        if (!write(get_update_marker_address(), &update_marker_cleared, 1))
+        {
+          return fail("clear update marker failed\n");
+        }
+      #endif
 
-      // report progress
-      progress(update_stage::write, total_bytes_written, total_bytes);
+      progress.finish();
+      TASK_END();
     }
 
-    return true;
-  }
+  private:
+    const uint32_t app_base_address;
+    const uint32_t program_end_address;
+    update_metadata &metadata;
+    progress_task &progress;
+
+    /**
+     * @brief sector currently erased
+     */
+    uint32_t sector = 0;
+
+    /**
+     * @brief size of the block read last, in bytes
+     */
+    UINT bytes_read = 0;
+
+    /**
+     * @brief number of bytes written so far
+     */
+    uint32_t bytes_written = 0;
+
+    /**
+     * @brief was the last block padded?
+     */
+    bool did_pad = false;
 
-  bool apply_firmware_update(const uint32_t app_base_address, const update_metadata &metadata, const progress_callback progress)
-  {
-    // calculate end addresses
-    const uint32_t program_end_address = app_base_address + metadata.app_size;
-    const uint32_t flash_end_address = get_flash_size() - 1;
-    const uint32_t metadata_start_address = update_metadata::get_start_address(flash_end_address);
+    #if HAS_KEPT_SECTORS
+      /**
+       * @brief sectors kept since they already hold their part of the application, one bit per sector of the application
+       */
+      uint64_t unchanged_sectors = 0;
+    #endif
 
-    // ensure the update fits in the flash
-    #if STORE_UPDATE_METADATA == 1
-      if (program_end_address >= metadata_start_address) // can only occupy up to the metadata
-    #else
-      if (program_end_address > flash_end_address) // can occupy the entire flash
+    #if ENABLE_DELTA_IMAGES == 1
+      /**
+       * @brief number of bytes patched into the sector buffer so far
+       */
+      uint32_t sector_bytes = 0;
     #endif
+
+    /**
+     * @brief get the last address of the flash area of the application, where its metadata is stored
+     */
+    uint32_t get_flash_end_address() const
     {
-      logging::error("update too large\n");
-      return false;
+      return get_app_area_end(app_base_address) - 1;
     }
 
-    // unlock and enable flash
-    EFM_Unlock();
-    EFM_FlashCmd(Enable);
-    while (EFM_GetFlagStatus(EFM_FLAG_RDY) != Set) { /* nada */ }
+    #if STORE_UPDATE_METADATA == 1
+      uint32_t get_metadata_start_address() const
+      {
+        return update_metadata::get_start_address(get_flash_end_address());
+      }
 
-    // disable interrupts while programming flash
-    // noInterrupts();
+      uint32_t get_update_marker_address() const
+      {
+        return update_metadata::get_update_marker_address(get_flash_end_address());
+      }
+    #endif
 
-    bool success = true;
+    /**
+     * @brief the profiler stage being timed, profiler::stage::count if none
+     */
+    profiler::stage active_stage = profiler::stage::count;
 
-    // erase the flash required for the application
-    if (!erase(app_base_address, program_end_address, progress))
+    void begin_stage(const profiler::stage stage)
     {
-      logging::error("app erase failed\n");
-      success = false;
-      goto cleanup; // cannot return directly because of cleanup
+      active_stage = stage;
+      profiler::begin(stage);
     }
 
-    #if STORE_UPDATE_METADATA == 1
-      // erase the flash required for the metadata
-      // metadata is stored at the end of the flash
-      if (!erase(metadata_start_address, flash_end_address, progress))
+    void end_stage()
+    {
+      if (active_stage != profiler::stage::count)
       {
-        logging::error("metadata erase failed\n");
-        success = false;
-        goto cleanup; // cannot return directly because of cleanup
+        profiler::end(active_stage);
+        active_stage = profiler::stage::count;
       }
-    #endif
+    }
 
-    // write the firmware update to the flash
-    if (!write_file(app_base_address, program_end_address, progress))
+    /**
+     * @brief end the update with an error, ending the stage being timed
+     */
+    scheduler::state fail(const char *message)
     {
-      logging::error("write app failed\n");
-      success = false;
-      goto cleanup; // cannot return directly because of cleanup
+      end_stage();
+      logging::error(message);
+      return scheduler::state::failed;
     }
+  };
+
+  bool apply_firmware_update(const uint32_t app_base_address, update_metadata &metadata, const progress_callback progress)
+  {
+    // calculate end addresses
+    const uint32_t program_end_address = app_base_address + metadata.app_size;
+    const uint32_t flash_end_address = get_app_area_end(app_base_address) - 1;
 
+    // ensure the update fits in the flash
     #if STORE_UPDATE_METADATA == 1
-      // write the metadata
-      if (!write(metadata_start_address, metadata.get_data(), metadata.get_word_count()))
+      if (program_end_address >= update_metadata::get_update_marker_address(flash_end_address)) // can only occupy up to the update marker
+    #else
+      if (program_end_address > flash_end_address) // can occupy the entire flash
+    #endif
+    {
+      logging::error("update too large\n");
+      return false;
+    }
+
+    #if ENABLE_STAGED_UPDATES == 1
+      // the upper half of the flash is kept for the staging slot
+      if (program_end_address > STAGING_SLOT_ADDRESS)
       {
-        logging::error("write metadata failed\n");
-        success = false;
-        goto cleanup; // cannot return directly because of cleanup
+        logging::error("update too large\n");
+        return false;
       }
     #endif
 
-    cleanup:
+    // unlock and enable flash
+    EFM_Unlock();
+    EFM_FlashCmd(Enable);
+    while (EFM_GetFlagStatus(EFM_FLAG_RDY) != Set) { /* nada */ }
 
-    // re-enable interrupts
-    // interrupts();
+    // the screen shows the progress while the update goes on, instead of holding it up
+    progress_task progress_task(progress);
+    update_task update_task(app_base_address, metadata, progress_task);
+    scheduler::task *const tasks[] = { &update_task, &progress_task };
+    const bool success = scheduler::run(tasks, countof(tasks));
 
     // re-lock flash
     EFM_Lock();
 
     return success;
   }
+
+  #if STORE_UPDATE_METADATA == 1
+    bool is_update_in_progress(const uint32_t app_base_address)
+    {
+      return *at<uint32_t>(update_metadata::get_update_marker_address(get_app_area_end(app_base_address) - 1)) == update_marker;
+    }
+  #endif
 } // namespace flash
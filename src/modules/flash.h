@@ -14,6 +14,7 @@ namespace flash
   constexpr uint32_t file_buffer_size = 512;   // 512 bytes
 
   static_assert(file_buffer_size % 4 == 0, "file buffer size must be aligned to 32-bit words");
+  static_assert(erase_sector_size % file_buffer_size == 0, "erase sector size must be a multiple of the file buffer size");
 
   enum class update_stage
   {
@@ -32,9 +33,18 @@ namespace flash
   /**
    * @brief apply a firmware update from the given file
    * @param app_base_address base address to write the firmware binary file to
-   * @param metadata the update metadata
+   * @param metadata the update metadata. with METADATA_SECTOR_CRCS, the sector CRC32s are filled in
    * @param progress callback function to report the update progress
    * @return true if the firmware update was successful
    */
-  bool apply_firmware_update(const uint32_t app_base_address, const update_metadata &metadata, const progress_callback progress);
+  bool apply_firmware_update(const uint32_t app_base_address, update_metadata &metadata, const progress_callback progress);
+
+  #if STORE_UPDATE_METADATA == 1
+    /**
+     * @brief was an update of the application started, but not completed?
+     * @param app_base_address the base address of the application
+     * @return true if the application may be partly erased or written
+     */
+    bool is_update_in_progress(const uint32_t app_base_address);
+  #endif
 } // namespace flash
@@ -1,5 +1,8 @@
 #pragma once
+#include <stddef.h>
 #include "hash.h"
+#include "image_format.h"
+#include "slots_format.h"
 #include "chipid.h"
 #include "log.h"
 #include "../config.h"
@@ -7,6 +10,22 @@
 
 namespace flash
 {
+  /**
+   * @brief get a pointer to data in flash
+   * @param address the flash address of the data
+   * @return pointer to the data
+   * @note all direct reads of flash contents must go through this, so the native build can redirect them
+   */
+  template <typename T>
+  inline const T *at(const uint32_t address)
+  {
+    #ifdef NATIVE_BUILD
+      return reinterpret_cast<const T *>(native_flash_base() + address);
+    #else
+      return reinterpret_cast<const T *>(address);
+    #endif
+  }
+
   /**
    * @brief get the total flash size of the MCU (including bootloader)
    * @note equal to the largest flash address + 1 
@@ -27,6 +46,22 @@ namespace flash
     }
   }
 
+  /**
+   * @brief get the end address of the flash area of an application, holding its update metadata at the end
+   * @param app_base_address the base address of the application
+   * @return the end address of the area, exclusive
+   * @note with ENABLE_AB_SLOTS, each slot is an area of its own
+   */
+  inline const uint32_t get_app_area_end(const uint32_t app_base_address)
+  {
+    #if ENABLE_AB_SLOTS == 1
+      const uint32_t slot_end = app_base_address < SLOT_B_ADDRESS ? SLOT_B_ADDRESS : SLOT_B_ADDRESS + (SLOT_B_ADDRESS - APP_BASE_ADDRESS);
+      return std::min(slot_end, get_flash_size());
+    #else
+      return get_flash_size();
+    #endif
+  }
+
   struct update_metadata
   {
     /**
@@ -41,6 +76,14 @@ namespace flash
       hash::hash_t hash;
     #endif
 
+    #if METADATA_SECTOR_CRCS == 1
+      /**
+       * @brief CRC32 of each flash sector of the application as written, 0xFFFFFFFF past the end of the application.
+       * filled in once the application is written, so not compared by equals()
+       */
+      uint32_t sector_crcs[IMAGE_MAX_SECTORS];
+    #endif
+
     #if STORE_UPDATE_METADATA == 1
 
       /**
@@ -78,6 +121,28 @@ namespace flash
         return address;
       }
 
+      /**
+       * @brief get the address of the word marking the application as verified, right before the update metadata
+       * @param flash_end_address the end address of the flash
+       * @return the address of the verified marker in flash
+       * @note the marker is erased together with the metadata
+       */
+      static constexpr uint32_t get_marker_address(const uint32_t flash_end_address)
+      {
+        return get_start_address(flash_end_address) - 4;
+      }
+
+      /**
+       * @brief get the address of the word marking an update as in progress, right before the verified marker
+       * @param flash_end_address the end address of the flash
+       * @return the address of the update marker in flash
+       * @note the marker is programmed before the application is erased, and cleared once the metadata is written
+       */
+      static constexpr uint32_t get_update_marker_address(const uint32_t flash_end_address)
+      {
+        return get_marker_address(flash_end_address) - 4;
+      }
+
       /**
        * @brief get the update metadata as an array of words of length get_word_count()
        * @return the update metadata as an array of words
@@ -97,11 +162,12 @@ namespace flash
 
       /**
        * @brief get the update metadata stored in flash
+       * @param app_base_address the base address of the application the metadata belongs to
        * @return the update metadata stored in flash or nullptr if the metadata is invalid 
        */
-      static const update_metadata *get_stored()
+      static const update_metadata *get_stored(const uint32_t app_base_address)
       {
-        return reinterpret_cast<const update_metadata *>(get_start_address(get_flash_size() - 1));
+        return at<update_metadata>(get_start_address(get_app_area_end(app_base_address) - 1));
       }
   
     #endif // STORE_UPDATE_METADATA == 1
@@ -113,9 +179,15 @@ namespace flash
      */
     const bool equals(const update_metadata *other) const
     {
+      #if METADATA_SECTOR_CRCS == 1
+        constexpr uint32_t compared_words = offsetof(update_metadata, sector_crcs) / 4;
+      #else
+        constexpr uint32_t compared_words = get_word_count();
+      #endif
+
       const uint32_t *this_data = this->get_data();
       const uint32_t *other_data = other->get_data();
-      return other_data != nullptr && std::equal(this_data, this_data + get_word_count(), other_data);
+      return other_data != nullptr && std::equal(this_data, this_data + compared_words, other_data);
     }
 
     /**
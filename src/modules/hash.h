@@ -15,6 +15,11 @@ namespace hash
     #error "Invalid METADATA_HASH"
   #endif
 
+  /**
+   * @brief size of the chunks the update file is hashed in
+   */
+  constexpr uint32_t chunk_size = 512;
+
   /**
    * @brief start a new hashing session
    * @return true if the session was successfully started
@@ -27,7 +32,8 @@ namespace hash
    * @param len the length of the data
    * @return true if the data was successfully pushed
    * 
-   * @note on SHA256, data length must be a multiple of 64 bytes, except for the last push
+   * @note on SHA256, data length must be a multiple of 64 bytes, except for the last push.
+   *       the result is the standard SHA-256 of all pushed data
    */
   bool push_data(const uint8_t *data, const uint32_t len);
 
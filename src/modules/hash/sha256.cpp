@@ -19,9 +19,16 @@
     static uint32_t total_length = 0;
 
     /**
-     * @brief is this the first push in the current session? 
+     * @brief is the next block the first one of the current session?
+     * only that block starts from the initial hash value
      */
-    #define is_first_push (total_length == 0)
+    static bool is_first_block = true;
+
+    /**
+     * @brief the data of the last push that did not fill a whole block, padded on get_hash()
+     */
+    static uint8_t tail[HASH_GROUP_LEN];
+    static uint32_t tail_length = 0;
 
     /**
      * @brief wait until the hash peripheral is ready again
@@ -32,27 +39,13 @@
     }
 
     /**
-     * @brief push a 512-bit block to the hash peripheral, adding padding as needed
-     * @param block the block to push.
-     * @param len the length of the block
+     * @brief push a 512-bit block to the hash peripheral
+     * @param block the block to push, 64 bytes
      * 
-     * @note expects len to be 64 bytes except for the last block
      * @note automatically starts the hash calculation
      */
-    void push_block(const uint8_t *block, const uint32_t len)
+    void push_block(const uint8_t *block)
     {
-      uint8_t scratch[HASH_GROUP_LEN];
-      std::fill(scratch, scratch + HASH_GROUP_LEN, 0);
-
-      // copy data to buffer
-      std::copy(block, block + len, scratch);
-
-      // add padding if needed
-      if (len < HASH_GROUP_LEN)
-      {
-        scratch[len] = 0x80;
-      }
-
       // wait for hash calculation to finish
       wait_for_ready();
 
@@ -62,43 +55,53 @@
       {
         const uint32_t j = (i * 4) + 3;
 
-        uint32_t dr = static_cast<uint32_t>(scratch[j]);
-        dr |= static_cast<uint32_t>(scratch[j - 1]) << 8;
-        dr |= static_cast<uint32_t>(scratch[j - 2]) << 16;
-        dr |= static_cast<uint32_t>(scratch[j - 3]) << 24;
+        uint32_t dr = static_cast<uint32_t>(block[j]);
+        dr |= static_cast<uint32_t>(block[j - 1]) << 8;
+        dr |= static_cast<uint32_t>(block[j - 2]) << 16;
+        dr |= static_cast<uint32_t>(block[j - 3]) << 24;
 
         *(hash_dr++) = dr;
       }
-      
 
       // start hash calculation
-      bM4_HASH_CR_FST_GRP = is_first_push ? 1ul : 0ul; // first group?
+      bM4_HASH_CR_FST_GRP = is_first_block ? 1ul : 0ul; // first group?
       bM4_HASH_CR_START = 1;
+      is_first_block = false;
     }
 
     /**
-     * @brief write the length of the data to the hash peripheral
-     * @param len the length to write
+     * @brief push the padding and the length of the data, as the end of the message
      */
-    void write_len(const uint32_t len)
+    void push_padding()
     {
       uint8_t scratch[HASH_GROUP_LEN];
       std::fill(scratch, scratch + HASH_GROUP_LEN, 0);
 
-      // write length to hash peripheral
-      uint32_t len_lo = (len >> 29u) & 0x7u;
-      uint32_t len_hi = (len << 3u);
+      // the remaining data, followed by a single 1 bit
+      std::copy(tail, tail + tail_length, scratch);
+      scratch[tail_length] = 0x80;
+
+      // the length needs the last 8 bytes of a block
+      if (tail_length >= LAST_GROUP_MAX_LEN)
+      {
+        push_block(scratch);
+        std::fill(scratch, scratch + HASH_GROUP_LEN, 0);
+      }
+
+      // length in bits, big endian
+      const uint32_t len_hi = (total_length >> 29u) & 0x7u;
+      const uint32_t len_lo = (total_length << 3u);
 
-      scratch[63] = static_cast<uint8_t>(len_lo);
-      scratch[62] = static_cast<uint8_t>(len_lo >> 8);
-      scratch[61] = static_cast<uint8_t>(len_lo >> 16);
-      scratch[60] = static_cast<uint8_t>(len_lo >> 24);
-      scratch[59] = static_cast<uint8_t>(len_hi);
-      scratch[58] = static_cast<uint8_t>(len_hi >> 8);
-      scratch[57] = static_cast<uint8_t>(len_hi >> 16);
       scratch[56] = static_cast<uint8_t>(len_hi >> 24);
+      scratch[57] = static_cast<uint8_t>(len_hi >> 16);
+      scratch[58] = static_cast<uint8_t>(len_hi >> 8);
+      scratch[59] = static_cast<uint8_t>(len_hi);
+      scratch[60] = static_cast<uint8_t>(len_lo >> 24);
+      scratch[61] = static_cast<uint8_t>(len_lo >> 16);
+      scratch[62] = static_cast<uint8_t>(len_lo >> 8);
+      scratch[63] = static_cast<uint8_t>(len_lo);
 
-      push_block(scratch, HASH_GROUP_LEN);
+      push_block(scratch);
     }
 
     bool start()
@@ -109,40 +112,54 @@
       // stop any ongoing hash calculation
       bM4_HASH_CR_START = 0;
       total_length = 0;
+      tail_length = 0;
+      is_first_block = true;
       return true;
     }
 
     bool push_data(const uint8_t *data, const uint32_t len)
     {
-      // write data to hash peripheral
+      // only the last push may end in a partial block
+      if (tail_length != 0)
+      {
+        return false;
+      }
+
+      // write whole blocks to hash peripheral
       uint32_t remaining_bytes = len;
-      while(remaining_bytes > 0)
+      while(remaining_bytes >= HASH_GROUP_LEN)
       {
-        const uint32_t push_len = minimum(remaining_bytes, HASH_GROUP_LEN);
-        push_block(data, push_len);
+        push_block(data);
 
-        data += push_len;
-        remaining_bytes -= push_len;
+        data += HASH_GROUP_LEN;
+        remaining_bytes -= HASH_GROUP_LEN;
       }
 
+      // keep the rest until the padding is added
+      std::copy(data, data + remaining_bytes, tail);
+      tail_length = remaining_bytes;
+
       total_length += len;
       return true;
     }
 
     bool get_hash(hash_t &hash)
     {
-      // write total length to hash peripheral
-      write_len(total_length);
+      // end the message
+      push_padding();
 
       // wait for hash calculation to finish
       wait_for_ready();
 
-      // copy hash to output
+      // copy hash to output. HR7 holds the first word of the digest, which is big endian
       volatile uint32_t *hash_hr = &M4_HASH->HR7;
-      uint32_t *hash_out = reinterpret_cast<uint32_t *>(hash);
       for (int i = 0; i < 8; i++)
       {
-        hash_out[i] = *hash_hr++;
+        const uint32_t hr = *hash_hr++;
+        hash[(i * 4) + 0] = static_cast<uint8_t>(hr >> 24);
+        hash[(i * 4) + 1] = static_cast<uint8_t>(hr >> 16);
+        hash[(i * 4) + 2] = static_cast<uint8_t>(hr >> 8);
+        hash[(i * 4) + 3] = static_cast<uint8_t>(hr);
       }
 
       // de-init
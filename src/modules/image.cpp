@@ -0,0 +1,1532 @@
+#include "image.h"
+#include <hc32_ddl.h>
+#include <string.h>
+#include "aes.h"
+#include "crc.h"
+#include "ecdsa.h"
+#include "flash.h"
+#include "integrity.h"
+#include "log.h"
+#include "profiler.h"
+#include "timebase.h"
+#include "../util.h"
+
+namespace image
+{
+  #if ENABLE_COMPRESSED_IMAGES == 1 || ENABLE_DELTA_IMAGES == 1
+    void reader::start(const source_function source, const uint32_t source_offset)
+    {
+      this->source = source;
+      this->source_offset = source_offset;
+      input_position = 0;
+      input_length = 0;
+    }
+
+    bool reader::fill()
+    {
+      // keep reads aligned to the input buffer, so full sectors are read into it directly
+      const UINT size = input_size - (source_offset % input_size);
+      UINT bytes_read = 0;
+      if (source(input, size, &bytes_read) != FR_OK || bytes_read == 0)
+      {
+        return false;
+      }
+
+      source_offset += bytes_read;
+      input_position = 0;
+      input_length = bytes_read;
+      return true;
+    }
+
+    bool reader::next_byte(uint8_t &byte)
+    {
+      if (input_position >= input_length && !fill())
+      {
+        return false;
+      }
+
+      byte = input[input_position++];
+      return true;
+    }
+
+    bool reader::next_bytes(uint8_t *buffer, const uint32_t size, uint32_t &copied)
+    {
+      if (input_position >= input_length && !fill())
+      {
+        return false;
+      }
+
+      copied = minimum(size, input_length - input_position);
+      memcpy(buffer, input + input_position, copied);
+      input_position += copied;
+      return true;
+    }
+
+    bool reader::next_number(uint32_t &number)
+    {
+      number = 0;
+      for (uint32_t shift = 0; shift < 35; shift += 7)
+      {
+        uint8_t byte = 0;
+        if (!next_byte(byte))
+        {
+          return false;
+        }
+
+        number |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    bool reader::next_length(uint32_t &length)
+    {
+      uint8_t byte = 0;
+      do
+      {
+        if (!next_byte(byte))
+        {
+          return false;
+        }
+
+        length += byte;
+      } while (byte == 255);
+
+      return true;
+    }
+  #endif
+
+  #if ENABLE_COMPRESSED_IMAGES == 1
+    bool decoder::start(const source_function source, const uint32_t source_offset, const uint32_t app_size, const uint8_t window_bits)
+    {
+      if (window_bits < IMAGE_MIN_WINDOW_BITS || window_bits > COMPRESSED_IMAGE_WINDOW_BITS)
+      {
+        return false;
+      }
+
+      input.start(source, source_offset);
+      this->app_size = app_size;
+      window_mask = (1ul << window_bits) - 1;
+
+      produced = 0;
+      literals = 0;
+      match = 0;
+      offset = 0;
+      match_pending = false;
+      return true;
+    }
+
+    bool decoder::read_token()
+    {
+      uint8_t token = 0;
+      if (!input.next_byte(token))
+      {
+        return false;
+      }
+
+      literals = token >> 4;
+      match_token = token & 0x0F;
+      match_pending = true;
+      return literals != 15 || input.next_length(literals);
+    }
+
+    bool decoder::read_match()
+    {
+      uint8_t low = 0, high = 0;
+      if (!input.next_byte(low) || !input.next_byte(high))
+      {
+        return false;
+      }
+
+      offset = static_cast<uint32_t>(low) | (static_cast<uint32_t>(high) << 8);
+      match = match_token + 4u;
+      match_pending = false;
+      if (match_token == 15 && !input.next_length(match))
+      {
+        return false;
+      }
+
+      // the match must be in the window and in the data decoded so far
+      return offset != 0 && offset <= (window_mask + 1) && offset <= produced;
+    }
+
+    bool decoder::read(uint8_t *buffer, const UINT size, UINT &bytes_read)
+    {
+      bytes_read = 0;
+      while (bytes_read < size && produced < app_size)
+      {
+        if (literals > 0)
+        {
+          // copy as many literals as the input buffer holds
+          uint32_t count = 0;
+          if (!input.next_bytes(buffer + bytes_read, minimum(minimum(literals, size - bytes_read), app_size - produced), count))
+          {
+            return false;
+          }
+
+          for (uint32_t i = 0; i < count; i++)
+          {
+            window[produced++ & window_mask] = buffer[bytes_read++];
+          }
+          literals -= count;
+        }
+        else if (match > 0)
+        {
+          // byte by byte, since the match may overlap the bytes it produces
+          const uint32_t count = minimum(minimum(match, size - bytes_read), app_size - produced);
+          for (uint32_t i = 0; i < count; i++)
+          {
+            const uint8_t byte = window[(produced - offset) & window_mask];
+            window[produced++ & window_mask] = byte;
+            buffer[bytes_read++] = byte;
+          }
+          match -= count;
+        }
+        else if (match_pending)
+        {
+          if (!read_match())
+          {
+            return false;
+          }
+        }
+        else if (!read_token())
+        {
+          return false;
+        }
+      }
+
+      // a sequence must not go past the end of the application
+      return produced < app_size || (literals == 0 && match == 0);
+    }
+  #endif
+
+  #if ENABLE_DELTA_IMAGES == 1
+    void patcher::start(const source_function source, const uint32_t source_offset, const uint32_t app_base_address, const uint32_t installed_size, const uint32_t app_size)
+    {
+      input.start(source, source_offset);
+      this->app_base_address = app_base_address;
+      this->installed_size = installed_size;
+      this->app_size = app_size;
+
+      produced = 0;
+      literals = 0;
+      copy = 0;
+      offset = 0;
+      copy_pending = false;
+    }
+
+    bool patcher::read_copy()
+    {
+      copy_pending = false;
+      if (!input.next_number(copy) || !input.next_number(offset))
+      {
+        return false;
+      }
+
+      // the copy must be in the installed application
+      uint32_t source_size = installed_size;
+      #if STORE_UPDATE_METADATA == 1
+        // and below the sector holding the update metadata, which is erased before the application is patched
+        const uint32_t metadata_sector = flash::update_metadata::get_update_marker_address(flash::get_app_area_end(app_base_address) - 1) & ~(flash::erase_sector_size - 1);
+        source_size = minimum(source_size, metadata_sector - app_base_address);
+      #endif
+      if (offset > source_size || copy > (source_size - offset))
+      {
+        return false;
+      }
+
+      // sectors before the one being patched are rewritten already, and the sector being patched is erased
+      // once it is complete. a copy crossing into the next sector must stay ahead of the bytes it produces
+      const uint32_t sector_start = produced - ((app_base_address + produced) % flash::erase_sector_size);
+      const bool crosses_sector = copy > (sector_start + flash::erase_sector_size - produced);
+      return offset >= (crosses_sector ? produced : sector_start);
+    }
+
+    bool patcher::read(uint8_t *buffer, const UINT size, UINT &bytes_read)
+    {
+      bytes_read = 0;
+      while (bytes_read < size && produced < app_size)
+      {
+        if (literals > 0)
+        {
+          uint32_t count = 0;
+          if (!input.next_bytes(buffer + bytes_read, minimum(minimum(literals, size - bytes_read), app_size - produced), count))
+          {
+            return false;
+          }
+
+          bytes_read += count;
+          produced += count;
+          literals -= count;
+        }
+        else if (copy > 0)
+        {
+          // straight from the installed application
+          const uint32_t count = minimum(minimum(copy, size - bytes_read), app_size - produced);
+          memcpy(buffer + bytes_read, flash::at<uint8_t>(app_base_address + offset), count);
+
+          bytes_read += count;
+          produced += count;
+          offset += count;
+          copy -= count;
+        }
+        else if (copy_pending)
+        {
+          if (!read_copy())
+          {
+            return false;
+          }
+        }
+        else
+        {
+          if (!input.next_number(literals))
+          {
+            return false;
+          }
+
+          copy_pending = true;
+        }
+      }
+
+      // a record must not go past the end of the application
+      return produced < app_size || (literals == 0 && copy == 0);
+    }
+  #endif
+
+  enum class format
+  {
+    /**
+     * @brief no image opened
+     */
+    none,
+
+    /**
+     * @brief application binary without an image header
+     */
+    raw,
+
+    /**
+     * @brief image with uncompressed application data
+     */
+    uncompressed,
+
+    /**
+     * @brief image with compressed application data
+     */
+    compressed,
+
+    /**
+     * @brief image with a delta against the installed application
+     */
+    delta,
+
+    /**
+     * @brief image with a compressed delta against the installed application
+     */
+    compressed_delta,
+
+    /**
+     * @brief application staged in flash, see staging_format.h
+     */
+    staged,
+
+    /**
+     * @brief image with the uncompressed segments of the application
+     */
+    sparse,
+
+    /**
+     * @brief image with the compressed segments of the application
+     */
+    compressed_sparse,
+  };
+
+  namespace state
+  {
+    format image_format = format::none;
+
+    /**
+     * @brief functions reading the update file and moving the read position in it
+     */
+    source_function file_read = &pf_read;
+    seek_function file_seek = &pf_lseek;
+
+    /**
+     * @brief the image header. holds the first bytes of raw binaries instead
+     */
+    image_header_t header;
+
+    /**
+     * @brief number of bytes at the start of a raw binary read into the header, and how many of them were returned by read()
+     */
+    UINT raw_bytes = 0;
+    UINT raw_bytes_returned = 0;
+
+    /**
+     * @brief size of the application, in bytes
+     */
+    uint32_t app_size = 0;
+
+    #if ENABLE_DELTA_IMAGES == 1
+      /**
+       * @brief the delta header of delta images
+       */
+      image_delta_header_t delta;
+
+      /**
+       * @brief was the installed application checked against its metadata?
+       * the image is opened twice, but the installed application only changes after that
+       */
+      bool installed_verified = false;
+    #endif
+
+    #if ENABLE_IMAGE_MANIFEST == 1
+      /**
+       * @brief does the image have a manifest?
+       */
+      bool has_manifest = false;
+
+      /**
+       * @brief the manifest, and the CRC32s of the application sectors following it
+       */
+      image_manifest_t manifest;
+      uint32_t sector_crcs[IMAGE_MAX_SECTORS];
+
+      /**
+       * @brief CRC32 of the header bytes read so far
+       */
+      uint32_t header_crc = 0;
+    #endif
+
+    #if ENABLE_STAGED_UPDATES == 1
+      /**
+       * @brief start address of the staged application
+       */
+      uint32_t staged_address = 0;
+    #endif
+
+    #if ENABLE_SPARSE_IMAGES == 1
+      /**
+       * @brief the segments of sparse images
+       */
+      image_segment_t segments[IMAGE_MAX_SEGMENTS];
+      uint32_t segment_count = 0;
+
+      /**
+       * @brief the segment at or after the position, and the offset of its data in the application data
+       */
+      uint32_t segment = 0;
+      uint32_t segment_data_offset = 0;
+    #endif
+
+    #if ENABLE_ENCRYPTED_IMAGES == 1
+      /**
+       * @brief is the application data encrypted? if so, file_read and file_seek decrypt it,
+       * using the functions reading and seeking the encrypted file
+       */
+      bool encrypted = false;
+      source_function encrypted_read = &pf_read;
+      seek_function encrypted_seek = &pf_lseek;
+
+      /**
+       * @brief the encryption header of encrypted images
+       */
+      image_encryption_header_t encryption;
+
+      /**
+       * @brief number of bytes decrypted, and time spent decrypting them, in microseconds
+       */
+      uint32_t decrypted_bytes = 0;
+      uint32_t decrypt_us = 0;
+    #endif
+
+    #if ENABLE_SIGNED_IMAGES == 1
+      /**
+       * @brief does the image carry a signature?
+       */
+      bool is_signed = false;
+
+      /**
+       * @brief the signature of signed images
+       */
+      image_signature_t signature;
+
+      /**
+       * @brief was the signature checked, and the time it took, in microseconds
+       */
+      bool signature_checked = false;
+      uint32_t verify_us = 0;
+    #endif
+
+    /**
+     * @brief number of application bytes read or skipped so far
+     */
+    uint32_t position = 0;
+  } // namespace state
+
+  #if ENABLE_COMPRESSED_IMAGES == 1 || ENABLE_DELTA_IMAGES == 1
+    namespace stats
+    {
+      /**
+       * @brief number of encoded bytes read, and number of bytes decoded
+       */
+      uint32_t bytes_in = 0;
+      uint32_t bytes_out = 0;
+
+      /**
+       * @brief time spent decoding, and time spent reading the encoded data from the file, in microseconds
+       */
+      uint32_t decode_us = 0;
+      uint32_t source_us = 0;
+    } // namespace stats
+
+    /**
+     * @brief read encoded data from the file, timing the reads apart from the decoding
+     */
+    FRESULT read_file(void *buffer, UINT size, UINT *bytes_read)
+    {
+      const uint32_t start = timebase::now();
+      const FRESULT res = state::file_read(buffer, size, bytes_read);
+      stats::source_us += timebase::now() - start;
+      stats::bytes_in += *bytes_read;
+      return res;
+    }
+  #endif
+
+  #if ENABLE_COMPRESSED_IMAGES == 1
+    decoder compressed_decoder;
+  #endif
+
+  #if ENABLE_DELTA_IMAGES == 1
+    patcher delta_patcher;
+
+    #if ENABLE_COMPRESSED_IMAGES == 1
+      /**
+       * @brief read decompressed delta data
+       */
+      FRESULT read_decompressed(void *buffer, UINT size, UINT *bytes_read)
+      {
+        return compressed_decoder.read(static_cast<uint8_t *>(buffer), size, *bytes_read) ? FR_OK : FR_DISK_ERR;
+      }
+    #endif
+  #endif
+
+  #if ENABLE_ENCRYPTED_IMAGES == 1
+    /**
+     * @brief read application data from the file, decrypting it
+     */
+    FRESULT read_encrypted(void *buffer, UINT size, UINT *bytes_read)
+    {
+      const FRESULT res = state::encrypted_read(buffer, size, bytes_read);
+      if (res == FR_OK)
+      {
+        const uint32_t start = timebase::now();
+        aes::apply_ctr(static_cast<uint8_t *>(buffer), *bytes_read);
+        state::decrypt_us += timebase::now() - start;
+        state::decrypted_bytes += *bytes_read;
+      }
+      return res;
+    }
+
+    /**
+     * @brief move the read position in the file, continuing the key stream at the new position
+     * @note the position must be in the application data
+     */
+    FRESULT seek_encrypted(DWORD offset)
+    {
+      const FRESULT res = state::encrypted_seek(offset);
+      if (res == FR_OK)
+      {
+        aes::seek_ctr(offset - state::header.header_size);
+      }
+      return res;
+    }
+  #endif
+
+  /**
+   * @brief log a failed pf_read()
+   */
+  void log_read_error(const FRESULT res)
+  {
+    logging::error("f_read() err=");
+    logging::error(res, 10);
+    logging::error("\n");
+  }
+
+  /**
+   * @brief read a part of the header
+   * @param data where to read to
+   * @param size number of bytes to read
+   * @param bytes_read the number of bytes read
+   */
+  bool read_header(void *data, const UINT size, UINT &bytes_read)
+  {
+    const FRESULT res = state::file_read(data, size, &bytes_read);
+    if (res != FR_OK)
+    {
+      log_read_error(res);
+      return false;
+    }
+
+    #if ENABLE_IMAGE_MANIFEST == 1
+      state::header_crc = crc::crc32(state::header_crc, static_cast<const uint8_t *>(data), bytes_read);
+    #endif
+    return true;
+  }
+
+  /**
+   * @brief skip header fields added by later header versions
+   * @param count number of bytes to skip
+   */
+  bool skip_header(uint32_t count)
+  {
+    uint8_t scratch[32];
+    while (count > 0)
+    {
+      UINT bytes_read = 0;
+      if (!read_header(scratch, minimum(count, sizeof(scratch)), bytes_read) || bytes_read == 0)
+      {
+        return false;
+      }
+
+      count -= bytes_read;
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief check the image header matches the file and is supported
+   */
+  bool is_valid_header(const image_header_t &header, const DWORD file_size)
+  {
+    if (header.version != IMAGE_VERSION)
+    {
+      logging::error("unsupported image version\n");
+      return false;
+    }
+
+    const bool is_delta = (header.flags & IMAGE_FLAG_DELTA) != 0;
+    const bool is_sparse = (header.flags & IMAGE_FLAG_SPARSE) != 0;
+    const bool is_encrypted = (header.flags & IMAGE_FLAG_ENCRYPTED) != 0;
+    const bool is_signed = (header.flags & IMAGE_FLAG_SIGNED) != 0;
+    const bool has_manifest = (header.flags & IMAGE_FLAG_MANIFEST) != 0;
+    const uint32_t min_header_size = sizeof(image_header_t)
+      + (is_delta ? sizeof(image_delta_header_t) : 0)
+      + (is_sparse ? sizeof(image_sparse_header_t) + sizeof(image_segment_t) : 0)
+      + (is_encrypted ? sizeof(image_encryption_header_t) : 0)
+      + (is_signed ? sizeof(image_signature_t) : 0)
+      + (has_manifest ? sizeof(image_manifest_t) + sizeof(uint32_t) : 0);
+    if (header.header_size < min_header_size || header.header_size > file_size || header.data_size != (file_size - header.header_size))
+    {
+      logging::error("image size mismatch\n");
+      return false;
+    }
+
+    if ((header.flags & ~(IMAGE_FLAG_COMPRESSED | IMAGE_FLAG_DELTA | IMAGE_FLAG_MANIFEST | IMAGE_FLAG_SPARSE | IMAGE_FLAG_ENCRYPTED | IMAGE_FLAG_SIGNED)) != 0 || (is_delta && is_sparse))
+    {
+      logging::error("unsupported image flags\n");
+      return false;
+    }
+
+    // the size of sparse data is checked against the segments
+    if ((header.flags & (IMAGE_FLAG_COMPRESSED | IMAGE_FLAG_DELTA | IMAGE_FLAG_SPARSE)) == 0 && header.data_size != header.app_size)
+    {
+      logging::error("image size mismatch\n");
+      return false;
+    }
+
+    #if ENABLE_COMPRESSED_IMAGES != 1
+      if ((header.flags & IMAGE_FLAG_COMPRESSED) != 0)
+      {
+        logging::error("compressed images not supported\n");
+        return false;
+      }
+    #endif
+
+    #if ENABLE_DELTA_IMAGES != 1
+      if (is_delta)
+      {
+        logging::error("delta images not supported\n");
+        return false;
+      }
+    #endif
+
+    #if ENABLE_SPARSE_IMAGES != 1
+      if (is_sparse)
+      {
+        logging::error("sparse images not supported\n");
+        return false;
+      }
+    #endif
+
+    #if ENABLE_ENCRYPTED_IMAGES != 1
+      if (is_encrypted)
+      {
+        logging::error("encrypted images not supported\n");
+        return false;
+      }
+    #endif
+
+    #if ENABLE_SIGNED_IMAGES == 1
+      if (!is_signed)
+      {
+        logging::error("image not signed\n");
+        return false;
+      }
+    #endif
+
+    return true;
+  }
+
+  #if ENABLE_DELTA_IMAGES == 1
+    /**
+     * @brief check the delta was made for the installed application, and the installed application is intact
+     */
+    bool is_valid_delta(const image_delta_header_t &delta)
+    {
+      const flash::update_metadata *installed = flash::update_metadata::get_stored(APP_BASE_ADDRESS);
+      if (delta.hash_type != METADATA_HASH || delta.source_size != installed->app_size || memcmp(delta.source_hash, &installed->hash, sizeof(hash::hash_t)) != 0)
+      {
+        logging::error("delta not for installed app\n");
+        return false;
+      }
+
+      // the delta copies from the installed application
+      if (!state::installed_verified)
+      {
+        if (!integrity::matches(APP_BASE_ADDRESS, *installed))
+        {
+          logging::error("installed app corrupt\n");
+          return false;
+        }
+
+        state::installed_verified = true;
+      }
+
+      return true;
+    }
+  #endif
+
+  #if ENABLE_SPARSE_IMAGES == 1
+    /**
+     * @brief read the segment table, and check the segments are in order and within the application
+     * @param header the image header
+     * @param size number of header bytes left
+     * @param data_size the size of the segments together, in bytes
+     */
+    bool read_segments(const image_header_t &header, const uint32_t size, uint32_t &data_size)
+    {
+      image_sparse_header_t sparse;
+      UINT bytes_read = 0;
+      if (!read_header(&sparse, sizeof(sparse), bytes_read)
+        || sparse.segment_count == 0
+        || sparse.segment_count > IMAGE_MAX_SEGMENTS
+        || size < sizeof(sparse) + (sparse.segment_count * sizeof(image_segment_t))
+        || !read_header(state::segments, sparse.segment_count * sizeof(image_segment_t), bytes_read))
+      {
+        logging::error("image segments invalid\n");
+        return false;
+      }
+
+      // segments in order, so the application is read front to back, and within the application, so within its flash
+      uint32_t end = 0;
+      data_size = 0;
+      for (uint32_t i = 0; i < sparse.segment_count; i++)
+      {
+        const image_segment_t &segment = state::segments[i];
+        if (segment.length == 0 || segment.offset < end || segment.offset > header.app_size || segment.length > (header.app_size - segment.offset))
+        {
+          logging::error("image segments invalid\n");
+          return false;
+        }
+
+        end = segment.offset + segment.length;
+        data_size += segment.length;
+      }
+
+      // plain segment data is read straight from the file
+      if ((header.flags & IMAGE_FLAG_COMPRESSED) == 0 && data_size != header.data_size)
+      {
+        logging::error("image size mismatch\n");
+        return false;
+      }
+
+      state::segment_count = sparse.segment_count;
+      state::segment = 0;
+      state::segment_data_offset = 0;
+      return true;
+    }
+  #endif
+
+  #if ENABLE_ENCRYPTED_IMAGES == 1
+    /**
+     * @brief read the encryption header, and check the image was encrypted with the image key
+     * @param size size of the header left to read
+     * @param key the image key
+     */
+    bool read_encryption_header(const uint32_t size, aes::key_t &key)
+    {
+      UINT bytes_read = 0;
+      if (size < sizeof(state::encryption))
+      {
+        logging::error("image size mismatch\n");
+        return false;
+      }
+
+      if (!read_header(&state::encryption, sizeof(state::encryption), bytes_read) || bytes_read != sizeof(state::encryption))
+      {
+        return false;
+      }
+
+      if (!aes::get_image_key(key))
+      {
+        logging::error("image key not set\n");
+        return false;
+      }
+
+      uint8_t key_check[aes::block_size] = {};
+      aes::encrypt_block(key, key_check, key_check);
+      if (memcmp(key_check, state::encryption.key_check, sizeof(state::encryption.key_check)) != 0)
+      {
+        logging::error("image key mismatch\n");
+        return false;
+      }
+
+      return true;
+    }
+  #endif
+
+  /**
+   * @brief read the signature. without ENABLE_SIGNED_IMAGES, it is skipped
+   * @param size size of the header left to read
+   */
+  bool read_signature(const uint32_t size)
+  {
+    if (size < sizeof(image_signature_t))
+    {
+      logging::error("image size mismatch\n");
+      return false;
+    }
+
+    #if ENABLE_SIGNED_IMAGES == 1
+      UINT bytes_read = 0;
+      if (!read_header(&state::signature, sizeof(state::signature), bytes_read) || bytes_read != sizeof(state::signature))
+      {
+        return false;
+      }
+
+      state::is_signed = true;
+      return true;
+    #else
+      return skip_header(sizeof(image_signature_t));
+    #endif
+  }
+
+  #if ENABLE_IMAGE_MANIFEST == 1
+    /**
+     * @brief read the manifest and the rest of the header, and check the header CRC32
+     * @param header the image header
+     * @param size number of header bytes left, including the header CRC32
+     */
+    bool read_manifest(const image_header_t &header, const uint32_t size)
+    {
+      image_manifest_t &manifest = state::manifest;
+      UINT bytes_read = 0;
+      if (!read_header(&manifest, sizeof(manifest), bytes_read))
+      {
+        return false;
+      }
+
+      const uint32_t sector_count = (header.app_size + IMAGE_SECTOR_SIZE - 1) / IMAGE_SECTOR_SIZE;
+      const uint32_t crcs_size = sector_count * sizeof(uint32_t);
+      if (manifest.sector_count != sector_count || sector_count > IMAGE_MAX_SECTORS || size < (sizeof(manifest) + crcs_size + sizeof(uint32_t)))
+      {
+        logging::error("image header corrupt\n");
+        return false;
+      }
+
+      if (!read_header(state::sector_crcs, crcs_size, bytes_read) || !skip_header(size - sizeof(manifest) - crcs_size - sizeof(uint32_t)))
+      {
+        return false;
+      }
+
+      // the header CRC32 covers all header bytes before it
+      const uint32_t expected_crc = state::header_crc;
+      uint32_t header_crc = 0;
+      if (!read_header(&header_crc, sizeof(header_crc), bytes_read) || header_crc != expected_crc)
+      {
+        logging::error("image header corrupt\n");
+        return false;
+      }
+
+      #if ENABLE_AB_SLOTS == 1
+        // the image is written to the slot it is built for
+        const bool is_valid_load_address = manifest.load_address == APP_BASE_ADDRESS || manifest.load_address == SLOT_B_ADDRESS;
+      #else
+        const bool is_valid_load_address = manifest.load_address == APP_BASE_ADDRESS;
+      #endif
+
+      if (!is_valid_load_address)
+      {
+        logging::error("image load address mismatch\n");
+        return false;
+      }
+
+      state::has_manifest = true;
+      return true;
+    }
+  #endif
+
+  bool open(const DWORD file_size, const source_function file_read, const seek_function file_seek)
+  {
+    state::file_read = file_read;
+    state::file_seek = file_seek;
+    state::image_format = format::none;
+    state::raw_bytes = 0;
+    state::raw_bytes_returned = 0;
+    state::position = 0;
+    #if ENABLE_IMAGE_MANIFEST == 1
+      state::has_manifest = false;
+      state::header_crc = 0;
+    #endif
+    #if ENABLE_ENCRYPTED_IMAGES == 1
+      state::encrypted = false;
+    #endif
+    #if ENABLE_SIGNED_IMAGES == 1
+      state::is_signed = false;
+      state::signature_checked = false;
+    #endif
+
+    image_header_t &header = state::header;
+    UINT bytes_read = 0;
+    if (!read_header(&header, sizeof(header), bytes_read))
+    {
+      return false;
+    }
+
+    // an image cut off in its header is no raw binary either, as the magic is no valid stack pointer
+    if (bytes_read >= sizeof(header.magic) && bytes_read < sizeof(header) && header.magic == IMAGE_MAGIC)
+    {
+      logging::error("image size mismatch\n");
+      return false;
+    }
+
+    // without the magic, the file is a raw binary. the bytes read so far are returned first by read()
+    if (bytes_read < sizeof(header) || header.magic != IMAGE_MAGIC)
+    {
+      // raw binaries carry no signature
+      #if ENABLE_SIGNED_IMAGES == 1
+        logging::error("image not signed\n");
+        return false;
+      #endif
+
+      state::image_format = format::raw;
+      state::raw_bytes = bytes_read;
+      state::app_size = file_size;
+      return true;
+    }
+
+    if (!is_valid_header(header, file_size))
+    {
+      return false;
+    }
+
+    uint32_t unknown_header_size = header.header_size - sizeof(header);
+    #if ENABLE_DELTA_IMAGES == 1
+      const bool is_delta = (header.flags & IMAGE_FLAG_DELTA) != 0;
+      if (is_delta)
+      {
+        if (!read_header(&state::delta, sizeof(state::delta), bytes_read) || !is_valid_delta(state::delta))
+        {
+          return false;
+        }
+
+        unknown_header_size -= sizeof(state::delta);
+      }
+    #endif
+
+    #if ENABLE_SPARSE_IMAGES == 1
+      const bool is_sparse = (header.flags & IMAGE_FLAG_SPARSE) != 0;
+      uint32_t segment_data_size = 0;
+      if (is_sparse)
+      {
+        if (!read_segments(header, unknown_header_size, segment_data_size))
+        {
+          return false;
+        }
+
+        unknown_header_size -= sizeof(image_sparse_header_t) + (state::segment_count * sizeof(image_segment_t));
+      }
+    #endif
+
+    #if ENABLE_ENCRYPTED_IMAGES == 1
+      const bool is_encrypted = (header.flags & IMAGE_FLAG_ENCRYPTED) != 0;
+      aes::key_t key;
+      if (is_encrypted)
+      {
+        if (!read_encryption_header(unknown_header_size, key))
+        {
+          return false;
+        }
+
+        unknown_header_size -= sizeof(state::encryption);
+      }
+    #endif
+
+    if ((header.flags & IMAGE_FLAG_SIGNED) != 0)
+    {
+      if (!read_signature(unknown_header_size))
+      {
+        return false;
+      }
+
+      unknown_header_size -= sizeof(image_signature_t);
+    }
+
+    #if ENABLE_IMAGE_MANIFEST == 1
+      if ((header.flags & IMAGE_FLAG_MANIFEST) != 0)
+      {
+        if (!read_manifest(header, unknown_header_size))
+        {
+          return false;
+        }
+
+        unknown_header_size = 0;
+      }
+    #endif
+
+    if (!skip_header(unknown_header_size))
+    {
+      return false;
+    }
+
+    #if ENABLE_ENCRYPTED_IMAGES == 1
+      // the application data is decrypted as it is read from the file, before it is decoded
+      if (is_encrypted)
+      {
+        state::encrypted = true;
+        state::encrypted_read = state::file_read;
+        state::encrypted_seek = state::file_seek;
+        state::file_read = &read_encrypted;
+        state::file_seek = &seek_encrypted;
+        aes::start_ctr(key, state::encryption.nonce, 0);
+      }
+    #endif
+
+    state::app_size = header.app_size;
+    state::image_format = format::uncompressed;
+
+    #if ENABLE_COMPRESSED_IMAGES == 1
+      if ((header.flags & IMAGE_FLAG_COMPRESSED) != 0)
+      {
+        // compressed delta data decompresses to the delta, and sparse data to the segments, not the application
+        uint32_t decoded_size = header.app_size;
+        #if ENABLE_DELTA_IMAGES == 1
+          if (is_delta)
+          {
+            decoded_size = state::delta.delta_size;
+          }
+        #endif
+        #if ENABLE_SPARSE_IMAGES == 1
+          if (is_sparse)
+          {
+            decoded_size = segment_data_size;
+          }
+        #endif
+
+        if (!compressed_decoder.start(&read_file, header.header_size, decoded_size, header.window_bits))
+        {
+          logging::error("image window too large\n");
+          return false;
+        }
+
+        state::image_format = format::compressed;
+      }
+    #endif
+
+    #if ENABLE_DELTA_IMAGES == 1
+      if (is_delta)
+      {
+        #if ENABLE_COMPRESSED_IMAGES == 1
+          if (state::image_format == format::compressed)
+          {
+            delta_patcher.start(&read_decompressed, 0, APP_BASE_ADDRESS, state::delta.source_size, header.app_size);
+            state::image_format = format::compressed_delta;
+            return true;
+          }
+        #endif
+
+        delta_patcher.start(&read_file, header.header_size, APP_BASE_ADDRESS, state::delta.source_size, header.app_size);
+        state::image_format = format::delta;
+      }
+    #endif
+
+    #if ENABLE_SPARSE_IMAGES == 1
+      if (is_sparse)
+      {
+        state::image_format = state::image_format == format::compressed ? format::compressed_sparse : format::sparse;
+      }
+    #endif
+
+    return true;
+  }
+
+  #if ENABLE_STAGED_UPDATES == 1
+    void open_staged(const uint32_t address, const uint32_t app_size)
+    {
+      state::image_format = format::staged;
+      state::staged_address = address;
+      state::app_size = app_size;
+      state::position = 0;
+      #if ENABLE_IMAGE_MANIFEST == 1
+        state::has_manifest = false;
+      #endif
+    }
+  #endif
+
+  uint32_t get_app_size()
+  {
+    return state::app_size;
+  }
+
+  uint32_t get_target_address()
+  {
+    #if ENABLE_IMAGE_MANIFEST == 1
+      if (state::has_manifest)
+      {
+        return state::manifest.load_address;
+      }
+    #endif
+
+    // raw binaries start with the vector table, so the reset handler is in the flash area they are built for
+    if (state::image_format == format::raw && state::raw_bytes >= 2 * sizeof(uint32_t))
+    {
+      return reinterpret_cast<const uint32_t *>(&state::header)[1];
+    }
+
+    return 0;
+  }
+
+  bool is_delta()
+  {
+    return state::image_format == format::delta || state::image_format == format::compressed_delta;
+  }
+
+  #if ENABLE_SPARSE_IMAGES == 1
+    /**
+     * @brief is the image a sparse image?
+     */
+    bool is_sparse()
+    {
+      return state::image_format == format::sparse || state::image_format == format::compressed_sparse;
+    }
+
+    /**
+     * @brief does a segment of the sparse image overlap a part of the application?
+     * @param offset offset of the part in the application
+     * @param length length of the part, in bytes
+     */
+    bool has_segment(const uint32_t offset, const uint32_t length)
+    {
+      for (uint32_t i = 0; i < state::segment_count; i++)
+      {
+        if (state::segments[i].offset < (offset + length) && (state::segments[i].offset + state::segments[i].length) > offset)
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+  #endif
+
+  #if METADATA_HASH != HASH_NONE
+    bool is_expected_hash(const hash::hash_t &hash)
+    {
+      #if ENABLE_DELTA_IMAGES == 1
+        if (is_delta())
+        {
+          return memcmp(state::delta.target_hash, &hash, sizeof(hash::hash_t)) == 0;
+        }
+      #endif
+
+      return true;
+    }
+  #endif
+
+  #if ENABLE_SIGNED_IMAGES == 1
+    bool is_signed_hash(const hash::hash_t &hash)
+    {
+      PROFILE_SCOPE(signature);
+      const uint32_t start = timebase::now();
+      const bool is_valid = state::is_signed && ecdsa::verify(hash, reinterpret_cast<const uint8_t *>(&state::signature));
+      state::verify_us = timebase::now() - start;
+      state::signature_checked = true;
+
+      if (!is_valid)
+      {
+        logging::error("image signature invalid\n");
+      }
+      return is_valid;
+    }
+  #endif
+
+  bool has_app_hash()
+  {
+    // the signature of signed images is checked against the hash of the application as read from the image, before
+    // the first erase. the hash of the manifest isn't signed, so it can't stand in for it
+    #if ENABLE_IMAGE_MANIFEST == 1 && ENABLE_SIGNED_IMAGES != 1
+      return state::has_manifest && state::manifest.hash_type == METADATA_HASH;
+    #else
+      return false;
+    #endif
+  }
+
+  #if METADATA_HASH != HASH_NONE
+    bool get_app_hash(hash::hash_t &hash)
+    {
+      #if ENABLE_IMAGE_MANIFEST == 1
+        if (has_app_hash())
+        {
+          memcpy(&hash, state::manifest.app_hash, sizeof(hash::hash_t));
+          return true;
+        }
+      #endif
+
+      return false;
+    }
+  #endif
+
+  bool is_sector_unchanged(const uint32_t app_base_address, const uint32_t offset)
+  {
+    #if ENABLE_SPARSE_IMAGES == 1
+      // sectors in the gaps of sparse images only have to be erased
+      if (is_sparse() && !has_segment(offset, IMAGE_SECTOR_SIZE))
+      {
+        const uint32_t size = minimum(state::app_size - offset, static_cast<uint32_t>(IMAGE_SECTOR_SIZE));
+        const uint32_t *words = flash::at<uint32_t>(app_base_address + offset);
+        return std::all_of(words, words + ((size + 3) / 4), [](const uint32_t word) { return word == 0xFFFFFFFF; });
+      }
+    #endif
+
+    #if ENABLE_STAGED_UPDATES == 1
+      // the staged application is compared with the flash directly, so an interrupted copy resumes where it stopped
+      if (state::image_format == format::staged)
+      {
+        const uint32_t size = minimum(state::app_size - offset, static_cast<uint32_t>(IMAGE_SECTOR_SIZE));
+        const uint8_t *staged = flash::at<uint8_t>(state::staged_address + offset);
+        return std::equal(staged, staged + size, flash::at<uint8_t>(app_base_address + offset));
+      }
+    #endif
+
+    // neither are the sector CRC32s of the manifest, so signed images rewrite all sectors. a CRC32 changed to match
+    // the flash would keep a sector the signed application doesn't have, failing the update after the first erase
+    #if ENABLE_IMAGE_MANIFEST == 1 && ENABLE_SIGNED_IMAGES != 1
+      const uint32_t sector = offset / IMAGE_SECTOR_SIZE;
+      if (!state::has_manifest || sector >= state::manifest.sector_count)
+      {
+        return false;
+      }
+
+      #if METADATA_SECTOR_CRCS == 1
+        // the stored metadata knows the sectors of the installed application, so their flash isn't read.
+        // the written application is checked against the hash of the image afterwards
+        const flash::update_metadata *stored = flash::update_metadata::get_stored(app_base_address);
+        if (has_app_hash() && stored->app_size != 0xFFFFFFFF && offset < stored->app_size)
+        {
+          return stored->sector_crcs[sector] == state::sector_crcs[sector];
+        }
+      #endif
+
+      // the sector as programmed, padded to whole words
+      const uint32_t size = minimum(state::app_size - offset, static_cast<uint32_t>(IMAGE_SECTOR_SIZE));
+      return crc::calculate(flash::at<uint32_t>(app_base_address + offset), (size + 3) / 4) == state::sector_crcs[sector];
+    #else
+      return false;
+    #endif
+  }
+
+  #if ENABLE_COMPRESSED_IMAGES == 1 || ENABLE_DELTA_IMAGES == 1
+    /**
+     * @brief read from the decoder of the image format
+     */
+    bool read_decoded(uint8_t *buffer, const UINT size, UINT &bytes_read)
+    {
+      #if ENABLE_DELTA_IMAGES == 1
+        if (is_delta())
+        {
+          return delta_patcher.read(buffer, size, bytes_read);
+        }
+      #endif
+
+      #if ENABLE_COMPRESSED_IMAGES == 1
+        return compressed_decoder.read(buffer, size, bytes_read);
+      #else
+        return false;
+      #endif
+    }
+  #endif
+
+  #if ENABLE_SPARSE_IMAGES == 1
+    /**
+     * @brief read the next bytes of the segment data
+     */
+    bool read_segment_data(uint8_t *buffer, const UINT size, UINT &bytes_read)
+    {
+      #if ENABLE_COMPRESSED_IMAGES == 1
+        if (state::image_format == format::compressed_sparse)
+        {
+          const uint32_t start = timebase::now();
+          const bool ok = compressed_decoder.read(buffer, size, bytes_read);
+          stats::decode_us += timebase::now() - start;
+          stats::bytes_out += bytes_read;
+          return ok && bytes_read != 0;
+        }
+      #endif
+
+      const FRESULT res = state::file_read(buffer, size, &bytes_read);
+      if (res != FR_OK)
+      {
+        log_read_error(res);
+        return false;
+      }
+
+      return bytes_read != 0;
+    }
+
+    /**
+     * @brief read the next bytes of a sparse image, with 0xFF in the gaps between the segments
+     */
+    bool read_sparse(uint8_t *buffer, const UINT size, UINT &bytes_read)
+    {
+      while (bytes_read < size && state::position < state::app_size)
+      {
+        UINT count = 0;
+        if (state::segment >= state::segment_count || state::position < state::segments[state::segment].offset)
+        {
+          // the gap up to the next segment, as erased flash
+          const uint32_t gap_end = state::segment < state::segment_count ? state::segments[state::segment].offset : state::app_size;
+          count = minimum(size - bytes_read, gap_end - state::position);
+          memset(buffer + bytes_read, 0xFF, count);
+        }
+        else
+        {
+          const image_segment_t &segment = state::segments[state::segment];
+          if (!read_segment_data(buffer + bytes_read, minimum(size - bytes_read, segment.offset + segment.length - state::position), count))
+          {
+            logging::error("image data corrupt\n");
+            return false;
+          }
+
+          if (state::position + count == segment.offset + segment.length)
+          {
+            state::segment_data_offset += segment.length;
+            state::segment++;
+          }
+        }
+
+        bytes_read += count;
+        state::position += count;
+      }
+
+      return true;
+    }
+  #endif
+
+  bool read(uint8_t *buffer, const UINT size, UINT &bytes_read)
+  {
+    bytes_read = 0;
+
+    #if ENABLE_SPARSE_IMAGES == 1
+      if (is_sparse())
+      {
+        return read_sparse(buffer, size, bytes_read);
+      }
+    #endif
+
+    #if ENABLE_STAGED_UPDATES == 1
+      // the staged application is copied straight from flash
+      if (state::image_format == format::staged)
+      {
+        bytes_read = minimum(static_cast<uint32_t>(size), state::app_size - state::position);
+        memcpy(buffer, flash::at<uint8_t>(state::staged_address + state::position), bytes_read);
+        state::position += bytes_read;
+        return true;
+      }
+    #endif
+
+    #if ENABLE_COMPRESSED_IMAGES == 1 || ENABLE_DELTA_IMAGES == 1
+      if (state::image_format != format::raw && state::image_format != format::uncompressed)
+      {
+        const uint32_t start = timebase::now();
+        const bool ok = read_decoded(buffer, size, bytes_read);
+        stats::decode_us += timebase::now() - start;
+        stats::bytes_out += bytes_read;
+
+        state::position += bytes_read;
+        if (!ok)
+        {
+          logging::error("image data corrupt\n");
+        }
+        return ok;
+      }
+    #endif
+
+    // return the start of a raw binary, read while looking for the header, first
+    const uint8_t *raw_bytes = reinterpret_cast<const uint8_t *>(&state::header);
+    while (state::raw_bytes_returned < state::raw_bytes && bytes_read < size)
+    {
+      buffer[bytes_read++] = raw_bytes[state::raw_bytes_returned++];
+    }
+
+    UINT file_bytes_read = 0;
+    const FRESULT res = state::file_read(buffer + bytes_read, size - bytes_read, &file_bytes_read);
+    if (res != FR_OK)
+    {
+      log_read_error(res);
+      return false;
+    }
+
+    bytes_read += file_bytes_read;
+    state::position += bytes_read;
+    return true;
+  }
+
+  bool skip(uint32_t count)
+  {
+    #if ENABLE_STAGED_UPDATES == 1
+      if (state::image_format == format::staged)
+      {
+        state::position += count;
+        return true;
+      }
+    #endif
+
+    #if ENABLE_SPARSE_IMAGES == 1
+      // gaps aren't stored, and plain segment data is skipped in the file
+      if (state::image_format == format::sparse)
+      {
+        state::position += count;
+        while (state::segment < state::segment_count && (state::segments[state::segment].offset + state::segments[state::segment].length) <= state::position)
+        {
+          state::segment_data_offset += state::segments[state::segment].length;
+          state::segment++;
+        }
+
+        const bool in_segment = state::segment < state::segment_count && state::position > state::segments[state::segment].offset;
+        const uint32_t segment_position = in_segment ? state::position - state::segments[state::segment].offset : 0;
+        const FRESULT res = state::file_seek(state::header.header_size + state::segment_data_offset + segment_position);
+        if (res != FR_OK)
+        {
+          log_read_error(res);
+          return false;
+        }
+
+        return true;
+      }
+    #endif
+
+    // plain application data is skipped in the file
+    if (state::image_format == format::uncompressed)
+    {
+      state::position += count;
+      const FRESULT res = state::file_seek(state::header.header_size + state::position);
+      if (res != FR_OK)
+      {
+        log_read_error(res);
+        return false;
+      }
+
+      return true;
+    }
+
+    // encoded data is decoded, as the data after it depends on it
+    uint8_t scratch[64] __attribute__((aligned(4)));
+    while (count > 0)
+    {
+      UINT bytes_read = 0;
+      if (!read(scratch, minimum(count, sizeof(scratch)), bytes_read) || bytes_read == 0)
+      {
+        return false;
+      }
+
+      count -= bytes_read;
+    }
+
+    return true;
+  }
+
+  void log_stats()
+  {
+    #if ENABLE_ENCRYPTED_IMAGES == 1
+      if (state::encrypted)
+      {
+        logging::debug(LOG_STR("image: encrypted, "));
+        logging::debug(state::decrypted_bytes, 10);
+        logging::debug(LOG_STR(" bytes decrypted, "));
+        logging::debug(state::decrypt_us, 10);
+        logging::debug(LOG_STR(" us decrypting\n"));
+      }
+    #endif
+
+    #if ENABLE_SIGNED_IMAGES == 1
+      if (state::signature_checked)
+      {
+        logging::debug(LOG_STR("image: signature checked in "));
+        logging::debug(state::verify_us, 10);
+        logging::debug(LOG_STR(" us\n"));
+      }
+    #endif
+
+    switch (state::image_format)
+    {
+    case format::none:
+      return;
+    case format::raw:
+      logging::debug(LOG_STR("image: raw\n"));
+      return;
+    case format::uncompressed:
+      logging::debug(LOG_STR("image: uncompressed\n"));
+      return;
+    case format::staged:
+      logging::debug(LOG_STR("image: staged\n"));
+      return;
+    case format::sparse:
+      logging::debug(LOG_STR("image: sparse\n"));
+      return;
+    case format::compressed:
+      logging::debug(LOG_STR("image: compressed, "));
+      break;
+    case format::delta:
+      logging::debug(LOG_STR("image: delta, "));
+      break;
+    case format::compressed_delta:
+      logging::debug(LOG_STR("image: compressed delta, "));
+      break;
+    case format::compressed_sparse:
+      logging::debug(LOG_STR("image: compressed sparse, "));
+      break;
+    }
+
+    #if ENABLE_COMPRESSED_IMAGES == 1 || ENABLE_DELTA_IMAGES == 1
+      // the file reads are timed separately, so only the decoding itself is counted
+      const uint32_t us = stats::decode_us - minimum(stats::source_us, stats::decode_us);
+      const uint32_t kb = stats::bytes_out >= 1024u ? stats::bytes_out / 1024u : 1u;
+      const uint32_t cycles_per_kb = static_cast<uint32_t>((static_cast<uint64_t>(us) * (SystemCoreClock / 1000000ul)) / kb);
+
+      logging::debug(stats::bytes_in, 10);
+      logging::debug(LOG_STR(" bytes in, "));
+      logging::debug(stats::bytes_out, 10);
+      logging::debug(LOG_STR(" bytes out, "));
+      logging::debug(us, 10);
+      logging::debug(LOG_STR(" us decoding, "));
+      logging::debug(cycles_per_kb, 10);
+      logging::debug(LOG_STR(" cycles/KB\n"));
+    #endif
+  }
+} // namespace image
@@ -0,0 +1,314 @@
+#pragma once
+#include <stdint.h>
+#include <source/pff.h>
+#include "image_format.h"
+#include "hash.h"
+#include "../config.h"
+
+namespace image
+{
+  /**
+   * @brief function reading the next bytes of the image data, like pf_read()
+   */
+  typedef FRESULT (*source_function)(void *buffer, UINT size, UINT *bytes_read);
+
+  /**
+   * @brief function moving the read position in the update file, like pf_lseek()
+   */
+  typedef FRESULT (*seek_function)(DWORD offset);
+
+  #if ENABLE_COMPRESSED_IMAGES == 1 || ENABLE_DELTA_IMAGES == 1
+    /**
+     * @brief buffered byte-wise reader of a source
+     */
+    class reader
+    {
+    public:
+      /**
+       * @brief size of the input buffer. the source is read in chunks of this size
+       */
+      static constexpr UINT input_size = 512;
+
+      /**
+       * @brief start reading
+       * @param source the source to read from
+       * @param source_offset current offset in the source, so reads can be aligned to input_size
+       */
+      void start(const source_function source, const uint32_t source_offset);
+
+      /**
+       * @brief get the next byte
+       * @return false if the source failed or ended
+       */
+      bool next_byte(uint8_t &byte);
+
+      /**
+       * @brief copy the next bytes, at most as many as the input buffer holds
+       * @param buffer the buffer to copy to
+       * @param size the maximum number of bytes to copy
+       * @param copied the number of bytes copied
+       * @return false if the source failed or ended
+       */
+      bool next_bytes(uint8_t *buffer, const uint32_t size, uint32_t &copied);
+
+      /**
+       * @brief read a LEB128 encoded number
+       * @return false if the source failed or ended, or the number doesn't fit 32 bits
+       */
+      bool next_number(uint32_t &number);
+
+      /**
+       * @brief read the extra bytes of a length: bytes are added to it until a byte is not 255
+       * @return false if the source failed or ended
+       */
+      bool next_length(uint32_t &length);
+
+    private:
+      /**
+       * @brief refill the input buffer from the source
+       * @return false if the source failed or ended
+       */
+      bool fill();
+
+      source_function source = nullptr;
+      uint32_t source_offset = 0;
+
+      uint8_t input[input_size] __attribute__((aligned(4)));
+      UINT input_position = 0;
+      UINT input_length = 0;
+    };
+  #endif
+
+  #if ENABLE_COMPRESSED_IMAGES == 1
+    /**
+     * @brief streaming decoder of compressed application data, see image_format.h.
+     * uses a fixed window of (1 << COMPRESSED_IMAGE_WINDOW_BITS) bytes and no heap
+     */
+    class decoder
+    {
+    public:
+      /**
+       * @brief start decoding
+       * @param source the source of the compressed data
+       * @param source_offset offset of the compressed data in the source, so reads can be aligned
+       * @param app_size size of the decoded data, in bytes
+       * @param window_bits log2 of the window size the data was compressed with
+       * @return true if the window fits into the decoder
+       */
+      bool start(const source_function source, const uint32_t source_offset, const uint32_t app_size, const uint8_t window_bits);
+
+      /**
+       * @brief decode the next bytes
+       * @param buffer the buffer to decode into
+       * @param size the size of the buffer
+       * @param bytes_read the number of bytes decoded. less than size only at the end of the data
+       * @return false if the data is corrupt or truncated
+       */
+      bool read(uint8_t *buffer, const UINT size, UINT &bytes_read);
+
+    private:
+      /**
+       * @brief read the next token and the literal count
+       */
+      bool read_token();
+
+      /**
+       * @brief read the match offset and length following the literals
+       */
+      bool read_match();
+
+      reader input;
+
+      uint8_t window[1ul << COMPRESSED_IMAGE_WINDOW_BITS];
+      uint32_t window_mask = 0;
+
+      /**
+       * @brief total size of the decoded data, and the number of bytes decoded so far
+       */
+      uint32_t app_size = 0;
+      uint32_t produced = 0;
+
+      /**
+       * @brief lower 4 bits of the current token, literals and match bytes left to copy, and the match offset
+       */
+      uint8_t match_token = 0;
+      uint32_t literals = 0;
+      uint32_t match = 0;
+      uint32_t offset = 0;
+
+      /**
+       * @brief are the match offset and length of the current sequence still to be read?
+       */
+      bool match_pending = false;
+    };
+  #endif
+
+  #if ENABLE_DELTA_IMAGES == 1
+    /**
+     * @brief streaming decoder of delta application data, see image_format.h.
+     * copies from the installed application straight from flash, and enforces the order the delta can be applied in place
+     */
+    class patcher
+    {
+    public:
+      /**
+       * @brief start patching
+       * @param source the source of the delta data
+       * @param source_offset offset of the delta data in the source, so reads can be aligned
+       * @param app_base_address base address of the installed application
+       * @param installed_size size of the installed application, in bytes
+       * @param app_size size of the patched application, in bytes
+       */
+      void start(const source_function source, const uint32_t source_offset, const uint32_t app_base_address, const uint32_t installed_size, const uint32_t app_size);
+
+      /**
+       * @brief patch the next bytes
+       * @param buffer the buffer to patch into
+       * @param size the size of the buffer
+       * @param bytes_read the number of bytes patched. less than size only at the end of the data
+       * @return false if the data is corrupt, truncated or can't be applied in place
+       */
+      bool read(uint8_t *buffer, const UINT size, UINT &bytes_read);
+
+    private:
+      /**
+       * @brief read the copy length and offset following the literals, and check the copy can be applied in place
+       */
+      bool read_copy();
+
+      reader input;
+
+      uint32_t app_base_address = 0;
+      uint32_t installed_size = 0;
+
+      /**
+       * @brief total size of the patched data, and the number of bytes patched so far
+       */
+      uint32_t app_size = 0;
+      uint32_t produced = 0;
+
+      /**
+       * @brief literals and copy bytes left, and the offset in the installed application to copy from next
+       */
+      uint32_t literals = 0;
+      uint32_t copy = 0;
+      uint32_t offset = 0;
+
+      /**
+       * @brief are the copy length and offset of the current record still to be read?
+       */
+      bool copy_pending = false;
+    };
+  #endif
+
+  /**
+   * @brief open the image in the update file, detecting its format from the header.
+   * files without an image header are raw application binaries
+   * @param file_size size of the update file, in bytes
+   * @param file_read function reading the update file, the file opened using pf_open() by default
+   * @param file_seek function moving the read position in the update file
+   * @return true if the image is valid and supported
+   * @note call with the file at its start. the file must not be read otherwise until it is opened again
+   */
+  bool open(const DWORD file_size, const source_function file_read = &pf_read, const seek_function file_seek = &pf_lseek);
+
+  #if ENABLE_STAGED_UPDATES == 1
+    /**
+     * @brief open an application staged in flash as the image, instead of the update file
+     * @param address start address of the staged application
+     * @param app_size size of the staged application, in bytes
+     */
+    void open_staged(const uint32_t address, const uint32_t app_size);
+  #endif
+
+  /**
+   * @brief get the size of the application in the image, in bytes
+   * @note valid after open()
+   */
+  uint32_t get_app_size();
+
+  /**
+   * @brief get an address in the flash area the application in the image is built for:
+   * the load address of the manifest, or the reset handler of raw binaries
+   * @return the address, or 0 if the image doesn't tell
+   * @note valid after open()
+   */
+  uint32_t get_target_address();
+
+  /**
+   * @brief does the image rebuild the application from the installed one?
+   * if so, each flash sector must be read completely before it is erased
+   */
+  bool is_delta();
+
+  #if METADATA_HASH != HASH_NONE
+    /**
+     * @brief check the hash of the application matches the hash the image expects
+     * @param hash the hash of the application read from the image
+     * @return true if the image expects this hash, or doesn't carry a hash
+     */
+    bool is_expected_hash(const hash::hash_t &hash);
+  #endif
+
+  #if ENABLE_SIGNED_IMAGES == 1
+    /**
+     * @brief check the signature of the image, see image_format.h, is valid for the hash of the application
+     * @param hash the hash of the application, from the manifest or read from the image
+     * @return true if the signature is valid
+     * @note the application must still be checked against the hash once it is written
+     */
+    bool is_signed_hash(const hash::hash_t &hash);
+  #endif
+
+  /**
+   * @brief does the image manifest carry the hash of the application, of the METADATA_HASH type?
+   * if so, the update file doesn't have to be read to hash it, but the written application must be checked against it.
+   * never with ENABLE_SIGNED_IMAGES, as the signature must be checked against the application itself
+   */
+  bool has_app_hash();
+
+  #if METADATA_HASH != HASH_NONE
+    /**
+     * @brief get the hash of the application from the image manifest
+     * @param hash the hash of the application
+     * @return true if the image carries the hash, see has_app_hash()
+     */
+    bool get_app_hash(hash::hash_t &hash);
+  #endif
+
+  /**
+   * @brief check a flash sector already holds its part of the application, using the CRC32s of the image manifest.
+   * with METADATA_SECTOR_CRCS, the CRC32s of the stored metadata are used instead of reading the sector.
+   * a staged application is compared with the sector directly, and sectors in the gaps of sparse images must be erased.
+   * with ENABLE_SIGNED_IMAGES, the manifest isn't used
+   * @param app_base_address base address of the application
+   * @param offset offset of the sector in the application
+   * @return true if the image has a manifest and the sector matches its CRC32, the sector matches the staged application,
+   * or the sector is erased and holds no segment of a sparse image
+   * @note call before the stored metadata is erased
+   */
+  bool is_sector_unchanged(const uint32_t app_base_address, const uint32_t offset);
+
+  /**
+   * @brief skip the next bytes of the application. seeks in the file when the application data is not encoded,
+   * and the gaps of sparse images cost nothing
+   * @param count number of bytes to skip
+   * @return true if the bytes were skipped
+   */
+  bool skip(const uint32_t count);
+
+  /**
+   * @brief read the next bytes of the application, decoding the image as needed
+   * @param buffer the buffer to read into
+   * @param size the size of the buffer
+   * @param bytes_read the number of bytes read. less than size only at the end of the application
+   * @return true if the read was successful
+   */
+  bool read(uint8_t *buffer, const UINT size, UINT &bytes_read);
+
+  /**
+   * @brief log the format of the image and the decoding counters to logging::debug
+   * @note call once, at the end of the boot
+   */
+  void log_stats();
+} // namespace image
@@ -0,0 +1,314 @@
+/**
+ * OpenHC32Boot update image format.
+ *
+ * an update file is either a raw application binary, or an image starting with an image header.
+ * images are created from the application binary using scripts/pack_image.py.
+ *
+ * layout of an image:
+ * 1. the image header, header_size bytes. fields added by later versions are appended, so readers skip
+ *    to header_size and ignore fields they don't know. the image header is followed by, in this order:
+ *    - the delta header (IMAGE_FLAG_DELTA)
+ *    - the segment table (IMAGE_FLAG_SPARSE), followed by segment_count segments
+ *    - the encryption header (IMAGE_FLAG_ENCRYPTED)
+ *    - the signature (IMAGE_FLAG_SIGNED)
+ *    - the manifest (IMAGE_FLAG_MANIFEST), followed by the CRC32 of each IMAGE_SECTOR_SIZE bytes of the application
+ *      as programmed, that is padded with 0xFF to whole words.
+ *      with a manifest, the last 4 bytes of the header are the CRC32 of all header bytes before them
+ * 2. the application data, data_size bytes, encoded as described by the flags
+ *
+ * compressed data (IMAGE_FLAG_COMPRESSED) is a sequence of LZ4 style sequences:
+ * 1. token byte: the upper 4 bits are the literal count, the lower 4 bits the match length - 4.
+ *    a count of 15 is followed by extra bytes that are added to it, until a byte is not 255
+ * 2. the literals
+ * 3. unless the application is complete after the literals:
+ *    the match offset (uint16_t, little endian, 1 to (1 << window_bits)), extra bytes of the match length
+ * a match copies match length bytes from match offset bytes back in the decoded output.
+ *
+ * delta data (IMAGE_FLAG_DELTA) rebuilds the application from the installed application (the source),
+ * and is followed by the delta header. it is a sequence of records:
+ * 1. literal count (LEB128), followed by the literals
+ * 2. unless the application is complete after the literals:
+ *    copy length (LEB128) and source offset (LEB128), copying copy length bytes of the source starting at source offset
+ * the delta is applied in place, one flash sector at a time: a sector is decoded into RAM before it is erased.
+ * so bytes of a sector may only be copied from the same or later sectors of the source, and a copy crossing into the
+ * next sector must not read from before its own position.
+ * delta data may be compressed too, it is decompressed before it is applied.
+ *
+ * sparse data (IMAGE_FLAG_SPARSE) only holds the bytes of the segments of the application, one after the other.
+ * the bytes between segments are 0xFF, as in erased flash, and are neither stored nor programmed. segments are
+ * ordered by offset and don't overlap. the hash, the manifest and app_size describe the application with the 0xFF
+ * bytes in between. sparse data may be compressed too, it is decompressed before it is split into the segments.
+ * sparse images can't be delta images.
+ *
+ * encrypted data (IMAGE_FLAG_ENCRYPTED) is the application data, encoded as described by the other flags, encrypted
+ * with AES-128 in CTR mode. the counter block of the 16 bytes at offset n of the application data is the nonce,
+ * followed by n / 16 as a big endian uint32_t. the header isn't encrypted, and the hash, the manifest and app_size
+ * describe the decrypted application.
+ *
+ * the signature (IMAGE_FLAG_SIGNED) is an ECDSA signature on the NIST P-256 curve of the application. the signed digest
+ * is the SHA-256 hash of the application the way the bootloader calculates the update metadata hash (METADATA_HASH
+ * HASH_SHA256), taken as a big endian number. it covers neither the header nor the encoding of the application data.
+ *
+ * CRC32 is the common CRC-32 (as used by zlib). the hashes of the delta header and the manifest are calculated
+ * the way the bootloader calculates the update metadata hash instead.
+ *
+ * all fields are little endian.
+ */
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief image magic value, "OHBI"
+ */
+#define IMAGE_MAGIC 0x4942484Ful
+
+/**
+ * @brief image header layout version. incremented on incompatible changes
+ */
+#define IMAGE_VERSION 1
+
+/**
+ * @brief the application data is compressed
+ */
+#define IMAGE_FLAG_COMPRESSED (1ul << 0)
+
+/**
+ * @brief the application data is a delta against the installed application, see image_delta_header_t
+ */
+#define IMAGE_FLAG_DELTA (1ul << 1)
+
+/**
+ * @brief the header carries a manifest, see image_manifest_t
+ */
+#define IMAGE_FLAG_MANIFEST (1ul << 2)
+
+/**
+ * @brief the application data only holds the segments of the application, see image_sparse_header_t
+ */
+#define IMAGE_FLAG_SPARSE (1ul << 3)
+
+/**
+ * @brief the application data is encrypted, see image_encryption_header_t
+ */
+#define IMAGE_FLAG_ENCRYPTED (1ul << 4)
+
+/**
+ * @brief the header carries a signature of the application, see image_signature_t
+ */
+#define IMAGE_FLAG_SIGNED (1ul << 5)
+
+/**
+ * @brief size of the application parts the manifest holds a CRC32 of, equal to the flash erase sector size
+ */
+#define IMAGE_SECTOR_SIZE 8192
+
+/**
+ * @brief most application parts a manifest holds, enough for 512 KB of flash
+ */
+#define IMAGE_MAX_SECTORS 64
+
+/**
+ * @brief most segments a sparse image holds
+ */
+#define IMAGE_MAX_SEGMENTS 32
+
+/**
+ * @brief hash types of the delta header and the manifest. equal to the METADATA_HASH values
+ */
+#define IMAGE_HASH_CRC32 1
+#define IMAGE_HASH_SHA256 2
+
+/**
+ * @brief window size of compressed data, as log2 of the window size in bytes
+ */
+#define IMAGE_MIN_WINDOW_BITS 8
+#define IMAGE_MAX_WINDOW_BITS 16
+
+/**
+ * @brief the image header
+ */
+typedef struct image_header
+{
+  /**
+   * @brief IMAGE_MAGIC
+   */
+  uint32_t magic;
+
+  /**
+   * @brief IMAGE_VERSION
+   */
+  uint16_t version;
+
+  /**
+   * @brief size of the header in bytes. the application data starts right after
+   */
+  uint16_t header_size;
+
+  /**
+   * @brief combination of IMAGE_FLAG_*
+   */
+  uint32_t flags;
+
+  /**
+   * @brief size of the application after decoding, in bytes
+   */
+  uint32_t app_size;
+
+  /**
+   * @brief size of the application data in the image, in bytes
+   */
+  uint32_t data_size;
+
+  /**
+   * @brief log2 of the window size of compressed data. 0 if not compressed
+   */
+  uint8_t window_bits;
+
+  /**
+   * @brief reserved, 0
+   */
+  uint8_t reserved[3];
+} image_header_t;
+
+/**
+ * @brief header of delta images, following the image header.
+ * hashes are calculated the way the bootloader calculates the update metadata hash
+ */
+typedef struct image_delta_header
+{
+  /**
+   * @brief size of the installed application the delta applies to, in bytes
+   */
+  uint32_t source_size;
+
+  /**
+   * @brief size of the delta data, in bytes. if the delta data is compressed, this is the size after decompression
+   */
+  uint32_t delta_size;
+
+  /**
+   * @brief type of the hashes, IMAGE_HASH_*
+   */
+  uint8_t hash_type;
+
+  /**
+   * @brief reserved, 0
+   */
+  uint8_t reserved[3];
+
+  /**
+   * @brief hash of the installed application the delta applies to. CRC32 uses the first 4 bytes
+   */
+  uint8_t source_hash[32];
+
+  /**
+   * @brief hash of the application after applying the delta. CRC32 uses the first 4 bytes
+   */
+  uint8_t target_hash[32];
+} image_delta_header_t;
+
+/**
+ * @brief segment table of sparse images, following the delta header. followed by segment_count image_segment_t
+ */
+typedef struct image_sparse_header
+{
+  /**
+   * @brief number of segments, 1 to IMAGE_MAX_SEGMENTS
+   */
+  uint16_t segment_count;
+
+  /**
+   * @brief reserved, 0
+   */
+  uint8_t reserved[2];
+} image_sparse_header_t;
+
+/**
+ * @brief a segment of a sparse image
+ */
+typedef struct image_segment
+{
+  /**
+   * @brief offset of the segment in the application, in bytes
+   */
+  uint32_t offset;
+
+  /**
+   * @brief size of the segment, in bytes. not 0
+   */
+  uint32_t length;
+} image_segment_t;
+
+/**
+ * @brief header of encrypted images, following the segment table
+ */
+typedef struct image_encryption_header
+{
+  /**
+   * @brief first 12 bytes of the counter blocks. must not be used for two images with the same key
+   */
+  uint8_t nonce[12];
+
+  /**
+   * @brief first 4 bytes of the AES-128 encryption of 16 zero bytes with the key, to tell a wrong key
+   */
+  uint8_t key_check[4];
+} image_encryption_header_t;
+
+/**
+ * @brief signature of the application, following the encryption header
+ */
+typedef struct image_signature
+{
+  /**
+   * @brief r of the ECDSA signature, big endian
+   */
+  uint8_t r[32];
+
+  /**
+   * @brief s of the ECDSA signature, big endian
+   */
+  uint8_t s[32];
+} image_signature_t;
+
+/**
+ * @brief manifest describing the application, following the signature.
+ * followed by sector_count CRC32s (uint32_t) of the application padded to whole words, IMAGE_SECTOR_SIZE bytes each
+ */
+typedef struct image_manifest
+{
+  /**
+   * @brief address the application is built for, the APP_BASE_ADDRESS of the bootloader
+   */
+  uint32_t load_address;
+
+  /**
+   * @brief number of sector CRC32s following the manifest, (app_size + IMAGE_SECTOR_SIZE - 1) / IMAGE_SECTOR_SIZE
+   */
+  uint16_t sector_count;
+
+  /**
+   * @brief type of app_hash, IMAGE_HASH_*
+   */
+  uint8_t hash_type;
+
+  /**
+   * @brief reserved, 0
+   */
+  uint8_t reserved;
+
+  /**
+   * @brief hash of the application. CRC32 uses the first 4 bytes
+   */
+  uint8_t app_hash[32];
+} image_manifest_t;
+
+#ifdef __cplusplus
+  static_assert(sizeof(image_header_t) == 24, "image_header_t ABI changed");
+  static_assert(sizeof(image_delta_header_t) == 76, "image_delta_header_t ABI changed");
+  static_assert(sizeof(image_manifest_t) == 40, "image_manifest_t ABI changed");
+  static_assert(sizeof(image_sparse_header_t) == 4, "image_sparse_header_t ABI changed");
+  static_assert(sizeof(image_segment_t) == 8, "image_segment_t ABI changed");
+  static_assert(sizeof(image_encryption_header_t) == 16, "image_encryption_header_t ABI changed");
+  static_assert(sizeof(image_signature_t) == 64, "image_signature_t ABI changed");
+#endif
@@ -0,0 +1,142 @@
+#include "integrity.h"
+
+#if STORE_UPDATE_METADATA == 1 && METADATA_HASH != HASH_NONE
+#include <hc32_ddl.h>
+#include <string.h>
+#include "flash.h"
+#include "hash.h"
+#include "log.h"
+#include "profiler.h"
+#include "trace.h"
+#include "../util.h"
+
+namespace integrity
+{
+  bool matches(const uint32_t app_base_address, const flash::update_metadata &metadata)
+  {
+    PROFILE_SCOPE(verify);
+
+    // the hash doesn't depend on how the data is split, so the application is pushed at once
+    const uint8_t *app = flash::at<uint8_t>(app_base_address);
+    bool ok = hash::start() && hash::push_data(app, metadata.app_size);
+
+    hash::hash_t hash;
+    ok = ok && hash::get_hash(hash);
+
+    profiler::add_bytes(profiler::stage::verify, metadata.app_size);
+    return ok && memcmp(&hash, &metadata.hash, sizeof(hash::hash_t)) == 0;
+  }
+} // namespace integrity
+
+#if APP_INTEGRITY_CHECK != APP_INTEGRITY_CHECK_OFF
+namespace integrity
+{
+  /**
+   * @brief results of the check, as recorded in the boot trace
+   */
+  enum result : uint8_t
+  {
+    mismatch = 0,
+    passed = 1,
+    verified_before = 2,
+    no_metadata = 3,
+  };
+
+  /**
+   * @brief get the address of the verified marker of an application
+   */
+  uint32_t get_marker_address(const uint32_t app_base_address)
+  {
+    return flash::update_metadata::get_marker_address(flash::get_app_area_end(app_base_address) - 1);
+  }
+
+  #if APP_INTEGRITY_CHECK == APP_INTEGRITY_CHECK_ONCE
+    /**
+     * @brief value of the marker once the application was verified, "OHBV"
+     */
+    constexpr uint32_t verified_marker = 0x5642484Ful;
+
+    /**
+     * @brief was the application verified since the last update?
+     */
+    bool is_marked_verified(const uint32_t app_base_address)
+    {
+      return *flash::at<uint32_t>(get_marker_address(app_base_address)) == verified_marker;
+    }
+
+    /**
+     * @brief mark the application as verified, until the next update erases the marker
+     */
+    void mark_verified(const uint32_t app_base_address)
+    {
+      // the marker can only be programmed while it is erased
+      const uint32_t address = get_marker_address(app_base_address);
+      if (*flash::at<uint32_t>(address) != 0xFFFFFFFF)
+      {
+        logging::debug(LOG_STR("verified marker not erased\n"));
+        return;
+      }
+
+      EFM_Unlock();
+      EFM_FlashCmd(Enable);
+      while (EFM_GetFlagStatus(EFM_FLAG_RDY) != Set) { /* nada */ }
+
+      const en_result_t rc = EFM_SingleProgramRB(address, verified_marker);
+      EFM_Lock();
+
+      if (rc != Ok)
+      {
+        // not fatal, the application is checked again on the next boot
+        trace::record(BOOT_TRACE_EVENT_FLASH_ERROR, rc, address, verified_marker);
+        logging::debug(LOG_STR("marking verified failed\n"));
+      }
+    }
+  #endif
+
+  bool check(const uint32_t app_base_address)
+  {
+    const flash::update_metadata *metadata = flash::update_metadata::get_stored(app_base_address);
+
+    // without metadata (e.g. if the application was flashed using a debugger), there is nothing to check against.
+    // with signed images, the metadata is only written once the signed hash matches the written application,
+    // so an application without it was not installed by a complete update and is not booted
+    if (metadata->app_size == 0 || metadata->app_size > (get_marker_address(app_base_address) - app_base_address))
+    {
+      trace::record(BOOT_TRACE_EVENT_INTEGRITY, result::no_metadata);
+      #if ENABLE_SIGNED_IMAGES == 1
+        logging::error("no metadata, app not verified\n");
+        return false;
+      #else
+        logging::debug(LOG_STR("no metadata, integrity check skipped\n"));
+        return true;
+      #endif
+    }
+
+    #if APP_INTEGRITY_CHECK == APP_INTEGRITY_CHECK_ONCE
+      if (is_marked_verified(app_base_address))
+      {
+        trace::record(BOOT_TRACE_EVENT_INTEGRITY, result::verified_before, metadata->app_size);
+        logging::debug(LOG_STR("app verified before\n"));
+        return true;
+      }
+    #endif
+
+    if (!matches(app_base_address, *metadata))
+    {
+      trace::record(BOOT_TRACE_EVENT_INTEGRITY, result::mismatch, metadata->app_size);
+      logging::error("app integrity check failed\n");
+      return false;
+    }
+
+    trace::record(BOOT_TRACE_EVENT_INTEGRITY, result::passed, metadata->app_size);
+    logging::debug(LOG_STR("app verified\n"));
+
+    #if APP_INTEGRITY_CHECK == APP_INTEGRITY_CHECK_ONCE
+      mark_verified(app_base_address);
+    #endif
+    return true;
+  }
+} // namespace integrity
+#endif // APP_INTEGRITY_CHECK != APP_INTEGRITY_CHECK_OFF
+
+#endif // STORE_UPDATE_METADATA == 1 && METADATA_HASH != HASH_NONE
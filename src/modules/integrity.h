@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include "flash_metadata.h"
+#include "../config.h"
+
+namespace integrity
+{
+  #if STORE_UPDATE_METADATA == 1 && METADATA_HASH != HASH_NONE
+    /**
+     * @brief hash the application straight from flash and compare it to the hash in the metadata
+     * @param app_base_address the base address of the application
+     * @param metadata the metadata of the application
+     * @return true if the application matches the hash
+     */
+    bool matches(const uint32_t app_base_address, const flash::update_metadata &metadata);
+  #endif
+
+  #if APP_INTEGRITY_CHECK != APP_INTEGRITY_CHECK_OFF
+    /**
+     * @brief check the whole application against the hash in the stored update metadata
+     * @param app_base_address the base address of the application
+     * @return true if the application matches the stored hash, was verified before, or there is no stored metadata.
+     * with ENABLE_SIGNED_IMAGES, an application without stored metadata fails the check
+     * @note with APP_INTEGRITY_CHECK_ONCE, a passed check is remembered in flash until the next update
+     */
+    bool check(const uint32_t app_base_address);
+  #else
+    inline bool check(const uint32_t app_base_address) { return true; }
+  #endif
+} // namespace integrity
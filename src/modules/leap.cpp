@@ -4,6 +4,8 @@
 #include "../config.h"
 #include "log.h"
 #include "flash.h"
+#include "integrity.h"
+#include "profiler.h"
 
 namespace leap
 {
@@ -24,13 +26,20 @@ namespace leap
         }
 
         /**
-         * @brief check if a address is in the area between APP_BASE_ADDRESS and the end of flash
+         * @brief flash area of the application being checked, set by pre_check()
+         */
+        uint32_t app_area_start = APP_BASE_ADDRESS;
+        uint32_t app_area_end = 0;
+
+        /**
+         * @brief check if a address is in the flash area of the application being checked
          * @param address the address to check
          * @return true if the address is in the application area
+         * @note with ENABLE_AB_SLOTS, this is the slot of the application
          */
         bool is_in_app_area(const uint32_t address)
         {
-          return address >= APP_BASE_ADDRESS && address < flash::get_flash_size();
+          return address >= app_area_start && address < app_area_end;
         }
 
         /**
@@ -158,8 +167,12 @@ namespace leap
 
   bool pre_check(const uint32_t app_base_address)
   {
+    PROFILE_SCOPE(pre_check);
+
     #if IS_PRE_CHECK_LEVEL(PRE_CHECK_MINIMAL)    
-      const vector_table_t *app_vector_table = reinterpret_cast<vector_table_t *>(app_base_address);
+      const vector_table_t *app_vector_table = flash::at<vector_table_t>(app_base_address);
+      checks::impl::helper::app_area_start = app_base_address;
+      checks::impl::helper::app_area_end = flash::get_app_area_end(app_base_address);
 
       // run all pre-checks
       int i = 0;
@@ -167,9 +180,10 @@ namespace leap
       {
         if (!check(app_vector_table))
         {
-          logging::debug("pre-check #");
+          trace::record(BOOT_TRACE_EVENT_PRE_CHECK_FAIL, i);
+          logging::debug(LOG_STR("pre-check #"));
           logging::debug(i, 10);
-          logging::debug(" failed\n");
+          logging::debug(LOG_STR(" failed\n"));
           return false;
         }
 
@@ -177,13 +191,19 @@ namespace leap
       }
     #endif
 
+    // check the whole application last, as it takes the longest
+    if (!integrity::check(app_base_address))
+    {
+      return false;
+    }
+
     // all checks passed
     return true;
   }
 
   void jump(const uint32_t app_base_address)
   {
-    const vector_table_t *app_vector_table = reinterpret_cast<vector_table_t *>(app_base_address);
+    const vector_table_t *app_vector_table = flash::at<vector_table_t>(app_base_address);
 
     // update stack pointer and VTOR
     __disable_irq();
@@ -193,6 +213,11 @@ namespace leap
     __enable_irq();
 
     // jump to the application
-    app_vector_table->reset();
+    #ifdef NATIVE_BUILD
+      // the application can't run on the host, so the simulation ends here
+      native_jump(app_base_address);
+    #else
+      app_vector_table->reset();
+    #endif
   }
 } // namespace leap
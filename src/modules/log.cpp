@@ -1,16 +1,20 @@
 #include "log.h"
 #include <stdint.h>
 #include <algorithm>
+#include <string.h>
 #include "serial.h"
 #include "screen.h"
+#include "../util.h"
 
-extern "C" int printf(const char *format, ...)
-{
-  logging::log("[");
-  logging::log(format);
-  logging::log("]\n");
-  return 0;
-}
+#ifndef NATIVE_BUILD
+  extern "C" int printf(const char *format, ...)
+  {
+    logging::log("[");
+    logging::log(format);
+    logging::log("]\n");
+    return 0;
+  }
+#endif
 
 namespace logging
 {
@@ -61,13 +65,247 @@ namespace logging
       str[i] = '\0';
       return i;
     }
+
+    int format_fixed_3(char *str, const uint32_t thousandths)
+    {
+      int i = format_number(str, thousandths / 1000, 10);
+      str[i++] = '.';
+
+      const uint32_t fraction = thousandths % 1000;
+      str[i++] = '0' + (fraction / 100);
+      str[i++] = '0' + ((fraction / 10) % 10);
+      str[i++] = '0' + (fraction % 10);
+
+      str[i] = '\0';
+      return i;
+    }
   }
 
-  void log(const char *message, const bool to_screen)
+  #if LOG_ASYNC == 1
+    /**
+     * @brief buffered host serial output, drained by the TX empty interrupt of the host serial
+     */
+    namespace async
+    {
+      /**
+       * @brief interrupt used for the host serial TX empty event.
+       * IRQ000 is free, since the bootloader uses no other interrupts
+       */
+      constexpr IRQn_Type irq = Int000_IRQn;
+      constexpr en_int_src_t irq_source = CONCAT(CONCAT(INT_USART, HOST_SERIAL), _TI);
+
+      /**
+       * @brief reset value of the interrupt source selection, no source selected
+       */
+      constexpr uint32_t no_irq_source = 0x1FFul;
+
+      constexpr uint16_t mask = LOG_BUFFER_SIZE - 1;
+
+      /**
+       * @brief ring buffer of pending output. one slot is kept free to tell a full buffer from an empty one
+       */
+      char buffer[LOG_BUFFER_SIZE];
+
+      /**
+       * @brief write position, only modified by the producer
+       */
+      volatile uint16_t head = 0;
+
+      /**
+       * @brief read position, only modified by the consumer
+       */
+      volatile uint16_t tail = 0;
+
+      /**
+       * @brief number of messages dropped because the buffer was full
+       */
+      uint32_t dropped = 0;
+
+      inline uint16_t get_free()
+      {
+        return mask - ((head - tail) & mask);
+      }
+
+      /**
+       * @brief can the TX empty interrupt preempt the current context?
+       * not the case in exception handlers, such as the hard fault handler, or with interrupts disabled
+       */
+      inline bool can_interrupt_run()
+      {
+        return __get_IPSR() == 0 && __get_PRIMASK() == 0;
+      }
+
+      /**
+       * @brief send the next buffered byte, if the host serial is ready for it
+       * @return false if the buffer is empty
+       */
+      bool send_next()
+      {
+        if (tail == head)
+        {
+          return false;
+        }
+
+        if (hostSerial.try_put(buffer[tail]))
+        {
+          tail = (tail + 1) & mask;
+        }
+        return true;
+      }
+
+      /**
+       * @brief wait until there is space for at least one more byte in the buffer
+       */
+      void wait_for_space()
+      {
+        while (get_free() == 0)
+        {
+          if (can_interrupt_run())
+          {
+            hostSerial.set_tx_empty_interrupt(true);
+          }
+          else
+          {
+            send_next();
+          }
+        }
+      }
+
+      /**
+       * @brief should a message of the given level be dropped if it doesn't fit the buffer?
+       */
+      constexpr bool is_droppable(const int level, const int overflow)
+      {
+        return overflow == LOG_OVERFLOW_DROP 
+            || (overflow == LOG_OVERFLOW_DROP_DEBUG && level == LOG_LEVEL_DEBUG);
+      }
+
+      void write(const uint8_t *data, const uint16_t length, const int level, const int overflow)
+      {
+        // messages are dropped as a whole, as partial messages would garble the log
+        if (is_droppable(level, overflow) && length > get_free())
+        {
+          dropped++;
+          return;
+        }
+
+        for (uint16_t i = 0; i < length; i++)
+        {
+          wait_for_space();
+          buffer[head] = data[i];
+          head = (head + 1) & mask;
+        }
+
+        hostSerial.set_tx_empty_interrupt(true);
+      }
+    } // namespace async
+
+    void init()
+    {
+      // route the host serial TX empty event to the interrupt
+      M4_INTC->SEL0 = async::irq_source;
+      NVIC_SetPriority(async::irq, DDL_IRQ_PRIORITY_DEFAULT);
+      NVIC_ClearPendingIRQ(async::irq);
+      NVIC_EnableIRQ(async::irq);
+    }
+
+    void flush()
+    {
+      // stop the interrupt from competing for the buffer, then send the rest by polling
+      hostSerial.set_tx_empty_interrupt(false);
+      while (async::send_next()) { /* nada */ }
+      hostSerial.flush();
+
+      // report dropped messages once the buffer is empty
+      if (async::dropped != 0)
+      {
+        char buffer[11]; // maximum length of a 32 bit number in base 10 + null terminator
+        formatters::format_number(buffer, async::dropped, 10);
+        async::dropped = 0;
+
+        hostSerial.write(buffer);
+        hostSerial.write(" log messages dropped\n");
+        hostSerial.flush();
+      }
+    }
+
+    void deinit()
+    {
+      flush();
+
+      // release the interrupt, so the application doesn't get a stray interrupt
+      NVIC_DisableIRQ(async::irq);
+      NVIC_ClearPendingIRQ(async::irq);
+      M4_INTC->SEL0 = async::no_irq_source;
+    }
+  #else
+    void init() {}
+
+    void flush()
+    {
+      #if HAS_SERIAL(HOST_SERIAL)
+        hostSerial.flush();
+      #endif
+    }
+
+    void deinit()
+    {
+      flush();
+    }
+  #endif
+
+  /**
+   * @brief write raw bytes to the host serial
+   * @param data the data to write
+   * @param length the number of bytes to write
+   * @param level the log level of the data
+   */
+  void write_host(const uint8_t *data, const uint16_t length, const int level)
   {
-    #if HAS_SERIAL(HOST_SERIAL)
-      hostSerial.write(message);
+    #if LOG_ASYNC == 1
+      async::write(data, length, level);
+    #elif HAS_SERIAL(HOST_SERIAL)
+      for (uint16_t i = 0; i < length; i++)
+      {
+        hostSerial.put(data[i]);
+      }
     #endif
+  }
+
+  #if LOG_TOKENIZED == 1
+    /**
+     * @brief write a number as a LEB128 varint
+     * @param out the buffer to write to, must hold at least 5 bytes
+     * @param number the number to write
+     * @return the number of bytes written
+     */
+    uint8_t write_varint(uint8_t *out, uint32_t number)
+    {
+      uint8_t i = 0;
+      while (number >= 0x80)
+      {
+        out[i++] = static_cast<uint8_t>(number | 0x80);
+        number >>= 7;
+      }
+
+      out[i++] = static_cast<uint8_t>(number);
+      return i;
+    }
+
+    void log(const token token, const int level)
+    {
+      const uint8_t data[] = {
+        tokens::marker::token,
+        static_cast<uint8_t>(token.id & 0xFF),
+        static_cast<uint8_t>((token.id >> 8) & 0xFF),
+      };
+      write_host(data, sizeof(data), level);
+    }
+  #endif
+
+  void log(const char *message, const bool to_screen, const int level)
+  {
+    write_host(reinterpret_cast<const uint8_t *>(message), strlen(message), level);
 
     if (to_screen)
     {
@@ -76,10 +314,37 @@ namespace logging
     }
   }
 
-  void log(uint32_t number, const int base, const bool to_screen)
+  void log(uint32_t number, const int base, const bool to_screen, const int level)
   {
+    #if LOG_TOKENIZED == 1
+      // debug numbers are sent as varint, the decoder formats them
+      if (level == LOG_LEVEL_DEBUG)
+      {
+        uint8_t data[2 + 5]; // marker + base + up to 5 bytes of varint
+        data[0] = tokens::marker::number;
+        data[1] = static_cast<uint8_t>(base);
+        const uint8_t length = 2 + write_varint(data + 2, number);
+        write_host(data, length, level);
+        return;
+      }
+    #endif
+
     char buffer[32 + 1]; // maximum length of a 32 bit number in binary + null terminator
     formatters::format_number(buffer, number, base);
-    log(buffer, to_screen);
+    log(buffer, to_screen, level);
   }
 }
+
+#if LOG_ASYNC == 1
+  /**
+   * @brief host serial TX empty interrupt, sends the next buffered byte
+   */
+  extern "C" void IRQ000_Handler(void)
+  {
+    if (!logging::async::send_next())
+    {
+      // nothing left to send, stop until the next write
+      hostSerial.set_tx_empty_interrupt(false);
+    }
+  }
+#endif
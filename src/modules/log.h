@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <type_traits>
 #include "../config.h"
 
 namespace logging
@@ -16,27 +17,129 @@ namespace logging
      *       this is [33, 11, 9] for base [2, 10, 16] respectively
      */
     int format_number(char *str, uint32_t number, const int base);
+
+    /**
+     * @brief format a number with 3 decimal places
+     * @param str the buffer to write the formatted number to, at least 15 characters
+     * @param thousandths the number, in thousandths
+     * @return the number of characters written, excluding the null terminator
+     */
+    int format_fixed_3(char *str, const uint32_t thousandths);
   } // namespace formatters
 
+  #if LOG_TOKENIZED == 1
+    namespace tokens
+    {
+      /**
+       * @brief marker bytes introducing binary records in the host serial output.
+       * text output never contains these control characters
+       */
+      namespace marker
+      {
+        /**
+         * @brief followed by the token, 16 bit little endian
+         */
+        constexpr uint8_t token = 0x01;
+
+        /**
+         * @brief followed by the base and the number as LEB128 varint
+         */
+        constexpr uint8_t number = 0x02;
+      } // namespace marker
+
+      /**
+       * @brief calculate the token of a string, as a 32 bit FNV-1a hash xor-folded to 16 bits
+       * @param str the string to hash
+       * @param hash the hash so far
+       * @return the token
+       * @note must match the hash used by scripts/log_tokens.py
+       */
+      constexpr uint16_t hash(const char *str, const uint32_t hash = 2166136261ul)
+      {
+        return *str == '\0' 
+          ? static_cast<uint16_t>((hash >> 16) ^ (hash & 0xFFFF))
+          : tokens::hash(str + 1, static_cast<uint32_t>((hash ^ static_cast<uint8_t>(*str)) * 16777619ul));
+      }
+    } // namespace tokens
+
+    /**
+     * @brief a tokenized log string
+     */
+    struct token
+    {
+      uint16_t id;
+    };
+
+    /**
+     * @brief log a tokenized string to the host serial
+     * @param token the token to log
+     * @param level the log level of the token
+     */
+    void log(const token token, const int level);
+
+    /**
+     * @brief tokenize a debug log string at compile time, so the string isn't included in the binary.
+     * the dictionary to decode the tokens is created by scripts/log_tokens.py
+     */
+    #define LOG_STR(str) (logging::token{std::integral_constant<uint16_t, logging::tokens::hash(str)>::value})
+  #else
+    #define LOG_STR(str) (str)
+  #endif
+
+  #if LOG_ASYNC == 1
+    namespace async
+    {
+      /**
+       * @brief add a message to the buffered host serial output
+       * @param data the message
+       * @param length the length of the message
+       * @param level the log level of the message
+       * @param overflow what to do if the message doesn't fit the buffer, one of LOG_OVERFLOW_*
+       * @note messages are dropped as a whole. the number dropped is reported by the next flush()
+       */
+      void write(const uint8_t *data, const uint16_t length, const int level, const int overflow = LOG_OVERFLOW);
+    } // namespace async
+  #endif
+
+  /**
+   * @brief initialize logging
+   * @note call after the host serial was initialized
+   */
+  void init();
+
+  /**
+   * @brief wait until all buffered log output was sent
+   * @note safe to call from the fault handler, buffered output is sent by polling
+   */
+  void flush();
+
+  /**
+   * @brief flush the log output and release the resources used for logging
+   * @note call before the host serial is deinitialized
+   */
+  void deinit();
+
   /**
    * @brief log a message
    * @param message the message to log
    * @param to_screen whether or not to log to the screen as well
+   * @param level the log level of the message. with LOG_OVERFLOW_DROP_DEBUG, only debug messages are dropped
    */
-  void log(const char *message, const bool to_screen = true);
+  void log(const char *message, const bool to_screen = true, const int level = LOG_LEVEL_INFO);
 
   /**
    * @brief log a number
    * @param number the number to log
    * @param base the base of the number
    * @param to_screen whether or not to log to the screen as well
+   * @param level the log level of the number
    */
-  void log(uint32_t number, const int base, const bool to_screen = true);
+  void log(uint32_t number, const int base, const bool to_screen = true, const int level = LOG_LEVEL_INFO);
 
 
-  #define _DEF_LOG_IMPL(name, to_screen)                                                    \
-    inline void name(const char *message) { log(message, to_screen); }                      \
-    inline void name(uint32_t number, const int base) { log(number, base, to_screen); }
+  #define _DEF_LOG_IMPL(name, to_screen, level)                                             \
+    inline void name(const char *message) { log(message, to_screen, level); }               \
+    inline void name(uint32_t number, const int base) { log(number, base, to_screen, level); }
 
   #define _DEF_LOG_DUMMY(name)                                                              \
     inline void name(const char *message) { }                                               \
@@ -44,19 +147,25 @@ namespace logging
 
 
   #if IS_LOG_LEVEL(LOG_LEVEL_DEBUG)
-    _DEF_LOG_IMPL(debug, false)
+    _DEF_LOG_IMPL(debug, false, LOG_LEVEL_DEBUG)
+    #if LOG_TOKENIZED == 1
+      inline void debug(const token token) { log(token, LOG_LEVEL_DEBUG); }
+    #endif
   #else
     _DEF_LOG_DUMMY(debug)
+    #if LOG_TOKENIZED == 1
+      inline void debug(const token token) { }
+    #endif
   #endif
 
   #if IS_LOG_LEVEL(LOG_LEVEL_INFO)
-    _DEF_LOG_IMPL(info, true)
+    _DEF_LOG_IMPL(info, true, LOG_LEVEL_INFO)
   #else
     _DEF_LOG_DUMMY(info)
   #endif
 
   #if IS_LOG_LEVEL(LOG_LEVEL_ERROR)
-    _DEF_LOG_IMPL(error, true)
+    _DEF_LOG_IMPL(error, true, LOG_LEVEL_ERROR)
   #else
     _DEF_LOG_DUMMY(error)
   #endif
@@ -0,0 +1,192 @@
+#include "profiler.h"
+
+#if ENABLE_PROFILER == 1
+#include <hc32_ddl.h>
+#include <string.h>
+#include "log.h"
+
+namespace profiler
+{
+  /**
+   * @brief names of the stages, as printed in the summary
+   */
+  const char *const stage_names[] = {
+    "screen",
+    "mount",
+    "hash",
+    "erase",
+    "write",
+    "precheck",
+    "verify",
+    "receive",
+    "ecdsa",
+  };
+  static_assert(countof(stage_names) == static_cast<int>(stage::count), "stage_names must match profiler::stage");
+
+  struct stage_stats
+  {
+    /**
+     * @brief DWT cycle count when the stage was last started
+     */
+    uint32_t start_cycles;
+
+    /**
+     * @brief total cycles spent in the stage
+     */
+    uint64_t cycles;
+
+    /**
+     * @brief total time spent in the stage, in microseconds
+     */
+    uint32_t us;
+
+    /**
+     * @brief total bytes processed in the stage
+     */
+    uint32_t bytes;
+  };
+
+  stage_stats stages[static_cast<int>(stage::count)];
+
+  /**
+   * @brief total cycles and time since init().
+   * accumulated on every begin() and end(), so the total only wraps if there is
+   * no stage boundary for a full CYCCNT period (~21 s at 200 MHz)
+   */
+  stage_stats total;
+
+  stage_stats &get(const stage stage)
+  {
+    return stages[static_cast<int>(stage)];
+  }
+
+  /**
+   * @brief add the cycles elapsed since start_cycles to a stats entry
+   * @param stats the entry to update
+   * @param now the current cycle count
+   */
+  void accumulate(stage_stats &stats, const uint32_t now)
+  {
+    const uint32_t elapsed = now - stats.start_cycles;
+    stats.cycles += elapsed;
+    stats.us += elapsed / (SystemCoreClock / 1000000ul);
+    stats.start_cycles = now;
+  }
+
+  void init()
+  {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    memset(stages, 0, sizeof(stages));
+    memset(&total, 0, sizeof(total));
+    total.start_cycles = DWT->CYCCNT;
+  }
+
+  void begin(const stage stage)
+  {
+    trace::record(BOOT_TRACE_EVENT_STAGE_ENTER, static_cast<uint8_t>(stage));
+
+    const uint32_t now = DWT->CYCCNT;
+    accumulate(total, now);
+    get(stage).start_cycles = now;
+  }
+
+  void end(const stage stage)
+  {
+    const uint32_t now = DWT->CYCCNT;
+    accumulate(total, now);
+    accumulate(get(stage), now);
+
+    trace::record(BOOT_TRACE_EVENT_STAGE_EXIT, static_cast<uint8_t>(stage));
+  }
+
+  void add_bytes(const stage stage, const uint32_t bytes)
+  {
+    get(stage).bytes += bytes;
+  }
+
+  namespace format
+  {
+    /**
+     * @brief append a column to a line, right-aligned
+     * @param line the line to append to
+     * @param value the column value
+     * @param width the column width
+     */
+    void column(char *line, const char *value, const size_t width)
+    {
+      char *end = line + strlen(line);
+      for (size_t len = strlen(value); len < width; len++)
+      {
+        *end++ = ' ';
+      }
+      strcpy(end, value);
+    }
+
+    /**
+     * @brief print a summary line
+     * @param name name of the stage
+     * @param stats the stage stats
+     */
+    void print_line(const char *name, const stage_stats &stats)
+    {
+      char line[128] = "profile: ";
+      char value[16];
+
+      column(line, name, 8);
+
+      if (stats.cycles <= UINT32_MAX)
+      {
+        logging::formatters::format_number(value, static_cast<uint32_t>(stats.cycles), 10);
+        column(line, value, 12);
+      }
+      else
+      {
+        column(line, "-", 12);
+      }
+
+      logging::formatters::format_fixed_3(value, stats.us);
+      column(line, value, 12);
+
+      logging::formatters::format_number(value, stats.bytes, 10);
+      column(line, value, 10);
+
+      // bytes per microsecond equals MB/s
+      if (stats.bytes != 0 && stats.us != 0)
+      {
+        logging::formatters::format_fixed_3(value, static_cast<uint32_t>((static_cast<uint64_t>(stats.bytes) * 1000ull) / stats.us));
+        column(line, value, 10);
+      }
+      else
+      {
+        column(line, "-", 10);
+      }
+
+      strcat(line, "\n");
+      logging::log(line, /*to_screen*/ false);
+    }
+  } // namespace format
+
+  void print()
+  {
+    accumulate(total, DWT->CYCCNT);
+
+    char header[128] = "profile: ";
+    format::column(header, "stage", 8);
+    format::column(header, "cycles", 12);
+    format::column(header, "ms", 12);
+    format::column(header, "bytes", 10);
+    format::column(header, "MB/s", 10);
+    strcat(header, "\n");
+    logging::log(header, /*to_screen*/ false);
+
+    for (int i = 0; i < static_cast<int>(stage::count); i++)
+    {
+      format::print_line(stage_names[i], stages[i]);
+    }
+    format::print_line("total", total);
+  }
+} // namespace profiler
+
+#endif // ENABLE_PROFILER == 1
@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+#include "../config.h"
+#include "../util.h"
+#include "trace.h"
+
+namespace profiler
+{
+  /**
+   * @brief boot stages that can be profiled.
+   * stage boundaries are also recorded in the boot trace
+   * @note names are defined in profiler.cpp, keep in sync
+   */
+  enum class stage : uint8_t
+  {
+    screen_init = BOOT_TRACE_STAGE_SCREEN_INIT,
+    mount = BOOT_TRACE_STAGE_MOUNT,
+    hash = BOOT_TRACE_STAGE_HASH,
+    erase = BOOT_TRACE_STAGE_ERASE,
+    write = BOOT_TRACE_STAGE_WRITE,
+    pre_check = BOOT_TRACE_STAGE_PRE_CHECK,
+    verify = BOOT_TRACE_STAGE_VERIFY,
+    receive = BOOT_TRACE_STAGE_RECEIVE,
+    signature = BOOT_TRACE_STAGE_SIGNATURE,
+
+    count
+  };
+
+  #if ENABLE_PROFILER == 1
+    /**
+     * @brief initialize the profiler, enabling the DWT cycle counter
+     * @note call after the system clock is configured. time spent before is not included in the total
+     */
+    void init();
+
+    /**
+     * @brief start timing a stage
+     * @param stage the stage to time
+     */
+    void begin(const stage stage);
+
+    /**
+     * @brief stop timing a stage, adding the elapsed time to the stage
+     * @param stage the stage to stop timing
+     */
+    void end(const stage stage);
+
+    /**
+     * @brief add to the number of bytes processed in a stage
+     * @param stage the stage that processed the bytes
+     * @param bytes the number of bytes processed
+     */
+    void add_bytes(const stage stage, const uint32_t bytes);
+
+    /**
+     * @brief print the per-stage timing summary to the host serial.
+     * format: lines prefixed with "profile: ", parsed by scripts/profile_to_csv.py
+     */
+    void print();
+  #else
+    inline void init() {}
+    inline void begin(const stage stage) { trace::record(BOOT_TRACE_EVENT_STAGE_ENTER, static_cast<uint8_t>(stage)); }
+    inline void end(const stage stage) { trace::record(BOOT_TRACE_EVENT_STAGE_EXIT, static_cast<uint8_t>(stage)); }
+    inline void add_bytes(const stage stage, const uint32_t bytes) {}
+    inline void print() {}
+  #endif
+
+  /**
+   * @brief times a stage for the lifetime of the scope
+   */
+  class scope
+  {
+  public:
+    scope(const profiler::stage stage) : stage(stage)
+    {
+      begin(stage);
+    }
+
+    ~scope()
+    {
+      end(stage);
+    }
+
+  private:
+    const profiler::stage stage;
+  };
+
+  /**
+   * @brief time a stage until the end of the current scope.
+   * compiles to nothing if both the profiler and the boot trace are disabled
+   * @param name name of the stage, one of profiler::stage
+   */
+  #define PROFILE_SCOPE(name) const profiler::scope CONCAT(profile_scope_, __LINE__)(profiler::stage::name)
+} // namespace profiler
@@ -0,0 +1,47 @@
+#include "scheduler.h"
+#include "assert.h"
+#include <hc32_ddl.h>
+
+namespace scheduler
+{
+  bool run(task *const *tasks, const size_t count)
+  {
+    ASSERT(count <= 32, "too many tasks");
+
+    // bit i is set while task i is not done
+    uint32_t active = count == 32 ? 0xFFFFFFFFul : ((1ul << count) - 1);
+    while (active != 0)
+    {
+      bool did_work = false;
+      for (size_t i = 0; i < count; i++)
+      {
+        if ((active & (1ul << i)) == 0)
+        {
+          continue;
+        }
+
+        switch (tasks[i]->step())
+        {
+        case state::running:
+          did_work = true;
+          break;
+        case state::waiting:
+          break;
+        case state::done:
+          active &= ~(1ul << i);
+          did_work = true;
+          break;
+        case state::failed:
+          return false;
+        }
+      }
+
+      if (!did_work)
+      {
+        __NOP();
+      }
+    }
+
+    return true;
+  }
+} // namespace scheduler
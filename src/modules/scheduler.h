@@ -0,0 +1,102 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace scheduler
+{
+  /**
+   * @brief result of a task step
+   */
+  enum class state : uint8_t
+  {
+    /**
+     * @brief the task did some work and wants to continue
+     */
+    running,
+
+    /**
+     * @brief the task waits for a condition and did no work
+     */
+    waiting,
+
+    /**
+     * @brief the task is finished
+     */
+    done,
+
+    /**
+     * @brief the task failed, stopping all other tasks
+     */
+    failed,
+  };
+
+  /**
+   * @brief a cooperative, stackless task.
+   * step() is called repeatedly, doing a bit of work each time and returning before it would have to wait.
+   * use the TASK_* macros to write step() as sequential code.
+   * local variables do not survive a yield or wait, keep state in members instead
+   */
+  class task
+  {
+  public:
+    /**
+     * @brief run the task until it yields, waits or ends
+     */
+    virtual state step() = 0;
+
+  protected:
+    /**
+     * @brief where step() continues on the next call. managed by the TASK_* macros
+     */
+    uint16_t resume_point = 0;
+  };
+
+  /**
+   * @brief run tasks round-robin until all are done or one fails
+   * @param tasks the tasks to run
+   * @param count the number of tasks. at most 32
+   * @return true if all tasks are done, false if a task failed
+   */
+  bool run(task *const *tasks, const size_t count);
+} // namespace scheduler
+
+/**
+ * @brief start the body of task::step()
+ */
+#define TASK_BEGIN()        \
+  switch (resume_point)     \
+  {                         \
+  case 0:
+
+/**
+ * @brief let the other tasks run, continuing here on the next step
+ */
+#define TASK_YIELD()                          \
+  do                                          \
+  {                                           \
+    resume_point = __LINE__;                  \
+    return scheduler::state::running;         \
+  case __LINE__:;                             \
+  } while (0)
+
+/**
+ * @brief let the other tasks run until the condition is true
+ */
+#define TASK_WAIT_UNTIL(condition)            \
+  do                                          \
+  {                                           \
+    resume_point = __LINE__;                  \
+  case __LINE__:                              \
+    if (!(condition))                         \
+    {                                         \
+      return scheduler::state::waiting;       \
+    }                                         \
+  } while (0)
+
+/**
+ * @brief end the body of task::step(). the task is done once it gets here
+ */
+#define TASK_END()                            \
+  }                                           \
+  resume_point = 0;                           \
+  return scheduler::state::done;
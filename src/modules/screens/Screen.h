@@ -26,8 +26,21 @@ public:
 
   /**
    * @brief flush buffered writes to the screen 
+   * @param force flush even if the last flush was very recent. 
+   *              otherwise, implementations may defer the flush to limit the screen update rate
    */
-  virtual void flush() = 0;
+  virtual void flush(const bool force = false) = 0;
+
+  /**
+   * @brief flush writes held back by the rate limit of flush(), once the limit allows it
+   * @note call regularly while waiting, so the last writes before a wait show up without another flush()
+   */
+  virtual void flush_deferred() = 0;
+
+  /**
+   * @brief is the screen ready to accept new output without waiting?
+   */
+  virtual bool is_ready() = 0;
 
   /**
    * @brief show progress bar on the screen
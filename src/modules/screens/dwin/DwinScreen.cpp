@@ -1,4 +1,5 @@
 #include "DwinScreen.h"
+#include "../../timebase.h"
 #include "../../../util.h"
 
 #ifndef SCREEN_ORIENTATION
@@ -22,90 +23,225 @@ constexpr dwin::rectangle screen_area = dwin::get_screen_area(orientation);
 constexpr dwin::rectangle text_area = {0, 0, screen_area.width, screen_area.height - progress_bar_height - progress_bar_padding_top};
 constexpr dwin::rectangle progress_bar_area = {0, screen_area.height - progress_bar_height, screen_area.width, progress_bar_height - 1}; // -1 to avoid screen wrap-around
 
-void DwinScreen::init()
+/**
+ * @brief line-buffered model of the text area.
+ * write() only updates the model, flush() brings the screen up to date with as few commands as possible:
+ * new lines are scrolled in with a single move, and only characters not yet on screen are drawn.
+ */
+namespace console
 {
-  dwin::init();
-  dwin::set_orientation(orientation);
-  clear();
-  flush();
-}
+  constexpr uint8_t columns = (text_area.width / font_width) - 1; // -1 to avoid screen wrap-around
+  constexpr uint8_t rows = text_area.height / font_height;
 
-void DwinScreen::clear()
-{
-  dwin::fill_screen(dwin::color::black);
-  cursor_x = 0;
-  cursor_y = 0;
-}
+  /**
+   * @brief minimum time between two flushes, in milliseconds
+   */
+  constexpr uint32_t frame_interval = 50;
 
-void DwinScreen::flush()
-{
-  dwin::redraw();
-}
+  /**
+   * @brief text of each line, as a ring buffer starting at top
+   */
+  char lines[rows][columns + 1];
 
-void DwinScreen::write(const char *str)
-{
-  static char buffer[64];
+  /**
+   * @brief number of characters of each line already drawn on the screen
+   */
+  uint8_t drawn[rows];
+
+  /**
+   * @brief index of the line shown at the top of the text area
+   */
+  uint8_t top;
+
+  /**
+   * @brief cursor position. row is relative to the top of the text area
+   */
+  uint8_t row, column;
 
-  uint16_t new_cursor_x = cursor_x;
-  uint16_t new_cursor_y = cursor_y;
-  for (size_t i = 0; *str != '\0';)
+  /**
+   * @brief number of lines the text area has to be scrolled up on the next flush
+   */
+  uint16_t pending_scroll;
+
+  /**
+   * @brief time of the last flush, as returned by timebase::now()
+   */
+  uint32_t last_flush;
+
+  /**
+   * @brief was a flush skipped to limit the flush rate, leaving changes off the screen?
+   */
+  bool is_deferred;
+
+  /**
+   * @brief get the line index of a row in the text area
+   */
+  inline uint8_t line_of(const uint8_t row)
   {
-    const char c = *str++;
-    bool shouldFlush = false;
+    return (top + row) % rows;
+  }
 
-    // if we encounter a newline or carriage return, move the cursor accordingly
-    // and flush the buffer
+  /**
+   * @brief reset the model to an empty text area
+   */
+  void reset()
+  {
+    for (uint8_t i = 0; i < rows; i++)
+    {
+      lines[i][0] = '\0';
+      drawn[i] = 0;
+    }
+
+    top = 0;
+    row = 0;
+    column = 0;
+    pending_scroll = 0;
+  }
+
+  /**
+   * @brief move the cursor to the start of the next line, scrolling if the text area is full
+   */
+  void new_line()
+  {
+    column = 0;
+    if (row < (rows - 1))
+    {
+      row++;
+      return;
+    }
+
+    // reuse the line scrolled out at the top as the new bottom line
+    top = (top + 1) % rows;
+    pending_scroll++;
+
+    const uint8_t line = line_of(row);
+    lines[line][0] = '\0';
+    drawn[line] = 0;
+  }
+
+  /**
+   * @brief add a character at the cursor, wrapping to the next line if needed
+   */
+  void put(const char c)
+  {
     if (c == '\n')
     {
-      new_cursor_x = 0;
-      new_cursor_y += font_height;
-      shouldFlush = true;
+      new_line();
+      return;
     }
-    else
+
+    if (column >= columns)
     {
-      // otherwise, add the character to the buffer
-      buffer[i++] = c;
-      new_cursor_x += font_width;
+      new_line();
     }
 
-    // if this is the last character in the string, or
-    // if the buffer is full, or
-    // if we should flush the buffer, or
-    // if the cursor X coordinate would leave the screen area,
-    // then draw the string and reset the buffer
-    const bool lastCharacter = *str == '\0';
-    const bool bufferFull = i >= sizeof(buffer) - 1;
-    const bool cursorXOutOfBounds = new_cursor_x >= (text_area.x_end() - font_width);
-    if (shouldFlush || lastCharacter || bufferFull || cursorXOutOfBounds)
+    char *line = lines[line_of(row)];
+    line[column++] = c;
+    line[column] = '\0';
+  }
+
+  /**
+   * @brief was the last flush less than a frame interval ago?
+   */
+  bool is_within_frame_interval()
+  {
+    // without a time base, e.g. once it is stopped for the jump, every flush is drawn
+    return timebase::is_running() && !timebase::has_elapsed(last_flush, frame_interval * 1000);
+  }
+
+  /**
+   * @brief bring the screen up to date with the model
+   * @return true if anything was drawn
+   */
+  bool draw()
+  {
+    bool did_draw = false;
+
+    // scroll in all new lines at once.
+    // if everything visible is new, clearing is cheaper than moving
+    if (pending_scroll >= rows)
+    {
+      dwin::draw_rectangle(dwin::color::black, text_area, /*fill*/ true);
+      did_draw = true;
+    }
+    else if (pending_scroll > 0)
     {
-      buffer[i] = '\0';
-      dwin::draw_string(buffer, cursor_x, cursor_y, font_size, dwin::color::white);
+      dwin::move_screen_area(text_area, dwin::screen_area_shift_dir::up, pending_scroll * font_height);
+      did_draw = true;
+    }
+    pending_scroll = 0;
 
-      // if the cursor X was out of bounds, move to the next line
-      if (cursorXOutOfBounds)
+    // draw only the characters that are not on the screen yet
+    for (uint8_t r = 0; r < rows; r++)
+    {
+      const uint8_t line = line_of(r);
+      const uint8_t length = strlen(lines[line]);
+      if (drawn[line] < length)
       {
-        new_cursor_x = 0;
-        new_cursor_y += font_height;
+        dwin::draw_string(lines[line] + drawn[line], drawn[line] * font_width, r * font_height, font_size, font_color);
+        drawn[line] = length;
+        did_draw = true;
       }
+    }
 
-      // if the cursor Y is out of bounds for the text area, move the entire text area up a line
-      if (new_cursor_y >= text_area.y_end())
-      {
-        dwin::move_screen_area(text_area, dwin::screen_area_shift_dir::up, font_height);
-        new_cursor_y -= font_height;
-      }
+    return did_draw;
+  }
+} // namespace console
 
-      cursor_x = new_cursor_x;
-      cursor_y = new_cursor_y;
-      i = 0;
-    }
+void DwinScreen::init()
+{
+  dwin::init();
+  dwin::set_orientation(orientation);
+  clear();
+  flush(true);
+}
+
+void DwinScreen::clear()
+{
+  dwin::fill_screen(dwin::color::black);
+  console::reset();
+}
+
+void DwinScreen::flush(const bool force)
+{
+  if (!force && console::is_within_frame_interval())
+  {
+    console::is_deferred = true;
+    return;
   }
 
-  dwin::redraw();
+  dwin::begin_batch();
+  if (console::draw() || force)
+  {
+    dwin::redraw();
+  }
+  dwin::end_batch();
+
+  console::last_flush = timebase::now();
+  console::is_deferred = false;
+}
+
+void DwinScreen::flush_deferred()
+{
+  // only when the screen is idle, so waiting for it doesn't delay the caller
+  if (console::is_deferred && !console::is_within_frame_interval() && dwin::is_ready())
+  {
+    flush();
+  }
+}
+
+void DwinScreen::write(const char *str)
+{
+  while (*str != '\0')
+  {
+    console::put(*str++);
+  }
 }
 
 void DwinScreen::showProgress(const uint32_t progress, const uint32_t total, const char* message)
 {
+  dwin::begin_batch();
+
   // draw progress bar background
   dwin::draw_rectangle(progress_bar_background_color, progress_bar_area, /*fill*/ true);
 
@@ -127,4 +263,5 @@ void DwinScreen::showProgress(const uint32_t progress, const uint32_t total, con
   }
 
   dwin::redraw();
+  dwin::end_batch();
 }
@@ -2,6 +2,7 @@
 #include "../../serial.h"
 #include "../../log.h"
 #include "../../delay.h"
+#include "../../timebase.h"
 #include "../../../util.h"
 #include <algorithm>
 
@@ -9,40 +10,169 @@ extern Serial screenSerial; // required if using SCREEN_NONE
 
 namespace dwin
 {
-  #define OPERATION_DELAY(value) if (value != 0) { delay::ms(value); }
+  namespace batch
+  {
+    /**
+     * @brief buffer collecting the frames of the current batch
+     */
+    uint8_t buffer[constants::batch_buffer_size];
+
+    /**
+     * @brief number of bytes used in the buffer
+     */
+    uint16_t length = 0;
+
+    /**
+     * @brief nesting depth of begin_batch() calls. batching is active if > 0
+     */
+    uint8_t depth = 0;
+
+    /**
+     * @brief total operation delay of the commands in the buffer, in milliseconds
+     */
+    uint32_t settle_time = 0;
+  } // namespace batch
+
+  namespace settle
+  {
+    /**
+     * @brief time the last command was sent at, as returned by timebase::now()
+     */
+    uint32_t since = 0;
+
+    /**
+     * @brief time the screen needs to process the last command, in microseconds. 0 if ready
+     */
+    uint32_t duration = 0;
+  } // namespace settle
 
   /**
-   * @brief send data to the DWIN screen
+   * @brief let the screen process the commands sent last.
+   * the wait is deferred to the next transmission, so other work can be done meanwhile
+   * @param time the processing time, in milliseconds
+   */
+  void settle_for(const uint32_t time)
+  {
+    // without a time base, there is no way to tell when the time is over
+    if (!timebase::is_running())
+    {
+      delay::ms(time);
+      return;
+    }
+
+    settle::since = timebase::now();
+    settle::duration = time * 1000ul;
+  }
+
+  bool is_ready()
+  {
+    return settle::duration == 0 || timebase::has_elapsed(settle::since, settle::duration);
+  }
+
+  /**
+   * @brief wait until the screen processed the commands sent last
+   */
+  void wait_ready()
+  {
+    if (!is_ready())
+    {
+      delay::us(settle::duration - (timebase::now() - settle::since));
+    }
+
+    settle::duration = 0;
+  }
+
+  /**
+   * @brief wait for the screen to process a command, before the next transmission.
+   * while batching, the screen still processes the commands one after another,
+   * so their delays add up and the sum is waited for after the batch is sent
+   */
+  #define OPERATION_DELAY(value)                                          \
+    if (value != 0)                                                       \
+    {                                                                     \
+      if (batch::depth > 0)                                               \
+      {                                                                   \
+        batch::settle_time += value;                                      \
+      }                                                                   \
+      else                                                                \
+      {                                                                   \
+        settle_for(value);                                                \
+      }                                                                   \
+    }
+
+  /**
+   * @brief write raw bytes to the screen serial
+   * @param data the data to write
+   * @param len the length of the data
+   */
+  void transmit(const uint8_t *data, const uint16_t len)
+  {
+    wait_ready();
+    for (uint16_t i = 0; i < len; i++)
+    {
+      screenSerial.put(data[i]);
+      if (constants::delays::byte_tx != 0)
+      {
+        delay::us(constants::delays::byte_tx);
+      }
+    }
+  }
+
+  /**
+   * @brief send all buffered frames in one burst and wait for the screen to process them
+   */
+  void flush_batch()
+  {
+    transmit(batch::buffer, batch::length);
+    batch::length = 0;
+
+    if (batch::settle_time != 0)
+    {
+      settle_for(batch::settle_time);
+      batch::settle_time = 0;
+    }
+  }
+
+  /**
+   * @brief send data to the DWIN screen, framed with head and tail
    * @param data the data to send
    * @param len the length of the data to send
+   * @note while batching, the frame is appended to the batch buffer instead
    */
   void send(const uint8_t *data, const uint16_t len)
   {
-    #define PUT(ch)                                         \
-      {                                                     \
-        screenSerial.put(ch);                               \
-        if (constants::delays::byte_tx != 0)                \
-        {                                                   \
-          delay::us(constants::delays::byte_tx);            \
-        }                                                   \
-      }
-
-    // send head
-    for (const uint8_t ch : constants::head)
+    if (batch::depth == 0)
     {
-      PUT(ch);
+      transmit(constants::head, sizeof(constants::head));
+      transmit(data, len);
+      transmit(constants::tail, sizeof(constants::tail));
+      return;
     }
 
-    // send data and log it
-    for (uint16_t i = 0; i < len; i++)
+    // send what's buffered so far if the frame doesn't fit anymore
+    const uint16_t frame_length = sizeof(constants::head) + len + sizeof(constants::tail);
+    if ((batch::length + frame_length) > sizeof(batch::buffer))
     {
-      PUT(data[i]);
+      flush_batch();
     }
 
-    // send tail
-    for (const uint8_t ch : constants::tail)
+    uint8_t *out = batch::buffer + batch::length;
+    out = std::copy(constants::head, constants::head + sizeof(constants::head), out);
+    out = std::copy(data, data + len, out);
+    out = std::copy(constants::tail, constants::tail + sizeof(constants::tail), out);
+    batch::length += frame_length;
+  }
+
+  void begin_batch()
+  {
+    batch::depth++;
+  }
+
+  void end_batch()
+  {
+    if (batch::depth > 0 && --batch::depth == 0)
     {
-      PUT(ch);
+      flush_batch();
     }
   }
 
@@ -60,19 +190,98 @@ namespace dwin
    */
   #define DWIN_WORD(x) static_cast<uint8_t>((x >> 8) & 0xFF), static_cast<uint8_t>(x & 0xFF)
 
-  void init()
+  bool handshake(const uint32_t timeout)
   {
-    // initialize the screen serial at 115200 baud
-    screenSerial.init(115200);
+    screenSerial.discard();
+    sendc(0x00); // cmd: handshake
 
-    // send handshake, don't care about response
-    for (uint32_t i = 0; i < constants::init_retries; i++)
+    // response is the regular frame head, 0x00 'O' 'K' and the frame tail
+    // only head and payload are checked, the tail is discarded with the next handshake
+    uint8_t ch;
+    for (const uint8_t expected : constants::head)
     {
-      sendc(0x00);
-      OPERATION_DELAY(constants::delays::init);
+      if (!screenSerial.get(ch, timeout) || ch != expected)
+      {
+        return false;
+      }
+    }
+
+    for (const uint8_t expected : constants::handshake_response)
+    {
+      if (!screenSerial.get(ch, timeout) || ch != expected)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief ask the screen to switch to a new baud rate and follow it
+   * @param baudrate the baud rate to switch to
+   * @return true if the screen responds at the new baud rate
+   * @note the screen must be responsive at the current baud rate
+   */
+  bool switch_baudrate(const uint32_t baudrate)
+  {
+    sendc(
+      constants::set_baudrate_cmd,
+      static_cast<uint8_t>((baudrate >> 24) & 0xFF),
+      static_cast<uint8_t>((baudrate >> 16) & 0xFF),
+      static_cast<uint8_t>((baudrate >> 8) & 0xFF),
+      static_cast<uint8_t>(baudrate & 0xFF)
+    );
+
+    // give the screen time to reconfigure its UART before following it
+    screenSerial.flush();
+    OPERATION_DELAY(constants::delays::set_baudrate);
+    wait_ready();
+    if (!screenSerial.set_baudrate(baudrate))
+    {
+      return false;
+    }
+
+    // verify with a ping round-trip
+    return handshake(constants::delays::init);
+  }
+
+  bool init()
+  {
+    // initialize the screen serial at the power-up baud rate
+    screenSerial.init(constants::default_baudrate);
+
+    // send handshake until the screen responds.
+    // without a receive pin, there is no response and all retries are sent
+    bool connected = false;
+    for (uint32_t i = 0; i < constants::init_retries && !connected; i++)
+    {
+      connected = handshake(constants::delays::init);
+      if (!connected && !screenSerial.can_receive())
+      {
+        OPERATION_DELAY(constants::delays::init);
+      }
+    }
+
+    // upgrade to a faster baud rate, falling back to the default if the screen doesn't follow
+    if (connected && SCREEN_SERIAL_BAUD != constants::default_baudrate)
+    {
+      if (!switch_baudrate(SCREEN_SERIAL_BAUD))
+      {
+        logging::debug(LOG_STR("DWIN baud switch failed\n"));
+
+        // the screen may have switched but not be reachable, so ask it to switch back.
+        // if it never switched, it'll ignore the garbled command
+        connected = switch_baudrate(constants::default_baudrate);
+        if (!connected)
+        {
+          logging::error("DWIN not responding\n");
+        }
+      }
     }
 
     redraw();
+    return connected;
   }
 
   void fill_screen(const color::color color)
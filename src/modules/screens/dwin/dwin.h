@@ -7,6 +7,10 @@
   #define SCREEN_DIMENSIONS { 0, 0 }
 #endif
 
+#ifndef SCREEN_SERIAL_BAUD
+  #define SCREEN_SERIAL_BAUD 115200
+#endif
+
 /**
  * @brief low-level screen driver for TWIN T5UIC1 (as found on Ender 3 V2 3D-Printers)
  * implements functions according to protocol version 1.2, as that is what most screens support.
@@ -36,6 +40,30 @@ namespace dwin
      */
     constexpr uint32_t init_retries = 3;
 
+    /**
+     * @brief baud rate the screen uses after power-up
+     */
+    constexpr uint32_t default_baudrate = 115200;
+
+    /**
+     * @brief expected response to the handshake command, excluding head and tail
+     */
+    constexpr uint8_t handshake_response[] = { 0x00, 'O', 'K' };
+
+    /**
+     * @brief command to change the baud rate of the screen.
+     * @note not every panel firmware implements this command. 
+     *       panels that don't will fail the verification handshake at the new baud rate, 
+     *       after which the driver falls back to default_baudrate.
+     */
+    constexpr uint8_t set_baudrate_cmd = 0x38;
+
+    /**
+     * @brief size of the buffer used to batch commands.
+     * @note larger batches are split, so this only has to fit the largest single frame
+     */
+    constexpr uint16_t batch_buffer_size = 256;
+
     /**
      * @brief delays for different operations.
      * @note set to 0 to disable
@@ -45,6 +73,7 @@ namespace dwin
       constexpr uint32_t byte_tx = 1; // us
 
       constexpr uint32_t init = 500; // ms
+      constexpr uint32_t set_baudrate = 20; // ms
       constexpr uint32_t fill_screen = 100; // ms
       constexpr uint32_t redraw = 10; // ms
       constexpr uint32_t set_brightness = 0; // ms
@@ -247,8 +276,36 @@ namespace dwin
 
   /**
    * @brief initialize the DWIN screen
+   * @note if the screen serial can receive, the baud rate is switched to SCREEN_SERIAL_BAUD after a successful handshake
+   * @return true if the screen answered, at the baud rate used from now on. always false if the screen serial cannot receive
+   */
+  bool init();
+
+  /**
+   * @brief send a handshake to the screen and wait for the response
+   * @param timeout the time to wait for the response, in milliseconds
+   * @return true if the screen responded. always false if the screen serial cannot receive
+   */
+  bool handshake(const uint32_t timeout);
+
+  /**
+   * @brief has the screen processed the commands sent last?
+   * @note commands sent while the screen is busy wait until it is ready
+   */
+  bool is_ready();
+
+  /**
+   * @brief start collecting commands into a single transmission.
+   * until the matching end_batch(), commands are buffered instead of sent, and 
+   * their post-command delays are merged into one wait after the batch is sent.
+   * @note batches may be nested. only the outermost end_batch() sends the batch
+   */
+  void begin_batch();
+
+  /**
+   * @brief send the commands collected since begin_batch() as one burst
    */
-  void init();
+  void end_batch();
 
   /**
    * @brief clear the screen
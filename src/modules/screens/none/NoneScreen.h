@@ -10,6 +10,8 @@ public:
   void init() override {}
   void clear() override {}
   void write(const char *str) override {}
-  void flush() override {}
+  void flush(const bool force = false) override {}
+  void flush_deferred() override {}
+  bool is_ready() override { return true; }
   void showProgress(const uint32_t progress, const uint32_t total = 100, const char* message = nullptr) override {}
 };
\ No newline at end of file
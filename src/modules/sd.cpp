@@ -1,5 +1,10 @@
 #include "sd.h"
+#include "image.h"
 #include "log.h"
+#include "screen.h"
+#include "profiler.h"
+#include "trace.h"
+#include "../util.h"
 #include "../config.h"
 
 namespace sd 
@@ -11,12 +16,37 @@ namespace sd
    */
   FATFS fs;
 
+  #if HAS_METADATA_HASH
+    /**
+     * @brief check the hash of the application is the one the image expects
+     */
+    bool is_expected_hash(const hash::hash_t &hash)
+    {
+      // delta images carry the hash of the application they rebuild
+      if (!image::is_expected_hash(hash))
+      {
+        logging::error("image hash mismatch\n");
+        return false;
+      }
+
+      return true;
+    }
+  #endif
+
   bool get_metadata(flash::update_metadata &metadata)
   {
-    // get file size
-    metadata.app_size = fs.fsize;
+    // get the application size
+    metadata.app_size = image::get_app_size();
 
     #if HAS_METADATA_HASH
+      PROFILE_SCOPE(hash);
+
+      // the image manifest carries the hash, so the file doesn't have to be read for it
+      if (image::get_app_hash(metadata.hash))
+      {
+        return is_expected_hash(metadata.hash);
+      }
+
       // start hash session
       if (!hash::start())
       {
@@ -25,18 +55,14 @@ namespace sd
       }
 
       // write data to hash
-      constexpr size_t buffer_size = 512;
-      uint8_t buffer[buffer_size];
+      constexpr size_t buffer_size = hash::chunk_size;
+      uint8_t buffer[buffer_size] __attribute__((aligned(4)));
       for(;;)
       {
         // read the next block
         UINT bytes_read = 0;
-        const FRESULT res = pf_read(buffer, buffer_size, &bytes_read);
-        if (res != FR_OK)
+        if (!image::read(buffer, buffer_size, bytes_read))
         {
-          logging::error("f_read() err=");
-          logging::error(res, 10);
-          logging::error("\n");
           return false;
         }
 
@@ -52,6 +78,11 @@ namespace sd
           logging::error("hash::push_data() failed\n");
           return false;
         }
+
+        profiler::add_bytes(profiler::stage::hash, bytes_read);
+
+        // reading the whole file takes a while, so show log output held back by the screen meanwhile
+        screen.flush_deferred();
       }
 
       // get the hash
@@ -60,15 +91,19 @@ namespace sd
         logging::error("hash::get_hash() failed\n");
         return false;
       }
-    #endif // HAS_METADATA_HASH
 
-    return true;
+      return is_expected_hash(metadata.hash);
+    #else
+      return true;
+    #endif // HAS_METADATA_HASH
   }
 
   bool get_update_file(flash::update_metadata &metadata, const char *path)
   {
     // mount the file system
+    profiler::begin(profiler::stage::mount);
     FRESULT res = pf_mount(&fs);
+    profiler::end(profiler::stage::mount);
     if (res != FR_OK)
     {
       logging::error("f_mount() err=");
@@ -98,6 +133,12 @@ namespace sd
         return false;
       }
 
+      // detect the image format
+      if (!image::open(file_size))
+      {
+        return false;
+      }
+
       // get metadata
       if (!read_metadata)
       {
@@ -109,15 +150,46 @@ namespace sd
         #if HAS_METADATA_HASH
           // open file again, but don't read metadata
           // this is equal to rewind the file, but uses less flash
-          read_metadata = true;
-          continue;
+          // not needed if the hash was taken from the image, without reading the file
+          if (!image::has_app_hash())
+          {
+            read_metadata = true;
+            continue;
+          }
         #endif
       }
 
-      // done if the file size matches the metadata
+      // done if the application size matches the metadata
       // since we may have re-opened the file, it's better to check 
-      // the file size didn't change
-      return metadata.app_size == file_size;
+      // the file didn't change
+      return metadata.app_size == image::get_app_size();
     }
   }
+
+  void log_io_stats()
+  {
+    const sdio::io_stats_t &stats = sdio::io_stats;
+    trace::record(BOOT_TRACE_EVENT_SD_READS, minimum(stats.retries, 255u), stats.sectors_requested, stats.device_reads);
+    trace::record(BOOT_TRACE_EVENT_SD_TIME, minimum(stats.timeouts, 255u), stats.busy_us, stats.cache_hits);
+
+    logging::debug(LOG_STR("sd: "));
+    logging::debug(stats.sectors_requested, 10);
+    logging::debug(LOG_STR(" requested, "));
+    logging::debug(stats.device_reads, 10);
+    logging::debug(LOG_STR(" reads, "));
+    logging::debug(stats.cache_hits, 10);
+    logging::debug(LOG_STR(" cached, "));
+    logging::debug(stats.bytes_copied, 10);
+    logging::debug(LOG_STR(" bytes, "));
+    logging::debug(stats.direct_reads, 10);
+    logging::debug(LOG_STR(" direct, "));
+    logging::debug(stats.retries, 10);
+    logging::debug(LOG_STR(" retries, "));
+    logging::debug(stats.timeouts, 10);
+    logging::debug(LOG_STR(" timeouts, "));
+    logging::debug(stats.busy_us, 10);
+    logging::debug(LOG_STR(" us busy, "));
+    logging::debug(stats.inits, 10);
+    logging::debug(LOG_STR(" inits\n"));
+  }
 } // namespace sd
@@ -14,4 +14,18 @@ namespace sd
    * @note assumes only one file is opened at a time
    */
   bool get_update_file(flash::update_metadata &metadata, const char *path);
+
+  /**
+   * @brief get the metadata of the opened image, hashing the application unless the image carries its hash
+   * @param metadata metadata object
+   * @return true if the metadata was read and the hash is the one the image expects
+   * @note if the application was hashed, the image is read to its end and must be opened again
+   */
+  bool get_metadata(flash::update_metadata &metadata);
+
+  /**
+   * @brief log the SD I/O counters to logging::debug, and record them in the boot trace
+   * @note call once, at the end of the boot
+   */
+  void log_io_stats();
 } // namespace sd
@@ -1,5 +1,6 @@
 #include "sdio.h"
 #include "../log.h"
+#include "../trace.h"
 #include <sd_card.h>
 
 #include "../assert.h"
@@ -39,6 +40,98 @@ constexpr en_sdioc_bus_width_t get_sdioc_bus_width(const int width)
  */
 stc_sd_handle_t *handle = nullptr;
 
+/**
+ * @brief sector currently held in the block buffer
+ */
+DWORD last_sector = LSECTOR_INVALID;
+
+sdio::io_stats_t sdio::io_stats = {};
+
+/**
+ * @brief measures the time spent waiting for the card, adding it to io_stats.busy_us
+ */
+class busy_timer
+{
+public:
+  busy_timer() : start(DWT->CYCCNT) {}
+
+  ~busy_timer()
+  {
+    sdio::io_stats.busy_us += (DWT->CYCCNT - start) / (SystemCoreClock / 1000000ul);
+  }
+
+private:
+  const uint32_t start;
+};
+
+/**
+ * @brief (re-)create the card handle and initialize the card
+ * @param clock SDIO clock to use after card identification
+ * @param width bus width to use
+ * @return status. byte with one or more of [STA_NOINIT, STA_NODISK] set
+ * @note assumes the SDIO pins are configured
+ */
+DSTATUS init_card(const en_sdioc_clk_freq_t clock, const int width)
+{
+  // If a handle is already initialized, free it before creating a new one
+  // otherwise, we will leak memory, which will eventually crash the system
+  if (handle != nullptr) 
+  {
+    delete handle->pstcDmaInitCfg;
+    delete handle->pstcCardInitCfg;
+    delete handle;
+    handle = nullptr;
+  }
+
+  // Create card configuration
+  // This should be a fairly safe configuration for most cards
+  stc_sdcard_init_t *cardConf = new stc_sdcard_init_t;
+  cardConf->enBusWidth = get_sdioc_bus_width(width);
+  cardConf->enClkFreq = clock;
+  cardConf->enSpeedMode = clock > SdiocClk25M ? SdiocHighSpeedMode : SdiocNormalSpeedMode;
+  cardConf->pstcInitCfg = nullptr;
+
+  // Create handle in DMA mode
+  handle = new stc_sd_handle_t;
+  handle->SDIOCx = SDIO_UNIT;
+  handle->enDevMode = SdCardPollingMode;
+  //handle->pstcCardInitCfg = cardConf; // assigned in SDCARD_Init
+
+  // cycle counter is used to measure the card busy time
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  const busy_timer timer;
+
+  // the new card may hold different data
+  last_sector = LSECTOR_INVALID;
+  sdio::io_stats.inits++;
+
+  // Initialize sd card
+  en_result_t rc = SDCARD_Init(handle, cardConf);
+  if (rc != Ok) 
+  {
+    trace::record(BOOT_TRACE_EVENT_SD_INIT_ERROR, rc, handle->u32ErrorCode, 0);
+    logging::debug(LOG_STR("SDIO_Init() rc="));
+    logging::debug(rc, 10);
+    logging::debug(LOG_STR("\n"));
+    return STA_NOINIT;
+  }
+
+  // read card CSD
+  rc = SDCARD_GetCardCSD(handle);
+  if (rc != Ok)
+  {
+    trace::record(BOOT_TRACE_EVENT_SD_INIT_ERROR, rc, handle->u32ErrorCode, 1);
+    logging::debug(LOG_STR("SDIO_GetCardCSD() rc="));
+    logging::debug(rc, 10);
+    logging::debug(LOG_STR("\n"));
+    return STA_NODISK;
+  }
+
+  // everything is OK
+  return 0;
+}
+
 /**
  * @brief initialize drive
  * @return status. byte with one or more of [STA_NOINIT, STA_NODISK] set
@@ -77,52 +170,53 @@ extern "C" DSTATUS disk_initialize(void)
   PORT_SetFunc(sdio::pins.cmd.port, sdio::pins.cmd.pin, Func_Sdio, Disable);
   PORT_SetFunc(sdio::pins.det.port, sdio::pins.det.pin, Func_Sdio, Disable);
 
-  // If a handle is already initialized, free it before creating a new one
-  // otherwise, we will leak memory, which will eventually crash the system
-  if (handle != nullptr) 
+  return init_card(sdio::default_clock, sdio::bus_width);
+}
+
+/**
+ * @brief read a sector from the card, retrying on errors
+ * @param buff the buffer to read to, at least SD_BLOCK_SIZE bytes and word-aligned
+ * @param sector sector number to read
+ * @return status. one of [RES_OK, RES_ERROR]
+ */
+DRESULT read_sector(BYTE *buff, const DWORD sector)
+{
+  en_result_t rc;
+  for (int attempt = 0;; attempt++)
   {
-    delete handle->pstcDmaInitCfg;
-    delete handle->pstcCardInitCfg;
-    delete handle;
-    handle = nullptr;
-  }
+    {
+      const busy_timer timer;
+      rc = SDCARD_ReadBlocks(handle, sector, 1, buff, sdio::read_timeout);
+    }
 
-  // Create card configuration
-  // This should be a fairly safe configuration for most cards
-  stc_sdcard_init_t *cardConf = new stc_sdcard_init_t;
-  cardConf->enBusWidth = get_sdioc_bus_width(sdio::bus_width);
-  cardConf->enClkFreq = SdiocClk400K;
-  cardConf->enSpeedMode = SdiocNormalSpeedMode;
-  cardConf->pstcInitCfg = nullptr;
+    sdio::io_stats.device_reads++;
+    if (rc == ErrorTimeout)
+    {
+      sdio::io_stats.timeouts++;
+    }
 
-  // Create handle in DMA mode
-  handle = new stc_sd_handle_t;
-  handle->SDIOCx = SDIO_UNIT;
-  handle->enDevMode = SdCardPollingMode;
-  //handle->pstcCardInitCfg = cardConf; // assigned in SDCARD_Init
+    if (rc == Ok || attempt >= sdio::read_retries)
+    {
+      break;
+    }
 
-  // Initialize sd card
-  en_result_t rc = SDCARD_Init(handle, cardConf);
-  if (rc != Ok) 
-  {
-    logging::debug("SDIO_Init() rc=");
-    logging::debug(rc, 10);
-    logging::debug("\n");
-    return STA_NOINIT;
+    sdio::io_stats.retries++;
   }
 
-  // read card CSD
-  rc = SDCARD_GetCardCSD(handle);
   if (rc != Ok)
   {
-    logging::debug("SDIO_GetCardCSD() rc=");
+    trace::record(BOOT_TRACE_EVENT_SD_READ_ERROR, rc, handle->u32ErrorCode, sector);
+    logging::debug(LOG_STR("SDCARD_ReadBlocks() rc="));
     logging::debug(rc, 10);
-    logging::debug("\n");
-    return STA_NODISK;
+    logging::debug(LOG_STR(" err="));
+    logging::debug(handle->u32ErrorCode, 10);
+    logging::debug(LOG_STR(" @ "));
+    logging::debug(sector, 10);
+    logging::debug(LOG_STR("\n"));
+    return RES_ERROR;
   }
 
-  // everything is OK
-  return 0;
+  return RES_OK;
 }
 
 /**
@@ -135,8 +229,7 @@ extern "C" DSTATUS disk_initialize(void)
  */
 extern "C" DRESULT disk_readp(BYTE *buff, DWORD sector, UINT offset, UINT count)
 {
-  static BYTE block_buffer[SD_BLOCK_SIZE];
-  static DWORD last_sector = LSECTOR_INVALID;
+  static BYTE block_buffer[SD_BLOCK_SIZE] __attribute__((aligned(4)));
 
   // if either offset or count is larger than the block buffer, we have a problem.
   // since we first read into the block buffer, we can't read more than that.
@@ -149,37 +242,57 @@ extern "C" DRESULT disk_readp(BYTE *buff, DWORD sector, UINT offset, UINT count)
     return RES_NOTRDY;
   }
 
+  // reads are only counted, since logging each one slows the update down considerably
+  sdio::io_stats.sectors_requested++;
+
+  // a full sector into a word-aligned buffer is read directly, without going through the block buffer.
+  // the cached sector stays valid, since the card is never written
+  if (offset == 0 && count == SD_BLOCK_SIZE && (reinterpret_cast<uintptr_t>(buff) % 4) == 0 && sector != last_sector)
+  {
+    sdio::io_stats.direct_reads++;
+    return read_sector(buff, sector);
+  }
+
   // read 1 full block / sector if different from last read
   // Petit FatFS wants to read partial sectors, but the DDL only allows reading full ones.
   // So we read the full sector and then copy "chunks" to FatFS's buffer.
   // Since FatFS may request the same (partial) sector multiple times, we cache the full sector buffer and 
   // use the cache if the sector matches.
-  logging::debug("read sector ");
-  logging::debug(sector, 10);
   if (sector != last_sector)
   {
-    logging::debug(" from DISK\n");
-
-    en_result_t rc = SDCARD_ReadBlocks(handle, sector, 1, block_buffer, sdio::read_timeout);
-    if (rc != Ok)
+    if (read_sector(block_buffer, sector) != RES_OK)
     {
-      logging::debug("SDCARD_ReadBlocks() rc=");
-      logging::debug(rc, 10);
-      logging::debug(" err=");
-      logging::debug(handle->u32ErrorCode, 10);
-      logging::debug(" @ ");
-      logging::debug(sector, 10);
-      logging::debug("\n");
+      // the block buffer may be partially overwritten
+      last_sector = LSECTOR_INVALID;
       return RES_ERROR;
     }
+
+    last_sector = sector;
   }
   else
   {
-    // read from cache
-    logging::debug(" from CACHE\n");
+    sdio::io_stats.cache_hits++;
   }
 
   // copy bytes from block SDIO buffer to FatFS buffer
   memcpy(buff, block_buffer + offset, count);
+  sdio::io_stats.bytes_copied += count;
   return RES_OK;
 }
+
+bool sdio::reinit(const en_sdioc_clk_freq_t clock, const int width)
+{
+  return init_card(clock, width) == 0;
+}
+
+bool sdio::read_blocks(const uint32_t sector, const uint16_t count, uint8_t *buffer)
+{
+  if (handle == nullptr)
+  {
+    return false;
+  }
+
+  const busy_timer timer;
+  sdio::io_stats.device_reads += count;
+  return SDCARD_ReadBlocks(handle, sector, count, buffer, sdio::read_timeout) == Ok;
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <hc32_ddl.h>
+#include <sd_card.h>
 #include "../../util.h"
 #include "../../config.h"
 
@@ -20,6 +22,91 @@ namespace sdio
    */
   constexpr pins_t pins = SDIO_PINS;
 
+  /**
+   * @brief SDIO clock used for FatFs access
+   */
+  constexpr en_sdioc_clk_freq_t default_clock = SdiocClk400K;
+
   constexpr uint32_t read_timeout = 500;  // ms
   constexpr uint32_t write_timeout = 500; // ms
+
+  /**
+   * @brief how often a failed block read is retried before giving up
+   */
+  constexpr int read_retries = 2;
+
+  /**
+   * @brief SD I/O accounting counters, updated by disk_initialize() and disk_readp()
+   */
+  struct io_stats_t
+  {
+    /**
+     * @brief number of card initializations
+     */
+    uint32_t inits;
+
+    /**
+     * @brief number of (partial) sectors requested by FatFs
+     */
+    uint32_t sectors_requested;
+
+    /**
+     * @brief number of block reads issued to the card, including retries
+     */
+    uint32_t device_reads;
+
+    /**
+     * @brief number of requests served from the sector cache
+     */
+    uint32_t cache_hits;
+
+    /**
+     * @brief number of bytes copied to FatFs
+     */
+    uint32_t bytes_copied;
+
+    /**
+     * @brief number of full sectors read directly into the FatFs buffer, without copying
+     */
+    uint32_t direct_reads;
+
+    /**
+     * @brief number of retried block reads
+     */
+    uint32_t retries;
+
+    /**
+     * @brief number of block reads that timed out
+     */
+    uint32_t timeouts;
+
+    /**
+     * @brief cumulative time spent waiting for the card, in microseconds.
+     * measured using the DWT cycle counter
+     */
+    uint32_t busy_us;
+  };
+
+  /**
+   * @brief SD I/O counters since boot
+   */
+  extern io_stats_t io_stats;
+
+  /**
+   * @brief re-initialize the card with a different bus configuration
+   * @param clock SDIO clock to use after card identification. clocks above 25 MHz use high speed mode
+   * @param width bus width to use, one of [1, 4, 8]. must not exceed bus_width
+   * @return true if the card was initialized
+   * @note the card must have been initialized by disk_initialize() before
+   */
+  bool reinit(const en_sdioc_clk_freq_t clock, const int width);
+
+  /**
+   * @brief read blocks from the card, bypassing the sector cache
+   * @param sector the first block to read
+   * @param count the number of blocks to read
+   * @param buffer the buffer to read to, at least count * 512 bytes
+   * @return true if the blocks were read
+   */
+  bool read_blocks(const uint32_t sector, const uint16_t count, uint8_t *buffer);
 } // namespace sdio
@@ -2,7 +2,7 @@
  * serial driver based on the Arduino core's usart_sync driver
  */
 #include "serial.h"
-#include "delay.h"
+#include "timebase.h"
 #include "assert.h"
 #include <addon_usart.h>
 
@@ -88,8 +88,12 @@ void Serial::init(uint32_t baudrate)
   // disable and de-init usart peripheral
   deinit();
 
-  // set tx pin
+  // set tx and rx pins
   PORT_SetFunc(tx_pin.port, tx_pin.pin, USART_DEV_TO_TX_FUNC(peripheral), Disable);
+  if (has_rx)
+  {
+    PORT_SetFunc(rx_pin.port, rx_pin.pin, USART_DEV_TO_RX_FUNC(peripheral), Disable);
+  }
 
   // enable USART clock
   PWC_Fcg1PeriphClockCmd(USART_DEV_TO_PERIPH_CLOCK(peripheral), Enable);
@@ -97,6 +101,12 @@ void Serial::init(uint32_t baudrate)
   // initialize USART peripheral and set baudrate
   USART_UART_Init(peripheral, &usart_config);
   SetUartBaudrate_FP(peripheral, baudrate);
+
+  // enable RX function
+  if (has_rx)
+  {
+    USART_FuncCmd(peripheral, UsartRx, Enable);
+  }
 }
 
 void Serial::deinit()
@@ -116,6 +126,13 @@ void Serial::deinit()
   #endif
 }
 
+bool Serial::set_baudrate(const uint32_t baudrate)
+{
+  // changing the baudrate mid-transmission would garble the last byte
+  flush();
+  return SetUartBaudrate_FP(peripheral, baudrate) == Ok;
+}
+
 void Serial::put(const uint8_t ch)
 {
   // enable TX function
@@ -128,6 +145,31 @@ void Serial::put(const uint8_t ch)
   USART_SendData(peripheral, ch);
 }
 
+bool Serial::try_put(const uint8_t ch)
+{
+  if (USART_GetStatus(peripheral, UsartTxEmpty) == Reset)
+  {
+    return false;
+  }
+
+  USART_SendData(peripheral, ch);
+  return true;
+}
+
+void Serial::set_tx_empty_interrupt(const bool enable)
+{
+  if (enable)
+  {
+    // TX function and interrupt are enabled together, 
+    // otherwise the first TX empty interrupt may be missed
+    USART_FuncCmd(peripheral, UsartTxAndTxEmptyInt, Enable);
+  }
+  else
+  {
+    USART_FuncCmd(peripheral, UsartTxEmptyInt, Disable);
+  }
+}
+
 void Serial::write(const char *str)
 {
   while (*str != '\0')
@@ -136,10 +178,56 @@ void Serial::write(const char *str)
   }
 }
 
+void Serial::flush()
+{
+  // TX complete is set after reset, so this won't block if nothing was sent
+  while (USART_GetStatus(peripheral, UsartTxComplete) == Reset) { /* nada */ }
+}
+
+bool Serial::get(uint8_t &ch, const uint32_t timeout)
+{
+  if (!has_rx)
+  {
+    return false;
+  }
+
+  // poll until a byte arrives or the timeout expires. the RX buffer holds a single byte,
+  // so it is polled without pause to keep up with high baud rates
+  const timebase::deadline deadline(timeout * 1000);
+  for (;;)
+  {
+    // an overrun error blocks further reception until cleared
+    if (USART_GetStatus(peripheral, UsartOverrunErr) == Set)
+    {
+      USART_ClearStatus(peripheral, UsartOverrunErr);
+    }
+
+    if (USART_GetStatus(peripheral, UsartRxNoEmpty) == Set)
+    {
+      ch = static_cast<uint8_t>(USART_RecData(peripheral));
+      return true;
+    }
+
+    if (deadline.expired())
+    {
+      return false;
+    }
+  }
+}
+
+void Serial::discard()
+{
+  uint8_t ch;
+  while (get(ch, 0)) { /* nada */ }
+}
+
 #if HAS_SERIAL(HOST_SERIAL)
   Serial hostSerial(
     CONCAT(M4_USART, HOST_SERIAL), 
     HOST_SERIAL_TX
+    #if defined(HOST_SERIAL_RX)
+      , HOST_SERIAL_RX
+    #endif
   );
 #endif
 
@@ -147,5 +235,8 @@ void Serial::write(const char *str)
   Serial screenSerial(
     CONCAT(M4_USART, SCREEN_SERIAL), 
     SCREEN_SERIAL_TX
+    #if defined(SCREEN_SERIAL_RX)
+      , SCREEN_SERIAL_RX
+    #endif
   );
 #endif
@@ -18,7 +18,21 @@ public:
    */
   Serial(M4_USART_TypeDef *peripheral, const gpio::pin_t tx_pin) : 
     peripheral(peripheral), 
-    tx_pin(tx_pin) {}
+    tx_pin(tx_pin),
+    rx_pin(tx_pin),
+    has_rx(false) {}
+
+  /**
+   * @brief Construct a new Serial object with receive support
+   * @param peripheral the peripheral
+   * @param tx_pin the tx pin
+   * @param rx_pin the rx pin
+   */
+  Serial(M4_USART_TypeDef *peripheral, const gpio::pin_t tx_pin, const gpio::pin_t rx_pin) : 
+    peripheral(peripheral), 
+    tx_pin(tx_pin),
+    rx_pin(rx_pin),
+    has_rx(true) {}
   
   /**
    * @brief initialize the Serial
@@ -31,21 +45,70 @@ public:
    */
   void deinit();  
 
+  /**
+   * @brief change the baudrate of the initialized Serial
+   * @param baudrate the new baudrate
+   * @return true if the baudrate could be set
+   * @note waits for the current transmission to complete before switching
+   */
+  bool set_baudrate(const uint32_t baudrate);
+
   /**
    * @brief write a byte to the Serial
    * @param ch the byte to write 
    */
   void put(const uint8_t ch);
 
+  /**
+   * @brief write a byte to the Serial without waiting
+   * @param ch the byte to write
+   * @return true if the byte was written, false if the TX buffer is still occupied
+   * @note the TX function must be enabled, e.g. by set_tx_empty_interrupt()
+   */
+  bool try_put(const uint8_t ch);
+
+  /**
+   * @brief enable or disable the TX buffer empty interrupt
+   * @param enable enable or disable the interrupt
+   * @note enabling also enables the TX function
+   */
+  void set_tx_empty_interrupt(const bool enable);
+
   /**
    * @brief write a string to the Serial
    * @param str the string to write
    */
   void write(const char *str);
 
+  /**
+   * @brief wait until all data has been transmitted
+   */
+  void flush();
+
+  /**
+   * @brief can this Serial receive data?
+   */
+  bool can_receive() const { return has_rx; }
+
+  /**
+   * @brief read a byte from the Serial
+   * @param ch the byte read
+   * @param timeout the maximum time to wait for a byte, in milliseconds
+   * @return true if a byte was read, false on timeout or if receiving is not supported
+   * @note the time base must be running
+   */
+  bool get(uint8_t &ch, const uint32_t timeout);
+
+  /**
+   * @brief discard any data received so far
+   */
+  void discard();
+
 private:
   M4_USART_TypeDef *peripheral;
   const gpio::pin_t tx_pin;
+  const gpio::pin_t rx_pin;
+  const bool has_rx;
 };
 
 #if HAS_SERIAL(HOST_SERIAL)
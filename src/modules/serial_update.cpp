@@ -0,0 +1,437 @@
+#include "serial_update.h"
+
+#if ENABLE_SERIAL_UPDATE == 1
+#include <string.h>
+#include "crc.h"
+#include "image.h"
+#include "log.h"
+#include "profiler.h"
+#include "sd.h"
+#include "serial.h"
+#include "timebase.h"
+#include "../util.h"
+
+namespace serial_update
+{
+  /**
+   * @brief READs of the same window sent without progress before the upload is given up
+   */
+  constexpr uint32_t max_retries = 5;
+
+  /**
+   * @brief a received frame
+   */
+  struct frame
+  {
+    uint8_t type;
+    uint16_t length;
+    uint8_t payload[SERIAL_MAX_PAYLOAD] __attribute__((aligned(4)));
+  };
+
+  /**
+   * @brief result of receiving a frame
+   */
+  enum class received : uint8_t
+  {
+    ok,
+    timeout,
+    corrupt,
+  };
+
+  namespace state
+  {
+    /**
+     * @brief size of the update file, and the offset of the next byte returned by read()
+     */
+    uint32_t file_size = 0;
+    uint32_t position = 0;
+
+    /**
+     * @brief the window of the update file received last, and its offset and length
+     */
+    uint8_t window[SERIAL_UPDATE_WINDOW_SIZE] __attribute__((aligned(4)));
+    uint32_t window_offset = 0;
+    uint32_t window_length = 0;
+
+    /**
+     * @brief the frame received last
+     */
+    frame rx;
+
+    /**
+     * @brief the baud rate confirmed by the host
+     */
+    uint32_t baudrate = HOST_SERIAL_BAUD;
+
+    /**
+     * @brief number of READs sent again, after a corrupt or missing chunk
+     */
+    uint32_t retries = 0;
+  } // namespace state
+
+  /**
+   * @brief send a frame
+   * @param type SERIAL_FRAME_*
+   * @param payload the payload
+   * @param length length of the payload, in bytes
+   */
+  void send(const uint8_t type, const void *payload, const uint16_t length)
+  {
+    const uint8_t header[] = { type, static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8) };
+    const uint32_t crc = crc::crc32(crc::crc32(0, header, sizeof(header)), static_cast<const uint8_t *>(payload), length);
+
+    // pending log output must not end up inside the frame
+    logging::flush();
+
+    hostSerial.put(SERIAL_FRAME_SYNC);
+    for (const uint8_t byte : header)
+    {
+      hostSerial.put(byte);
+    }
+    for (uint16_t i = 0; i < length; i++)
+    {
+      hostSerial.put(static_cast<const uint8_t *>(payload)[i]);
+    }
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+      hostSerial.put(static_cast<uint8_t>(crc >> shift));
+    }
+  }
+
+  /**
+   * @brief receive a byte before the deadline
+   */
+  bool get_byte(uint8_t &byte, const timebase::deadline &deadline)
+  {
+    return hostSerial.get(byte, deadline.remaining() / 1000);
+  }
+
+  /**
+   * @brief receive the next frame into state::rx
+   * @param timeout the time the whole frame must be received in, in milliseconds
+   */
+  received receive(const uint32_t timeout)
+  {
+    const timebase::deadline deadline(timeout * 1000);
+    frame &rx = state::rx;
+
+    // bytes before the sync, e.g. the rest of an abandoned frame, are skipped
+    uint8_t byte = 0;
+    do
+    {
+      if (!get_byte(byte, deadline))
+      {
+        return received::timeout;
+      }
+    } while (byte != SERIAL_FRAME_SYNC);
+
+    uint8_t header[3];
+    for (uint8_t &header_byte : header)
+    {
+      if (!get_byte(header_byte, deadline))
+      {
+        return received::timeout;
+      }
+    }
+
+    rx.type = header[0];
+    rx.length = static_cast<uint16_t>(header[1] | (header[2] << 8));
+    if (rx.length > SERIAL_MAX_PAYLOAD)
+    {
+      return received::corrupt;
+    }
+
+    for (uint16_t i = 0; i < rx.length; i++)
+    {
+      if (!get_byte(rx.payload[i], deadline))
+      {
+        return received::timeout;
+      }
+    }
+
+    uint32_t crc = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+      if (!get_byte(byte, deadline))
+      {
+        return received::timeout;
+      }
+
+      crc |= static_cast<uint32_t>(byte) << shift;
+    }
+
+    return crc == crc::crc32(crc::crc32(0, header, sizeof(header)), rx.payload, rx.length) ? received::ok : received::corrupt;
+  }
+
+  /**
+   * @brief get the payload of state::rx, if it is a frame of the type and large enough
+   */
+  template <typename T>
+  const T *get_payload(const uint8_t type)
+  {
+    return (state::rx.type == type && state::rx.length >= sizeof(T)) ? reinterpret_cast<const T *>(state::rx.payload) : nullptr;
+  }
+
+  /**
+   * @brief answer a HELLO of the host
+   */
+  void send_hello()
+  {
+    const serial_hello_t hello = {
+      .magic = SERIAL_HELLO_MAGIC,
+      .version = SERIAL_PROTOCOL_VERSION,
+      .reserved = { 0, 0, 0 },
+      .window_size = SERIAL_UPDATE_WINDOW_SIZE,
+    };
+    send(SERIAL_FRAME_HELLO, &hello, sizeof(hello));
+  }
+
+  /**
+   * @brief switch to the baud rate the host asks for, keeping it only if the host confirms it with a PING
+   * @param baudrate the baud rate to switch to
+   */
+  void switch_baudrate(const uint32_t baudrate)
+  {
+    const serial_baud_t answer = { .baudrate = baudrate <= SERIAL_UPDATE_MAX_BAUD ? baudrate : 0 };
+    send(SERIAL_FRAME_BAUD, &answer, sizeof(answer));
+    if (answer.baudrate == 0)
+    {
+      return;
+    }
+
+    // if the peripheral clock can't make the baud rate, the PING isn't echoed, so the host gives up on it as well.
+    // either way, the previous baud rate returns SERIAL_UPDATE_TIMEOUT after the answer, when the host expects it
+    const bool switched = hostSerial.set_baudrate(answer.baudrate);
+    const timebase::deadline deadline(SERIAL_UPDATE_TIMEOUT * 1000);
+    while (!deadline.expired())
+    {
+      if (receive(deadline.remaining() / 1000) == received::ok && state::rx.type == SERIAL_FRAME_PING && switched)
+      {
+        state::baudrate = answer.baudrate;
+        send(SERIAL_FRAME_PING, state::rx.payload, state::rx.length);
+        return;
+      }
+    }
+
+    hostSerial.set_baudrate(state::baudrate);
+  }
+
+  /**
+   * @brief wait for a host to start an upload
+   * @return true once the host sent BEGIN
+   */
+  bool connect()
+  {
+    if (!hostSerial.can_receive())
+    {
+      return false;
+    }
+
+    // listening may start in the middle of a HELLO, so the next one is waited for
+    const timebase::deadline deadline(SERIAL_UPDATE_WAIT * 1000);
+    for (;;)
+    {
+      if (receive(deadline.remaining() / 1000) == received::ok)
+      {
+        const serial_hello_t *hello = get_payload<serial_hello_t>(SERIAL_FRAME_HELLO);
+        if (hello != nullptr && hello->magic == SERIAL_HELLO_MAGIC)
+        {
+          break;
+        }
+      }
+
+      if (deadline.expired())
+      {
+        return false;
+      }
+    }
+
+    logging::log("serial host connected\n");
+    send_hello();
+
+    // the host may repeat its HELLO, and tries baud rates before it begins
+    for (;;)
+    {
+      const received result = receive(SERIAL_UPDATE_TIMEOUT);
+      if (result == received::timeout)
+      {
+        state::baudrate = HOST_SERIAL_BAUD;
+        hostSerial.set_baudrate(HOST_SERIAL_BAUD);
+        logging::error("serial host lost\n");
+        return false;
+      }
+
+      if (result != received::ok)
+      {
+        continue;
+      }
+
+      switch (state::rx.type)
+      {
+      case SERIAL_FRAME_HELLO:
+        send_hello();
+        break;
+      case SERIAL_FRAME_BAUD:
+        if (const serial_baud_t *baud = get_payload<serial_baud_t>(SERIAL_FRAME_BAUD))
+        {
+          switch_baudrate(baud->baudrate);
+        }
+        break;
+      case SERIAL_FRAME_PING:
+        send(SERIAL_FRAME_PING, state::rx.payload, state::rx.length);
+        break;
+      case SERIAL_FRAME_BEGIN:
+        if (const serial_begin_t *begin = get_payload<serial_begin_t>(SERIAL_FRAME_BEGIN))
+        {
+          state::file_size = begin->file_size;
+          return true;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  /**
+   * @brief receive the window of the update file starting at an offset
+   * @param offset offset of the window in the update file
+   * @return true if the whole window was received
+   * @note the window is received in one go, as no data can be received while the flash is erased or programmed
+   */
+  bool receive_window(const uint32_t offset)
+  {
+    PROFILE_SCOPE(receive);
+
+    const uint32_t length = minimum(static_cast<uint32_t>(SERIAL_UPDATE_WINDOW_SIZE), state::file_size - offset);
+    state::window_offset = offset;
+    state::window_length = 0;
+
+    uint32_t retries = 0;
+    bool request = true;
+    while (state::window_length < length)
+    {
+      // a READ acknowledges everything before its offset, and makes the host send the rest of the window
+      if (request)
+      {
+        if (retries++ > max_retries)
+        {
+          logging::error("serial upload stalled\n");
+          return false;
+        }
+
+        const serial_read_t read = { .offset = offset + state::window_length, .length = length - state::window_length };
+        send(SERIAL_FRAME_READ, &read, sizeof(read));
+        request = false;
+      }
+
+      const received result = receive(SERIAL_UPDATE_TIMEOUT);
+      if (result != received::ok)
+      {
+        // the missing or corrupt frame may have been the next chunk
+        state::retries++;
+        request = true;
+        continue;
+      }
+
+      // chunks after a corrupt one, sent before the host got the new READ, are skipped
+      const serial_data_t *data = reinterpret_cast<const serial_data_t *>(state::rx.payload);
+      const uint32_t size = state::rx.length - sizeof(data->offset);
+      if (state::rx.type != SERIAL_FRAME_DATA || state::rx.length <= sizeof(data->offset) || data->offset != offset + state::window_length || size > length - state::window_length)
+      {
+        continue;
+      }
+
+      memcpy(state::window + state::window_length, data->data, size);
+      state::window_length += size;
+      retries = 0;
+    }
+
+    profiler::add_bytes(profiler::stage::receive, length);
+    return true;
+  }
+
+  /**
+   * @brief read the next bytes of the update file, like pf_read()
+   */
+  FRESULT read(void *buffer, UINT size, UINT *bytes_read)
+  {
+    *bytes_read = 0;
+    while (*bytes_read < size && state::position < state::file_size)
+    {
+      if (state::position < state::window_offset || state::position >= state::window_offset + state::window_length)
+      {
+        if (!receive_window(state::position))
+        {
+          return FR_DISK_ERR;
+        }
+      }
+
+      const uint32_t window_position = state::position - state::window_offset;
+      const uint32_t count = minimum(size - *bytes_read, state::window_length - window_position);
+      memcpy(static_cast<uint8_t *>(buffer) + *bytes_read, state::window + window_position, count);
+      state::position += count;
+      *bytes_read += count;
+    }
+
+    return FR_OK;
+  }
+
+  /**
+   * @brief move the read position in the update file, like pf_lseek(). skipped data is not transferred
+   */
+  FRESULT seek(DWORD offset)
+  {
+    state::position = minimum(static_cast<uint32_t>(offset), state::file_size);
+    return FR_OK;
+  }
+
+  /**
+   * @brief open the uploaded image from its start
+   */
+  bool open_image()
+  {
+    seek(0);
+    return image::open(state::file_size, &read, &seek);
+  }
+
+  bool get_update(flash::update_metadata &metadata)
+  {
+    if (!connect())
+    {
+      return false;
+    }
+
+    logging::log("serial update\n");
+    state::position = 0;
+    state::window_length = 0;
+    state::retries = 0;
+
+    // like the update file, the image is opened again if the application had to be hashed
+    const bool ok = state::file_size != 0
+                 && open_image()
+                 && sd::get_metadata(metadata)
+                 && (image::has_app_hash() || open_image())
+                 && metadata.app_size == image::get_app_size();
+    if (!ok)
+    {
+      end(false);
+    }
+
+    return ok;
+  }
+
+  void end(const bool installed)
+  {
+    const serial_end_t result = { .result = static_cast<uint8_t>(installed ? SERIAL_RESULT_INSTALLED : SERIAL_RESULT_FAILED) };
+    send(SERIAL_FRAME_END, &result, sizeof(result));
+    state::baudrate = HOST_SERIAL_BAUD;
+    hostSerial.set_baudrate(HOST_SERIAL_BAUD);
+
+    logging::log("serial: ");
+    logging::log(state::retries, 10);
+    logging::log(" retries\n");
+  }
+} // namespace serial_update
+
+#endif // ENABLE_SERIAL_UPDATE == 1
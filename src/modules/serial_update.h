@@ -0,0 +1,25 @@
+#pragma once
+#include "serial_update_format.h"
+#include "flash.h"
+#include "../config.h"
+
+namespace serial_update
+{
+  #if ENABLE_SERIAL_UPDATE == 1
+    /**
+     * @brief wait SERIAL_UPDATE_WAIT milliseconds for a host to start an upload, see serial_update_format.h
+     * @param metadata metadata object, filled from the uploaded image
+     * @return true if an upload was started and the uploaded image is valid.
+     * the upload is then opened as the image read by flash::apply_firmware_update()
+     * @note if an upload was started but the image is not valid, the upload is ended
+     */
+    bool get_update(flash::update_metadata &metadata);
+
+    /**
+     * @brief end the upload, telling the host the result, and return to HOST_SERIAL_BAUD
+     * @param installed is the uploaded application installed?
+     * @note call once the update is applied or skipped, if get_update() returned true
+     */
+    void end(const bool installed);
+  #endif
+} // namespace serial_update
@@ -0,0 +1,154 @@
+/**
+ * OpenHC32Boot serial update protocol.
+ *
+ * instead of the SD card, the update file can be uploaded over the host serial, using scripts/serial_upload.py.
+ * all messages are frames:
+ *   SERIAL_FRAME_SYNC, type, payload length (16 bit), payload, CRC32 of type, length and payload
+ * bytes outside of frames, e.g. log output of the bootloader, are ignored by both sides.
+ *
+ * 1. the host sends HELLO repeatedly while the printer resets. the bootloader listens for it for SERIAL_UPDATE_WAIT
+ *    milliseconds after boot, and answers with HELLO
+ * 2. optionally, the host raises the baud rate: it sends BAUD, the bootloader answers BAUD at the current baud rate
+ *    and both switch. the host then sends PING, which the bootloader echoes at the new baud rate. without a valid PING,
+ *    the bootloader returns to the previous baud rate SERIAL_UPDATE_TIMEOUT after its answer, and so does the host
+ *    without the echo. the host then continues within another SERIAL_UPDATE_TIMEOUT
+ * 3. the host sends BEGIN with the size of the update file
+ * 4. the bootloader reads the file in windows: it sends READ with an offset and a length, and the host sends the
+ *    requested bytes as DATA frames of at most SERIAL_CHUNK_SIZE bytes, back to back. a READ acknowledges all data
+ *    before its offset. after a corrupt or missing chunk, the bootloader sends READ from the chunk again, and the
+ *    host abandons the window it was sending
+ * 5. once done, the bootloader sends END with the result, returns to the initial baud rate and boots on
+ *
+ * CRC32 is the common CRC-32 (as used by zlib). all fields are little endian.
+ */
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief first byte of a frame
+ */
+#define SERIAL_FRAME_SYNC 0xA5
+
+/**
+ * @brief frame types
+ */
+#define SERIAL_FRAME_HELLO 'H'
+#define SERIAL_FRAME_BAUD 'B'
+#define SERIAL_FRAME_PING 'P'
+#define SERIAL_FRAME_BEGIN 'S'
+#define SERIAL_FRAME_READ 'R'
+#define SERIAL_FRAME_DATA 'D'
+#define SERIAL_FRAME_END 'E'
+
+/**
+ * @brief HELLO magic value, "OHBU"
+ */
+#define SERIAL_HELLO_MAGIC 0x5542484Ful
+
+/**
+ * @brief protocol version, in the HELLO of the bootloader
+ */
+#define SERIAL_PROTOCOL_VERSION 1
+
+/**
+ * @brief largest amount of file data in a DATA frame
+ */
+#define SERIAL_CHUNK_SIZE 512
+
+/**
+ * @brief largest payload of a frame: a DATA frame with a full chunk
+ */
+#define SERIAL_MAX_PAYLOAD (4 + SERIAL_CHUNK_SIZE)
+
+/**
+ * @brief END results
+ */
+#define SERIAL_RESULT_INSTALLED 0
+#define SERIAL_RESULT_FAILED 1
+
+/**
+ * @brief HELLO payload
+ */
+typedef struct serial_hello
+{
+  /**
+   * @brief SERIAL_HELLO_MAGIC
+   */
+  uint32_t magic;
+
+  /**
+   * @brief SERIAL_PROTOCOL_VERSION. 0 in the HELLO of the host
+   */
+  uint8_t version;
+
+  /**
+   * @brief reserved, 0
+   */
+  uint8_t reserved[3];
+
+  /**
+   * @brief largest length of a READ. 0 in the HELLO of the host
+   */
+  uint32_t window_size;
+} serial_hello_t;
+
+/**
+ * @brief BAUD payload: the baud rate to switch to. the bootloader answers 0 if it doesn't support it
+ */
+typedef struct serial_baud
+{
+  uint32_t baudrate;
+} serial_baud_t;
+
+/**
+ * @brief BEGIN payload
+ */
+typedef struct serial_begin
+{
+  /**
+   * @brief size of the update file, in bytes
+   */
+  uint32_t file_size;
+} serial_begin_t;
+
+/**
+ * @brief READ payload
+ */
+typedef struct serial_read
+{
+  /**
+   * @brief offset in the update file
+   */
+  uint32_t offset;
+
+  /**
+   * @brief number of bytes to send, in DATA frames
+   */
+  uint32_t length;
+} serial_read_t;
+
+/**
+ * @brief DATA payload: the offset of the data in the update file, followed by the data
+ */
+typedef struct serial_data
+{
+  uint32_t offset;
+  uint8_t data[SERIAL_CHUNK_SIZE];
+} serial_data_t;
+
+/**
+ * @brief END payload
+ */
+typedef struct serial_end
+{
+  /**
+   * @brief SERIAL_RESULT_*
+   */
+  uint8_t result;
+} serial_end_t;
+
+#ifdef __cplusplus
+  static_assert(sizeof(serial_hello_t) == 12, "serial_hello_t ABI changed");
+  static_assert(sizeof(serial_read_t) == 8, "serial_read_t ABI changed");
+  static_assert(sizeof(serial_data_t) == SERIAL_MAX_PAYLOAD, "serial_data_t ABI changed");
+#endif
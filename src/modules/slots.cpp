@@ -0,0 +1,258 @@
+#include "slots.h"
+
+#if ENABLE_AB_SLOTS == 1
+#include <hc32_ddl.h>
+#include <stddef.h>
+#include "crc.h"
+#include "flash.h"
+#include "integrity.h"
+#include "log.h"
+#include "trace.h"
+
+namespace slots
+{
+  /**
+   * @brief addresses of the sectors holding the slot record
+   */
+  constexpr uint32_t record_addresses[] = { SLOT_RECORD_ADDRESS_0, SLOT_RECORD_ADDRESS_1 };
+
+  /**
+   * @brief reasons of a record change, as recorded in the boot trace
+   */
+  enum change : uint8_t
+  {
+    activated = 0,
+    rolled_back = 1,
+  };
+
+  /**
+   * @brief is there room for slot B and the slot records?
+   */
+  bool has_slots()
+  {
+    return flash::get_flash_size() > SLOT_RECORD_ADDRESS_1;
+  }
+
+  /**
+   * @brief get the base address of a slot
+   */
+  uint32_t get_base(const uint32_t slot)
+  {
+    return slot == SLOT_B ? SLOT_B_ADDRESS : APP_BASE_ADDRESS;
+  }
+
+  /**
+   * @brief get the record in one of the record sectors
+   */
+  const slot_record_t &get_record(const int index)
+  {
+    return *flash::at<slot_record_t>(record_addresses[index]);
+  }
+
+  /**
+   * @brief check a record is complete
+   */
+  bool is_valid(const slot_record_t &record)
+  {
+    return record.magic == SLOT_RECORD_MAGIC
+        && (record.active == SLOT_A || record.active == SLOT_B)
+        && crc::calculate(reinterpret_cast<const uint32_t *>(&record), offsetof(slot_record_t, crc) / 4) == record.crc;
+  }
+
+  /**
+   * @brief find the current record: the valid one with the highest sequence
+   * @return the index of its sector, or -1 if there is none
+   */
+  int find_current()
+  {
+    if (!has_slots())
+    {
+      return -1;
+    }
+
+    int current = -1;
+    for (int i = 0; i < 2; i++)
+    {
+      if (is_valid(get_record(i)) && (current < 0 || get_record(i).sequence > get_record(current).sequence))
+      {
+        current = i;
+      }
+    }
+
+    return current;
+  }
+
+  /**
+   * @brief get the active slot, SLOT_A without a record
+   */
+  uint32_t get_active()
+  {
+    const int current = find_current();
+    return current < 0 ? SLOT_A : get_record(current).active;
+  }
+
+  /**
+   * @brief program words to erased flash
+   * @note flash must be unlocked
+   */
+  en_result_t program(const uint32_t address, const uint32_t *words, const uint32_t count)
+  {
+    for (uint32_t i = 0; i < count; i++)
+    {
+      const en_result_t rc = EFM_SingleProgramRB(address + (i * 4), words[i]);
+      if (rc != Ok)
+      {
+        trace::record(BOOT_TRACE_EVENT_FLASH_ERROR, rc, address + (i * 4), words[i]);
+        return rc;
+      }
+    }
+
+    return Ok;
+  }
+
+  /**
+   * @brief write a new record to the sector not holding the current one
+   * @param active the slot to boot
+   * @param confirmed is the slot confirmed already?
+   * @param reason the reason of the change, for the boot trace
+   */
+  bool write_record(const uint32_t active, const bool confirmed, const change reason)
+  {
+    const int current = find_current();
+    const uint32_t address = record_addresses[current == 0 ? 1 : 0];
+
+    slot_record_t record;
+    record.magic = SLOT_RECORD_MAGIC;
+    record.sequence = current < 0 ? 0 : get_record(current).sequence + 1;
+    record.active = active;
+    record.attempts = 0xFFFFFFFF;
+    record.confirmed = confirmed ? SLOT_CONFIRMED : 0xFFFFFFFF;
+    record.crc = crc::calculate(reinterpret_cast<const uint32_t *>(&record), offsetof(slot_record_t, crc) / 4);
+
+    EFM_Unlock();
+    EFM_FlashCmd(Enable);
+    while (EFM_GetFlagStatus(EFM_FLAG_RDY) != Set) { /* nada */ }
+
+    en_result_t rc = EFM_SectorErase(address);
+    if (rc != Ok)
+    {
+      trace::record(BOOT_TRACE_EVENT_ERASE_ERROR, rc, address);
+    }
+    else
+    {
+      rc = program(address, reinterpret_cast<const uint32_t *>(&record), sizeof(record) / 4);
+    }
+
+    EFM_Lock();
+
+    if (rc != Ok)
+    {
+      // the current record stays valid, so the active slot doesn't change
+      logging::error("writing slot record failed\n");
+      return false;
+    }
+
+    trace::record(BOOT_TRACE_EVENT_SLOT, reason, get_base(active), record.sequence);
+    return true;
+  }
+
+  uint32_t get_active_base()
+  {
+    return get_base(get_active());
+  }
+
+  uint32_t get_other_base()
+  {
+    return get_base(get_active() == SLOT_A ? SLOT_B : SLOT_A);
+  }
+
+  uint32_t get_update_base(const uint32_t target_address)
+  {
+    if (target_address >= APP_BASE_ADDRESS && target_address < SLOT_B_ADDRESS)
+    {
+      return APP_BASE_ADDRESS;
+    }
+
+    if (has_slots() && target_address >= SLOT_B_ADDRESS && target_address < flash::get_app_area_end(SLOT_B_ADDRESS))
+    {
+      return SLOT_B_ADDRESS;
+    }
+
+    return 0;
+  }
+
+  bool can_update(const uint32_t slot_base_address)
+  {
+    return slot_base_address != 0 && (!has_slots() || slot_base_address != get_active_base());
+  }
+
+  bool activate(const uint32_t slot_base_address)
+  {
+    // without slot B, slot A is always active
+    if (!has_slots())
+    {
+      return true;
+    }
+
+    logging::log("activating slot\n");
+    return write_record(slot_base_address == SLOT_B_ADDRESS ? SLOT_B : SLOT_A, false, change::activated);
+  }
+
+  bool count_boot()
+  {
+    const int current = find_current();
+    if (current < 0 || get_record(current).confirmed == SLOT_CONFIRMED)
+    {
+      return true;
+    }
+
+    // each boot clears one more bit, so the attempts are counted without erasing the record
+    const uint32_t attempts = get_record(current).attempts;
+    const uint32_t used = 32 - static_cast<uint32_t>(__builtin_popcount(attempts));
+    if (used >= SLOT_BOOT_ATTEMPTS)
+    {
+      logging::error("slot not confirmed\n");
+      return false;
+    }
+
+    EFM_Unlock();
+    EFM_FlashCmd(Enable);
+    while (EFM_GetFlagStatus(EFM_FLAG_RDY) != Set) { /* nada */ }
+
+    const uint32_t address = record_addresses[current] + offsetof(slot_record_t, attempts);
+    const uint32_t counted = attempts << 1;
+    const en_result_t rc = program(address, &counted, 1);
+    EFM_Lock();
+
+    if (rc != Ok)
+    {
+      // not fatal, the boot is counted again on the next one
+      logging::debug(LOG_STR("counting slot boot failed\n"));
+    }
+
+    return true;
+  }
+
+  bool can_roll_back()
+  {
+    if (!has_slots())
+    {
+      return false;
+    }
+
+    // only an application installed by the bootloader is known to be complete
+    const uint32_t base = get_other_base();
+    const flash::update_metadata *metadata = flash::update_metadata::get_stored(base);
+    return metadata->app_size != 0
+        && metadata->app_size <= (flash::update_metadata::get_start_address(flash::get_app_area_end(base) - 1) - base)
+        && integrity::matches(base, *metadata);
+  }
+
+  bool roll_back()
+  {
+    logging::log("rolling back slot\n");
+    return write_record(get_active() == SLOT_A ? SLOT_B : SLOT_A, true, change::rolled_back);
+  }
+} // namespace slots
+
+#endif // ENABLE_AB_SLOTS == 1
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include "slots_format.h"
+#include "../config.h"
+
+namespace slots
+{
+  #if ENABLE_AB_SLOTS == 1
+    /**
+     * @brief get the base address of the active slot
+     * @note slot A unless a slot record says otherwise, and always on MCUs with less than 512 KB of flash
+     */
+    uint32_t get_active_base();
+
+    /**
+     * @brief get the base address of the slot that isn't active
+     */
+    uint32_t get_other_base();
+
+    /**
+     * @brief get the base address of the slot an update is written to
+     * @param target_address an address in the flash area the update is built for, see image::get_target_address()
+     * @return the base address of that slot, or 0 if the update isn't built for a slot
+     */
+    uint32_t get_update_base(const uint32_t target_address);
+
+    /**
+     * @brief can an update be written to a slot? the active slot is never overwritten, unless it is the only one
+     * @param slot_base_address the base address of the slot, as returned by get_update_base()
+     */
+    bool can_update(const uint32_t slot_base_address);
+
+    /**
+     * @brief make a freshly installed slot the active one. it stays unconfirmed until the application confirms it
+     * @param slot_base_address the base address of the slot
+     * @return true if the slot record was written
+     */
+    bool activate(const uint32_t slot_base_address);
+
+    /**
+     * @brief count a boot of the active slot, if it is unconfirmed
+     * @return false if the active slot is unconfirmed and used up its SLOT_BOOT_ATTEMPTS, so it should be rolled back
+     */
+    bool count_boot();
+
+    /**
+     * @brief check the other slot holds an intact application installed by the bootloader
+     * @note hashes the whole application of the other slot
+     */
+    bool can_roll_back();
+
+    /**
+     * @brief make the other slot the active one, confirmed
+     * @return true if the slot record was written
+     */
+    bool roll_back();
+  #endif
+} // namespace slots
@@ -0,0 +1,90 @@
+/**
+ * OpenHC32Boot A/B slot layout.
+ *
+ * on MCUs with 512 KB of flash, the application flash can be split into two slots. updates are written to the slot
+ * that isn't running, so the running application stays intact until the update is complete:
+ * - slot A starts at APP_BASE_ADDRESS and ends at SLOT_B_ADDRESS
+ * - slot B starts at SLOT_B_ADDRESS and is as large as slot A
+ * each slot keeps the update metadata of its application at its end. an application runs from the slot it is built
+ * for, so an update must be built for the slot it replaces, e.g. using the linker script of that slot. the update file
+ * must be a raw binary or an image with a manifest, created with pack_image.py --load-address.
+ *
+ * the slot to boot is kept in a slot record, in one of two flash sectors. the valid record with the highest sequence
+ * is the current one, a new record is written to the other sector, so an interrupted write leaves the current one.
+ * a freshly installed slot is unconfirmed: the bootloader counts each boot of it in the attempts field, and rolls back
+ * to the other slot once SLOT_BOOT_ATTEMPTS boots passed without the application confirming it.
+ *
+ * to confirm, the application finds the current record and programs SLOT_CONFIRMED to its confirmed field,
+ * if it is still erased (0xFFFFFFFF). the record of the running slot can be read the same way.
+ *
+ * CRC32 is the common CRC-32 (as used by zlib). all fields are little endian.
+ */
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief start address of slot B, and end address of slot A
+ */
+#define SLOT_B_ADDRESS 0x40000ul
+
+/**
+ * @brief addresses of the two flash sectors holding the slot record
+ */
+#define SLOT_RECORD_ADDRESS_0 0x7C000ul
+#define SLOT_RECORD_ADDRESS_1 0x7E000ul
+
+/**
+ * @brief slot record magic value, "OHBR"
+ */
+#define SLOT_RECORD_MAGIC 0x5242484Ful
+
+/**
+ * @brief value of the confirmed field once the application confirmed the slot, "OHBC"
+ */
+#define SLOT_CONFIRMED 0x4342484Ful
+
+/**
+ * @brief values of the active field
+ */
+#define SLOT_A 0
+#define SLOT_B 1
+
+/**
+ * @brief the slot record, at the start of its flash sector
+ */
+typedef struct slot_record
+{
+  /**
+   * @brief SLOT_RECORD_MAGIC
+   */
+  uint32_t magic;
+
+  /**
+   * @brief incremented with every record written
+   */
+  uint32_t sequence;
+
+  /**
+   * @brief the slot to boot, SLOT_A or SLOT_B
+   */
+  uint32_t active;
+
+  /**
+   * @brief CRC32 of the fields before it
+   */
+  uint32_t crc;
+
+  /**
+   * @brief boots of the unconfirmed slot: starts erased, one more bit is cleared on each boot
+   */
+  uint32_t attempts;
+
+  /**
+   * @brief SLOT_CONFIRMED once the active slot is confirmed, erased (0xFFFFFFFF) until
+   */
+  uint32_t confirmed;
+} slot_record_t;
+
+#ifdef __cplusplus
+  static_assert(sizeof(slot_record_t) == 24, "slot_record_t ABI changed");
+#endif
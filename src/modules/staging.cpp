@@ -0,0 +1,100 @@
+#include "staging.h"
+
+#if ENABLE_STAGED_UPDATES == 1
+#include <hc32_ddl.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc.h"
+#include "image.h"
+#include "integrity.h"
+#include "log.h"
+#include "trace.h"
+
+namespace staging
+{
+  /**
+   * @brief is there room for the staging slot?
+   */
+  bool has_slot()
+  {
+    return flash::get_flash_size() >= STAGING_TRAILER_ADDRESS + flash::erase_sector_size;
+  }
+
+  /**
+   * @brief check the trailer is complete and describes an application that fits the slot
+   */
+  bool is_valid_trailer(const staging_trailer_t &trailer)
+  {
+    if (trailer.magic != STAGING_MAGIC)
+    {
+      return false;
+    }
+
+    if (crc::calculate(reinterpret_cast<const uint32_t *>(&trailer), offsetof(staging_trailer_t, crc) / 4) != trailer.crc)
+    {
+      logging::error("staged trailer corrupt\n");
+      return false;
+    }
+
+    if (trailer.hash_type != METADATA_HASH)
+    {
+      logging::error("staged hash type mismatch\n");
+      return false;
+    }
+
+    if (trailer.app_size == 0 || trailer.app_size > STAGING_SLOT_SIZE)
+    {
+      logging::error("staged app size invalid\n");
+      return false;
+    }
+
+    return true;
+  }
+
+  bool get_update(flash::update_metadata &metadata)
+  {
+    if (!has_slot())
+    {
+      return false;
+    }
+
+    const staging_trailer_t &trailer = *flash::at<staging_trailer_t>(STAGING_TRAILER_ADDRESS);
+    if (!is_valid_trailer(trailer))
+    {
+      return false;
+    }
+
+    logging::log("found staged update\n");
+    metadata.app_size = trailer.app_size;
+    memcpy(&metadata.hash, trailer.app_hash, sizeof(metadata.hash));
+
+    // the staged application is memory-mapped, so it is hashed in place
+    if (!integrity::matches(STAGING_SLOT_ADDRESS, metadata))
+    {
+      logging::error("staged app corrupt\n");
+      return false;
+    }
+
+    image::open_staged(STAGING_SLOT_ADDRESS, trailer.app_size);
+    return true;
+  }
+
+  void clear()
+  {
+    EFM_Unlock();
+    EFM_FlashCmd(Enable);
+    while (EFM_GetFlagStatus(EFM_FLAG_RDY) != Set) { /* nada */ }
+
+    const en_result_t rc = EFM_SectorErase(STAGING_TRAILER_ADDRESS);
+    EFM_Lock();
+
+    if (rc != Ok)
+    {
+      // not fatal, the installed update is skipped on the next boot and the trailer erased again
+      trace::record(BOOT_TRACE_EVENT_ERASE_ERROR, rc, STAGING_TRAILER_ADDRESS);
+      logging::error("clearing staged update failed\n");
+    }
+  }
+} // namespace staging
+
+#endif // ENABLE_STAGED_UPDATES == 1
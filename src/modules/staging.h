@@ -0,0 +1,24 @@
+#pragma once
+#include "staging_format.h"
+#include "flash.h"
+#include "../config.h"
+
+namespace staging
+{
+  #if ENABLE_STAGED_UPDATES == 1
+    /**
+     * @brief check the staging slot for an update staged by the application, see staging_format.h
+     * @param metadata metadata object, filled from the trailer
+     * @return true if the trailer is valid and the staged application matches its hash.
+     * the staged application is then opened as the image read by flash::apply_firmware_update()
+     * @note always false on MCUs with less than 512 KB of flash
+     */
+    bool get_update(flash::update_metadata &metadata);
+
+    /**
+     * @brief erase the trailer, so the staged update is not installed again
+     * @note call once the staged update is installed
+     */
+    void clear();
+  #endif
+} // namespace staging
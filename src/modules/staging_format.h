@@ -0,0 +1,81 @@
+/**
+ * OpenHC32Boot staging slot layout.
+ *
+ * on MCUs with 512 KB of flash, the application can stage an update in the upper half of the flash,
+ * which the bootloader installs on the next boot without an SD card. to stage an update, the application:
+ * 1. erases the staging slot and the trailer sector
+ * 2. writes the application binary, built for APP_BASE_ADDRESS, to STAGING_SLOT_ADDRESS
+ * 3. writes the trailer to STAGING_TRAILER_ADDRESS, last. updates without a valid trailer are ignored
+ * 4. resets the MCU
+ *
+ * the bootloader checks the staged application against the hash in the trailer, copies it to APP_BASE_ADDRESS
+ * and erases the trailer once the update is installed. a copy interrupted by a reset is resumed on the next boot.
+ * scripts/pack_image.py --staged creates the contents of the staging slot, from STAGING_SLOT_ADDRESS to the end
+ * of the trailer.
+ *
+ * the hash is calculated the way the bootloader calculates the update metadata hash, see image_format.h.
+ * all fields are little endian.
+ */
+#pragma once
+#include <stdint.h>
+#include "image_format.h"
+
+/**
+ * @brief start address of the staged application. the application itself must end before it
+ */
+#define STAGING_SLOT_ADDRESS 0x40000ul
+
+/**
+ * @brief address of the trailer, in a flash sector of its own right before the sector of the update metadata
+ */
+#define STAGING_TRAILER_ADDRESS 0x7C000ul
+
+/**
+ * @brief largest staged application, in bytes
+ */
+#define STAGING_SLOT_SIZE (STAGING_TRAILER_ADDRESS - STAGING_SLOT_ADDRESS)
+
+/**
+ * @brief trailer magic value, "OHBS"
+ */
+#define STAGING_MAGIC 0x5342484Ful
+
+/**
+ * @brief the trailer describing the staged application
+ */
+typedef struct staging_trailer
+{
+  /**
+   * @brief STAGING_MAGIC
+   */
+  uint32_t magic;
+
+  /**
+   * @brief size of the staged application, in bytes
+   */
+  uint32_t app_size;
+
+  /**
+   * @brief type of app_hash, IMAGE_HASH_*. must match the METADATA_HASH of the bootloader
+   */
+  uint8_t hash_type;
+
+  /**
+   * @brief reserved, 0
+   */
+  uint8_t reserved[3];
+
+  /**
+   * @brief hash of the staged application. CRC32 uses the first 4 bytes
+   */
+  uint8_t app_hash[32];
+
+  /**
+   * @brief CRC32 of all trailer bytes before it
+   */
+  uint32_t crc;
+} staging_trailer_t;
+
+#ifdef __cplusplus
+  static_assert(sizeof(staging_trailer_t) == 48, "staging_trailer_t ABI changed");
+#endif
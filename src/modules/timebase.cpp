@@ -0,0 +1,141 @@
+#include "timebase.h"
+#include <hc32_ddl.h>
+
+namespace timebase
+{
+  /**
+   * @brief number of ticks since init(). one tick is 1 ms
+   */
+  volatile uint32_t ticks = 0;
+
+  /**
+   * @brief function called on every tick
+   */
+  volatile tick_handler on_tick = nullptr;
+
+  /**
+   * @brief SysTick cycles per microsecond, set on init()
+   */
+  uint32_t cycles_per_us = 1;
+
+  /**
+   * @brief SysTick register values before init(), restored on deinit()
+   */
+  uint32_t saved_ctrl = 0;
+  uint32_t saved_load = 0;
+
+  void init()
+  {
+    saved_ctrl = SysTick->CTRL;
+    saved_load = SysTick->LOAD;
+
+    cycles_per_us = SystemCoreClock / 1000000ul;
+    ticks = 0;
+
+    // count HCLK cycles, interrupting every 1 ms
+    SysTick->CTRL = 0;
+    SysTick->LOAD = (SystemCoreClock / 1000ul) - 1;
+    SysTick->VAL = 0;
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+  }
+
+  void deinit()
+  {
+    SysTick->CTRL = 0;
+    on_tick = nullptr;
+
+    // a pending tick would otherwise be taken by the application's handler
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+
+    SysTick->LOAD = saved_load;
+    SysTick->VAL = 0;
+    SysTick->CTRL = saved_ctrl;
+  }
+
+  void set_tick_handler(const tick_handler handler)
+  {
+    on_tick = handler;
+  }
+
+  bool is_running()
+  {
+    return (SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) != 0;
+  }
+
+  /**
+   * @brief count a pending tick whose handler can't run
+   * @return true if a tick was counted
+   * @note interrupts must be disabled
+   */
+  bool take_pending_tick()
+  {
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) == 0)
+    {
+      return false;
+    }
+
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+    ticks = ticks + 1;
+    return true;
+  }
+
+  uint32_t now()
+  {
+    if (!is_running())
+    {
+      return 0;
+    }
+
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // in fault handlers or with interrupts disabled, the tick handler can't run, so ticks are counted here instead.
+    // in thread mode, a pending tick is left to the handler, so on_tick runs for every tick
+    const bool count_ticks = primask != 0 || __get_IPSR() != 0;
+    uint32_t value;
+    if (count_ticks)
+    {
+      take_pending_tick();
+      value = SysTick->VAL;
+
+      // the counter may have reloaded between checking for a tick and reading its value
+      if (take_pending_tick())
+      {
+        value = SysTick->VAL;
+      }
+    }
+    else
+    {
+      value = SysTick->VAL;
+
+      // let the tick handler run, then read the value again
+      while ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0)
+      {
+        __enable_irq();
+        __ISB();
+        __disable_irq();
+        value = SysTick->VAL;
+      }
+    }
+
+    const uint32_t us = (ticks * 1000ul) + ((SysTick->LOAD - value) / cycles_per_us);
+
+    if (primask == 0)
+    {
+      __enable_irq();
+    }
+    return us;
+  }
+} // namespace timebase
+
+extern "C" void SysTick_Handler(void)
+{
+  timebase::ticks = timebase::ticks + 1;
+
+  const timebase::tick_handler handler = timebase::on_tick;
+  if (handler != nullptr)
+  {
+    handler();
+  }
+}
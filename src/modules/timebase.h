@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+
+namespace timebase
+{
+  /**
+   * @brief start the time base, using SysTick with a 1 ms tick
+   * @note SystemCoreClock must be set up before
+   */
+  void init();
+
+  /**
+   * @brief stop the time base and restore the SysTick registers to their reset values
+   * @note must be called before jumping to the application
+   */
+  void deinit();
+
+  /**
+   * @brief function called on every tick, in interrupt context
+   */
+  typedef void (*tick_handler)(void);
+
+  /**
+   * @brief set the function called on every tick
+   * @param handler the function to call, or nullptr for none
+   * @note ticks counted by now() while the tick interrupt can't run do not call the handler
+   */
+  void set_tick_handler(const tick_handler handler);
+
+  /**
+   * @brief is the time base running?
+   */
+  bool is_running();
+
+  /**
+   * @brief get the time since init(), in microseconds
+   * @note wraps around after ~71 minutes. compare times only using differences, or use has_elapsed() or deadline
+   * @note works in fault handlers and with interrupts disabled, as long as it is called at least once per tick
+   */
+  uint32_t now();
+
+  /**
+   * @brief check if a duration has passed since a point in time, without blocking
+   * @param since the start time, as returned by now()
+   * @param duration the duration, in microseconds
+   * @return true if at least duration microseconds have passed since the start time
+   */
+  inline bool has_elapsed(const uint32_t since, const uint32_t duration)
+  {
+    // unsigned difference handles the wrap-around of now()
+    return (now() - since) >= duration;
+  }
+
+  /**
+   * @brief a point in time that expires after a duration
+   * @note durations must be less than half the wrap-around period of now() (~35 minutes)
+   */
+  class deadline
+  {
+  public:
+    /**
+     * @brief create a deadline
+     * @param duration the time until the deadline expires, in microseconds
+     */
+    deadline(const uint32_t duration) : at(now() + duration) {}
+
+    /**
+     * @brief has the deadline passed?
+     */
+    bool expired() const
+    {
+      // signed difference handles the wrap-around of now()
+      return static_cast<int32_t>(now() - at) >= 0;
+    }
+
+    /**
+     * @brief get the time until the deadline expires, in microseconds. 0 if expired
+     */
+    uint32_t remaining() const
+    {
+      const int32_t remaining = static_cast<int32_t>(at - now());
+      return remaining > 0 ? static_cast<uint32_t>(remaining) : 0;
+    }
+
+  private:
+    const uint32_t at;
+  };
+} // namespace timebase
@@ -0,0 +1,158 @@
+#include "trace.h"
+
+#if ENABLE_BOOT_TRACE == 1
+#include <hc32_ddl.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc.h"
+#include "log.h"
+#include "../util.h"
+
+namespace trace
+{
+  /**
+   * @brief the trace in retained RAM
+   */
+  #ifdef NATIVE_BUILD
+    #define TRACE (reinterpret_cast<boot_trace_t *>(native_ret_sram_base() + (BOOT_TRACE_ADDRESS - BOOT_TRACE_DEFAULT_ADDRESS)))
+  #else
+    #define TRACE (reinterpret_cast<boot_trace_t *>(BOOT_TRACE_ADDRESS))
+  #endif
+
+  /**
+   * @brief DWT cycle count at the last recorded event
+   */
+  uint32_t last_cycles = 0;
+
+  /**
+   * @brief time since init() at the last recorded event, in microseconds
+   */
+  uint32_t elapsed_us = 0;
+
+  /**
+   * @brief boot number of the previous boot, if its entries should be printed
+   */
+  bool print_previous_boot = false;
+  uint16_t previous_boot = 0;
+
+  /**
+   * @brief calculate the CRC of the trace, excluding the crc field
+   */
+  uint32_t get_crc(const boot_trace_t *trace)
+  {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(trace);
+    constexpr size_t crc_offset = offsetof(boot_trace_t, crc);
+    constexpr size_t entries_offset = offsetof(boot_trace_t, entries);
+
+    const uint32_t crc = crc::crc32(0, bytes, crc_offset);
+    return crc::crc32(crc, bytes + entries_offset, sizeof(boot_trace_t) - entries_offset);
+  }
+
+  /**
+   * @brief is the trace intact and of a compatible layout?
+   */
+  bool is_valid(const boot_trace_t *trace)
+  {
+    return trace->magic == BOOT_TRACE_MAGIC
+        && trace->version == BOOT_TRACE_VERSION
+        && trace->entry_size == sizeof(boot_trace_entry_t)
+        && trace->capacity == BOOT_TRACE_CAPACITY
+        && trace->crc == get_crc(trace);
+  }
+
+  /**
+   * @brief get the newest entry, or nullptr if the trace is empty
+   */
+  const boot_trace_entry_t *get_newest(const boot_trace_t *trace)
+  {
+    return trace->head != 0 ? &trace->entries[(trace->head - 1) % BOOT_TRACE_CAPACITY] : nullptr;
+  }
+
+  void init()
+  {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    last_cycles = DWT->CYCCNT;
+    elapsed_us = 0;
+
+    boot_trace_t *trace = TRACE;
+    const bool kept = is_valid(trace);
+    if (kept)
+    {
+      // print the previous boot if it didn't reach the application
+      const boot_trace_entry_t *newest = get_newest(trace);
+      print_previous_boot = newest != nullptr && newest->event != BOOT_TRACE_EVENT_JUMP;
+      previous_boot = trace->boot_count;
+      trace->boot_count++;
+    }
+    else
+    {
+      memset(trace, 0, sizeof(boot_trace_t));
+      trace->magic = BOOT_TRACE_MAGIC;
+      trace->version = BOOT_TRACE_VERSION;
+      trace->entry_size = sizeof(boot_trace_entry_t);
+      trace->capacity = BOOT_TRACE_CAPACITY;
+    }
+
+    record(BOOT_TRACE_EVENT_BOOT, 0, SystemCoreClock, kept ? 1 : 0);
+  }
+
+  void print_previous()
+  {
+    if (!print_previous_boot)
+    {
+      return;
+    }
+
+    logging::log("previous boot trace:\n", /*to_screen*/ false);
+
+    // print all entries of the previous boot, oldest first
+    const boot_trace_t *trace = TRACE;
+    const uint32_t count = minimum(trace->head, static_cast<uint32_t>(BOOT_TRACE_CAPACITY));
+    for (uint32_t i = trace->head - count; i != trace->head; i++)
+    {
+      const boot_trace_entry_t &entry = trace->entries[i % BOOT_TRACE_CAPACITY];
+      if (entry.boot != previous_boot)
+      {
+        continue;
+      }
+
+      // "trace: <timestamp> <event> <detail> <arg0> <arg1>", decoded by scripts/boot_trace.py
+      logging::log("trace: ", false);
+      logging::log(entry.timestamp_us, 10, false);
+      logging::log(" ", false);
+      logging::log(entry.event, 10, false);
+      logging::log(" ", false);
+      logging::log(entry.detail, 10, false);
+      logging::log(" 0x", false);
+      logging::log(entry.arg0, 16, false);
+      logging::log(" 0x", false);
+      logging::log(entry.arg1, 16, false);
+      logging::log("\n", false);
+    }
+
+    print_previous_boot = false;
+  }
+
+  void record(const boot_trace_event event, const uint8_t detail, const uint32_t arg0, const uint32_t arg1)
+  {
+    // accumulate time since the last event, so the clock may change in between
+    const uint32_t now = DWT->CYCCNT;
+    elapsed_us += (now - last_cycles) / (SystemCoreClock / 1000000ul);
+    last_cycles = now;
+
+    boot_trace_t *trace = TRACE;
+    boot_trace_entry_t &entry = trace->entries[trace->head % BOOT_TRACE_CAPACITY];
+    entry.timestamp_us = elapsed_us;
+    entry.event = static_cast<uint8_t>(event);
+    entry.detail = detail;
+    entry.boot = trace->boot_count;
+    entry.arg0 = arg0;
+    entry.arg1 = arg1;
+
+    trace->head++;
+    trace->crc = get_crc(trace);
+  }
+} // namespace trace
+
+#endif // ENABLE_BOOT_TRACE == 1
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include "boot_trace.h"
+#include "../config.h"
+
+namespace trace
+{
+  #if ENABLE_BOOT_TRACE == 1
+    /**
+     * @brief initialize the boot trace, keeping the entries of previous boots if the trace is intact.
+     * records the BOOT event
+     * @note call as early as possible, before any other event is recorded
+     */
+    void init();
+
+    /**
+     * @brief print the entries of the previous boot to the host serial, if the previous boot
+     * didn't end with a jump to the application
+     * @note call after logging was initialized
+     */
+    void print_previous();
+
+    /**
+     * @brief record an event
+     * @param event the event type
+     * @param detail event specific detail
+     * @param arg0 event specific argument
+     * @param arg1 event specific argument
+     */
+    void record(const boot_trace_event event, const uint8_t detail = 0, const uint32_t arg0 = 0, const uint32_t arg1 = 0);
+  #else
+    inline void init() {}
+    inline void print_previous() {}
+    inline void record(const boot_trace_event event, const uint8_t detail = 0, const uint32_t arg0 = 0, const uint32_t arg1 = 0) {}
+  #endif
+} // namespace trace
@@ -0,0 +1,475 @@
+/**
+ * native model of the Cortex-M4 core, clock, power and interrupt controllers
+ */
+#include "native.h"
+#include <hc32_ddl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <vector>
+
+//
+// core registers
+//
+SCB_Type native_scb = {
+  .CPUID = 0x410FC241ul, // Cortex-M4 r0p1
+};
+SysTick_Type native_systick = {
+  .CALIB = 0x80000000ul, // no reference clock
+};
+CoreDebug_Type native_core_debug = {};
+DWT_Type native_dwt = {};
+MPU_Type native_mpu = {
+  .TYPE = (8ul << MPU_TYPE_DREGION_Pos), // 8 regions
+};
+M4_INTC_TypeDef native_intc = {
+  .SEL0 = 0x1FFul, // reset value, no event selected
+  .SEL1 = 0x1FFul,
+  .SEL2 = 0x1FFul,
+  .SEL3 = 0x1FFul,
+};
+
+/**
+ * @brief HCLK after reset, running from the 8 MHz MRC
+ */
+constexpr uint32_t reset_clock = 8000000ul;
+uint32_t SystemCoreClock = reset_clock;
+
+// default interrupt handlers, overridden by the bootloader
+extern "C" __attribute__((weak)) void SysTick_Handler(void) {}
+extern "C" __attribute__((weak)) void IRQ000_Handler(void) {}
+extern "C" __attribute__((weak)) void IRQ001_Handler(void) {}
+extern "C" __attribute__((weak)) void IRQ002_Handler(void) {}
+extern "C" __attribute__((weak)) void IRQ003_Handler(void) {}
+
+namespace native
+{
+  const char *get_env(const char *name, const char *fallback)
+  {
+    const char *value = getenv(name);
+    return value != nullptr ? value : fallback;
+  }
+
+  void trace(const char *format, ...)
+  {
+    va_list args;
+    va_start(args, format);
+    fputs("[native] ", stderr);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+  }
+
+  namespace interrupts
+  {
+    typedef void (*handler_t)(void);
+
+    /**
+     * @brief handlers of the IRQs selected by INTC_SEL0 to INTC_SEL3
+     */
+    const handler_t handlers[] = {
+      IRQ000_Handler,
+      IRQ001_Handler,
+      IRQ002_Handler,
+      IRQ003_Handler,
+    };
+    constexpr int irq_count = sizeof(handlers) / sizeof(handlers[0]);
+
+    bool enabled[irq_count] = {};
+    bool primask = false;
+
+    /**
+     * @brief the IRQ currently being handled, -1 in thread mode
+     */
+    int active_irq = -1;
+
+    /**
+     * @brief value of active_irq while the SysTick handler runs
+     */
+    constexpr int systick_irq = -2;
+
+    std::vector<const source *> &get_sources()
+    {
+      static std::vector<const source *> sources;
+      return sources;
+    }
+
+    void add_source(const source *source)
+    {
+      get_sources().push_back(source);
+    }
+
+    /**
+     * @brief get the IRQ an event is routed to
+     * @return the IRQ number, or -1 if the event is not routed to an enabled IRQ
+     */
+    int get_irq(const uint32_t event)
+    {
+      const uint32_t *sel = &native_intc.SEL0;
+      for (int irq = 0; irq < irq_count; irq++)
+      {
+        if (sel[irq] == event && enabled[irq])
+        {
+          return irq;
+        }
+      }
+
+      return -1;
+    }
+
+    /**
+     * @brief find the earliest routed event that is due up to the given time
+     * @param limit the latest due time to consider
+     * @param due_at the due time of the found event
+     * @return the IRQ of the event, or -1 if none is due
+     */
+    int find_due(const uint64_t limit, uint64_t &due_at)
+    {
+      int irq = -1;
+      due_at = time::never;
+      for (const source *source : get_sources())
+      {
+        const uint64_t t = source->due_at();
+        const int source_irq = get_irq(source->event);
+        if (t <= limit && t < due_at && source_irq != -1)
+        {
+          irq = source_irq;
+          due_at = t;
+        }
+      }
+
+      return irq;
+    }
+  } // namespace interrupts
+
+  namespace time
+  {
+    uint64_t current = 0;
+  } // namespace time
+
+  namespace systick
+  {
+    /**
+     * @brief is the counter running?
+     */
+    bool running = false;
+
+    /**
+     * @brief simulated time the counter was started at
+     */
+    uint64_t started_at = 0;
+
+    /**
+     * @brief number of reloads since the counter was started
+     */
+    uint64_t reloads = 0;
+
+    /**
+     * @brief counter value last set by the model. any other value was written by the bootloader, clearing the counter
+     */
+    uint32_t synced_value = 0;
+
+    /**
+     * @brief get the number of HCLK cycles since the counter was started
+     */
+    uint64_t get_cycles(const uint64_t time)
+    {
+      return static_cast<uint64_t>((static_cast<unsigned __int128>(time - started_at) * SystemCoreClock) / 1000000000ull);
+    }
+
+    /**
+     * @brief update the counter value and tick pending flag to the given time.
+     * the counter starts when it is first seen enabled, and restarts when its value was written
+     */
+    void sync(const uint64_t time)
+    {
+      if ((native_systick.CTRL & SysTick_CTRL_ENABLE_Msk) == 0)
+      {
+        running = false;
+        return;
+      }
+
+      if (!running || native_systick.VAL != synced_value)
+      {
+        running = true;
+        started_at = time;
+        reloads = 0;
+      }
+
+      const uint64_t period = static_cast<uint64_t>(native_systick.LOAD) + 1;
+      const uint64_t cycles = get_cycles(time);
+      native_systick.VAL = static_cast<uint32_t>(native_systick.LOAD - (cycles % period));
+      synced_value = native_systick.VAL;
+
+      if ((cycles / period) > reloads)
+      {
+        reloads = cycles / period;
+        native_scb.ICSR = (native_scb.ICSR & ~SCB_ICSR_PENDSTCLR_Msk) | SCB_ICSR_PENDSTSET_Msk;
+      }
+    }
+
+    bool is_pending()
+    {
+      return (native_scb.ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+    }
+
+    /**
+     * @brief get the simulated time the tick interrupt becomes due at
+     */
+    uint64_t due_at()
+    {
+      if (!running || (native_systick.CTRL & SysTick_CTRL_TICKINT_Msk) == 0)
+      {
+        return time::never;
+      }
+
+      if (is_pending())
+      {
+        return time::current;
+      }
+
+      // round up, so the reload has happened at the returned time
+      const uint64_t period = static_cast<uint64_t>(native_systick.LOAD) + 1;
+      const unsigned __int128 cycles = static_cast<unsigned __int128>(reloads + 1) * period;
+      return started_at + static_cast<uint64_t>(((cycles * 1000000000ull) + SystemCoreClock - 1) / SystemCoreClock);
+    }
+  } // namespace systick
+
+  namespace time
+  {
+
+    uint64_t now()
+    {
+      return current;
+    }
+
+    /**
+     * @brief move the clock, keeping the cycle counter in sync
+     */
+    void set(const uint64_t time)
+    {
+      current = time;
+      native_dwt.CYCCNT = static_cast<uint32_t>((current * SystemCoreClock) / 1000000000ull);
+      systick::sync(current);
+    }
+
+    void advance_to(const uint64_t time)
+    {
+      // pick up changes to the SysTick configuration made since the clock last moved
+      systick::sync(current);
+
+      // interrupts can't preempt a running handler or masked code
+      while (interrupts::active_irq == -1 && !interrupts::primask)
+      {
+        uint64_t due_at;
+        const int irq = interrupts::find_due(time, due_at);
+
+        // SysTick takes precedence over the external interrupts
+        const uint64_t tick_due_at = systick::due_at();
+        if (tick_due_at <= time && tick_due_at <= due_at)
+        {
+          if (tick_due_at > current)
+          {
+            set(tick_due_at);
+          }
+
+          if (systick::is_pending())
+          {
+            native_scb.ICSR = SCB_ICSR_PENDSTCLR_Msk;
+            interrupts::active_irq = interrupts::systick_irq;
+            SysTick_Handler();
+            interrupts::active_irq = -1;
+          }
+          continue;
+        }
+
+        if (irq == -1)
+        {
+          break;
+        }
+
+        if (due_at > current)
+        {
+          set(due_at);
+        }
+
+        interrupts::active_irq = irq;
+        interrupts::handlers[irq]();
+        interrupts::active_irq = -1;
+      }
+
+      if (time > current)
+      {
+        set(time);
+      }
+    }
+
+    void advance(const uint64_t duration)
+    {
+      advance_to(current + duration);
+    }
+  } // namespace time
+
+  /**
+   * @brief print the simulation statistics
+   */
+  void print_stats()
+  {
+    fprintf(stderr, "[native] simulated time: %llu.%03llu ms\n",
+      static_cast<unsigned long long>(time::now() / 1000000ull),
+      static_cast<unsigned long long>((time::now() / 1000ull) % 1000ull));
+    efm::print_stats(stderr);
+    sdcard::print_stats(stderr);
+    usart::print_stats(stderr);
+  }
+
+  /**
+   * @brief end the simulation
+   * @param code the exit code
+   */
+  __attribute__((noreturn)) void end(const int code)
+  {
+    fflush(stdout);
+    print_stats();
+    exit(code);
+  }
+} // namespace native
+
+//
+// simulation end points
+//
+void native_jump(uint32_t app_base_address)
+{
+  native::trace("jump to application @ 0x%08X", app_base_address);
+  native::end(0);
+}
+
+void native_breakpoint(void)
+{
+  native::trace("breakpoint hit");
+  native::end(3);
+}
+
+void native_wait_for_interrupt(void)
+{
+  // nothing in the model can wake the core again
+  native::trace("core halted");
+  native::end(0);
+}
+
+void native_nop(void)
+{
+  // code takes no time in the model, so each iteration of a poll loop lets 10 us pass
+  native::time::advance(10000);
+}
+
+void __NVIC_SystemReset(void)
+{
+  native::trace("system reset");
+  native::end(2);
+}
+
+//
+// CMSIS core
+//
+void __disable_irq(void)
+{
+  native::interrupts::primask = true;
+
+  // critical sections read the SysTick registers, so they are brought up to date first
+  native::systick::sync(native::time::now());
+}
+
+void __enable_irq(void)
+{
+  native::interrupts::primask = false;
+  native::time::advance(0);
+}
+
+uint32_t __get_PRIMASK(void)
+{
+  return native::interrupts::primask ? 1u : 0u;
+}
+
+uint32_t __get_IPSR(void)
+{
+  // SysTick is exception number 15, external interrupts start at exception number 16
+  switch (native::interrupts::active_irq)
+  {
+  case -1:
+    return 0u;
+  case native::interrupts::systick_irq:
+    return 15u;
+  default:
+    return static_cast<uint32_t>(16 + native::interrupts::active_irq);
+  }
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority)
+{
+  // single priority level in the model
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+  native::interrupts::enabled[irq] = true;
+  native::time::advance(0);
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq)
+{
+  native::interrupts::enabled[irq] = false;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq)
+{
+  // events are level triggered in the model, nothing is latched
+}
+
+//
+// delays
+//
+void Ddl_Delay1ms(uint32_t u32Cnt)
+{
+  native::time::advance(u32Cnt * 1000000ull);
+}
+
+void Ddl_Delay1us(uint32_t u32Cnt)
+{
+  native::time::advance(u32Cnt * 1000ull);
+}
+
+//
+// CLK
+//
+stc_clk_sysclk_cfg_t clock_dividers = {};
+
+void CLK_SysClkConfig(const stc_clk_sysclk_cfg_t *pstcSysclkCfg)
+{
+  clock_dividers = *pstcSysclkCfg;
+}
+
+void CLK_GetClockFreq(stc_clk_freq_t *pstcClkFreq)
+{
+  const auto divide = [](const en_clk_sysclk_div_factor_t div) { return reset_clock >> static_cast<uint32_t>(div); };
+  pstcClkFreq->sysclkFreq = reset_clock;
+  pstcClkFreq->hclkFreq = divide(clock_dividers.enHclkDiv);
+  pstcClkFreq->exckFreq = divide(clock_dividers.enExclkDiv);
+  pstcClkFreq->pclk0Freq = divide(clock_dividers.enPclk0Div);
+  pstcClkFreq->pclk1Freq = divide(clock_dividers.enPclk1Div);
+  pstcClkFreq->pclk2Freq = divide(clock_dividers.enPclk2Div);
+  pstcClkFreq->pclk3Freq = divide(clock_dividers.enPclk3Div);
+  pstcClkFreq->pclk4Freq = divide(clock_dividers.enPclk4Div);
+}
+
+//
+// PWC
+//
+void PWC_Fcg0PeriphClockCmd(uint32_t u32Fcg0Periph, en_functional_state_t enNewState)
+{
+  // peripheral clocks are always on in the model
+}
+
+void PWC_Fcg1PeriphClockCmd(uint32_t u32Fcg1Periph, en_functional_state_t enNewState)
+{
+  // peripheral clocks are always on in the model
+}
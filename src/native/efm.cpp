@@ -0,0 +1,300 @@
+/**
+ * native model of the embedded flash (EFM), backed by a memory-mapped file.
+ *
+ * follows the HC32F460 semantics the bootloader relies on:
+ * - erase works on 8K sectors and sets all bits
+ * - programming can only clear bits, the read-back variant fails if the result doesn't match
+ * - erase and program require the EFM to be unlocked, and respect the programming window
+ * - the last 32 bytes of the 512K variant are reserved
+ * - the OTP area is read from NATIVE_OTP (1 KB, erased if not set), and can't be programmed
+ * - NATIVE_POWER_CUT cuts the power before the erase or program operation with this number, counting from 0
+ * erase and program times are approximate typical values, sequential programming saves the per-word setup time.
+ */
+#include "native.h"
+#include <hc32_ddl.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace native::efm
+{
+  /**
+   * @brief is the simulated chip the 256K variant? NATIVE_CHIP selects the variant (C = 256K, E = 512K)
+   */
+  bool is_256k()
+  {
+    return strcmp(get_env("NATIVE_CHIP", "E"), "C") == 0;
+  }
+} // namespace native::efm
+
+// FRANDS tells the variants apart, and is read before the flash is first accessed
+M4_EFM_TypeDef native_efm = []
+{
+  M4_EFM_TypeDef efm = {};
+  efm.FRANDS_f.FRANDS = native::efm::is_256k() ? 0x3fff : 0;
+  return efm;
+}();
+
+namespace native::efm
+{
+  constexpr uint32_t sector_size = 8192;
+  constexpr uint32_t reserved_size = 32;
+
+  constexpr uint64_t sector_erase_time = 20000000ull; // 20 ms
+  constexpr uint64_t word_program_time = 16000ull;    // 16 us
+  constexpr uint64_t word_sequence_time = 11000ull;   // 11 us, per word in sequential programming
+
+  uint8_t *flash = nullptr;
+  uint32_t flash_size = 0;
+
+  bool unlocked = false;
+
+  constexpr uint32_t otp_size = 1024;
+  uint8_t otp[otp_size];
+  bool otp_loaded = false;
+
+  struct
+  {
+    uint32_t sector_erases;
+    uint32_t words_programmed;
+    uint32_t errors;
+  } stats = {};
+
+  /**
+   * @brief cut the power before an erase or program operation, if NATIVE_POWER_CUT says so.
+   * the flash keeps what was erased and programmed before
+   */
+  void check_power()
+  {
+    static const char *power_cut = get_env("NATIVE_POWER_CUT", nullptr);
+    if (power_cut != nullptr && (stats.sector_erases + stats.words_programmed) >= strtoul(power_cut, nullptr, 0))
+    {
+      trace("power cut");
+      native::end(4);
+    }
+  }
+
+  /**
+   * @brief map the flash file, creating an erased flash of the variant if it doesn't exist yet.
+   * NATIVE_FLASH selects the file
+   */
+  void map()
+  {
+    flash_size = is_256k() ? 0x40000 : 0x80000;
+
+    const char *path = get_env("NATIVE_FLASH", "flash.bin");
+    const int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+      trace("cannot open flash file '%s'", path);
+      exit(1);
+    }
+
+    // new or shorter files are extended with erased flash
+    struct stat st;
+    fstat(fd, &st);
+    if (st.st_size < flash_size)
+    {
+      uint8_t erased[sector_size];
+      memset(erased, 0xFF, sizeof(erased));
+      for (off_t offset = st.st_size; offset < flash_size;)
+      {
+        const size_t length = sector_size - (offset % sector_size);
+        if (pwrite(fd, erased, length, offset) != static_cast<ssize_t>(length))
+        {
+          trace("cannot extend flash file '%s'", path);
+          exit(1);
+        }
+        offset += length;
+      }
+    }
+
+    void *mapped = mmap(nullptr, flash_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+      trace("cannot map flash file '%s'", path);
+      exit(1);
+    }
+
+    flash = static_cast<uint8_t *>(mapped);
+  }
+
+  uint8_t *get_flash()
+  {
+    if (flash == nullptr)
+    {
+      map();
+    }
+
+    return flash;
+  }
+
+  /**
+   * @brief load the OTP area from NATIVE_OTP. shorter files leave the rest erased
+   */
+  uint8_t *get_otp()
+  {
+    if (!otp_loaded)
+    {
+      memset(otp, 0xFF, otp_size);
+      const char *path = get_env("NATIVE_OTP", nullptr);
+      if (path != nullptr)
+      {
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0 || read(fd, otp, otp_size) < 0)
+        {
+          trace("cannot read OTP file '%s'", path);
+          exit(1);
+        }
+        close(fd);
+      }
+      otp_loaded = true;
+    }
+
+    return otp;
+  }
+
+  /**
+   * @brief can the address be erased or programmed?
+   */
+  bool is_writable(const uint32_t address)
+  {
+    get_flash();
+    if (!unlocked || address >= (flash_size - (flash_size == 0x80000 ? reserved_size : 0)))
+    {
+      return false;
+    }
+
+    // if start != end, only the window (start, end] may be erased or programmed
+    const uint32_t window_start = native_efm.FPMTSW_f.FPMTSW;
+    const uint32_t window_end = native_efm.FPMTEW_f.FPMTEW;
+    return window_start == window_end || (address > window_start && address <= window_end);
+  }
+
+  void print_stats(FILE *out)
+  {
+    fprintf(out, "[native] flash: %u sectors erased, %u words programmed, %u errors\n",
+      stats.sector_erases, stats.words_programmed, stats.errors);
+  }
+} // namespace native::efm
+
+uint8_t *native_flash_base(void)
+{
+  return native::efm::get_flash();
+}
+
+uint8_t *native_otp_base(void)
+{
+  return native::efm::get_otp();
+}
+
+void EFM_Unlock(void)
+{
+  native::efm::unlocked = true;
+}
+
+void EFM_Lock(void)
+{
+  native::efm::unlocked = false;
+}
+
+void EFM_FlashCmd(en_functional_state_t enNewState) {}
+
+en_flag_status_t EFM_GetFlagStatus(uint32_t u32flag)
+{
+  // the model is always ready
+  return Set;
+}
+
+en_result_t EFM_SectorErase(uint32_t u32Addr)
+{
+  using namespace native::efm;
+  const uint32_t sector_address = u32Addr & ~(sector_size - 1);
+  if (!is_writable(sector_address))
+  {
+    native::trace("sector erase @ 0x%08X rejected", sector_address);
+    stats.errors++;
+    return Error;
+  }
+
+  check_power();
+  memset(get_flash() + sector_address, 0xFF, sector_size);
+  stats.sector_erases++;
+  native::time::advance(sector_erase_time);
+  return Ok;
+}
+
+namespace native::efm
+{
+  /**
+   * @brief program a word, only clearing bits
+   * @param address the address to program
+   * @param data the data to program
+   * @param duration the time programming takes
+   * @return true if programming was accepted
+   */
+  bool program(const uint32_t address, const uint32_t data, const uint64_t duration)
+  {
+    if ((address % 4) != 0 || !is_writable(address))
+    {
+      native::trace("program @ 0x%08X rejected", address);
+      stats.errors++;
+      return false;
+    }
+
+    check_power();
+
+    // programming can only clear bits
+    uint32_t *word = reinterpret_cast<uint32_t *>(get_flash() + address);
+    *word &= data;
+    stats.words_programmed++;
+    native::time::advance(duration);
+    return true;
+  }
+} // namespace native::efm
+
+en_result_t EFM_SingleProgram(uint32_t u32Addr, uint32_t u32Data)
+{
+  // without read-back, a mismatch is not reported
+  native::efm::program(u32Addr, u32Data, native::efm::word_program_time);
+  return Ok;
+}
+
+en_result_t EFM_SingleProgramRB(uint32_t u32Addr, uint32_t u32Data)
+{
+  using namespace native::efm;
+  if (!program(u32Addr, u32Data, word_program_time))
+  {
+    return Error;
+  }
+
+  if (*reinterpret_cast<const uint32_t *>(get_flash() + u32Addr) != u32Data)
+  {
+    native::trace("program @ 0x%08X read-back mismatch, sector not erased?", u32Addr);
+    stats.errors++;
+    return Error;
+  }
+
+  return Ok;
+}
+
+en_result_t EFM_SequenceProgram(uint32_t u32Addr, uint32_t u32Len, void *pBuf)
+{
+  using namespace native::efm;
+  const uint32_t *data = static_cast<const uint32_t *>(pBuf);
+  for (uint32_t i = 0; i < (u32Len / 4); i++)
+  {
+    program(u32Addr + (i * 4), data[i], word_sequence_time);
+  }
+
+  return Ok;
+}
+
+stc_efm_unique_id_t EFM_ReadUID(void)
+{
+  return { 0x4E415449ul, 0x56450000ul, 0x00000001ul }; // "NATIVE"
+}
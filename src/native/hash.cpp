@@ -0,0 +1,154 @@
+/**
+ * native models of the HASH (SHA-256) and CRC peripherals.
+ *
+ * both reproduce what the peripherals return for the way the bootloader drives them:
+ * - HASH: HR7 holds the first word of the digest, HR0 the last
+ * - CRC: only CRC32 with input and output reflection is modelled.
+ *        every 32 bit write to DAT0 feeds all 4 bytes, least significant byte first
+ */
+#include "native.h"
+#include <hc32_ddl.h>
+#include <stdlib.h>
+#include <algorithm>
+
+namespace native::hash
+{
+  constexpr uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+  };
+
+  constexpr uint32_t initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+
+  inline uint32_t rotr(const uint32_t x, const uint32_t n)
+  {
+    return (x >> n) | (x << (32 - n));
+  }
+
+  /**
+   * @brief run the SHA-256 compression function on one block
+   * @param state the hash state, updated in place
+   * @param block the message block, as 16 big-endian words
+   */
+  void compress(uint32_t state[8], const uint32_t block[16])
+  {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+    {
+      w[i] = block[i];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+      const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+      const uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+      const uint32_t ch = (e & f) ^ (~e & g);
+      const uint32_t t1 = h + s1 + ch + k[i] + w[i];
+      const uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+      const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+      const uint32_t t2 = s0 + maj;
+
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+  }
+
+  /**
+   * @brief START written: process the block in DR15..DR0 and publish the state in HR7..HR0
+   */
+  void on_start_write(const uint32_t value)
+  {
+    if (value == 0)
+    {
+      return;
+    }
+
+    uint32_t state[8];
+    uint32_t *hr = &native_hash.HR7;
+    if (native_hash_cr_fst_grp.value != 0)
+    {
+      std::copy(initial_state, initial_state + 8, state);
+    }
+    else
+    {
+      std::copy(hr, hr + 8, state);
+    }
+
+    compress(state, &native_hash.DR15);
+    std::copy(state, state + 8, hr);
+  }
+
+  /**
+   * @brief START reads as 0, the calculation finishes instantly
+   */
+  uint32_t on_start_read(const uint32_t value)
+  {
+    return 0;
+  }
+} // namespace native::hash
+
+namespace native::crc
+{
+  constexpr uint32_t config_crc32_reflected = (0x1ul << 1u) | (0x1ul << 2u) | (0x1ul << 3u);
+  constexpr uint32_t config_mask = 0x1Eul;
+
+  /**
+   * @brief RESLT written: set the initial value
+   */
+  void on_result_write(const uint32_t value)
+  {
+    if ((native_crc.CR & config_mask) != config_crc32_reflected)
+    {
+      trace("CRC configuration 0x%02X is not modelled", native_crc.CR);
+      abort();
+    }
+  }
+
+  /**
+   * @brief DAT0 written: feed the 4 bytes of the word
+   */
+  void on_data_write(const uint32_t value)
+  {
+    uint32_t crc = native_crc.RESLT.value;
+    for (int i = 0; i < 32; i++)
+    {
+      const uint32_t bit = (crc ^ (value >> i)) & 1u;
+      crc = (crc >> 1) ^ (bit != 0 ? 0xEDB88320ul : 0u);
+    }
+    native_crc.RESLT.value = crc;
+  }
+} // namespace native::crc
+
+M4_HASH_TypeDef native_hash = {};
+native_register_hook native_hash_cr_start = { 0, native::hash::on_start_write, native::hash::on_start_read };
+native_register_hook native_hash_cr_fst_grp = { 0, nullptr, nullptr };
+
+M4_CRC_TypeDef native_crc = {
+  .CR = 0,
+  .RESLT = { 0, native::crc::on_result_write, nullptr },
+  .DAT0 = { 0, native::crc::on_data_write, nullptr },
+};
@@ -0,0 +1,514 @@
+/**
+ * host-side stand-in for the HC32F460 DDL, used by the native build.
+ * declares only what OpenHC32Boot uses, peripherals are modelled in src/native.
+ * register layouts only match the real ones where the bootloader depends on them.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// common types
+//
+typedef enum
+{
+  Ok = 0u,
+  Error = 1u,
+  ErrorAddressAlignment = 2u,
+  ErrorAccessRights = 3u,
+  ErrorInvalidParameter = 4u,
+  ErrorOperationInProgress = 5u,
+  ErrorInvalidMode = 6u,
+  ErrorUninitialized = 7u,
+  ErrorBufferFull = 8u,
+  ErrorTimeout = 9u,
+  ErrorNotReady = 10u,
+  OperationInProgress = 11u,
+} en_result_t;
+
+typedef enum
+{
+  Disable = 0u,
+  Enable = 1u,
+} en_functional_state_t;
+
+typedef enum
+{
+  Reset = 0u,
+  Set = 1u,
+} en_flag_status_t;
+
+extern uint32_t SystemCoreClock;
+
+void Ddl_Delay1ms(uint32_t u32Cnt);
+void Ddl_Delay1us(uint32_t u32Cnt);
+
+//
+// native build hooks
+//
+
+/**
+ * @brief get the host address of the simulated flash. flash address 0 maps to the returned pointer
+ */
+uint8_t *native_flash_base(void);
+
+/**
+ * @brief end the simulation when the bootloader jumps to the application
+ */
+void native_jump(uint32_t app_base_address);
+
+/**
+ * @brief get the host address of the simulated retention SRAM. address 0x200F0000 maps to the returned pointer
+ */
+uint8_t *native_ret_sram_base(void);
+
+/**
+ * @brief get the host address of the simulated OTP area. address 0x03000C00 maps to the returned pointer
+ */
+uint8_t *native_otp_base(void);
+
+//
+// CMSIS core
+//
+void native_breakpoint(void);
+#define __BKPT(value) native_breakpoint()
+void native_wait_for_interrupt(void);
+#define __WFI() native_wait_for_interrupt()
+void native_nop(void);
+#define __NOP() native_nop()
+#define __DSB()
+#define __ISB()
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+uint32_t __get_IPSR(void);
+#define __set_MSP(value) ((void)(value))
+void __NVIC_SystemReset(void);
+
+typedef enum
+{
+  Int000_IRQn = 0,
+  Int001_IRQn = 1,
+  Int002_IRQn = 2,
+  Int003_IRQn = 3,
+} IRQn_Type;
+#define DDL_IRQ_PRIORITY_DEFAULT 15u
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+typedef enum
+{
+  INT_USART1_TI = 279u,
+  INT_USART2_TI = 284u,
+  INT_USART3_TI = 289u,
+  INT_USART4_TI = 294u,
+} en_int_src_t;
+
+typedef struct
+{
+  uint32_t SEL0;
+  uint32_t SEL1;
+  uint32_t SEL2;
+  uint32_t SEL3;
+} M4_INTC_TypeDef;
+extern M4_INTC_TypeDef native_intc;
+#define M4_INTC (&native_intc)
+
+typedef struct
+{
+  uint32_t CPUID;
+  uint32_t ICSR;
+  uint32_t VTOR;
+  uint32_t CCR;
+  uint32_t CFSR;
+  uint32_t HFSR;
+  uint32_t DFSR;
+  uint32_t MMFAR;
+  uint32_t BFAR;
+  uint32_t AFSR;
+} SCB_Type;
+extern SCB_Type native_scb;
+#define SCB (&native_scb)
+
+#define SCB_ICSR_PENDSTSET_Msk (1ul << 26)
+#define SCB_ICSR_PENDSTCLR_Msk (1ul << 25)
+#define SCB_CCR_DIV_0_TRP_Msk (1ul << 4)
+#define SCB_CCR_UNALIGN_TRP_Msk (1ul << 3)
+#define SCB_CFSR_MMARVALID_Msk (1ul << 7)
+#define SCB_CFSR_BFARVALID_Msk (1ul << 15)
+
+typedef struct
+{
+  uint32_t CTRL;
+  uint32_t LOAD;
+  uint32_t VAL;
+  uint32_t CALIB;
+} SysTick_Type;
+extern SysTick_Type native_systick;
+#define SysTick (&native_systick)
+#define SysTick_CTRL_ENABLE_Msk (1ul << 0)
+#define SysTick_CTRL_TICKINT_Msk (1ul << 1)
+#define SysTick_CTRL_CLKSOURCE_Msk (1ul << 2)
+
+typedef struct
+{
+  uint32_t DHCSR;
+  uint32_t DEMCR;
+} CoreDebug_Type;
+extern CoreDebug_Type native_core_debug;
+#define CoreDebug (&native_core_debug)
+#define CoreDebug_DHCSR_C_DEBUGEN_Msk (1ul << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1ul << 24)
+
+typedef struct
+{
+  uint32_t CTRL;
+  uint32_t CYCCNT;
+} DWT_Type;
+extern DWT_Type native_dwt;
+#define DWT (&native_dwt)
+#define DWT_CTRL_CYCCNTENA_Msk (1ul << 0)
+
+#define __MPU_PRESENT 1
+typedef struct
+{
+  uint32_t TYPE;
+  uint32_t CTRL;
+  uint32_t RNR;
+  uint32_t RBAR;
+  uint32_t RASR;
+} MPU_Type;
+extern MPU_Type native_mpu;
+#define MPU (&native_mpu)
+
+#define MPU_TYPE_DREGION_Pos 8u
+#define MPU_TYPE_DREGION_Msk (0xFFul << MPU_TYPE_DREGION_Pos)
+#define MPU_CTRL_ENABLE_Msk (1ul << 0)
+#define MPU_CTRL_HFNMIENA_Msk (1ul << 1)
+#define MPU_CTRL_PRIVDEFENA_Msk (1ul << 2)
+#define MPU_RBAR_ADDR_Msk (0x7FFFFFFul << 5)
+#define MPU_RBAR_VALID_Msk (1ul << 4)
+#define MPU_RASR_XN_Msk (1ul << 28)
+#define MPU_RASR_AP_Pos 24u
+#define MPU_RASR_B_Pos 16u
+#define MPU_RASR_SIZE_Pos 1u
+#define MPU_RASR_ENABLE_Msk (1ul << 0)
+
+//
+// CLK
+//
+typedef enum
+{
+  ClkSysclkDiv1 = 0u,
+  ClkSysclkDiv2 = 1u,
+  ClkSysclkDiv4 = 2u,
+  ClkSysclkDiv8 = 3u,
+  ClkSysclkDiv16 = 4u,
+  ClkSysclkDiv32 = 5u,
+  ClkSysclkDiv64 = 6u,
+} en_clk_sysclk_div_factor_t;
+
+typedef struct
+{
+  en_clk_sysclk_div_factor_t enHclkDiv;
+  en_clk_sysclk_div_factor_t enExclkDiv;
+  en_clk_sysclk_div_factor_t enPclk0Div;
+  en_clk_sysclk_div_factor_t enPclk1Div;
+  en_clk_sysclk_div_factor_t enPclk2Div;
+  en_clk_sysclk_div_factor_t enPclk3Div;
+  en_clk_sysclk_div_factor_t enPclk4Div;
+} stc_clk_sysclk_cfg_t;
+
+typedef struct
+{
+  uint32_t sysclkFreq;
+  uint32_t hclkFreq;
+  uint32_t exckFreq;
+  uint32_t pclk0Freq;
+  uint32_t pclk1Freq;
+  uint32_t pclk2Freq;
+  uint32_t pclk3Freq;
+  uint32_t pclk4Freq;
+} stc_clk_freq_t;
+
+void CLK_SysClkConfig(const stc_clk_sysclk_cfg_t *pstcSysclkCfg);
+void CLK_GetClockFreq(stc_clk_freq_t *pstcClkFreq);
+
+//
+// PWC
+//
+#define PWC_FCG0_PERIPH_AES (1ul << 20)
+#define PWC_FCG0_PERIPH_CRC (1ul << 23)
+#define PWC_FCG0_PERIPH_HASH (1ul << 21)
+#define PWC_FCG1_PERIPH_USART1 (1ul << 24)
+#define PWC_FCG1_PERIPH_USART2 (1ul << 25)
+#define PWC_FCG1_PERIPH_USART3 (1ul << 26)
+#define PWC_FCG1_PERIPH_USART4 (1ul << 27)
+
+void PWC_Fcg0PeriphClockCmd(uint32_t u32Fcg0Periph, en_functional_state_t enNewState);
+void PWC_Fcg1PeriphClockCmd(uint32_t u32Fcg1Periph, en_functional_state_t enNewState);
+
+//
+// PORT / GPIO
+//
+typedef enum
+{
+  PortA = 0u,
+  PortB = 1u,
+  PortC = 2u,
+  PortD = 3u,
+  PortE = 4u,
+  PortH = 5u,
+} en_port_t;
+
+typedef enum
+{
+  Pin00 = (1u << 0),
+  Pin01 = (1u << 1),
+  Pin02 = (1u << 2),
+  Pin03 = (1u << 3),
+  Pin04 = (1u << 4),
+  Pin05 = (1u << 5),
+  Pin06 = (1u << 6),
+  Pin07 = (1u << 7),
+  Pin08 = (1u << 8),
+  Pin09 = (1u << 9),
+  Pin10 = (1u << 10),
+  Pin11 = (1u << 11),
+  Pin12 = (1u << 12),
+  Pin13 = (1u << 13),
+  Pin14 = (1u << 14),
+  Pin15 = (1u << 15),
+  PinAll = 0xFFFFu,
+} en_pin_t;
+
+typedef enum
+{
+  Func_Gpio = 0u,
+  Func_Usart1_Tx = 32u,
+  Func_Usart3_Tx = 32u,
+  Func_Usart1_Rx = 33u,
+  Func_Usart3_Rx = 33u,
+  Func_Usart2_Tx = 36u,
+  Func_Usart4_Tx = 36u,
+  Func_Usart2_Rx = 37u,
+  Func_Usart4_Rx = 37u,
+  Func_Sdio = 9u,
+} en_port_func_t;
+
+typedef struct
+{
+  uint16_t POUT : 1;
+  uint16_t POUTE : 1;
+  uint16_t NOD : 1;
+  uint16_t RESERVED3 : 1;
+  uint16_t DRV : 2;
+  uint16_t PUU : 1;
+  uint16_t RESERVED7 : 1;
+  uint16_t PIN : 1;
+  uint16_t INVE : 1;
+  uint16_t RESERVED10 : 2;
+  uint16_t INTE : 1;
+  uint16_t RESERVED13 : 1;
+  uint16_t LTE : 1;
+  uint16_t DDIS : 1;
+} stc_port_pcr_field_t;
+
+// same layout as the real PORT registers, since gpio.cpp calculates register addresses
+typedef struct
+{
+  uint16_t PIDRA;           // 0x000
+  uint16_t RESERVED0;
+  uint16_t PODRA;           // 0x004, PODRx at 0x004 + (0x10 * port)
+  uint8_t RESERVED1[0x3EE];
+  uint16_t PSPCR;           // 0x3F4
+  uint8_t RESERVED2[0x0A];
+  uint16_t PCRA0;           // 0x400, PCRxy at 0x400 + (0x40 * port) + (0x04 * pin)
+  uint8_t RESERVED3[0x17E];
+} M4_PORT_TypeDef;
+extern M4_PORT_TypeDef native_port;
+#define M4_PORT (&native_port)
+
+void PORT_Unlock(void);
+void PORT_Lock(void);
+en_result_t PORT_SetFunc(en_port_t enPort, uint16_t u16Pin, en_port_func_t enFuncSel, en_functional_state_t enSubFunc);
+en_flag_status_t PORT_GetBit(en_port_t enPort, en_pin_t enPin);
+
+//
+// EFM
+//
+typedef struct
+{
+  uint32_t uniqueID1;
+  uint32_t uniqueID2;
+  uint32_t uniqueID3;
+} stc_efm_unique_id_t;
+
+typedef struct
+{
+  struct { uint32_t FRANDS : 14; } FRANDS_f;
+  struct { uint32_t FPMTSW : 19; } FPMTSW_f;
+  struct { uint32_t FPMTEW : 19; } FPMTEW_f;
+} M4_EFM_TypeDef;
+extern M4_EFM_TypeDef native_efm;
+#define M4_EFM (&native_efm)
+
+#define EFM_FLAG_RDY (1ul << 8)
+
+void EFM_Unlock(void);
+void EFM_Lock(void);
+void EFM_FlashCmd(en_functional_state_t enNewState);
+en_flag_status_t EFM_GetFlagStatus(uint32_t u32flag);
+en_result_t EFM_SectorErase(uint32_t u32Addr);
+en_result_t EFM_SingleProgram(uint32_t u32Addr, uint32_t u32Data);
+en_result_t EFM_SingleProgramRB(uint32_t u32Addr, uint32_t u32Data);
+en_result_t EFM_SequenceProgram(uint32_t u32Addr, uint32_t u32Len, void *pBuf);
+stc_efm_unique_id_t EFM_ReadUID(void);
+
+//
+// USART
+//
+typedef struct
+{
+  struct { uint32_t PSC : 2; } PR_f;
+  struct { uint32_t OVER8 : 1; uint32_t FBME : 1; } CR1_f;
+  struct { uint32_t DIV_FRACTION : 7; uint32_t DIV_INTEGER : 8; } BRR_f;
+  int index;
+} M4_USART_TypeDef;
+extern M4_USART_TypeDef native_usart[4];
+#define M4_USART1 (&native_usart[0])
+#define M4_USART2 (&native_usart[1])
+#define M4_USART3 (&native_usart[2])
+#define M4_USART4 (&native_usart[3])
+
+typedef enum { UsartIntClkCkNoOutput = 0u, UsartIntClkCkOutput, UsartExtClk } en_usart_clk_mode_t;
+typedef enum { UsartClkDiv_1 = 0u, UsartClkDiv_4, UsartClkDiv_16, UsartClkDiv_64 } en_usart_clk_div_t;
+typedef enum { UsartDataBits8 = 0u, UsartDataBits9 } en_usart_data_len_t;
+typedef enum { UsartDataLsbFirst = 0u, UsartDataMsbFirst } en_usart_data_dir_t;
+typedef enum { UsartOneStopBit = 0u, UsartTwoStopBit } en_usart_stop_bit_t;
+typedef enum { UsartParityNone = 0u, UsartParityEven, UsartParityOdd } en_usart_parity_t;
+typedef enum { UsartSampleBit16 = 0u, UsartSampleBit8 } en_usart_sample_mode_t;
+typedef enum { UsartStartBitLowLvl = 0u, UsartStartBitFallEdge } en_usart_sb_detect_mode_t;
+typedef enum { UsartRtsEnable = 0u, UsartCtsEnable } en_usart_hw_flow_ctrl_t;
+
+typedef struct
+{
+  en_usart_clk_mode_t enClkMode;
+  en_usart_clk_div_t enClkDiv;
+  en_usart_data_len_t enDataLength;
+  en_usart_data_dir_t enDirection;
+  en_usart_stop_bit_t enStopBit;
+  en_usart_parity_t enParity;
+  en_usart_sample_mode_t enSampleMode;
+  en_usart_sb_detect_mode_t enDetectMode;
+  en_usart_hw_flow_ctrl_t enHwFlow;
+} stc_usart_uart_init_t;
+
+typedef enum
+{
+  UsartRx = 0u,
+  UsartRxInt,
+  UsartTx,
+  UsartTxEmptyInt,
+  UsartTimeOut,
+  UsartTimeOutInt,
+  UsartSilentMode,
+  UsartTxCmpltInt,
+  UsartTxAndTxEmptyInt,
+  UsartParityCheck,
+  UsartNoiseFilter,
+  UsartFracBaudrate,
+  UsartMulProcessor,
+  UsartSmartCard,
+  UsartCts,
+} en_usart_func_t;
+
+typedef enum
+{
+  UsartParityErr = (1u << 0),
+  UsartFrameErr = (1u << 1),
+  UsartOverrunErr = (1u << 3),
+  UsartRxNoEmpty = (1u << 5),
+  UsartTxComplete = (1u << 6),
+  UsartTxEmpty = (1u << 7),
+  UsartRxTimeOut = (1u << 8),
+  UsartRxMpb = (1u << 16),
+} en_usart_status_t;
+
+en_result_t USART_UART_Init(M4_USART_TypeDef *USARTx, const stc_usart_uart_init_t *pstcInitCfg);
+en_result_t USART_DeInit(M4_USART_TypeDef *USARTx);
+en_result_t USART_FuncCmd(M4_USART_TypeDef *USARTx, en_usart_func_t enFunc, en_functional_state_t enCmd);
+en_flag_status_t USART_GetStatus(M4_USART_TypeDef *USARTx, en_usart_status_t enStatus);
+en_result_t USART_ClearStatus(M4_USART_TypeDef *USARTx, en_usart_status_t enStatus);
+en_result_t USART_SendData(M4_USART_TypeDef *USARTx, uint16_t u16Data);
+uint16_t USART_RecData(M4_USART_TypeDef *USARTx);
+
+#ifdef __cplusplus
+} // extern "C"
+
+//
+// HASH, CRC and AES register models
+// writing START / DAT0 triggers the calculation in the model
+//
+struct native_register_hook
+{
+  uint32_t value;
+  void (*on_write)(uint32_t value);
+  uint32_t (*on_read)(uint32_t value);
+
+  native_register_hook &operator=(const uint32_t v)
+  {
+    value = v;
+    if (on_write != nullptr) on_write(v);
+    return *this;
+  }
+
+  operator uint32_t() const
+  {
+    return on_read != nullptr ? on_read(value) : value;
+  }
+};
+
+typedef struct
+{
+  uint32_t CR;
+  uint32_t HR7, HR6, HR5, HR4, HR3, HR2, HR1, HR0;
+  uint32_t DR15, DR14, DR13, DR12, DR11, DR10, DR9, DR8, DR7, DR6, DR5, DR4, DR3, DR2, DR1, DR0;
+} M4_HASH_TypeDef;
+extern M4_HASH_TypeDef native_hash;
+extern native_register_hook native_hash_cr_start;
+extern native_register_hook native_hash_cr_fst_grp;
+#define M4_HASH (&native_hash)
+#define bM4_HASH_CR_START native_hash_cr_start
+#define bM4_HASH_CR_FST_GRP native_hash_cr_fst_grp
+
+typedef struct
+{
+  uint32_t CR;
+  native_register_hook RESLT;
+  native_register_hook DAT0;
+} M4_CRC_TypeDef;
+extern M4_CRC_TypeDef native_crc;
+#define M4_CRC (&native_crc)
+
+typedef struct
+{
+  uint32_t CR;
+  uint32_t DR0, DR1, DR2, DR3;
+  uint32_t KR0, KR1, KR2, KR3;
+} M4_AES_TypeDef;
+extern M4_AES_TypeDef native_aes;
+extern native_register_hook native_aes_cr_start;
+extern native_register_hook native_aes_cr_mode;
+#define M4_AES (&native_aes)
+#define bM4_AES_CR_START native_aes_cr_start
+#define bM4_AES_CR_MODE native_aes_cr_mode
+
+#endif // __cplusplus
@@ -0,0 +1,2 @@
+#pragma once
+#include "hc32_ddl.h"
@@ -0,0 +1,75 @@
+/**
+ * host-side stand-in for the SD card middleware, used by the native build.
+ */
+#pragma once
+#include "hc32_ddl.h"
+
+typedef struct
+{
+  int index;
+} M4_SDIOC_TypeDef;
+extern M4_SDIOC_TypeDef native_sdioc[2];
+#define M4_SDIOC1 (&native_sdioc[0])
+#define M4_SDIOC2 (&native_sdioc[1])
+
+typedef enum
+{
+  SdiocBusWidth1Bit = 0u,
+  SdiocBusWidth4Bit = 1u,
+  SdiocBusWidth8Bit = 2u,
+} en_sdioc_bus_width_t;
+
+typedef enum
+{
+  SdiocClk400K = 400000u,
+  SdiocClk20M = 20000000u,
+  SdiocClk25M = 25000000u,
+  SdiocClk40M = 40000000u,
+  SdiocClk50M = 50000000u,
+} en_sdioc_clk_freq_t;
+
+typedef enum
+{
+  SdiocNormalSpeedMode = 0u,
+  SdiocHighSpeedMode = 1u,
+} en_sdioc_speed_mode_t;
+
+typedef enum
+{
+  SdCardDmaMode = 0u,
+  SdCardPollingMode = 1u,
+} en_sdcard_device_mode_t;
+
+typedef struct
+{
+  en_sdioc_bus_width_t enBusWidth;
+  en_sdioc_clk_freq_t enClkFreq;
+  en_sdioc_speed_mode_t enSpeedMode;
+  void *pstcInitCfg;
+} stc_sdcard_init_t;
+
+typedef struct
+{
+  uint32_t dummy;
+} stc_sdcard_dma_init_t;
+
+typedef struct
+{
+  M4_SDIOC_TypeDef *SDIOCx;
+  en_sdcard_device_mode_t enDevMode;
+  stc_sdcard_dma_init_t *pstcDmaInitCfg;
+  stc_sdcard_init_t *pstcCardInitCfg;
+  uint32_t u32ErrorCode;
+} stc_sd_handle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+en_result_t SDCARD_Init(stc_sd_handle_t *handle, stc_sdcard_init_t *pstcInitCfg);
+en_result_t SDCARD_GetCardCSD(stc_sd_handle_t *handle);
+en_result_t SDCARD_ReadBlocks(stc_sd_handle_t *handle, uint32_t u32BlockAddr, uint16_t u16BlockCnt, uint8_t *pu8Data, uint32_t u32Timeout);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+/**
+ * host-side stand-in for the linker script symbols, used by the native build.
+ * there is no linker script on the host, so the symbols describe a 12K bootloader without retained RAM data
+ */
+#pragma once
+#include <stdint.h>
+
+#define __etext_ret_ram (*reinterpret_cast<uint32_t *>(0x3000ul))
+#define __data_start_ret_ram__ (*reinterpret_cast<uint32_t *>(0x1FFF8000ul))
+#define __data_end_ret_ram__ (*reinterpret_cast<uint32_t *>(0x1FFF8000ul))
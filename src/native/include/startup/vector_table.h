@@ -0,0 +1,26 @@
+/**
+ * host-side stand-in for the vector table definition, used by the native build.
+ * the native build is 32-bit, so this matches the layout of a vector table in flash
+ */
+#pragma once
+#include <stdint.h>
+
+typedef void (*irq_vector_t)(void);
+
+typedef struct
+{
+  void *stackTop;
+  irq_vector_t reset;
+  irq_vector_t nmi;
+  irq_vector_t hardFault;
+  irq_vector_t memManageFault;
+  irq_vector_t busFault;
+  irq_vector_t usageFault;
+  irq_vector_t reserved1[4];
+  irq_vector_t svCall;
+  irq_vector_t debugMonitor;
+  irq_vector_t reserved2;
+  irq_vector_t pendSV;
+  irq_vector_t sysTick;
+  irq_vector_t irqs[144];
+} vector_table_t;
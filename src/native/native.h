@@ -0,0 +1,88 @@
+/**
+ * shared definitions of the native build peripheral models.
+ *
+ * the models run on simulated time: only waiting (delays, flash operations, serial transfers, SD reads)
+ * advances the clock, code execution itself takes no time.
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+namespace native
+{
+  namespace time
+  {
+    /**
+     * @brief marker for events that never happen
+     */
+    constexpr uint64_t never = UINT64_MAX;
+
+    /**
+     * @brief get the simulated time since reset, in nanoseconds
+     */
+    uint64_t now();
+
+    /**
+     * @brief let simulated time pass, servicing interrupts that become due
+     * @param duration the time to pass, in nanoseconds
+     */
+    void advance(const uint64_t duration);
+
+    /**
+     * @brief let simulated time pass up to the given point, servicing interrupts that become due
+     * @param time the point in simulated time to advance to. no effect if in the past
+     */
+    void advance_to(const uint64_t time);
+  } // namespace time
+
+  namespace interrupts
+  {
+    /**
+     * @brief a peripheral event that can be routed to an interrupt through the INTC
+     */
+    struct source
+    {
+      /**
+       * @brief the event number, as selected in INTC_SELx
+       */
+      uint32_t event;
+
+      /**
+       * @brief get the simulated time the event becomes due at
+       * @return the due time, or time::never if the event is disabled
+       */
+      uint64_t (*due_at)(void);
+    };
+
+    /**
+     * @brief register a peripheral event
+     * @param source the event. must stay valid for the whole simulation
+     */
+    void add_source(const source *source);
+  } // namespace interrupts
+
+  /**
+   * @brief get an environment variable
+   * @param name the name of the variable
+   * @param fallback the value to use if the variable is not set
+   */
+  const char *get_env(const char *name, const char *fallback);
+
+  /**
+   * @brief print a message of the native models to stderr
+   */
+  void trace(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+  /**
+   * @brief end the simulation, printing the statistics
+   * @param code the exit code
+   */
+  __attribute__((noreturn)) void end(const int code);
+
+  //
+  // statistics printed when the simulation ends
+  //
+  namespace efm { void print_stats(FILE *out); }
+  namespace sdcard { void print_stats(FILE *out); }
+  namespace usart { void print_stats(FILE *out); }
+} // namespace native
@@ -0,0 +1,24 @@
+/**
+ * native model of the PORT (GPIO) controller
+ */
+#include "native.h"
+#include <hc32_ddl.h>
+
+M4_PORT_TypeDef native_port = {};
+
+void PORT_Unlock(void) {}
+void PORT_Lock(void) {}
+
+en_result_t PORT_SetFunc(en_port_t enPort, uint16_t u16Pin, en_port_func_t enFuncSel, en_functional_state_t enSubFunc)
+{
+  // pin functions don't matter in the model
+  return Ok;
+}
+
+en_flag_status_t PORT_GetBit(en_port_t enPort, en_pin_t enPin)
+{
+  // nothing is connected, inputs read back the output register
+  const uint16_t *podr = reinterpret_cast<const uint16_t *>(
+    reinterpret_cast<const uint8_t *>(&native_port.PODRA) + (0x10u * enPort));
+  return (*podr & enPin) != 0 ? Set : Reset;
+}
@@ -0,0 +1,50 @@
+/**
+ * native model of the retention SRAM (Ret_SRAM), backed by a memory-mapped file (NATIVE_RET_SRAM, default 'ret_sram.bin').
+ *
+ * the contents survive between runs, like they survive a reset on the target.
+ * a new file starts with all zeros, while the target starts with random contents after power-on.
+ */
+#include "native.h"
+#include <hc32_ddl.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace native::ret_sram
+{
+  constexpr uint32_t size = 0x1000; // 4K
+
+  uint8_t *ram = nullptr;
+
+  void map()
+  {
+    const char *path = get_env("NATIVE_RET_SRAM", "ret_sram.bin");
+    const int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || ftruncate(fd, size) != 0)
+    {
+      trace("cannot open retention SRAM file '%s'", path);
+      exit(1);
+    }
+
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+      trace("cannot map retention SRAM file '%s'", path);
+      exit(1);
+    }
+
+    ram = static_cast<uint8_t *>(mapped);
+  }
+} // namespace native::ret_sram
+
+uint8_t *native_ret_sram_base(void)
+{
+  if (native::ret_sram::ram == nullptr)
+  {
+    native::ret_sram::map();
+  }
+
+  return native::ret_sram::ram;
+}
@@ -0,0 +1,112 @@
+/**
+ * native model of the SD card middleware, backed by a disk image file (NATIVE_SD_IMAGE, default 'sd.img').
+ *
+ * the image is addressed in 512 byte blocks, like a SDHC card.
+ * read times follow the configured bus width and clock, plus an approximate fixed access latency per command.
+ */
+#include "native.h"
+#include <sd_card.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+M4_SDIOC_TypeDef native_sdioc[2] = { { 0 }, { 1 } };
+
+namespace native::sdcard
+{
+  constexpr uint32_t block_size = 512;
+
+  /**
+   * @brief time from the read command to the first data block
+   */
+  constexpr uint64_t access_latency = 100000ull; // 100 us
+
+  /**
+   * @brief clock cycles for command and response, 48 bits each plus turnaround
+   */
+  constexpr uint64_t command_cycles = 48 + 48 + 8;
+
+  int image = -1;
+
+  struct
+  {
+    uint32_t commands;
+    uint32_t blocks_read;
+  } stats = {};
+
+  /**
+   * @brief get the time to transfer a number of clock cycles
+   */
+  uint64_t get_transfer_time(const stc_sdcard_init_t *config, const uint64_t cycles)
+  {
+    return (cycles * 1000000000ull) / static_cast<uint64_t>(config->enClkFreq);
+  }
+
+  /**
+   * @brief get the clock cycles to transfer one block, including start bit, CRC and end bit on each data line
+   */
+  uint64_t get_block_cycles(const stc_sdcard_init_t *config)
+  {
+    const uint32_t lines = config->enBusWidth == SdiocBusWidth8Bit ? 8
+                         : config->enBusWidth == SdiocBusWidth4Bit ? 4
+                         : 1;
+    return ((block_size * 8) / lines) + 1 + 16 + 1;
+  }
+
+  void print_stats(FILE *out)
+  {
+    fprintf(out, "[native] SD: %u read commands, %u blocks read\n", stats.commands, stats.blocks_read);
+  }
+} // namespace native::sdcard
+
+en_result_t SDCARD_Init(stc_sd_handle_t *handle, stc_sdcard_init_t *pstcInitCfg)
+{
+  using namespace native::sdcard;
+  handle->pstcCardInitCfg = pstcInitCfg;
+  handle->u32ErrorCode = 0;
+
+  if (image < 0)
+  {
+    const char *path = native::get_env("NATIVE_SD_IMAGE", "sd.img");
+    image = open(path, O_RDONLY);
+    if (image < 0)
+    {
+      native::trace("cannot open SD image '%s', no card inserted", path);
+      return Error;
+    }
+  }
+
+  // card identification runs at 400 kHz
+  native::time::advance(10000000ull); // 10 ms
+  return Ok;
+}
+
+en_result_t SDCARD_GetCardCSD(stc_sd_handle_t *handle)
+{
+  return native::sdcard::image >= 0 ? Ok : Error;
+}
+
+en_result_t SDCARD_ReadBlocks(stc_sd_handle_t *handle, uint32_t u32BlockAddr, uint16_t u16BlockCnt, uint8_t *pu8Data, uint32_t u32Timeout)
+{
+  using namespace native::sdcard;
+  if (image < 0)
+  {
+    return Error;
+  }
+
+  const size_t length = static_cast<size_t>(u16BlockCnt) * block_size;
+  const off_t offset = static_cast<off_t>(u32BlockAddr) * block_size;
+  if (pread(image, pu8Data, length, offset) != static_cast<ssize_t>(length))
+  {
+    handle->u32ErrorCode = 1;
+    return Error;
+  }
+
+  const stc_sdcard_init_t *config = handle->pstcCardInitCfg;
+  native::time::advance(access_latency
+    + get_transfer_time(config, command_cycles + (get_block_cycles(config) * u16BlockCnt)));
+
+  stats.commands++;
+  stats.blocks_read += u16BlockCnt;
+  return Ok;
+}
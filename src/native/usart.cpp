@@ -0,0 +1,344 @@
+/**
+ * native model of the USART peripherals.
+ *
+ * transmitted data goes to stdout for the host serial, and to a file for all other USARTs
+ * (NATIVE_USART<n> sets the path, default 'usart<n>.bin').
+ * transfer times follow the configured baud rate, with a one byte transmit buffer in front of the shift register.
+ *
+ * received data is read from the file set by NATIVE_USART<n>_RX (e.g. a pipe, or /dev/stdin), nothing is received
+ * without it. a byte is received one frame time after the previous one at the earliest, and polling for it waits
+ * up to a millisecond of real time for the sender, which passes in the simulation as well. received bytes are never
+ * lost to overruns.
+ */
+#include "native.h"
+#include <hc32_ddl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../config.h"
+
+M4_USART_TypeDef native_usart[4] = {};
+
+namespace native::usart
+{
+  struct usart_model
+  {
+    FILE *out;
+    bool tx_enabled;
+    bool tx_empty_interrupt;
+
+    /**
+     * @brief time at which the transmit buffer is empty again
+     */
+    uint64_t tx_empty_at;
+
+    /**
+     * @brief time at which the last byte is completely shifted out
+     */
+    uint64_t tx_complete_at;
+
+    uint32_t bytes_sent;
+
+    /**
+     * @brief file descriptor received data is read from, -1 if none
+     */
+    int rx_fd;
+    bool rx_enabled;
+
+    /**
+     * @brief the received byte waiting to be read, -1 if none, and the time it was received at
+     */
+    int rx_byte;
+    uint64_t rx_at;
+
+    uint32_t bytes_received;
+  };
+
+  usart_model models[4] = {
+    { .rx_fd = -1, .rx_byte = -1 },
+    { .rx_fd = -1, .rx_byte = -1 },
+    { .rx_fd = -1, .rx_byte = -1 },
+    { .rx_fd = -1, .rx_byte = -1 },
+  };
+
+  usart_model &get_model(const M4_USART_TypeDef *usart)
+  {
+    return models[usart - native_usart];
+  }
+
+  /**
+   * @brief get the time to transmit one frame (start bit, 8 data bits, stop bit)
+   * @return the frame time in nanoseconds, or 0 if no baud rate is configured
+   */
+  uint64_t get_frame_time(const M4_USART_TypeDef *usart)
+  {
+    // inverse of SetUartBaudrate_FP
+    const uint64_t clock = SystemCoreClock / (1ul << (2ul * usart->PR_f.PSC));
+    const uint64_t fraction = usart->CR1_f.FBME != 0 ? (128 + usart->BRR_f.DIV_FRACTION) : 256;
+    const uint64_t divider = 8ull * (2 - usart->CR1_f.OVER8) * (usart->BRR_f.DIV_INTEGER + 1) * 256;
+    const uint64_t baudrate = (clock * fraction) / divider;
+    return baudrate != 0 ? (10ull * 1000000000ull) / baudrate : 0;
+  }
+
+  /**
+   * @brief open the output of a USART
+   * @param index zero-based index of the USART
+   */
+  FILE *open_output(const int index)
+  {
+    #if HAS_SERIAL(HOST_SERIAL)
+      if (index == (HOST_SERIAL - 1))
+      {
+        return stdout;
+      }
+    #endif
+
+    char name[16];
+    snprintf(name, sizeof(name), "NATIVE_USART%d", index + 1);
+    char default_path[16];
+    snprintf(default_path, sizeof(default_path), "usart%d.bin", index + 1);
+
+    const char *path = get_env(name, default_path);
+    FILE *out = fopen(path, "wb");
+    if (out == nullptr)
+    {
+      trace("cannot open USART%d output '%s'", index + 1, path);
+    }
+    return out;
+  }
+
+  /**
+   * @brief open the received data of a USART
+   * @param index zero-based index of the USART
+   * @return the file descriptor, or -1 if nothing is received
+   */
+  int open_input(const int index)
+  {
+    char name[24];
+    snprintf(name, sizeof(name), "NATIVE_USART%d_RX", index + 1);
+    const char *path = get_env(name, nullptr);
+    if (path == nullptr)
+    {
+      return -1;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+      trace("cannot open USART%d input '%s'", index + 1, path);
+    }
+    return fd;
+  }
+
+  /**
+   * @brief poll for a received byte
+   * @return true if a byte is waiting to be read
+   */
+  bool poll_rx(usart_model &model, const M4_USART_TypeDef *usart)
+  {
+    const uint64_t frame_time = get_frame_time(usart);
+    uint64_t waited = frame_time != 0 ? frame_time : 10000;
+    if (model.rx_byte < 0 && model.rx_enabled && model.rx_fd >= 0)
+    {
+      // whoever sends may wait for our output first
+      if (model.out != nullptr)
+      {
+        fflush(model.out);
+      }
+
+      pollfd pfd = { .fd = model.rx_fd, .events = POLLIN, .revents = 0 };
+      uint8_t byte = 0;
+      if (poll(&pfd, 1, 1) > 0)
+      {
+        if (read(model.rx_fd, &byte, 1) == 1)
+        {
+          const uint64_t now = time::now();
+          model.rx_at = (model.rx_at + frame_time) > now ? (model.rx_at + frame_time) : now;
+          model.rx_byte = byte;
+        }
+        else
+        {
+          // the sender is gone
+          close(model.rx_fd);
+          model.rx_fd = -1;
+        }
+      }
+      else if (waited < 1000000)
+      {
+        // the real time waited for the sender passes in the simulation as well
+        waited = 1000000;
+      }
+    }
+
+    if (model.rx_byte >= 0)
+    {
+      time::advance_to(model.rx_at);
+      return true;
+    }
+
+    // polling takes at least as long as a frame, so timeouts expire
+    time::advance(waited);
+    return false;
+  }
+
+  /**
+   * @brief generate the interrupt event sources of a USART
+   */
+  template <int index>
+  uint64_t tx_empty_due_at()
+  {
+    const usart_model &model = models[index];
+    return (model.tx_enabled && model.tx_empty_interrupt) ? model.tx_empty_at : time::never;
+  }
+
+  const interrupts::source tx_empty_sources[] = {
+    { INT_USART1_TI, tx_empty_due_at<0> },
+    { INT_USART2_TI, tx_empty_due_at<1> },
+    { INT_USART3_TI, tx_empty_due_at<2> },
+    { INT_USART4_TI, tx_empty_due_at<3> },
+  };
+
+  struct register_sources
+  {
+    register_sources()
+    {
+      for (const interrupts::source &source : tx_empty_sources)
+      {
+        interrupts::add_source(&source);
+      }
+    }
+  } register_sources_instance;
+
+  void print_stats(FILE *out)
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      if (models[i].bytes_sent != 0)
+      {
+        fprintf(out, "[native] USART%d: %u bytes sent\n", i + 1, models[i].bytes_sent);
+      }
+      if (models[i].bytes_received != 0)
+      {
+        fprintf(out, "[native] USART%d: %u bytes received\n", i + 1, models[i].bytes_received);
+      }
+    }
+  }
+} // namespace native::usart
+
+en_result_t USART_UART_Init(M4_USART_TypeDef *USARTx, const stc_usart_uart_init_t *pstcInitCfg)
+{
+  native::usart::usart_model &model = native::usart::get_model(USARTx);
+  if (model.out == nullptr)
+  {
+    model.out = native::usart::open_output(USARTx - native_usart);
+  }
+  if (model.rx_fd < 0)
+  {
+    model.rx_fd = native::usart::open_input(USARTx - native_usart);
+  }
+
+  USARTx->PR_f.PSC = 0;
+  USARTx->CR1_f.OVER8 = pstcInitCfg->enSampleMode == UsartSampleBit8 ? 1u : 0u;
+  return Ok;
+}
+
+en_result_t USART_DeInit(M4_USART_TypeDef *USARTx)
+{
+  native::usart::usart_model &model = native::usart::get_model(USARTx);
+  model.tx_enabled = false;
+  model.tx_empty_interrupt = false;
+  model.rx_enabled = false;
+  if (model.out != nullptr)
+  {
+    fflush(model.out);
+  }
+  return Ok;
+}
+
+en_result_t USART_FuncCmd(M4_USART_TypeDef *USARTx, en_usart_func_t enFunc, en_functional_state_t enCmd)
+{
+  native::usart::usart_model &model = native::usart::get_model(USARTx);
+  const bool enable = enCmd == Enable;
+  switch (enFunc)
+  {
+  case UsartRx:
+    model.rx_enabled = enable;
+    break;
+  case UsartTx:
+    model.tx_enabled = enable;
+    break;
+  case UsartTxEmptyInt:
+    model.tx_empty_interrupt = enable;
+    break;
+  case UsartTxAndTxEmptyInt:
+    model.tx_enabled = enable;
+    model.tx_empty_interrupt = enable;
+    break;
+  default:
+    break;
+  }
+
+  // a newly enabled interrupt may be due right away
+  native::time::advance(0);
+  return Ok;
+}
+
+en_flag_status_t USART_GetStatus(M4_USART_TypeDef *USARTx, en_usart_status_t enStatus)
+{
+  // polling for a flag is modelled as waiting until it is set
+  native::usart::usart_model &model = native::usart::get_model(USARTx);
+  switch (enStatus)
+  {
+  case UsartRxNoEmpty:
+    return native::usart::poll_rx(model, USARTx) ? Set : Reset;
+  case UsartTxEmpty:
+    native::time::advance_to(model.tx_empty_at);
+    return Set;
+  case UsartTxComplete:
+    native::time::advance_to(model.tx_complete_at);
+    return Set;
+  default:
+    return Reset;
+  }
+}
+
+en_result_t USART_ClearStatus(M4_USART_TypeDef *USARTx, en_usart_status_t enStatus)
+{
+  return Ok;
+}
+
+en_result_t USART_SendData(M4_USART_TypeDef *USARTx, uint16_t u16Data)
+{
+  native::usart::usart_model &model = native::usart::get_model(USARTx);
+  if (!model.tx_enabled)
+  {
+    return Error;
+  }
+
+  // the byte moves to the shift register once the previous one is out
+  const uint64_t now = native::time::now();
+  const uint64_t start = model.tx_complete_at > now ? model.tx_complete_at : now;
+  model.tx_empty_at = start;
+  model.tx_complete_at = start + native::usart::get_frame_time(USARTx);
+
+  if (model.out != nullptr)
+  {
+    fputc(u16Data & 0xFF, model.out);
+  }
+  model.bytes_sent++;
+  return Ok;
+}
+
+uint16_t USART_RecData(M4_USART_TypeDef *USARTx)
+{
+  native::usart::usart_model &model = native::usart::get_model(USARTx);
+  if (model.rx_byte < 0)
+  {
+    return 0;
+  }
+
+  const uint16_t byte = static_cast<uint16_t>(model.rx_byte);
+  model.rx_byte = -1;
+  model.bytes_received++;
+  return byte;
+}
@@ -0,0 +1,29 @@
+import itertools
+import shutil
+
+import pytest
+
+import harness
+
+@pytest.fixture(scope="session")
+def bootloader(tmp_path_factory):
+    """Build the bootloader with extra build flags. Builds are shared by all tests using the same flags."""
+    if shutil.which("pio") is None:
+        pytest.skip("PlatformIO is required to build the native environment")
+
+    builds = {}
+    def get(*flags: str):
+        if flags not in builds:
+            builds[flags] = harness.build(flags, tmp_path_factory.mktemp("build"))
+        return builds[flags]
+    return get
+
+@pytest.fixture
+def board(bootloader, tmp_path):
+    """Create a simulated board running the bootloader built with extra build flags, with erased flash and an empty SD card."""
+    counter = itertools.count()
+    def make(*flags: str, chip: str = "E"):
+        directory = tmp_path / f"board{next(counter)}"
+        directory.mkdir()
+        return harness.Board(bootloader(*flags), directory, chip)
+    return make
@@ -0,0 +1,175 @@
+"""
+Helpers for the end-to-end tests, running the native build of the bootloader against simulated peripherals.
+
+Builds are made with 'pio run -e native', each set of build flags in its own build directory.
+"""
+import os
+import random
+import re
+import struct
+import subprocess
+import sys
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parents[2]
+sys.path.insert(0, str(ROOT / "scripts"))
+
+import make_sd_image # noqa: E402
+
+# application base address of all test builds, so images can be packed for it
+APP_BASE_ADDRESS = 0x6000
+
+# flags every test build starts from
+BASE_FLAGS = (
+    "-D CONFIG_PROFILE=CONFIG_PROFILE_FULL",
+    f"-D APP_BASE_ADDRESS={APP_BASE_ADDRESS:#x}",
+)
+
+SECTOR_SIZE = 8192
+FLASH_SIZE = {"C": 0x40000, "E": 0x80000}
+
+# exit codes of the native build
+EXIT_JUMP = 0
+EXIT_RESET = 2
+EXIT_BREAKPOINT = 3
+EXIT_POWER_CUT = 4
+
+STAT_PATTERNS = {
+    "time_ms": re.compile(r"simulated time: (\d+\.\d+) ms"),
+    "sectors_erased": re.compile(r"flash: (\d+) sectors erased"),
+    "words_programmed": re.compile(r"(\d+) words programmed"),
+    "flash_errors": re.compile(r"programmed, (\d+) errors"),
+    "sd_commands": re.compile(r"SD: (\d+) read commands"),
+    "sd_blocks": re.compile(r"(\d+) blocks read"),
+}
+
+# statistics the bootloader logs itself, at debug level
+LOG_STAT_PATTERNS = {
+    "sd_requested": re.compile(r"sd: (\d+) requested"),
+    "sd_reads": re.compile(r"requested, (\d+) reads"),
+    "sd_cached": re.compile(r"reads, (\d+) cached"),
+}
+
+def build(flags: tuple, build_dir: Path) -> Path:
+    """Build the native environment with extra build flags, returning the path of the program."""
+    env = dict(os.environ)
+    env["PLATFORMIO_BUILD_FLAGS"] = " ".join(BASE_FLAGS + tuple(flags))
+    env["PLATFORMIO_BUILD_DIR"] = str(build_dir)
+    subprocess.run(["pio", "run", "-e", "native"], cwd=ROOT, env=env, check=True,
+                   stdout=subprocess.DEVNULL)
+    return build_dir / "native" / "program"
+
+def make_app(size: int, seed: int = 0, base: int = APP_BASE_ADDRESS, compressible: bool = False) -> bytes:
+    """
+    Create a synthetic application: a vector table passing the pre-checks, followed by pseudo-random data.
+    compressible data repeats snippets, like code does.
+    """
+    rng = random.Random(seed)
+    handler = base + 0x400 + 1
+    vectors = [0x20010000] + [handler] * 6 + [0] * 4 + [handler] * 2 + [0] + [handler] * 2 + [handler] * 144
+    app = bytearray(struct.pack(f"<{len(vectors)}I", *vectors))
+
+    if compressible:
+        snippets = [bytes(rng.getrandbits(8) for _ in range(rng.randint(4, 24))) for _ in range(64)]
+        while len(app) < size:
+            app += rng.choice(snippets)
+    else:
+        app += bytes(rng.getrandbits(8) for _ in range(size - len(app)))
+
+    return bytes(app[:size])
+
+class Result:
+    """Outcome of a run of the native build."""
+
+    def __init__(self, process: subprocess.CompletedProcess):
+        self.exit_code = process.returncode
+        self.output = process.stdout
+        self.log = process.stdout.decode("latin-1")
+        self.trace = process.stderr.decode("latin-1")
+        self.stats = {}
+        for patterns, text in ((STAT_PATTERNS, self.trace), (LOG_STAT_PATTERNS, self.log)):
+            for name, pattern in patterns.items():
+                match = pattern.search(text)
+                if match:
+                    self.stats[name] = float(match.group(1)) if "." in match.group(1) else int(match.group(1))
+
+    @property
+    def jumped(self) -> bool:
+        """Did the bootloader jump to the application?"""
+        return self.exit_code == EXIT_JUMP and "jump to application" in self.trace
+
+    @property
+    def halted(self) -> bool:
+        """Did the bootloader stop at a breakpoint, e.g. a failed assertion?"""
+        return self.exit_code == EXIT_BREAKPOINT
+
+    @property
+    def power_cut(self) -> bool:
+        """Was the power cut, as set by NATIVE_POWER_CUT?"""
+        return self.exit_code == EXIT_POWER_CUT
+
+    @property
+    def flash_writes(self) -> int:
+        """Number of sector erases and programmed words."""
+        return self.stats["sectors_erased"] + self.stats["words_programmed"]
+
+    def __repr__(self):
+        return f"exit code {self.exit_code}\n--- log ---\n{self.log}\n--- trace ---\n{self.trace}"
+
+class Board:
+    """
+    A simulated board: flash, retention SRAM and SD card files of a native build, kept across runs like on a real board.
+    """
+
+    def __init__(self, program: Path, directory: Path, chip: str = "E"):
+        self.program = program
+        self.directory = directory
+        self.chip = chip
+        self.flash_path = directory / "flash.bin"
+        self.sd_path = directory / "sd.img"
+        self.env = {
+            "NATIVE_CHIP": chip,
+            "NATIVE_FLASH": str(self.flash_path),
+            "NATIVE_SD_IMAGE": str(self.sd_path),
+            "NATIVE_RET_SRAM": str(directory / "ret_sram.bin"),
+        }
+        for usart in range(1, 5):
+            self.env[f"NATIVE_USART{usart}"] = str(directory / f"usart{usart}.bin")
+
+        self.flash_path.write_bytes(b"\xFF" * FLASH_SIZE[chip])
+        self.insert_card({})
+
+    def insert_card(self, files: dict):
+        """Replace the SD card with one holding the given files, by name."""
+        make_sd_image.make_image(str(self.sd_path), list(files.items()), make_sd_image.MIN_SIZE_MB)
+
+    def read_flash(self, address: int, size: int) -> bytes:
+        with open(self.flash_path, "rb") as f:
+            f.seek(address)
+            return f.read(size)
+
+    def write_flash(self, address: int, data: bytes):
+        """Change the flash contents directly, as a debug probe would."""
+        with open(self.flash_path, "r+b") as f:
+            f.seek(address)
+            f.write(data)
+
+    def run(self, env: dict = None, timeout: float = 300) -> Result:
+        """Reset the board and run the bootloader until it jumps, resets or halts."""
+        run_env = dict(os.environ)
+        run_env.update(self.env)
+        run_env.update(env or {})
+        process = subprocess.run([str(self.program)], cwd=self.directory, env=run_env,
+                                 stdout=subprocess.PIPE, stderr=subprocess.PIPE, timeout=timeout)
+        return Result(process)
+
+def check_rejected(b: Board, image: bytes, message: str, installed: bytes = None):
+    """The image is rejected without writing the flash, and the installed application, if given, still boots."""
+    b.insert_card({"FIRMWARE.BIN": image})
+    result = b.run()
+    assert message in result.log, result
+    assert "update applied" not in result.log
+    assert result.flash_writes == 0
+    if installed is not None:
+        assert result.jumped, result
+        assert b.read_flash(APP_BASE_ADDRESS, len(installed)) == installed
@@ -0,0 +1,166 @@
+"""
+A/B application slots: updates written to the slot that isn't running, the slot record selecting the slot to boot,
+and the rollback of a slot its application didn't confirm.
+"""
+import struct
+import zlib
+
+from harness import APP_BASE_ADDRESS, make_app
+
+# slot layout, see modules/slots_format.h
+SLOT_B_ADDRESS = 0x40000
+SLOT_RECORD_ADDRESSES = (0x7C000, 0x7E000)
+SLOT_RECORD_FORMAT = "<6I"
+SLOT_RECORD_MAGIC = 0x5242484F
+SLOT_CONFIRMED = 0x4342484F
+SLOT_BOOT_ATTEMPTS = 3
+
+# slot B needs the 512K variant, which the board would override
+SLOT_FLAGS = ("-D ENABLE_AB_SLOTS=1", "-D CHIPID_VARIANT_OVERRIDE_ENABLE=0")
+
+def jumped_to(result, address: int) -> bool:
+    return result.jumped and f"jump to application @ 0x{address:08X}" in result.trace
+
+def get_record(b):
+    """Get the current slot record and its address, or None without one."""
+    current = None
+    for address in SLOT_RECORD_ADDRESSES:
+        data = b.read_flash(address, struct.calcsize(SLOT_RECORD_FORMAT))
+        magic, sequence, active, crc, attempts, confirmed = struct.unpack(SLOT_RECORD_FORMAT, data)
+        if magic == SLOT_RECORD_MAGIC and crc == zlib.crc32(data[:12]) and (current is None or sequence > current[1]["sequence"]):
+            current = (address, {"sequence": sequence, "active": active, "attempts": attempts, "confirmed": confirmed})
+    return current
+
+def confirm(b):
+    """Confirm the active slot, as its application would."""
+    address, _ = get_record(b)
+    b.write_flash(address + 20, struct.pack("<I", SLOT_CONFIRMED))
+
+def install(b, app: bytes, base: int):
+    b.insert_card({"FIRMWARE.BIN": app})
+    result = b.run()
+    assert "update applied" in result.log, result
+    assert jumped_to(result, base), result
+    assert b.read_flash(base, len(app)) == app
+    b.insert_card({})
+    return result
+
+def test_update_written_to_inactive_slot(board):
+    b = board(*SLOT_FLAGS)
+    app_b = make_app(30000, seed=1, base=SLOT_B_ADDRESS)
+    result = install(b, app_b, SLOT_B_ADDRESS)
+    assert "activating slot" in result.log
+    assert get_record(b)[1]["active"] == 1
+    print(f"update of slot B: {result.stats['time_ms']} ms, {result.stats['sectors_erased']} sectors erased")
+
+    # slot B keeps booting
+    result = b.run()
+    assert jumped_to(result, SLOT_B_ADDRESS), result
+
+    # the next update goes to slot A, leaving slot B intact
+    confirm(b)
+    app_a = make_app(30000, seed=2)
+    install(b, app_a, APP_BASE_ADDRESS)
+    assert get_record(b)[1]["active"] == 0
+    assert b.read_flash(SLOT_B_ADDRESS, len(app_b)) == app_b
+
+def test_update_for_active_slot_rejected(board):
+    b = board(*SLOT_FLAGS)
+    install(b, make_app(30000, seed=1, base=SLOT_B_ADDRESS), SLOT_B_ADDRESS)
+
+    b.insert_card({"FIRMWARE.BIN": make_app(30000, seed=2, base=SLOT_B_ADDRESS)})
+    result = b.run()
+    assert "update not for inactive slot" in result.log
+    assert jumped_to(result, SLOT_B_ADDRESS), result
+
+    # boots are counted, but no sector is erased
+    assert result.stats["sectors_erased"] == 0
+
+def test_update_for_no_slot_rejected(board):
+    b = board(*SLOT_FLAGS)
+    b.insert_card({"FIRMWARE.BIN": make_app(30000, base=0x10000000)})
+    result = b.run()
+    assert "update not for inactive slot" in result.log
+    assert result.flash_writes == 0
+
+def test_confirmed_slot_not_rolled_back(board):
+    b = board(*SLOT_FLAGS)
+    install(b, make_app(30000, seed=1, base=SLOT_B_ADDRESS), SLOT_B_ADDRESS)
+    confirm(b)
+    install(b, make_app(30000, seed=2), APP_BASE_ADDRESS)
+    confirm(b)
+
+    # a confirmed slot doesn't count its boots
+    attempts = get_record(b)[1]["attempts"]
+    for _ in range(SLOT_BOOT_ATTEMPTS + 2):
+        result = b.run()
+        assert jumped_to(result, APP_BASE_ADDRESS), result
+        assert "rolling back slot" not in result.log
+    assert get_record(b)[1]["attempts"] == attempts
+
+def test_unconfirmed_slot_rolled_back(board):
+    b = board(*SLOT_FLAGS)
+    install(b, make_app(30000, seed=1, base=SLOT_B_ADDRESS), SLOT_B_ADDRESS)
+    confirm(b)
+    install(b, make_app(30000, seed=2), APP_BASE_ADDRESS)
+
+    # the boot installing the update is the first attempt
+    for _ in range(SLOT_BOOT_ATTEMPTS - 1):
+        result = b.run()
+        assert jumped_to(result, APP_BASE_ADDRESS), result
+
+    result = b.run()
+    assert "slot not confirmed" in result.log
+    assert "rolling back slot" in result.log
+    assert jumped_to(result, SLOT_B_ADDRESS), result
+    _, record = get_record(b)
+    assert record["active"] == 1
+    assert record["confirmed"] == SLOT_CONFIRMED
+
+    # slot B stays active
+    result = b.run()
+    assert jumped_to(result, SLOT_B_ADDRESS), result
+
+def test_slot_failing_integrity_check_rolled_back(board):
+    b = board(*SLOT_FLAGS, "-D APP_INTEGRITY_CHECK=APP_INTEGRITY_CHECK_ALWAYS")
+    install(b, make_app(30000, seed=1, base=SLOT_B_ADDRESS), SLOT_B_ADDRESS)
+    confirm(b)
+    install(b, make_app(30000, seed=2), APP_BASE_ADDRESS)
+    confirm(b)
+
+    # the application of slot A is damaged after it confirmed itself
+    b.write_flash(APP_BASE_ADDRESS + 20000, b"\x00" * 4)
+    result = b.run()
+    assert "rolling back slot" in result.log, result
+    assert jumped_to(result, SLOT_B_ADDRESS), result
+
+def test_no_rollback_to_corrupt_slot(board):
+    b = board(*SLOT_FLAGS)
+    app_b = make_app(30000, seed=1, base=SLOT_B_ADDRESS)
+    install(b, app_b, SLOT_B_ADDRESS)
+    confirm(b)
+    install(b, make_app(30000, seed=2), APP_BASE_ADDRESS)
+
+    # slot B no longer matches its update metadata, so the unconfirmed slot A is booted anyway
+    b.write_flash(SLOT_B_ADDRESS + 20000, b"\x00" * 4)
+    for _ in range(SLOT_BOOT_ATTEMPTS + 1):
+        result = b.run()
+        assert jumped_to(result, APP_BASE_ADDRESS), result
+        assert "rolling back slot" not in result.log
+
+def test_only_slot_a_on_256k_chip(board):
+    b = board(*SLOT_FLAGS, chip="C")
+    b.insert_card({"FIRMWARE.BIN": make_app(30000, base=SLOT_B_ADDRESS)})
+    result = b.run()
+    assert "update not for inactive slot" in result.log
+    assert result.flash_writes == 0
+
+    # slot A is always active, and is updated in place
+    for seed in (1, 2):
+        app = make_app(30000, seed=seed)
+        b.insert_card({"FIRMWARE.BIN": app})
+        result = b.run()
+        assert "update applied" in result.log
+        assert "activating slot" not in result.log
+        assert jumped_to(result, APP_BASE_ADDRESS), result
+        assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
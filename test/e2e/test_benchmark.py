@@ -0,0 +1,45 @@
+"""
+Benchmark profile: the flash benchmark uses the free sector after the installed application as scratch area,
+and leaves the application, its metadata and all other flash contents as they were.
+"""
+from harness import APP_BASE_ADDRESS, FLASH_SIZE, SECTOR_SIZE, make_app
+
+BENCHMARK_FLAGS = ("-U CONFIG_PROFILE", "-D CONFIG_PROFILE=CONFIG_PROFILE_BENCHMARK")
+
+def install(board, app: bytes, chip: str):
+    """Install an application with the default profile, then return a benchmark board with the same flash."""
+    b = board(chip=chip)
+    b.insert_card({"FIRMWARE.BIN": app})
+    assert b.run().jumped
+
+    bench = board(*BENCHMARK_FLAGS, chip=chip)
+    bench.flash_path.write_bytes(b.flash_path.read_bytes())
+    return bench
+
+def run_benchmark(b, chip: str):
+    flash = b.read_flash(0, FLASH_SIZE[chip])
+    result = b.run()
+    assert b.read_flash(0, FLASH_SIZE[chip]) == flash
+    return result
+
+def test_scratch_sector_after_app(board):
+    b = install(board, make_app(30000), "C")
+    result = run_benchmark(b, "C")
+    assert "bench: efm_program strategy=sequence" in result.log, result
+    assert "efm_erase error" not in result.log
+
+def test_skipped_without_free_sector(board):
+    # the application ends in the sector before the one holding the update metadata
+    metadata_sector = FLASH_SIZE["C"] - SECTOR_SIZE
+    b = install(board, make_app(metadata_sector - SECTOR_SIZE - APP_BASE_ADDRESS + 100), "C")
+    result = run_benchmark(b, "C")
+    assert "no free flash sector after the app" in result.log, result
+    assert result.stats["sectors_erased"] == 0
+
+def test_skipped_without_metadata(board):
+    # an application written using a debugger has no metadata, so its end isn't known
+    b = board(*BENCHMARK_FLAGS, chip="C")
+    b.write_flash(APP_BASE_ADDRESS, make_app(30000))
+    result = run_benchmark(b, "C")
+    assert "no free flash sector after the app" in result.log, result
+    assert result.stats["sectors_erased"] == 0
@@ -0,0 +1,109 @@
+"""
+Boot trace: the trace the bootloader records in retention SRAM decodes on the host,
+both from a memory dump and from the lines printed after a failed boot.
+"""
+import pytest
+
+import pack_image
+from boot_trace import decode_dump, decode_log, HEADER_SIZE
+from harness import APP_BASE_ADDRESS, SECTOR_SIZE, make_app
+
+TRACE_FLAGS = ("-D ENABLE_BOOT_TRACE=1",)
+
+EVENT_BOOT = 1
+EVENT_STAGE_ENTER = 2
+EVENT_STAGE_EXIT = 3
+EVENT_PRE_CHECK_FAIL = 8
+EVENT_UPDATE = 12
+EVENT_JUMP = 13
+EVENT_INTEGRITY = 16
+
+STAGE_ERASE = 3
+STAGE_WRITE = 4
+
+def read_trace(b) -> list:
+    return decode_dump((b.directory / "ret_sram.bin").read_bytes())
+
+def test_update_boot_decodes(board):
+    b = board(*TRACE_FLAGS)
+    b.insert_card({"FIRMWARE.BIN": make_app(30000)})
+    assert b.run().jumped
+
+    entries = read_trace(b)
+    events = [entry[2] for entry in entries]
+    assert events[0] == EVENT_BOOT
+    assert events[-1] == EVENT_JUMP
+    assert entries[-1][4] == APP_BASE_ADDRESS
+    assert (EVENT_UPDATE, 1) in [(entry[2], entry[3]) for entry in entries]
+
+    # stages are entered and exited in pairs, at increasing times
+    assert events.count(EVENT_STAGE_ENTER) == events.count(EVENT_STAGE_EXIT) > 0
+    timestamps = [entry[1] for entry in entries]
+    assert timestamps == sorted(timestamps)
+
+def test_delta_update_keeps_boot_entries(board):
+    # a delta update erases and writes one sector at a time, which must not flood the ring
+    b = board(*TRACE_FLAGS, "-D ENABLE_DELTA_IMAGES=1")
+    old = make_app(24 * SECTOR_SIZE, seed=1)
+    b.insert_card({"FIRMWARE.BIN": old})
+    assert b.run().jumped
+
+    new = bytearray(old)
+    new[12 * SECTOR_SIZE + 100] ^= 0xFF
+    b.insert_card({"FIRMWARE.BIN": pack_image.pack(bytes(new), False, 0, source=old)})
+    assert b.run().jumped
+    assert b.read_flash(APP_BASE_ADDRESS, len(new)) == new
+
+    entries = [entry for entry in read_trace(b) if entry[0] == 1]
+    events = [entry[2] for entry in entries]
+    assert events[0] == EVENT_BOOT
+    assert events[-1] == EVENT_JUMP
+    stages = [entry[3] for entry in entries if entry[2] == EVENT_STAGE_ENTER]
+    assert stages.count(STAGE_ERASE) == stages.count(STAGE_WRITE) == 1, stages
+
+def test_trace_is_kept_across_boots(board):
+    b = board(*TRACE_FLAGS)
+    b.insert_card({"FIRMWARE.BIN": make_app(30000)})
+    b.run()
+
+    # boots without update are short, so the ring holds both
+    b.insert_card({})
+    b.run()
+    b.run()
+
+    boots = [entry for entry in read_trace(b) if entry[2] == EVENT_BOOT]
+    assert [entry[0] for entry in boots] == [1, 2]
+    assert boots[1][5] == 1
+
+def test_failed_boot_is_printed_on_next_boot(board):
+    b = board(*TRACE_FLAGS, "-D APP_INTEGRITY_CHECK=APP_INTEGRITY_CHECK_ALWAYS")
+    b.insert_card({"FIRMWARE.BIN": make_app(30000)})
+    assert b.run().jumped
+
+    # damage the installed application, so the integrity check stops the next boot
+    b.write_flash(APP_BASE_ADDRESS + 20000, b"\x00" * 4)
+    assert b.run().halted
+    failed_boot = [entry for entry in read_trace(b) if entry[0] == 1]
+    assert (EVENT_INTEGRITY, 0) in [(entry[2], entry[3]) for entry in failed_boot]
+    assert failed_boot[-1][2] != EVENT_JUMP
+
+    # the boot after prints the entries of the failed boot, which decode like the dump
+    result = b.run()
+    printed = decode_log(result.log.splitlines())
+    assert [entry[1:] for entry in printed] == [entry[1:] for entry in failed_boot]
+
+def test_damaged_trace_is_reset(board):
+    b = board(*TRACE_FLAGS)
+    b.run()
+
+    path = b.directory / "ret_sram.bin"
+    dump = bytearray(path.read_bytes())
+    dump[HEADER_SIZE] ^= 0xFF
+    path.write_bytes(dump)
+    with pytest.raises(ValueError, match="CRC"):
+        decode_dump(bytes(dump))
+
+    b.run()
+    entries = read_trace(b)
+    assert entries[0][2] == EVENT_BOOT
+    assert entries[0][5] == 0
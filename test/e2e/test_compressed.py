@@ -0,0 +1,99 @@
+"""
+Compressed images: packed by pack_image.py, decompressed by the bootloader while it is writing the flash.
+"""
+import re
+import resource
+
+import pack_image
+from harness import APP_BASE_ADDRESS, make_app
+
+COMPRESSED_FLAGS = ("-D ENABLE_COMPRESSED_IMAGES=1",)
+
+DECODE_STATS = re.compile(r"image: compressed, (\d+) bytes in, (\d+) bytes out, (\d+) us decoding, (\d+) cycles/KB")
+
+def pack(app: bytes, window_bits: int = pack_image.DEFAULT_WINDOW_BITS) -> bytes:
+    return pack_image.pack(app, compressed=True, window_bits=window_bits)
+
+def test_round_trip():
+    app = make_app(50000, compressible=True)
+    for window_bits in (pack_image.MIN_WINDOW_BITS, pack_image.DEFAULT_WINDOW_BITS):
+        data = pack_image.compress(app, window_bits)
+        assert len(data) < len(app)
+        assert pack_image.decompress(data, len(app), window_bits) == app
+
+def cpu_time(run) -> tuple:
+    """Run the bootloader, returning the result and the host CPU time it took, in seconds."""
+    before = resource.getrusage(resource.RUSAGE_CHILDREN)
+    result = run()
+    after = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return result, (after.ru_utime - before.ru_utime) + (after.ru_stime - before.ru_stime)
+
+def test_installs_compressed_image(board):
+    app = make_app(100000, compressible=True)
+    image = pack(app)
+
+    raw = board(*COMPRESSED_FLAGS)
+    raw.insert_card({"FIRMWARE.BIN": app})
+    raw_result, raw_cpu = cpu_time(raw.run)
+    assert raw_result.jumped, raw_result
+
+    b = board(*COMPRESSED_FLAGS)
+    b.insert_card({"FIRMWARE.BIN": image})
+    result, cpu = cpu_time(b.run)
+    assert result.jumped, result
+    assert "update applied" in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+    stats = DECODE_STATS.search(result.log)
+    assert stats, result
+    # the image is decoded twice: once for the hash, once for the update
+    assert int(stats.group(1)) == 2 * (len(image) - pack_image.HEADER_SIZE)
+    assert int(stats.group(2)) == 2 * len(app)
+
+    # both passes read the smaller file, so fewer SD card blocks are read than for the raw binary
+    assert result.stats["sd_blocks"] < raw_result.stats["sd_blocks"]
+
+    # the models don't charge simulated time for computation, so the cycles/KB the bootloader logs are 0 here.
+    # on hardware, they come from the DWT cycle counter. the host CPU time of the decoder stands in for them
+    host_us_per_kb = max(cpu - raw_cpu, 0) * 1e6 / (2 * len(app) / 1024)
+    print(f"raw: {len(app)} bytes, {raw_result.stats['sd_blocks']} SD blocks read, {raw_result.stats['time_ms']} ms; "
+          f"compressed: {len(image)} bytes, {result.stats['sd_blocks']} SD blocks read, {result.stats['time_ms']} ms, "
+          f"decoding about {host_us_per_kb:.1f} us/KB of host CPU time")
+
+def test_incompressible_data(board):
+    b = board(*COMPRESSED_FLAGS)
+    app = make_app(30000)
+    b.insert_card({"FIRMWARE.BIN": pack(app, pack_image.MIN_WINDOW_BITS)})
+
+    result = b.run()
+    assert result.jumped, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+def test_window_too_large_rejected(board):
+    b = board(*COMPRESSED_FLAGS)
+    b.insert_card({"FIRMWARE.BIN": pack(make_app(20000, compressible=True), pack_image.MAX_WINDOW_BITS)})
+
+    result = b.run()
+    assert "image window too large" in result.log
+    assert result.flash_writes == 0
+
+def test_corrupt_data_rejected(board):
+    b = board(*COMPRESSED_FLAGS)
+    app = make_app(30000, compressible=True)
+    image = bytearray(pack(app))
+    image[pack_image.HEADER_SIZE + 1000:pack_image.HEADER_SIZE + 1016] = b"\xff" * 16
+    b.insert_card({"FIRMWARE.BIN": bytes(image)})
+
+    # the data is decoded for the hash before anything is written
+    result = b.run()
+    assert "image data corrupt" in result.log
+    assert "update applied" not in result.log
+    assert result.flash_writes == 0
+
+def test_rejected_without_decoder(board):
+    b = board()
+    b.insert_card({"FIRMWARE.BIN": pack(make_app(20000, compressible=True))})
+
+    result = b.run()
+    assert "compressed images not supported" in result.log
+    assert result.flash_writes == 0
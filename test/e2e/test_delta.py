@@ -0,0 +1,128 @@
+"""
+Delta images: built by pack_image.py against the installed application, and applied by the bootloader one sector at a time.
+Also covers the update marker, which keeps the bootloader from starting an application an interrupted update left behind.
+"""
+import pack_image
+from harness import APP_BASE_ADDRESS, FLASH_SIZE, SECTOR_SIZE, make_app
+
+DELTA_FLAGS = ("-D ENABLE_DELTA_IMAGES=1", "-D ENABLE_COMPRESSED_IMAGES=1")
+
+def pack_delta(old: bytes, new: bytes, compressed: bool = False) -> bytes:
+    return pack_image.pack(new, compressed, pack_image.DEFAULT_WINDOW_BITS if compressed else 0, source=old)
+
+def delta_pairs() -> dict:
+    """Pairs of installed and new applications, by the change between them."""
+    old = make_app(5 * SECTOR_SIZE + 1234, seed=1, compressible=True)
+    changed = bytearray(old)
+    changed[3 * SECTOR_SIZE + 100:3 * SECTOR_SIZE + 104] = b"\x12\x34\x56\x78"
+    inserted = old[:SECTOR_SIZE + 500] + make_app(300, seed=2)[200:] + old[SECTOR_SIZE + 500:]
+    return {
+        "one word changed": (old, bytes(changed)),
+        "code inserted": (old, inserted),
+        "code appended": (old, old + make_app(3000, seed=3, compressible=True)[1000:]),
+        "rebuilt": (old, make_app(len(old), seed=4, compressible=True)),
+    }
+
+def test_delta_pairs(board):
+    for name, (old, new) in delta_pairs().items():
+        for compressed in (False, True):
+            b = board(*DELTA_FLAGS)
+            b.insert_card({"FIRMWARE.BIN": old})
+            assert b.run().jumped
+
+            delta = pack_delta(old, new, compressed)
+            b.insert_card({"FIRMWARE.BIN": delta})
+            result = b.run()
+            assert result.jumped, result
+            assert "update applied" in result.log
+            assert b.read_flash(APP_BASE_ADDRESS, len(new)) == new
+
+            # the same update as a full image
+            full = board(*DELTA_FLAGS)
+            full.insert_card({"FIRMWARE.BIN": old})
+            full.run()
+            full.insert_card({"FIRMWARE.BIN": new})
+            full_result = full.run()
+            assert full_result.jumped, full_result
+
+            print(f"{name}{', compressed' if compressed else ''}: delta image {len(delta)} bytes, full binary {len(new)} bytes; "
+                  f"update {result.stats['time_ms']} ms, {result.stats['sd_blocks']} SD blocks read, "
+                  f"full update {full_result.stats['time_ms']} ms, {full_result.stats['sd_blocks']} SD blocks read")
+
+            if name != "rebuilt":
+                assert len(delta) < len(new) / 4
+
+def test_delta_for_other_app_rejected(board):
+    old, new = delta_pairs()["one word changed"]
+    b = board(*DELTA_FLAGS)
+    b.insert_card({"FIRMWARE.BIN": make_app(len(old), seed=9)})
+    assert b.run().jumped
+
+    b.insert_card({"FIRMWARE.BIN": pack_delta(old, new)})
+    result = b.run()
+    assert "delta not for installed app" in result.log
+    assert result.flash_writes == 0
+
+def test_interrupted_delta_not_booted(board):
+    old, new = delta_pairs()["one word changed"]
+    b = board(*DELTA_FLAGS)
+    b.insert_card({"FIRMWARE.BIN": old})
+    assert b.run().jumped
+
+    # the power is cut while the second sector is written: the metadata sector, the update marker,
+    # then the first sector are erased or written
+    b.insert_card({"FIRMWARE.BIN": pack_delta(old, new)})
+    result = b.run({"NATIVE_POWER_CUT": str(1 + 1 + 1 + (SECTOR_SIZE // 4) + 1 + 100)})
+    assert result.power_cut, result
+
+    # the delta no longer applies, and the partly written application isn't started
+    result = b.run()
+    assert "delta not for installed app" in result.log
+    assert "update incomplete" in result.log
+    assert result.halted, result
+
+    # a full image recovers
+    b.insert_card({"FIRMWARE.BIN": new})
+    result = b.run()
+    assert result.jumped, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(new)) == new
+
+def test_interrupted_update_not_booted(board):
+    b = board()
+    app = make_app(3 * SECTOR_SIZE + 100)
+    b.insert_card({"FIRMWARE.BIN": app})
+    result = b.run({"NATIVE_POWER_CUT": "1000"})
+    assert result.power_cut, result
+
+    b.insert_card({})
+    result = b.run()
+    assert "update incomplete" in result.log
+    assert result.halted, result
+
+    # the update marker is cleared once the update completes
+    b.insert_card({"FIRMWARE.BIN": app})
+    assert b.run().jumped
+    b.insert_card({})
+    result = b.run()
+    assert result.jumped, result
+    assert "update incomplete" not in result.log
+
+def test_copy_from_metadata_sector_rejected(board):
+    # the installed application reaches into the sector holding the update metadata, which is erased before patching
+    metadata_sector = FLASH_SIZE["C"] - SECTOR_SIZE
+    old = make_app(metadata_sector + 2000 - APP_BASE_ADDRESS, seed=1)
+    new = bytearray(old)
+    new[100:104] = b"\x12\x34\x56\x78"
+    new = bytes(new)
+
+    b = board(*DELTA_FLAGS)
+    b.insert_card({"FIRMWARE.BIN": old})
+    assert b.run().jumped
+
+    b.insert_card({"FIRMWARE.BIN": pack_delta(old, new)})
+    result = b.run()
+    assert "image data corrupt" in result.log, result
+    assert "update applied" not in result.log
+    assert result.flash_writes == 0
+    assert result.jumped, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(old)) == old
@@ -0,0 +1,111 @@
+"""
+Encrypted images: application data encrypted with AES-128 in CTR mode by pack_image.py, decrypted by the bootloader
+with the AES peripheral while it reads the image. The key is read from the OTP area, so builds need no key.
+"""
+import struct
+
+import pack_image
+from harness import APP_BASE_ADDRESS, SECTOR_SIZE, check_rejected, make_app
+
+KEY = bytes.fromhex("2B7E151628AED2A6ABF7158809CF4F3C")
+NONCE = bytes.fromhex("F0F1F2F3F4F5F6F7F8F9FAFB")
+OTP_BLOCK = 2
+
+ENCRYPTED_FLAGS = (
+    "-D ENABLE_ENCRYPTED_IMAGES=1",
+    "-D IMAGE_KEY_SOURCE=IMAGE_KEY_OTP",
+    f"-D IMAGE_KEY_OTP_BLOCK={OTP_BLOCK}",
+    "-D ENABLE_COMPRESSED_IMAGES=1",
+    "-D ENABLE_SPARSE_IMAGES=1",
+    "-D ENABLE_IMAGE_MANIFEST=1",
+)
+
+def encrypted_board(board, key: bytes = KEY):
+    """A board with the key in its OTP area, or an erased OTP area without a key."""
+    b = board(*ENCRYPTED_FLAGS)
+    otp = bytearray(b"\xff" * 1024)
+    if key is not None:
+        otp[OTP_BLOCK * 16:OTP_BLOCK * 16 + 16] = key
+    (b.directory / "otp.bin").write_bytes(otp)
+    b.env["NATIVE_OTP"] = str(b.directory / "otp.bin")
+    return b
+
+def pack_encrypted(app: bytes, compressed: bool = False, load_address: int = None, sparse: bool = False, key: bytes = KEY) -> bytes:
+    return pack_image.pack(app, compressed, pack_image.DEFAULT_WINDOW_BITS if compressed else 0, load_address=load_address,
+                           sparse=sparse, key=key, nonce=NONCE)
+
+def test_python_model_vectors():
+    # FIPS-197 appendix C.1, and the CTR example of SP 800-38A F.5.1, starting at counter 0xFCFDFEFF
+    round_keys = pack_image.aes_expand_key(bytes(range(16)))
+    assert pack_image.aes_encrypt_block(round_keys, bytes.fromhex("00112233445566778899AABBCCDDEEFF")) == \
+        bytes.fromhex("69C4E0D86A7B0430D8CDB78070B4C55A")
+
+    plain = bytes.fromhex("6BC1BEE22E409F96E93D7E117393172AAE2D8A571E03AC9C9EB76FAC45AF8E51"
+                          "30C81C46A35CE411E5FBC1191A0A52EFF69F2445DF4F9B17AD2B417BE66C3710")
+    cipher = bytes.fromhex("874D6191B620E3261BEF6864990DB6CE9806F66B7970FDFF8617187BB9FFFDFF"
+                           "5AE4DF3EDBD5D35E5B4F09020DB03EAB1E031DDA2FBE03D1792170A0F3009CEE")
+    assert pack_image.aes_ctr(KEY, NONCE, plain, 0xFCFDFEFF * 16) == cipher
+
+    # pieces not aligned to the blocks continue the stream
+    data = make_app(5000)
+    assert pack_image.decrypt_in_pieces(KEY, NONCE, pack_image.aes_ctr(KEY, NONCE, data)) == data
+
+def test_installs_encrypted_images(board):
+    app = bytearray(make_app(6 * SECTOR_SIZE + 1001, compressible=True))
+    app[2 * SECTOR_SIZE:4 * SECTOR_SIZE] = b"\xff" * (2 * SECTOR_SIZE)
+    app = bytes(app)
+    images = {
+        "plain": pack_encrypted(app),
+        "compressed": pack_encrypted(app, compressed=True),
+        "sparse": pack_encrypted(app, sparse=True),
+        "compressed sparse": pack_encrypted(app, compressed=True, sparse=True),
+        "manifest": pack_encrypted(app, load_address=APP_BASE_ADDRESS),
+    }
+    for name, image in images.items():
+        b = encrypted_board(board)
+        b.insert_card({"FIRMWARE.BIN": image})
+        result = b.run()
+        assert result.jumped, (name, result)
+        assert "update applied" in result.log, name
+        assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app, name
+
+def test_unchanged_sectors_skipped(board):
+    # the key stream continues in the middle of the data after skipping unchanged sectors
+    old = make_app(6 * SECTOR_SIZE + 1001, seed=1)
+    new = bytearray(old)
+    new[4 * SECTOR_SIZE + 77:4 * SECTOR_SIZE + 81] = b"\x12\x34\x56\x78"
+    new = bytes(new)
+
+    b = encrypted_board(board)
+    b.insert_card({"FIRMWARE.BIN": pack_encrypted(old, load_address=APP_BASE_ADDRESS)})
+    assert b.run().jumped
+
+    b.insert_card({"FIRMWARE.BIN": pack_encrypted(new, load_address=APP_BASE_ADDRESS)})
+    result = b.run()
+    assert result.jumped, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(new)) == new
+    assert result.stats["words_programmed"] < 2 * SECTOR_SIZE // 4
+
+def test_key_mismatch(board):
+    b = encrypted_board(board, key=bytes(range(16)))
+    check_rejected(b, pack_encrypted(make_app(20000)), "image key mismatch")
+
+def test_key_not_set(board):
+    b = encrypted_board(board, key=None)
+    check_rejected(b, pack_encrypted(make_app(20000)), "image key not set")
+
+def test_corrupt_encryption_header(board):
+    image = bytearray(pack_encrypted(make_app(20000)))
+    image[pack_image.HEADER_SIZE + 12] ^= 0xFF
+    check_rejected(encrypted_board(board), bytes(image), "image key mismatch")
+
+def test_encrypted_not_supported(board):
+    b = board()
+    check_rejected(b, pack_encrypted(make_app(20000)), "encrypted images not supported")
+
+def test_encryption_header_layout():
+    image = pack_encrypted(make_app(20000))
+    assert struct.unpack_from(pack_image.HEADER_FORMAT, image)[3] & pack_image.FLAG_ENCRYPTED
+    nonce, key_check = struct.unpack_from(pack_image.ENCRYPTION_HEADER_FORMAT, image, pack_image.HEADER_SIZE)
+    assert nonce == NONCE
+    assert key_check == pack_image.key_check(KEY)
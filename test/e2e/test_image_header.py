@@ -0,0 +1,97 @@
+"""
+Parsing of the image header by the bootloader: valid headers, and malformed or truncated ones, which must be
+rejected before anything is written to the flash.
+"""
+import struct
+import zlib
+
+import pack_image
+from harness import APP_BASE_ADDRESS, check_rejected, make_app
+
+MANIFEST_FLAGS = ("-D ENABLE_IMAGE_MANIFEST=1",)
+
+def pack(app: bytes, load_address: int = APP_BASE_ADDRESS) -> bytes:
+    return pack_image.pack(app, compressed=False, window_bits=0, load_address=load_address)
+
+def set_header(image: bytes, **fields) -> bytes:
+    """Change fields of the image header, keeping the header CRC of the manifest valid."""
+    names = ("magic", "version", "header_size", "flags", "app_size", "data_size", "window_bits")
+    values = dict(zip(names, struct.unpack_from(pack_image.HEADER_FORMAT, image)))
+    header_size = values["header_size"]
+    values.update(fields)
+
+    image = bytearray(image)
+    struct.pack_into(pack_image.HEADER_FORMAT, image, 0, *(values[name] for name in names))
+    if values["flags"] & pack_image.FLAG_MANIFEST:
+        struct.pack_into("<I", image, header_size - 4, zlib.crc32(image[:header_size - 4]))
+    return bytes(image)
+
+def test_installs_packed_image(board):
+    # the manifest is skipped like any header field unknown to the bootloader
+    for flags in ((), MANIFEST_FLAGS):
+        b = board(*flags)
+        app = make_app(20000)
+        b.insert_card({"FIRMWARE.BIN": pack(app)})
+        result = b.run()
+        assert result.jumped, result
+        assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+def test_skips_unknown_header_fields(board):
+    # without a manifest, the header is padded to the first SD card sector, like fields of later header versions
+    b = board()
+    app = make_app(20000)
+    image = pack_image.pack(app, compressed=False, window_bits=0)
+    assert struct.unpack_from(pack_image.HEADER_FORMAT, image)[2] == pack_image.SD_SECTOR_SIZE
+    b.insert_card({"FIRMWARE.BIN": image})
+
+    result = b.run()
+    assert result.jumped, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+def test_unsupported_version(board):
+    check_rejected(board(), set_header(pack(make_app(20000)), version=pack_image.VERSION + 1), "unsupported image version")
+
+def test_unsupported_flags(board):
+    image = pack(make_app(20000))
+    flags = struct.unpack_from(pack_image.HEADER_FORMAT, image)[3]
+    check_rejected(board(), set_header(image, flags=flags | (1 << 7)), "unsupported image flags")
+    check_rejected(board(), set_header(image, flags=flags | pack_image.FLAG_DELTA | pack_image.FLAG_SPARSE), "unsupported image flags")
+
+def test_header_size_mismatch(board):
+    image = pack(make_app(20000))
+    check_rejected(board(), set_header(image, header_size=pack_image.HEADER_SIZE - 4), "image size mismatch")
+    check_rejected(board(), set_header(image, header_size=len(image) + 4), "image size mismatch")
+
+def test_data_size_mismatch(board):
+    image = pack(make_app(20000))
+    check_rejected(board(), set_header(image, data_size=20000 - 4), "image size mismatch")
+    check_rejected(board(), set_header(image, app_size=20000 + 4), "image size mismatch")
+
+def test_truncated_data(board):
+    image = pack(make_app(20000))
+    check_rejected(board(), image[:-100], "image size mismatch")
+
+def test_truncated_header(board):
+    image = pack(make_app(20000))
+    for size in (4, pack_image.HEADER_SIZE - 1):
+        check_rejected(board(), image[:size], "image size mismatch")
+
+def test_truncated_manifest(board):
+    # the header claims more than the file holds
+    image = pack(make_app(20000))
+    check_rejected(board(*MANIFEST_FLAGS), image[:pack_image.HEADER_SIZE + 40], "image size mismatch")
+
+def test_corrupt_manifest(board):
+    image = bytearray(pack(make_app(20000)))
+    image[pack_image.HEADER_SIZE + 8] ^= 0xFF
+    check_rejected(board(*MANIFEST_FLAGS), bytes(image), "image header corrupt")
+
+def test_manifest_sector_count_mismatch(board):
+    image = bytearray(pack(make_app(20000)))
+    struct.pack_into("<H", image, pack_image.HEADER_SIZE + 4, 7)
+    header_size = struct.unpack_from(pack_image.HEADER_FORMAT, image)[2]
+    struct.pack_into("<I", image, header_size - 4, zlib.crc32(image[:header_size - 4]))
+    check_rejected(board(*MANIFEST_FLAGS), bytes(image), "image header corrupt")
+
+def test_load_address_mismatch(board):
+    check_rejected(board(*MANIFEST_FLAGS), pack(make_app(20000), load_address=APP_BASE_ADDRESS + 0x2000), "image load address mismatch")
@@ -0,0 +1,82 @@
+"""
+Application integrity check with APP_INTEGRITY_CHECK_ONCE: the installed application is hashed on the first boot
+after an update, and marked verified in the flash, so later boots skip the hash until the next update.
+"""
+from harness import APP_BASE_ADDRESS, FLASH_SIZE, SECTOR_SIZE, make_app
+
+ONCE_FLAGS = ("-D APP_INTEGRITY_CHECK=APP_INTEGRITY_CHECK_ONCE",)
+
+VERIFIED_MARKER = b"OHBV"
+
+def find_marker(b) -> int:
+    """Address of the verified marker in the sector holding the update metadata, or None if it isn't programmed."""
+    # the default board overrides the chip variant to the 256K HC32F460C
+    sector = FLASH_SIZE["C"] - SECTOR_SIZE
+    offset = b.read_flash(sector, SECTOR_SIZE).find(VERIFIED_MARKER)
+    return sector + offset if offset >= 0 else None
+
+def install(b, app: bytes):
+    b.insert_card({"FIRMWARE.BIN": app})
+    result = b.run()
+    assert "update applied" in result.log, result
+    b.insert_card({})
+    return result
+
+def test_marked_after_passing_check(board):
+    b = board(*ONCE_FLAGS)
+    result = install(b, make_app(30000))
+    assert result.jumped, result
+    assert "app verified\n" in result.log
+    assert find_marker(b) is not None
+
+def test_next_boot_skips_hash(board):
+    b = board(*ONCE_FLAGS)
+    install(b, make_app(30000))
+
+    result = b.run()
+    assert result.jumped, result
+    assert "app verified before" in result.log
+    assert "app verified\n" not in result.log
+
+    # a change the hash would catch goes unnoticed once verified
+    b.write_flash(APP_BASE_ADDRESS + 20000, b"\x00")
+    assert b.run().jumped
+
+def test_update_erases_marker(board):
+    b = board(*ONCE_FLAGS)
+    install(b, make_app(30000, seed=1))
+    marker = find_marker(b)
+
+    # interrupted right after the metadata sector is erased, the new application isn't marked verified
+    b.insert_card({"FIRMWARE.BIN": make_app(30000, seed=2)})
+    b.run(env={"NATIVE_POWER_CUT": "1"})
+    assert b.read_flash(marker, 4) == b"\xff" * 4
+
+    # the completed update hashes the new application again
+    result = install(b, make_app(30000, seed=2))
+    assert "app verified\n" in result.log
+    assert "app verified before" not in result.log
+    assert find_marker(b) == marker
+
+def test_flipped_bit_caught(board):
+    b = board(*ONCE_FLAGS)
+    app = make_app(30000)
+    install(b, app)
+    marker = find_marker(b)
+
+    # before the application was verified, e.g. with the marker erased by a debug probe
+    for offset in (0, 12345, len(app) - 1):
+        b.write_flash(marker, b"\xff" * 4)
+        b.write_flash(APP_BASE_ADDRESS + offset, bytes([app[offset] ^ 0x01]))
+        result = b.run()
+        assert result.halted, (offset, result)
+        assert "app integrity check failed" in result.log
+        assert b.read_flash(marker, 4) == b"\xff" * 4
+        b.write_flash(APP_BASE_ADDRESS + offset, app[offset:offset + 1])
+
+    # a flipped bit in the marker itself is no verified marker
+    b.write_flash(marker, bytes([VERIFIED_MARKER[0] ^ 0x01]) + VERIFIED_MARKER[1:])
+    b.write_flash(APP_BASE_ADDRESS + 100, bytes([app[100] ^ 0x01]))
+    result = b.run()
+    assert result.halted, result
+    assert "app integrity check failed" in result.log
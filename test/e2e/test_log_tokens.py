@@ -0,0 +1,80 @@
+"""
+Tokenized logging: the dictionary built from the sources decodes every log call site,
+and the decoded output of a tokenized build matches the plain text output.
+"""
+import re
+
+import pytest
+
+from harness import ROOT, make_app
+from log_decode import Decoder, MARKER_NUMBER, MARKER_TOKEN
+from log_tokens import LOG_STR_REGEX, build_dictionary, token_hash, unescape_c_string
+
+SRC_DIR = ROOT / "src"
+
+# plain and tokenized builds log the same, with debug messages.
+# logging asynchronously, the shorter tokenized output doesn't change when the update progress is reported
+LOG_FLAGS = ("-D LOG_LEVEL=LOG_LEVEL_DEBUG", "-D ENABLE_PROFILER=0", "-D LOG_ASYNC=1")
+
+def call_sites():
+    """All LOG_STR() call sites in the sources, as (file, string) tuples."""
+    sites = []
+    for file in sorted(SRC_DIR.rglob("*")):
+        if file.suffix in (".c", ".cpp", ".h"):
+            content = file.read_text(encoding="utf-8", errors="replace")
+            sites += [(file.relative_to(ROOT), unescape_c_string(m.group(1))) for m in LOG_STR_REGEX.finditer(content)]
+    return sites
+
+def encode_number(number: int, base: int) -> bytes:
+    """Encode a number like logging::log() does for debug numbers."""
+    out = bytearray([MARKER_NUMBER, base])
+    while number >= 0x80:
+        out.append((number & 0x7F) | 0x80)
+        number >>= 7
+    out.append(number)
+    return bytes(out)
+
+def test_every_call_site_round_trips():
+    dictionary = build_dictionary(str(SRC_DIR))
+    sites = call_sites()
+    assert len(sites) > 20
+
+    for file, string in sites:
+        token = token_hash(string)
+        encoded = bytes([MARKER_TOKEN, token & 0xFF, token >> 8])
+        assert Decoder(dictionary).feed(encoded) == string, f"{file}: {string!r}"
+
+def test_numbers_round_trip():
+    decoder = Decoder({})
+    for number in (0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 123456789, 0xFFFFFFFF):
+        assert decoder.feed(encode_number(number, 10)) == str(number).encode()
+        assert decoder.feed(encode_number(number, 16)) == f"{number:08X}".encode()
+
+def test_split_records_decode_like_whole():
+    dictionary = build_dictionary(str(SRC_DIR))
+    _, string = call_sites()[0]
+    token = token_hash(string)
+    stream = b"text " + bytes([MARKER_TOKEN, token & 0xFF, token >> 8]) + encode_number(300, 10) + b"\n"
+
+    decoder = Decoder(dictionary)
+    decoded = b"".join(decoder.feed(stream[i:i + 1]) for i in range(len(stream)))
+    assert decoded == Decoder(dictionary).feed(stream)
+    assert decoded == b"text " + string + b"300\n"
+
+def test_tokenized_build_logs_like_plain_build(board):
+    plain = board(*LOG_FLAGS, "-D LOG_TOKENIZED=0")
+    tokenized = board(*LOG_FLAGS, "-D LOG_TOKENIZED=1")
+    dictionary = build_dictionary(str(SRC_DIR))
+
+    # an update, the boot skipping it and a boot without card reach most of the log call sites on the update path
+    app = make_app(30000)
+    for files in ({"FIRMWARE.BIN": app}, {"FIRMWARE.BIN": app}, {}):
+        plain.insert_card(files)
+        tokenized.insert_card(files)
+        expected = plain.run()
+        result = tokenized.run()
+        assert expected.jumped and result.jumped, result
+
+        assert MARKER_TOKEN in result.output
+        assert Decoder(dictionary).feed(result.output) == expected.output
+        assert len(result.output) < len(expected.output)
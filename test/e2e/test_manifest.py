@@ -0,0 +1,153 @@
+"""
+Image manifest: generation by pack_image.py, and the sectors the bootloader keeps by comparing
+the manifest against the sector CRCs of the installed application.
+"""
+import hashlib
+import struct
+import zlib
+
+import pytest
+
+import pack_image
+from harness import APP_BASE_ADDRESS, FLASH_SIZE, SECTOR_SIZE, make_app
+
+MANIFEST_FLAGS = ("-D ENABLE_IMAGE_MANIFEST=1", "-D METADATA_SECTOR_CRCS=1")
+
+def pack(app: bytes) -> bytes:
+    return pack_image.pack(app, compressed=False, window_bits=0, load_address=APP_BASE_ADDRESS)
+
+def parse_manifest(image: bytes) -> tuple:
+    """Get the manifest and the sector CRCs of a packed image."""
+    magic, _, header_size, flags, app_size, _, _ = struct.unpack_from(pack_image.HEADER_FORMAT, image)
+    assert magic == pack_image.MAGIC
+    assert flags & pack_image.FLAG_MANIFEST
+    load_address, sector_count, hash_type, app_hash = struct.unpack_from(pack_image.MANIFEST_FORMAT, image, pack_image.HEADER_SIZE)
+    crcs = struct.unpack_from(f"<{sector_count}I", image, pack_image.HEADER_SIZE + pack_image.MANIFEST_SIZE)
+    return load_address, hash_type, app_hash, list(crcs), app_size
+
+def test_manifest_describes_application():
+    app = make_app(3 * SECTOR_SIZE + 1001)
+    image = pack(app)
+    load_address, hash_type, app_hash, crcs, app_size = parse_manifest(image)
+
+    assert load_address == APP_BASE_ADDRESS
+    assert app_size == len(app)
+    assert hash_type == pack_image.HASH_TYPES["sha256"]
+    assert app_hash == hashlib.sha256(app).digest()
+
+    # sectors as programmed: the last one padded with 0xFF to whole words
+    programmed = app + b"\xff" * (-len(app) % 4)
+    assert crcs == [zlib.crc32(programmed[i:i + SECTOR_SIZE]) for i in range(0, len(programmed), SECTOR_SIZE)]
+
+def test_manifest_crc32_hash():
+    app = make_app(5000)
+    _, hash_type, app_hash, _, _ = parse_manifest(pack_image.pack(app, False, 0, hash_type="crc32", load_address=APP_BASE_ADDRESS))
+    assert hash_type == pack_image.HASH_TYPES["crc32"]
+    assert app_hash[:4] == pack_image.image_hash(app, "crc32")
+    assert app_hash[4:] == bytes(28)
+
+def test_header_crc_covers_manifest():
+    image = bytearray(pack(make_app(20000)))
+    header_size = struct.unpack_from(pack_image.HEADER_FORMAT, image)[2]
+
+    # the CRC ends the header, after the manifest and the padding to the first SD card sector of data
+    assert header_size % pack_image.SD_SECTOR_SIZE == 0
+    assert struct.unpack_from("<I", image, header_size - 4)[0] == zlib.crc32(image[:header_size - 4])
+
+    # damage the manifest, so the header is no longer valid
+    image[pack_image.HEADER_SIZE + 8] ^= 0xFF
+    assert struct.unpack_from("<I", image, header_size - 4)[0] != zlib.crc32(image[:header_size - 4])
+
+def test_too_many_sectors_rejected():
+    with pytest.raises(ValueError, match="too large"):
+        pack_image.build_manifest(bytes((pack_image.MAX_SECTORS * SECTOR_SIZE) + 1), APP_BASE_ADDRESS, "sha256")
+
+def test_installs_manifest_image(board):
+    b = board(*MANIFEST_FLAGS)
+    app = make_app(3 * SECTOR_SIZE + 1001)
+    b.insert_card({"FIRMWARE.BIN": pack(app)})
+
+    result = b.run()
+    assert result.jumped, result
+    assert "update applied" in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+    # the application sectors and the metadata sector
+    assert result.stats["sectors_erased"] == 4 + 1
+
+def test_keeps_unchanged_sectors(board):
+    b = board(*MANIFEST_FLAGS)
+    old = make_app(6 * SECTOR_SIZE - 500, seed=1)
+    b.insert_card({"FIRMWARE.BIN": pack(old)})
+    full = b.run()
+    assert full.jumped, full
+
+    # change sector 4 only
+    new = bytearray(old)
+    new[4 * SECTOR_SIZE + 100:4 * SECTOR_SIZE + 108] = b"\x12" * 8
+    new = bytes(new)
+    b.insert_card({"FIRMWARE.BIN": pack(new)})
+
+    result = b.run()
+    assert result.jumped, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(new)) == new
+
+    # the changed sector and the metadata sector are erased, only the changed sector is programmed again
+    assert result.stats["sectors_erased"] == 2
+    assert result.stats["words_programmed"] < full.stats["words_programmed"] / 3
+    print(f"full update: {full.stats['sectors_erased']} sectors erased, {full.stats['words_programmed']} words programmed, {full.stats['time_ms']} ms; "
+          f"one sector changed: {result.stats['sectors_erased']} sectors erased, {result.stats['words_programmed']} words programmed, {result.stats['time_ms']} ms")
+
+def test_rewrites_app_in_metadata_sector(board):
+    # the application ends in the sector holding the update metadata, of the 256K layout the default board uses
+    metadata_sector = FLASH_SIZE["C"] - SECTOR_SIZE
+    b = board(*MANIFEST_FLAGS)
+    old = make_app(metadata_sector + 2000 - APP_BASE_ADDRESS, seed=1)
+    b.insert_card({"FIRMWARE.BIN": pack(old)})
+    assert b.run().jumped
+
+    # change sector 4 only; the unchanged application tail is erased with the metadata, so it is written again
+    new = bytearray(old)
+    new[4 * SECTOR_SIZE + 100:4 * SECTOR_SIZE + 108] = b"\x12" * 8
+    new = bytes(new)
+    b.insert_card({"FIRMWARE.BIN": pack(new)})
+
+    result = b.run()
+    assert result.jumped, result
+    assert "update applied" in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(new)) == new
+    assert result.stats["sectors_erased"] == 2
+
+def test_stale_sector_crc_caught_by_hash(board):
+    b = board(*MANIFEST_FLAGS)
+    old = make_app(4 * SECTOR_SIZE, seed=1)
+    b.insert_card({"FIRMWARE.BIN": pack(old)})
+    assert b.run().jumped
+
+    # damage sector 1 behind the bootloader's back, so its stored CRC no longer describes the flash
+    b.write_flash(APP_BASE_ADDRESS + SECTOR_SIZE + 16, b"\x00" * 4)
+
+    new = bytearray(old)
+    new[3 * SECTOR_SIZE] ^= 0xFF
+    b.insert_card({"FIRMWARE.BIN": pack(bytes(new))})
+
+    result = b.run()
+    assert not result.jumped
+    assert "app verify failed" in result.log
+
+def test_first_sector_damage_caught_by_hash(board):
+    # the whole vector table is covered by the metadata hash
+    b = board(*MANIFEST_FLAGS, "-D APP_INTEGRITY_CHECK=APP_INTEGRITY_CHECK_ALWAYS")
+    app = make_app(3 * SECTOR_SIZE)
+    b.insert_card({"FIRMWARE.BIN": pack(app)})
+    assert b.run().jumped
+
+    # a different but valid handler address in the vector table
+    offset = 100 * 4
+    handler = struct.unpack_from("<I", app, offset)[0]
+    b.write_flash(APP_BASE_ADDRESS + offset, struct.pack("<I", handler + 4))
+
+    b.insert_card({})
+    result = b.run()
+    assert result.halted, result
+    assert "app integrity check failed" in result.log
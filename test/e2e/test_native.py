@@ -0,0 +1,90 @@
+"""
+Basic update flow of the native build: plain firmware binaries on the SD card.
+"""
+import re
+
+from harness import APP_BASE_ADDRESS, make_app
+
+SD_SECTOR_SIZE = 512
+
+# SD sectors read by a boot without update file: boot sector, FAT and root directory
+NO_FILE_SD_READS = 4
+
+def test_installs_firmware(board):
+    b = board()
+    app = make_app(40000)
+    b.insert_card({"FIRMWARE.BIN": app})
+
+    result = b.run()
+    assert result.jumped, result
+    assert "update applied" in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+    assert result.stats["flash_errors"] == 0
+
+def test_skips_installed_firmware(board):
+    b = board()
+    app = make_app(40000)
+    b.insert_card({"FIRMWARE.BIN": app})
+    b.run()
+
+    result = b.run()
+    assert result.jumped, result
+    assert "update skipped" in result.log
+    assert result.flash_writes == 0
+
+    # the file is read once to hash it, after reading its first sector for the metadata
+    file_sectors = (len(app) + SD_SECTOR_SIZE - 1) // SD_SECTOR_SIZE
+    assert result.stats["sd_reads"] <= NO_FILE_SD_READS + 1 + file_sectors, result.stats
+    assert result.stats["sd_reads"] == result.stats["sd_blocks"]
+
+def test_boots_without_update_file(board):
+    b = board()
+    app = make_app(20000)
+    b.insert_card({"FIRMWARE.BIN": app})
+    b.run()
+
+    b.insert_card({})
+    result = b.run()
+    assert result.jumped, result
+    assert result.flash_writes == 0
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+    # mounting and looking up the file, the repeated sectors coming from the sector cache
+    assert result.stats["sd_reads"] <= NO_FILE_SD_READS, result.stats
+    assert result.stats["sd_reads"] + result.stats["sd_cached"] == result.stats["sd_requested"]
+
+def test_replaces_firmware(board):
+    b = board()
+    b.insert_card({"FIRMWARE.BIN": make_app(60000, seed=1)})
+    b.run()
+
+    app = make_app(30000, seed=2)
+    b.insert_card({"FIRMWARE.BIN": app})
+    result = b.run()
+    assert result.jumped, result
+    assert "update applied" in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+def test_keeps_bootloader_area(board):
+    b = board()
+    b.write_flash(0, b"\x5A" * APP_BASE_ADDRESS)
+    b.insert_card({"FIRMWARE.BIN": make_app(20000)})
+
+    result = b.run()
+    assert result.jumped, result
+    assert b.read_flash(0, APP_BASE_ADDRESS) == b"\x5A" * APP_BASE_ADDRESS
+
+def test_progress_in_order_with_async_log(board):
+    b = board("-D LOG_ASYNC=1", "-D LOG_LEVEL=LOG_LEVEL_DEBUG")
+    b.insert_card({"FIRMWARE.BIN": make_app(60000)})
+
+    result = b.run()
+    assert result.jumped, result
+
+    # progress lines are whole, not mixed into the buffered log lines around them
+    lines = result.log.splitlines()
+    progress = [line for line in lines if " of " in line]
+    assert len(progress) > 2
+    for line in progress:
+        assert re.fullmatch(r"(erase|write): \d+ of \d+", line), line
+    assert lines.index(progress[-1]) < lines.index("update applied")
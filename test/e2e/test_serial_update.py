@@ -0,0 +1,129 @@
+"""
+Updates uploaded over the host serial: serial_upload.py talking to the native build through the stdin and stdout of
+its host serial, as it does with --native.
+"""
+import os
+import queue
+import re
+import subprocess
+import threading
+import time
+
+import pack_image
+import serial_upload
+from harness import APP_BASE_ADDRESS, Result, make_app
+
+# the profiler reports the time the upload was received in
+SERIAL_FLAGS = ("-D ENABLE_SERIAL_UPDATE=1", "-D ENABLE_PROFILER=1")
+
+RECEIVE_PATTERN = re.compile(r"profile:\s+receive\s+\S+\s+(\d+\.\d+)\s+(\d+)")
+
+class BoardTransport(serial_upload.NativeTransport):
+    """The host serial of a simulated board, keeping all it sent for the result of the run."""
+
+    def __init__(self, b, corrupt_chunk: int = -1):
+        env = dict(os.environ)
+        env.update(b.env)
+        env["NATIVE_USART2_RX"] = "/dev/stdin"
+        self.stderr = open(b.directory / "stderr.bin", "w+b")
+        self.process = subprocess.Popen([str(b.program)], cwd=b.directory, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                        stderr=self.stderr, env=env)
+        self.output = queue.Queue()
+        threading.Thread(target=self._pump, daemon=True).start()
+        self.received = bytearray()
+        self.chunks = 0
+        self.corrupt_chunk = corrupt_chunk
+
+    def read(self):
+        data = super().read()
+        self.received += data
+        return data
+
+    def write(self, data):
+        # corrupt one byte of a DATA frame, like noise on the line
+        if data[1] == serial_upload.FRAME_DATA:
+            if self.chunks == self.corrupt_chunk:
+                data = data[:20] + bytes([data[20] ^ 0xFF]) + data[21:]
+            self.chunks += 1
+        super().write(data)
+
+    def finish(self) -> Result:
+        """Wait for the rest of the boot."""
+        while self.process.poll() is None or not self.output.empty():
+            self.read()
+        exit_code = self.close()
+        self.stderr.seek(0)
+        trace = self.stderr.read()
+        self.stderr.close()
+        return Result(subprocess.CompletedProcess(self.process.args, exit_code, bytes(self.received), trace))
+
+def upload(b, image: bytes, max_baud: int = serial_upload.DEFAULT_BAUD, corrupt_chunk: int = -1):
+    """Upload an update file while the board boots, returning the result of the run and the result sent in END."""
+    transport = BoardTransport(b, corrupt_chunk)
+    link = serial_upload.Link(transport, verbose=False)
+    try:
+        serial_upload.connect(link, wait=10)
+        baudrate = serial_upload.raise_baudrate(link, serial_upload.DEFAULT_BAUD, max_baud, serial_upload.DEFAULT_UPDATE_TIMEOUT)
+        start = time.monotonic()
+        status, sent, retries = serial_upload.upload(link, image, timeout=10)
+        elapsed = time.monotonic() - start
+    finally:
+        result = transport.finish()
+
+    match = RECEIVE_PATTERN.search(result.log)
+    received_ms, received = float(match.group(1)), int(match.group(2))
+    print(f"{len(image)} bytes at {baudrate} baud: {sent} bytes sent, {retries} retries; "
+          f"{received / 1024 / (received_ms / 1000):.1f} KB/s simulated, {sent / 1024 / elapsed:.1f} KB/s host")
+    return result, status, sent, retries
+
+def test_upload_installs_update(board):
+    for max_baud in (serial_upload.DEFAULT_BAUD, max(serial_upload.BAUD_RATES)):
+        b = board(*SERIAL_FLAGS)
+        app = make_app(40000)
+        result, status, sent, retries = upload(b, app, max_baud)
+        assert status == serial_upload.RESULT_INSTALLED, result
+        assert "update applied" in result.log
+        assert result.jumped, result
+        assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+        assert retries == 0
+
+        # the application is hashed while the file is read, then read again to write it
+        assert sent == 2 * len(app)
+
+def test_upload_packed_image(board):
+    # the manifest carries the hash, so the file is read once
+    b = board(*SERIAL_FLAGS, "-D ENABLE_IMAGE_MANIFEST=1")
+    app = make_app(40000)
+    image = pack_image.pack(app, compressed=False, window_bits=0, load_address=APP_BASE_ADDRESS)
+    result, status, sent, _ = upload(b, image)
+    assert status == serial_upload.RESULT_INSTALLED, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+    assert sent == len(image)
+
+def test_corrupt_chunk_sent_again(board):
+    b = board(*SERIAL_FLAGS)
+    app = make_app(40000)
+    result, status, _, retries = upload(b, app, corrupt_chunk=10)
+    assert status == serial_upload.RESULT_INSTALLED, result
+    assert retries == 1
+    assert "serial: 1 retries" in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+def test_rejected_update_reported(board):
+    b = board(*SERIAL_FLAGS)
+    image = pack_image.pack(make_app(40000), compressed=False, window_bits=0, load_address=APP_BASE_ADDRESS)
+    result, status, _, _ = upload(b, image[:-100])
+    assert status != serial_upload.RESULT_INSTALLED
+    assert "image size mismatch" in result.log
+    assert result.flash_writes == 0
+
+def test_boots_without_host(board):
+    # the SD card is checked once the bootloader stopped listening for the host
+    b = board(*SERIAL_FLAGS)
+    app = make_app(40000)
+    b.insert_card({"FIRMWARE.BIN": app})
+    result = b.run()
+    assert "serial host connected" not in result.log
+    assert "checking FIRMWARE.BIN" in result.log
+    assert result.jumped, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
@@ -0,0 +1,174 @@
+"""
+Signed images: an ECDSA P-256 signature of the application hash, made by pack_image.py --sign-key and checked against
+IMAGE_PUBLIC_KEY before the flash is erased. Covers valid, tampered and truncated images.
+"""
+import struct
+import zlib
+
+import pytest
+
+import pack_image
+from harness import APP_BASE_ADDRESS, SECTOR_SIZE, check_rejected, make_app
+
+# the private key of RFC 6979 A.2.5
+SIGN_KEY = 0xC9AFA9D845BA75166B5C215767B1D6934E50C3DB36E89B127B8A622B120F6721
+OTHER_SIGN_KEY = 0x1234
+
+@pytest.fixture(scope="module")
+def signed_flags(tmp_path_factory):
+    """Build flags of signed images. the public key is a string, so it is defined in a header included by all sources."""
+    header = tmp_path_factory.mktemp("signed") / "image_public_key.h"
+    header.write_text(f"#define IMAGE_PUBLIC_KEY \"{pack_image.public_key(SIGN_KEY).hex().upper()}\"\n")
+    return (
+        "-D ENABLE_SIGNED_IMAGES=1",
+        f"-include {header}",
+        "-D APP_INTEGRITY_CHECK=APP_INTEGRITY_CHECK_ALWAYS",
+        "-D ENABLE_IMAGE_MANIFEST=1",
+        "-D ENABLE_COMPRESSED_IMAGES=1",
+        "-D ENABLE_SPARSE_IMAGES=1",
+    )
+
+def pack_signed(app: bytes, compressed: bool = False, load_address: int = None, sparse: bool = False,
+                sign_key: int = SIGN_KEY) -> bytes:
+    return pack_image.pack(app, compressed, pack_image.DEFAULT_WINDOW_BITS if compressed else 0, load_address=load_address,
+                           sparse=sparse, sign_key=sign_key)
+
+def header_size(image: bytes) -> int:
+    return struct.unpack_from(pack_image.HEADER_FORMAT, image)[2]
+
+def fix_header_crc(image: bytearray):
+    """Recalculate the header CRC32 ending the header of images with a manifest."""
+    size = header_size(image)
+    struct.pack_into("<I", image, size - 4, zlib.crc32(image[:size - 4]))
+
+def install(b, app: bytes):
+    b.insert_card({"FIRMWARE.BIN": pack_signed(app, load_address=APP_BASE_ADDRESS)})
+    result = b.run()
+    assert "update applied" in result.log, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+    b.insert_card({})
+
+def test_installs_signed_images(board, signed_flags):
+    app = bytearray(make_app(6 * SECTOR_SIZE + 1001, compressible=True))
+    app[2 * SECTOR_SIZE:4 * SECTOR_SIZE] = b"\xff" * (2 * SECTOR_SIZE)
+    app = bytes(app)
+    images = {
+        "plain": pack_signed(app),
+        "compressed": pack_signed(app, compressed=True),
+        "sparse": pack_signed(app, sparse=True),
+        "manifest": pack_signed(app, load_address=APP_BASE_ADDRESS),
+    }
+    for name, image in images.items():
+        b = board(*signed_flags)
+        b.insert_card({"FIRMWARE.BIN": image})
+        result = b.run()
+        assert result.jumped, (name, result)
+        assert "update applied" in result.log, name
+        assert "image: signature checked" in result.log, name
+        assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app, name
+
+def test_manifest_image_read_twice(board, signed_flags):
+    # the hash of the manifest isn't signed, so the signed hash is taken from the data
+    app = make_app(6 * SECTOR_SIZE + 1001)
+    stats = {}
+    for name, flags in (("unsigned", ("-D ENABLE_IMAGE_MANIFEST=1",)), ("signed", signed_flags)):
+        b = board(*flags)
+        sign_key = SIGN_KEY if name == "signed" else None
+        b.insert_card({"FIRMWARE.BIN": pack_signed(app, load_address=APP_BASE_ADDRESS, sign_key=sign_key)})
+        result = b.run()
+        assert "update applied" in result.log, result
+        stats[name] = result.stats
+        print(f"{name} manifest image: {result.stats['sd_blocks']} SD blocks read, {result.stats['time_ms']} ms")
+    assert stats["signed"]["sd_blocks"] > 2 * len(app) // 512 > stats["unsigned"]["sd_blocks"]
+
+def test_tampered_images_rejected(board, signed_flags):
+    installed = make_app(6 * SECTOR_SIZE + 1001, seed=1)
+    app = make_app(6 * SECTOR_SIZE + 1001, seed=2)
+    images = {
+        "plain": pack_signed(app),
+        "compressed": pack_signed(app, compressed=True),
+        "manifest": pack_signed(app, load_address=APP_BASE_ADDRESS),
+    }
+    for name, image in images.items():
+        # a byte of the application data, after the header holding the hash of the manifest
+        tampered = bytearray(image)
+        tampered[header_size(image) + 3 * SECTOR_SIZE + 77] ^= 0x01
+        b = board(*signed_flags)
+        install(b, installed)
+        check_rejected(b, bytes(tampered), "image signature invalid", installed)
+
+    # the signature itself
+    b = board(*signed_flags)
+    install(b, installed)
+    tampered = bytearray(images["plain"])
+    tampered[pack_image.HEADER_SIZE + 5] ^= 0x01
+    check_rejected(b, bytes(tampered), "image signature invalid", installed)
+
+def test_forged_manifest_rejected(board, signed_flags):
+    # the manifest of a tampered image carries the hash of the tampered application and a valid header CRC32
+    installed = make_app(6 * SECTOR_SIZE + 1001, seed=1)
+    app = make_app(6 * SECTOR_SIZE + 1001, seed=2)
+    forged = bytearray(app)
+    forged[3 * SECTOR_SIZE + 77] ^= 0x01
+    image = bytearray(pack_signed(app, load_address=APP_BASE_ADDRESS))
+    manifest = pack_image.HEADER_SIZE + struct.calcsize(pack_image.SIGNATURE_FORMAT)
+    manifest_data = pack_image.build_manifest(bytes(forged), APP_BASE_ADDRESS, "sha256")
+    image[manifest:manifest + len(manifest_data)] = manifest_data
+    image[header_size(image):] = forged
+    fix_header_crc(image)
+
+    b = board(*signed_flags)
+    install(b, installed)
+    check_rejected(b, bytes(image), "image signature invalid", installed)
+
+def test_sector_crcs_not_trusted(board, signed_flags):
+    # a sector CRC32 of the manifest changed to match the installed sector doesn't keep that sector
+    installed = make_app(6 * SECTOR_SIZE + 1001, seed=1)
+    app = bytearray(installed)
+    app[3 * SECTOR_SIZE + 77] ^= 0x01
+    app = bytes(app)
+
+    image = bytearray(pack_signed(app, load_address=APP_BASE_ADDRESS))
+    crcs = pack_image.HEADER_SIZE + struct.calcsize(pack_image.SIGNATURE_FORMAT) + struct.calcsize(pack_image.MANIFEST_FORMAT)
+    struct.pack_into("<I", image, crcs + 3 * 4, zlib.crc32(installed[3 * SECTOR_SIZE:4 * SECTOR_SIZE]))
+    fix_header_crc(image)
+
+    b = board(*signed_flags)
+    install(b, installed)
+    b.insert_card({"FIRMWARE.BIN": bytes(image)})
+    result = b.run()
+    assert "update applied" in result.log, result
+    assert result.jumped, result
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+def test_wrong_key_rejected(board, signed_flags):
+    installed = make_app(30000, seed=1)
+    b = board(*signed_flags)
+    install(b, installed)
+    check_rejected(b, pack_signed(make_app(30000, seed=2), load_address=APP_BASE_ADDRESS, sign_key=OTHER_SIGN_KEY),
+                   "image signature invalid", installed)
+
+def test_unsigned_images_rejected(board, signed_flags):
+    installed = make_app(30000, seed=1)
+    app = make_app(30000, seed=2)
+    for image in (app, pack_signed(app, load_address=APP_BASE_ADDRESS, sign_key=None)):
+        b = board(*signed_flags)
+        install(b, installed)
+        check_rejected(b, image, "image not signed", installed)
+
+def test_truncated_images_rejected(board, signed_flags):
+    installed = make_app(30000, seed=1)
+    for load_address in (None, APP_BASE_ADDRESS):
+        image = pack_signed(make_app(30000, seed=2), load_address=load_address)
+        for size in (len(image) - 100, header_size(image) + 1000, pack_image.HEADER_SIZE + 40):
+            b = board(*signed_flags)
+            install(b, installed)
+            check_rejected(b, image[:size], "image size mismatch", installed)
+
+def test_no_boot_without_metadata(board, signed_flags):
+    # an application written without an update, e.g. using a debugger, isn't verified
+    b = board(*signed_flags)
+    b.write_flash(APP_BASE_ADDRESS, make_app(30000))
+    result = b.run()
+    assert "no metadata, app not verified" in result.log
+    assert not result.jumped
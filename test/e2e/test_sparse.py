@@ -0,0 +1,91 @@
+"""
+Sparse images: only the segments of the application are stored, the gaps between them are left erased.
+Covers the validation of the segment table, and the flash erased and programmed for the gaps.
+"""
+import struct
+
+import pack_image
+from harness import APP_BASE_ADDRESS, SECTOR_SIZE, check_rejected, make_app
+
+SPARSE_FLAGS = ("-D ENABLE_SPARSE_IMAGES=1", "-D ENABLE_COMPRESSED_IMAGES=1")
+
+def make_sparse_app() -> bytes:
+    """An application with a gap of several sectors, e.g. between code and data sections, and a short one."""
+    app = bytearray(make_app(12 * SECTOR_SIZE + 700, compressible=True))
+    app[2 * SECTOR_SIZE + 300:7 * SECTOR_SIZE + 100] = b"\xff" * (5 * SECTOR_SIZE - 200)
+    app[9 * SECTOR_SIZE:9 * SECTOR_SIZE + 200] = b"\xff" * 200
+    return bytes(app)
+
+def pack_sparse(app: bytes, compressed: bool = False) -> bytes:
+    return pack_image.pack(app, compressed, pack_image.DEFAULT_WINDOW_BITS if compressed else 0, sparse=True)
+
+def set_segments(image: bytes, segments: list, count: int = None) -> bytes:
+    """Replace the segment table, keeping the data."""
+    image = bytearray(image)
+    struct.pack_into(pack_image.SPARSE_HEADER_FORMAT, image, pack_image.HEADER_SIZE, len(segments) if count is None else count)
+    for i, segment in enumerate(segments):
+        struct.pack_into(pack_image.SEGMENT_FORMAT, image, pack_image.HEADER_SIZE + 4 + 8 * i, *segment)
+    return bytes(image)
+
+def test_installs_sparse_image(board):
+    app = make_sparse_app()
+    for compressed in (False, True):
+        for installed in (None, make_app(len(app), seed=1)):
+            results = {}
+            for name, image in (("sparse", pack_sparse(app, compressed)), ("full", app)):
+                b = board(*SPARSE_FLAGS)
+                if installed is not None:
+                    b.insert_card({"FIRMWARE.BIN": installed})
+                    assert b.run().jumped
+
+                b.insert_card({"FIRMWARE.BIN": image})
+                result = b.run()
+                assert result.jumped, result
+                assert "update applied" in result.log
+                assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+                results[name] = (len(image), result.stats)
+
+            # gaps are not read, and the sectors in the gap are only erased if they aren't yet. words of all ones
+            # are never programmed, so both program the same words
+            sparse, full = results["sparse"][1], results["full"][1]
+            assert sparse["words_programmed"] == full["words_programmed"]
+            assert sparse["sd_blocks"] < full["sd_blocks"]
+            if installed is None:
+                assert sparse["sectors_erased"] == full["sectors_erased"] - 4
+            else:
+                assert sparse["sectors_erased"] == full["sectors_erased"]
+
+            for name, (size, stats) in results.items():
+                print(f"{name}{', compressed' if compressed and name == 'sparse' else ''}, {'over an app' if installed else 'erased flash'}: "
+                      f"{size} bytes, {stats['sectors_erased']} sectors erased, {stats['words_programmed']} words programmed, "
+                      f"{stats['sd_blocks']} SD blocks read, {stats['time_ms']} ms")
+
+def test_segment_table_layout():
+    segments = pack_image.find_segments(make_sparse_app())
+    assert segments == [(0, 2 * SECTOR_SIZE + 300), (7 * SECTOR_SIZE + 100, 2 * SECTOR_SIZE - 100),
+                        (9 * SECTOR_SIZE + 200, 3 * SECTOR_SIZE + 500)]
+
+def test_invalid_segments_rejected(board):
+    app = make_sparse_app()
+    image = pack_sparse(app)
+    segments = pack_image.find_segments(app)
+    (a_offset, a_length), (b_offset, b_length), (c_offset, c_length) = segments
+    invalid = {
+        "no segments": set_segments(image, [], count=0),
+        "too many segments": set_segments(image, segments, count=pack_image.MAX_SEGMENTS + 1),
+        "header padding read as segments": set_segments(image, segments, count=pack_image.MAX_SEGMENTS),
+        "empty segment": set_segments(image, [(a_offset, a_length), (b_offset, 0), (b_offset, b_length + c_length)]),
+        "overlapping segments": set_segments(image, [(a_offset, a_length), (a_offset + a_length - 4, b_length), (c_offset, c_length + 4)]),
+        "segments out of order": set_segments(image, [(b_offset, b_length), (a_offset, a_length), (c_offset, c_length)]),
+        "segment beyond app": set_segments(image, [(a_offset, a_length), (b_offset, b_length), (c_offset + 4, c_length)]),
+        "segment starting beyond app": set_segments(image, [(a_offset, a_length), (b_offset, b_length + c_length), (len(app) + 4, 1)]),
+    }
+    for bad in invalid.values():
+        check_rejected(board(*SPARSE_FLAGS), bad, "image segments invalid")
+
+    # the segments must hold the data of the image
+    check_rejected(board(*SPARSE_FLAGS), set_segments(image, [(a_offset, a_length), (b_offset, b_length), (c_offset, c_length - 4)]),
+                   "image size mismatch")
+
+def test_sparse_not_supported(board):
+    check_rejected(board(), pack_sparse(make_sparse_app()), "sparse images not supported")
@@ -0,0 +1,112 @@
+"""
+Updates staged by the application in the upper half of the flash: the copy to the application area, and resuming
+a copy interrupted by a power cut.
+"""
+import pack_image
+from harness import APP_BASE_ADDRESS, SECTOR_SIZE, make_app
+
+# the staging slot needs the 512K variant, which the board would override
+STAGING_FLAGS = ("-D ENABLE_STAGED_UPDATES=1", "-D CHIPID_VARIANT_OVERRIDE_ENABLE=0")
+
+def stage(b, app: bytes):
+    """Write the staging slot, as the application would."""
+    b.write_flash(pack_image.STAGING_SLOT_ADDRESS, pack_image.pack_staged(app, "sha256"))
+
+def is_trailer_erased(b) -> bool:
+    return b.read_flash(pack_image.STAGING_TRAILER_ADDRESS, 64) == b"\xff" * 64
+
+def test_installs_staged_update(board):
+    b = board(*STAGING_FLAGS)
+    app = make_app(5 * SECTOR_SIZE + 300)
+    stage(b, app)
+
+    result = b.run()
+    assert result.jumped, result
+    assert "found staged update" in result.log
+    assert "update applied" in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+
+    # the trailer is erased once the update is installed, so it isn't installed again
+    assert is_trailer_erased(b)
+    result = b.run()
+    assert result.jumped, result
+    assert "found staged update" not in result.log
+    assert result.flash_writes == 0
+    print(f"staged copy of {len(app)} bytes: {result.stats['time_ms']} ms")
+
+def test_staged_update_before_update_file(board):
+    b = board(*STAGING_FLAGS)
+    staged = make_app(20000, seed=1)
+    stage(b, staged)
+    b.insert_card({"FIRMWARE.BIN": make_app(20000, seed=2)})
+
+    result = b.run()
+    assert result.jumped, result
+    assert "checking FIRMWARE.BIN" not in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(staged)) == staged
+
+def test_resumes_interrupted_copy(board):
+    app = make_app(5 * SECTOR_SIZE + 300)
+
+    full = board(*STAGING_FLAGS)
+    stage(full, app)
+    full_result = full.run()
+    assert full_result.jumped, full_result
+
+    # the power is cut after three sectors of the application were copied: the metadata sector, the update marker
+    # and the application sectors are erased first
+    b = board(*STAGING_FLAGS)
+    stage(b, app)
+    result = b.run({"NATIVE_POWER_CUT": str(1 + 1 + 6 + (3 * SECTOR_SIZE // 4))})
+    assert result.power_cut, result
+    assert not is_trailer_erased(b)
+
+    # the sectors copied already are kept
+    result = b.run()
+    assert result.jumped, result
+    assert "update applied" in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
+    assert is_trailer_erased(b)
+    assert result.stats["words_programmed"] < full_result.stats["words_programmed"] / 2
+    print(f"full copy: {full_result.stats['sectors_erased']} sectors erased, {full_result.stats['words_programmed']} words programmed; "
+          f"resumed copy: {result.stats['sectors_erased']} sectors erased, {result.stats['words_programmed']} words programmed")
+
+def test_interrupted_copy_not_booted_without_slot(board):
+    # interrupted while erasing, and the staged update is gone before the next boot
+    b = board(*STAGING_FLAGS)
+    stage(b, make_app(3 * SECTOR_SIZE + 300))
+    assert b.run({"NATIVE_POWER_CUT": "4"}).power_cut
+    b.write_flash(pack_image.STAGING_TRAILER_ADDRESS, b"\x00" * 4)
+
+    result = b.run()
+    assert "update incomplete" in result.log
+    assert result.halted, result
+
+def test_corrupt_staged_app_ignored(board):
+    b = board(*STAGING_FLAGS)
+    app = make_app(20000)
+    stage(b, app)
+    b.write_flash(pack_image.STAGING_SLOT_ADDRESS + 1000, b"\x00" * 4)
+
+    result = b.run()
+    assert "staged app corrupt" in result.log
+    assert result.flash_writes == 0
+
+def test_corrupt_trailer_ignored(board):
+    b = board(*STAGING_FLAGS)
+    stage(b, make_app(20000))
+    b.write_flash(pack_image.STAGING_TRAILER_ADDRESS + 4, b"\x00")
+
+    result = b.run()
+    assert "staged trailer corrupt" in result.log
+    assert result.flash_writes == 0
+
+def test_no_slot_on_256k_chip(board):
+    b = board(*STAGING_FLAGS, chip="C")
+    app = make_app(20000)
+    b.insert_card({"FIRMWARE.BIN": app})
+
+    result = b.run()
+    assert result.jumped, result
+    assert "found staged update" not in result.log
+    assert b.read_flash(APP_BASE_ADDRESS, len(app)) == app
@@ -0,0 +1,205 @@
+/**
+ * tests of the AES peripheral model of the native build against standard test vectors, and of the CTR stream of the
+ * aes module across chunk boundaries. the aes module is only built with ENABLE_ENCRYPTED_IMAGES, so its tests run
+ * with -D ENABLE_ENCRYPTED_IMAGES=1 and an IMAGE_KEY in PLATFORMIO_BUILD_FLAGS
+ */
+#include <unity.h>
+#include <string.h>
+#include "modules/aes.h"
+
+void setUp() {}
+void tearDown() {}
+
+/**
+ * @brief encrypt a block with the peripheral, through its registers
+ */
+void encrypt_with_registers(const uint8_t key[16], const uint8_t input[16], uint8_t output[16])
+{
+  memcpy(&M4_AES->KR0, key, 16);
+  memcpy(&M4_AES->DR0, input, 16);
+  bM4_AES_CR_MODE = 0;
+  bM4_AES_CR_START = 1;
+  TEST_ASSERT_EQUAL_UINT32(0, static_cast<uint32_t>(bM4_AES_CR_START));
+  memcpy(output, &M4_AES->DR0, 16);
+}
+
+/**
+ * @brief FIPS-197 appendix C.1
+ */
+const uint8_t fips197_key[16] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+};
+const uint8_t fips197_plain[16] = {
+  0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+};
+const uint8_t fips197_cipher[16] = {
+  0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A,
+};
+
+/**
+ * @brief SP 800-38A F.1.1, ECB-AES128
+ */
+const uint8_t sp800_key[16] = {
+  0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C,
+};
+const uint8_t sp800_plain[4][16] = {
+  { 0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A },
+  { 0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51 },
+  { 0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF },
+  { 0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10 },
+};
+const uint8_t sp800_cipher[4][16] = {
+  { 0x3A, 0xD7, 0x7B, 0xB4, 0x0D, 0x7A, 0x36, 0x60, 0xA8, 0x9E, 0xCA, 0xF3, 0x24, 0x66, 0xEF, 0x97 },
+  { 0xF5, 0xD3, 0xD5, 0x85, 0x03, 0xB9, 0x69, 0x9D, 0xE7, 0x85, 0x89, 0x5A, 0x96, 0xFD, 0xBA, 0xAF },
+  { 0x43, 0xB1, 0xCD, 0x7F, 0x59, 0x8E, 0xCE, 0x23, 0x88, 0x1B, 0x00, 0xE3, 0xED, 0x03, 0x06, 0x88 },
+  { 0x7B, 0x0C, 0x78, 0x5E, 0x27, 0xE8, 0xAD, 0x3F, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5D, 0xD4 },
+};
+
+void test_model_fips197()
+{
+  uint8_t output[16];
+  encrypt_with_registers(fips197_key, fips197_plain, output);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(fips197_cipher, output, 16);
+}
+
+void test_model_sp800_38a()
+{
+  for (int i = 0; i < 4; i++)
+  {
+    uint8_t output[16];
+    encrypt_with_registers(sp800_key, sp800_plain[i], output);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sp800_cipher[i], output, 16);
+  }
+}
+
+#if ENABLE_ENCRYPTED_IMAGES == 1
+  /**
+   * @brief test data, byte i is (i * 7) + 3
+   */
+  uint8_t data[80];
+
+  /**
+   * @brief the test data encrypted in CTR mode with the FIPS-197 key and ctr_nonce, as by pack_image.py aes_ctr(),
+   * whose CTR stream matches SP 800-38A F.5.1
+   */
+  const uint8_t ctr_nonce[12] = { 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB };
+  const uint8_t ctr_cipher[80] = {
+    0x04, 0x76, 0x70, 0x5B, 0xD4, 0x04, 0x36, 0xF7, 0x6E, 0xBD, 0x6A, 0x85, 0xAE, 0xDA, 0xC4, 0x02,
+    0x8F, 0x94, 0xE8, 0x95, 0xAD, 0x51, 0xE4, 0x17, 0x0A, 0x14, 0x61, 0x62, 0xB0, 0x9E, 0xA5, 0xB9,
+    0x49, 0x6C, 0xC9, 0x43, 0x81, 0x8F, 0x3E, 0x1E, 0x91, 0x5A, 0x9C, 0x30, 0x71, 0x2C, 0xF5, 0x2C,
+    0x00, 0xB4, 0x42, 0x60, 0xEC, 0x61, 0x40, 0x2B, 0xAE, 0x82, 0xE8, 0x3B, 0xE5, 0x23, 0x3A, 0x14,
+    0x59, 0x69, 0x94, 0xE9, 0xD0, 0x0C, 0x01, 0x99, 0x84, 0xDC, 0xEB, 0xD4, 0xB8, 0xC5, 0x2C, 0xFC,
+  };
+
+  /**
+   * @brief the first 40 bytes of the test data, encrypted at offset 0x10005: 5 bytes into block 0x1000
+   */
+  const uint8_t ctr_cipher_at_offset[40] = {
+    0x70, 0xB4, 0x3A, 0xB4, 0x96, 0xB3, 0x88, 0x4B, 0x38, 0x46, 0x84, 0xA1, 0x38, 0xCB, 0x43, 0xB3,
+    0x99, 0xF3, 0x8A, 0xE9, 0x0F, 0xB7, 0xA5, 0x39, 0x9D, 0x64, 0x18, 0x7F, 0xFC, 0xC4, 0x0D, 0xEB,
+    0x0F, 0xB0, 0x54, 0xE1, 0xC7, 0xD1, 0x24, 0x6E,
+  };
+
+  void test_encrypt_block()
+  {
+    uint8_t output[16];
+    aes::encrypt_block(fips197_key, fips197_plain, output);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(fips197_cipher, output, 16);
+
+    // in place
+    memcpy(output, sp800_plain[0], 16);
+    aes::encrypt_block(sp800_key, output, output);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sp800_cipher[0], output, 16);
+  }
+
+  void test_ctr_vector()
+  {
+    uint8_t buffer[80];
+    memcpy(buffer, data, sizeof(buffer));
+    aes::start_ctr(fips197_key, ctr_nonce, 0);
+    aes::apply_ctr(buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(ctr_cipher, buffer, sizeof(buffer));
+
+    // and back
+    aes::start_ctr(fips197_key, ctr_nonce, 0);
+    aes::apply_ctr(buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(data, buffer, sizeof(buffer));
+  }
+
+  void test_ctr_chunk_boundaries()
+  {
+    // chunks ending inside, at and after the end of a block, and buffers not aligned to words
+    const uint32_t pieces[][4] = {
+      { 1, 15, 16, 48 },
+      { 15, 17, 32, 16 },
+      { 17, 3, 13, 47 },
+      { 5, 5, 5, 65 },
+    };
+    for (const auto &sizes : pieces)
+    {
+      for (uint32_t alignment = 0; alignment < 4; alignment++)
+      {
+        uint8_t storage[84];
+        uint8_t *buffer = storage + alignment;
+        memcpy(buffer, data, sizeof(data));
+
+        aes::start_ctr(fips197_key, ctr_nonce, 0);
+        uint32_t offset = 0;
+        for (const uint32_t size : sizes)
+        {
+          aes::apply_ctr(buffer + offset, size);
+          offset += size;
+        }
+        TEST_ASSERT_EQUAL_UINT32(sizeof(data), offset);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(ctr_cipher, buffer, sizeof(data));
+      }
+    }
+  }
+
+  void test_ctr_seek()
+  {
+    // into the middle of a block, back to the start, and to the block in flight
+    uint8_t buffer[40];
+    aes::start_ctr(fips197_key, ctr_nonce, 0x10005);
+    memcpy(buffer, data, sizeof(buffer));
+    aes::apply_ctr(buffer, 20);
+    aes::apply_ctr(buffer + 20, 20);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(ctr_cipher_at_offset, buffer, sizeof(buffer));
+
+    uint8_t start[40];
+    memcpy(start, data, sizeof(start));
+    aes::seek_ctr(0);
+    aes::apply_ctr(start, 7);
+    aes::seek_ctr(7);
+    aes::apply_ctr(start + 7, 33);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(ctr_cipher, start, sizeof(start));
+
+    uint8_t first[16];
+    uint8_t next[24];
+    memcpy(next, data + 16, sizeof(next));
+    aes::seek_ctr(0);
+    aes::apply_ctr(first, sizeof(first));
+    aes::seek_ctr(16);
+    aes::apply_ctr(next, sizeof(next));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(ctr_cipher + 16, next, sizeof(next));
+  }
+#endif
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_model_fips197);
+  RUN_TEST(test_model_sp800_38a);
+  #if ENABLE_ENCRYPTED_IMAGES == 1
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+      data[i] = static_cast<uint8_t>((i * 7) + 3);
+    }
+
+    RUN_TEST(test_encrypt_block);
+    RUN_TEST(test_ctr_vector);
+    RUN_TEST(test_ctr_chunk_boundaries);
+    RUN_TEST(test_ctr_seek);
+  #endif
+  return UNITY_END();
+}
@@ -0,0 +1,140 @@
+/**
+ * tests of the beep sequencer, sampling the beeper pin of the native build every tick of the simulated SysTick
+ */
+#include <unity.h>
+#include <string>
+#include "config.h"
+#include "modules/beep.h"
+#include "modules/gpio.h"
+#include "modules/timebase.h"
+
+/**
+ * @brief let time pass one tick at a time, recording the beeper pin level after each tick
+ * @param ms number of ticks to record
+ * @return the runs of the same level, e.g. "#3.2" for 3 ms on and 2 ms off
+ */
+std::string record(const int ms)
+{
+  std::string runs;
+  bool level = false;
+  int length = 0;
+  for (int i = 0; i < ms; i++)
+  {
+    Ddl_Delay1us(1000);
+    const bool sample = BEEPER_PIN.read();
+    if (length > 0 && sample != level)
+    {
+      runs += (level ? "#" : ".") + std::to_string(length);
+      length = 0;
+    }
+    level = sample;
+    length++;
+  }
+  runs += (level ? "#" : ".") + std::to_string(length);
+  return runs;
+}
+
+void setUp()
+{
+  timebase::init();
+}
+
+void tearDown()
+{
+  beep::stop();
+  timebase::deinit();
+}
+
+void test_pattern()
+{
+  beep::play(3, 2, 2);
+  const std::string levels = record(20);
+  TEST_ASSERT_EQUAL_STRING("#3.2#3.12", levels.c_str());
+}
+
+void test_patterns_play_in_order()
+{
+  beep::play(2, 1, 1);
+  beep::play(4, 1, 3);
+  beep::play(1, 2, 0);
+  const std::string levels = record(20);
+  TEST_ASSERT_EQUAL_STRING("#2.1#4.3#2.8", levels.c_str());
+}
+
+void test_beep_returns_right_away()
+{
+  const uint32_t start = timebase::now();
+  beep::beep(50, 2);
+  TEST_ASSERT_LESS_THAN_UINT32(100, timebase::now() - start);
+
+  // two beeps and two gaps, and the tick noticing the queue is empty
+  beep::wait();
+  TEST_ASSERT_UINT32_WITHIN(2, 201, (timebase::now() - start) / 1000);
+  TEST_ASSERT_FALSE(BEEPER_PIN.read());
+}
+
+void test_full_queue_waits_for_room()
+{
+  for (int i = 0; i < 4; i++)
+  {
+    beep::play(5, 1, 5);
+  }
+
+  // the fifth pattern waits until the first one was taken from the queue
+  const uint32_t start = timebase::now();
+  beep::play(1, 1, 1);
+  const uint32_t waited = timebase::now() - start;
+  TEST_ASSERT_GREATER_THAN_UINT32(0, waited);
+  TEST_ASSERT_LESS_THAN_UINT32(15000, waited);
+
+  beep::wait();
+  TEST_ASSERT_UINT32_WITHIN(3, 42, (timebase::now() - start) / 1000);
+}
+
+void test_stop_silences_and_drops_queue()
+{
+  beep::play(10, 3, 10);
+  beep::play(10, 3, 10);
+  record(5);
+  TEST_ASSERT_TRUE(BEEPER_PIN.read());
+
+  beep::stop();
+  TEST_ASSERT_FALSE(BEEPER_PIN.read());
+  const std::string levels = record(50);
+  TEST_ASSERT_EQUAL_STRING(".50", levels.c_str());
+}
+
+void test_every_tick_reaches_sequencer()
+{
+  // a long pattern lasts exactly as many ticks as requested, so no tick was lost to now()
+  beep::play(500, 1, 0);
+  const std::string levels = record(510);
+  TEST_ASSERT_EQUAL_STRING("#500.10", levels.c_str());
+}
+
+void test_blocking_without_time_base()
+{
+  timebase::deinit();
+
+  const uint32_t cycles = DWT->CYCCNT;
+  beep::beep(5, 2);
+  const uint32_t elapsed_us = (DWT->CYCCNT - cycles) / (SystemCoreClock / 1000000ul);
+
+  TEST_ASSERT_UINT32_WITHIN(500, 20000, elapsed_us);
+  TEST_ASSERT_FALSE(BEEPER_PIN.read());
+
+  timebase::init();
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_pattern);
+  RUN_TEST(test_patterns_play_in_order);
+  RUN_TEST(test_beep_returns_right_away);
+  RUN_TEST(test_full_queue_waits_for_room);
+  RUN_TEST(test_stop_silences_and_drops_queue);
+  RUN_TEST(test_every_tick_reaches_sequencer);
+  RUN_TEST(test_blocking_without_time_base);
+  return UNITY_END();
+}
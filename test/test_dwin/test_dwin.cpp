@@ -0,0 +1,353 @@
+/**
+ * tests of the DWIN screen driver, capturing the bytes sent to the screen serial of the native build.
+ * a panel model answers the handshakes sent at its baud rate
+ */
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "modules/screens/dwin/dwin.h"
+#include "modules/serial.h"
+#include "modules/timebase.h"
+#include "modules/delay.h"
+#include "util.h"
+#include "../usart_capture.h"
+
+/**
+ * @brief model of the panel, reading the frames sent to it from the capture file and answering through a pipe
+ */
+namespace panel
+{
+  /**
+   * @brief does the panel answer at all?
+   */
+  std::atomic<bool> present(false);
+
+  /**
+   * @brief does the panel firmware implement the set baud rate command?
+   */
+  std::atomic<bool> follows_baudrate(true);
+
+  /**
+   * @brief the baud rate the panel listens and answers at
+   */
+  std::atomic<uint32_t> baudrate(dwin::constants::default_baudrate);
+
+  /**
+   * @brief the pipe the screen serial receives from
+   */
+  int rx_pipe[2];
+
+  /**
+   * @brief get the baud rate the screen serial is set to, as the native USART model derives it
+   */
+  uint32_t host_baudrate()
+  {
+    const M4_USART_TypeDef *usart = CONCAT(M4_USART, SCREEN_SERIAL);
+    const uint64_t clock = SystemCoreClock / (1ul << (2ul * usart->PR_f.PSC));
+    const uint64_t fraction = usart->CR1_f.FBME != 0 ? (128 + usart->BRR_f.DIV_FRACTION) : 256;
+    const uint64_t divider = 8ull * (2 - usart->CR1_f.OVER8) * (usart->BRR_f.DIV_INTEGER + 1) * 256;
+    return static_cast<uint32_t>((clock * fraction) / divider);
+  }
+
+  /**
+   * @brief handle a frame sent to the panel
+   * @note a handshake is answered right after it is sent, so the baud rate of the screen serial is still the one it
+   * was sent at. a set baud rate command is not, so it is taken as received
+   */
+  void receive(const std::vector<uint8_t> &frame)
+  {
+    if (!present || frame.size() < 2)
+    {
+      return;
+    }
+
+    const uint8_t command = frame[1];
+    if (command == 0x00)
+    {
+      // frames sent at another baud rate arrive garbled
+      const uint32_t host = host_baudrate();
+      const uint32_t own = baudrate;
+      if ((host > own ? host - own : own - host) * 20 > own)
+      {
+        return;
+      }
+
+      const uint8_t response[] = { 0xAA, 0x00, 'O', 'K', 0xCC, 0x33, 0xC3, 0x3C };
+      TEST_ASSERT_EQUAL(sizeof(response), write(rx_pipe[1], response, sizeof(response)));
+    }
+    else if (command == dwin::constants::set_baudrate_cmd && follows_baudrate && frame.size() >= 6)
+    {
+      baudrate = (frame[2] << 24) | (frame[3] << 16) | (frame[4] << 8) | frame[5];
+    }
+  }
+
+  /**
+   * @brief follow the capture file, splitting it into frames
+   */
+  void run()
+  {
+    FILE *f = fopen(capture_path, "rb");
+    std::vector<uint8_t> frame;
+    for (;;)
+    {
+      const int ch = fgetc(f);
+      if (ch == EOF)
+      {
+        clearerr(f);
+        usleep(50);
+        continue;
+      }
+
+      // frames start with the head, and end with the tail
+      if (frame.empty() && ch != dwin::constants::head[0])
+      {
+        continue;
+      }
+
+      frame.push_back(static_cast<uint8_t>(ch));
+      constexpr size_t tail_size = sizeof(dwin::constants::tail);
+      if (frame.size() > tail_size && memcmp(frame.data() + frame.size() - tail_size, dwin::constants::tail, tail_size) == 0)
+      {
+        receive(frame);
+        frame.clear();
+      }
+    }
+  }
+
+  /**
+   * @brief start the panel model. the screen serial must not be initialized yet
+   */
+  void start()
+  {
+    TEST_ASSERT_EQUAL(0, pipe(panel::rx_pipe));
+    char name[24];
+    char path[24];
+    snprintf(name, sizeof(name), "NATIVE_USART%d_RX", SCREEN_SERIAL);
+    snprintf(path, sizeof(path), "/dev/fd/%d", panel::rx_pipe[0]);
+    setenv(name, path, 1);
+    std::thread(run).detach();
+  }
+
+  /**
+   * @brief reset the panel and the screen serial to the power-up baud rate
+   */
+  void reset(const bool is_present, const bool follows)
+  {
+    present = is_present;
+    follows_baudrate = follows;
+    baudrate = dwin::constants::default_baudrate;
+    screenSerial.set_baudrate(dwin::constants::default_baudrate);
+  }
+} // namespace panel
+
+/**
+ * @brief count the frames with the given command and payload in the sent bytes
+ */
+int count_frames(const std::vector<uint8_t> &sent, const std::vector<uint8_t> &payload)
+{
+  std::vector<uint8_t> frame(dwin::constants::head, dwin::constants::head + sizeof(dwin::constants::head));
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  frame.insert(frame.end(), dwin::constants::tail, dwin::constants::tail + sizeof(dwin::constants::tail));
+
+  int count = 0;
+  for (auto at = sent.begin(); (at = std::search(at, sent.end(), frame.begin(), frame.end())) != sent.end(); at++)
+  {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief the set baud rate command for a baud rate
+ */
+std::vector<uint8_t> set_baudrate_payload(const uint32_t baudrate)
+{
+  return {
+    dwin::constants::set_baudrate_cmd,
+    static_cast<uint8_t>(baudrate >> 24), static_cast<uint8_t>(baudrate >> 16),
+    static_cast<uint8_t>(baudrate >> 8), static_cast<uint8_t>(baudrate)
+  };
+}
+
+/**
+ * @brief a sequence of drawing commands, as the screen module would send them
+ * @param lines number of text lines to draw
+ */
+void draw_sequence(const int lines)
+{
+  dwin::fill_screen(dwin::color::black);
+  dwin::draw_rectangle(dwin::color::white, { 10, 20, 200, 30 }, false);
+  for (int i = 0; i < lines; i++)
+  {
+    dwin::move_screen_area({ 0, 50, 272, 400 }, dwin::screen_area_shift_dir::up, 20, dwin::color::black);
+    dwin::draw_string("writing sector 12 of 40", 4, static_cast<uint16_t>(50 + (i * 20)),
+      dwin::font_size::pt16, dwin::color::white, dwin::color::black, true);
+  }
+  dwin::redraw();
+}
+
+void setUp()
+{
+  // let the screen process everything sent by the previous test
+  delay::ms(500);
+  take_sent();
+}
+
+void tearDown() {}
+
+void test_frame_bytes()
+{
+  dwin::draw_rectangle(dwin::color::white, { 1, 2, 3, 4 }, true);
+
+  const uint8_t expected[] = {
+    0xAA,                           // head
+    0x05, 0x01, 0xFF, 0xFF,         // draw rectangle, filled, white
+    0x00, 0x01, 0x00, 0x02,         // x, y
+    0x00, 0x04, 0x00, 0x06,         // x end, y end
+    0xCC, 0x33, 0xC3, 0x3C,         // tail
+  };
+  const std::vector<uint8_t> sent = take_sent();
+  TEST_ASSERT_EQUAL_size_t(sizeof(expected), sent.size());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, sent.data(), sizeof(expected));
+}
+
+void test_batched_stream_matches_unbatched()
+{
+  // enough lines to overflow the batch buffer, so the batch is split
+  draw_sequence(8);
+  const std::vector<uint8_t> unbatched = take_sent();
+  TEST_ASSERT_GREATER_THAN_UINT32(dwin::constants::batch_buffer_size, unbatched.size());
+
+  dwin::begin_batch();
+  draw_sequence(8);
+  dwin::end_batch();
+  const std::vector<uint8_t> batched = take_sent();
+
+  TEST_ASSERT_EQUAL_size_t(unbatched.size(), batched.size());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(unbatched.data(), batched.data(), unbatched.size());
+}
+
+void test_nested_batch_sends_on_outermost_end()
+{
+  dwin::begin_batch();
+  dwin::begin_batch();
+  dwin::redraw();
+  dwin::end_batch();
+  TEST_ASSERT_EQUAL_size_t(0, take_sent().size());
+
+  dwin::end_batch();
+  TEST_ASSERT_EQUAL_size_t(6, take_sent().size());
+}
+
+void test_batch_waits_for_all_operation_delays()
+{
+  dwin::begin_batch();
+  for (int i = 0; i < 4; i++)
+  {
+    dwin::draw_string("x", 0, 0, dwin::font_size::pt16, dwin::color::white, dwin::color::black, true);
+  }
+  dwin::move_screen_area({ 0, 0, 10, 10 }, dwin::screen_area_shift_dir::up, 1, dwin::color::black);
+  dwin::end_batch();
+
+  // the screen processes the commands one after another, so the next one waits for all of them
+  const uint32_t settle_time = ((4 * dwin::constants::delays::draw_string) + dwin::constants::delays::move_screen_area) * 1000;
+  const uint32_t sent_at = timebase::now();
+  dwin::redraw();
+  const uint32_t waited = timebase::now() - sent_at;
+
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(settle_time, waited);
+  TEST_ASSERT_LESS_THAN_UINT32(settle_time + 1000, waited);
+}
+
+void test_init_switches_baudrate()
+{
+  panel::reset(true, true);
+  TEST_ASSERT_TRUE(dwin::init());
+
+  const std::vector<uint8_t> sent = take_sent();
+  TEST_ASSERT_EQUAL(2, count_frames(sent, { 0x00 }));
+  TEST_ASSERT_EQUAL(1, count_frames(sent, set_baudrate_payload(SCREEN_SERIAL_BAUD)));
+  TEST_ASSERT_EQUAL_UINT32(SCREEN_SERIAL_BAUD, panel::baudrate);
+  TEST_ASSERT_UINT32_WITHIN(SCREEN_SERIAL_BAUD / 20, SCREEN_SERIAL_BAUD, panel::host_baudrate());
+}
+
+void test_init_falls_back_without_ping()
+{
+  // the panel ignores the set baud rate command, so the handshake at the new baud rate fails
+  panel::reset(true, false);
+  TEST_ASSERT_TRUE(dwin::init());
+
+  const std::vector<uint8_t> sent = take_sent();
+  TEST_ASSERT_EQUAL(1, count_frames(sent, set_baudrate_payload(SCREEN_SERIAL_BAUD)));
+  TEST_ASSERT_EQUAL(1, count_frames(sent, set_baudrate_payload(dwin::constants::default_baudrate)));
+  TEST_ASSERT_EQUAL(3, count_frames(sent, { 0x00 }));
+  TEST_ASSERT_UINT32_WITHIN(dwin::constants::default_baudrate / 20, dwin::constants::default_baudrate, panel::host_baudrate());
+}
+
+void test_init_without_panel()
+{
+  panel::reset(false, true);
+  TEST_ASSERT_FALSE(dwin::init());
+  TEST_ASSERT_EQUAL(dwin::constants::init_retries, count_frames(take_sent(), { 0x00 }));
+}
+
+void test_frame_time()
+{
+  // a screen update fitting into one batch, at the power-up and at the faster baud rate
+  uint32_t frame_us[2];
+  const uint32_t baudrates[] = { dwin::constants::default_baudrate, SCREEN_SERIAL_BAUD };
+  for (int i = 0; i < 2; i++)
+  {
+    panel::reset(true, true);
+    screenSerial.set_baudrate(baudrates[i]);
+    delay::ms(500);
+
+    const uint32_t start = timebase::now();
+    dwin::begin_batch();
+    draw_sequence(3);
+    dwin::end_batch();
+    screenSerial.flush();
+    frame_us[i] = timebase::now() - start;
+
+    const size_t bytes = take_sent().size();
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(dwin::constants::batch_buffer_size, bytes);
+    printf("%u baud: %u bytes per frame in %u us\n", static_cast<unsigned>(baudrates[i]), static_cast<unsigned>(bytes),
+      static_cast<unsigned>(frame_us[i]));
+
+    // ten bits per byte, and the byte transmit delay
+    const uint32_t line_us = static_cast<uint32_t>((bytes * 10 * 1000000ull) / baudrates[i]);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(line_us, frame_us[i]);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32((line_us * 21 / 20) + (bytes * dwin::constants::delays::byte_tx) + 100, frame_us[i]);
+  }
+
+  TEST_ASSERT_LESS_THAN_UINT32(frame_us[0] / 2, frame_us[1]);
+  panel::reset(true, true);
+}
+
+int main()
+{
+  start_capture(SCREEN_SERIAL);
+  panel::start();
+
+  timebase::init();
+  screenSerial.init(dwin::constants::default_baudrate);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_bytes);
+  RUN_TEST(test_batched_stream_matches_unbatched);
+  RUN_TEST(test_nested_batch_sends_on_outermost_end);
+  RUN_TEST(test_batch_waits_for_all_operation_delays);
+  RUN_TEST(test_init_switches_baudrate);
+  RUN_TEST(test_init_falls_back_without_ping);
+  RUN_TEST(test_init_without_panel);
+  RUN_TEST(test_frame_time);
+  const int failures = UNITY_END();
+
+  stop_capture();
+  return failures;
+}
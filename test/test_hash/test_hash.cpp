@@ -0,0 +1,123 @@
+/**
+ * tests of the SHA-256 hash module against standard test vectors, on the HASH peripheral model of the native build
+ */
+#include <unity.h>
+#include "modules/hash.h"
+
+void setUp() {}
+void tearDown() {}
+
+#if METADATA_HASH == HASH_SHA256
+  /**
+   * @brief test data, byte i is (i * 7) + 3
+   */
+  uint8_t data[1000];
+
+  /**
+   * @brief hash the first len bytes of the test data, pushed in pieces of the given size
+   */
+  void hash_pieces(const uint32_t len, const uint32_t piece, hash::hash_t &digest)
+  {
+    TEST_ASSERT_TRUE(hash::start());
+    for (uint32_t offset = 0; offset < len; offset += piece)
+    {
+      TEST_ASSERT_TRUE(hash::push_data(data + offset, (len - offset) < piece ? (len - offset) : piece));
+    }
+    TEST_ASSERT_TRUE(hash::get_hash(digest));
+  }
+
+  void test_empty()
+  {
+    const uint8_t expected[32] = {
+      0xE3, 0xB0, 0xC4, 0x42, 0x98, 0xFC, 0x1C, 0x14, 0x9A, 0xFB, 0xF4, 0xC8, 0x99, 0x6F, 0xB9, 0x24,
+      0x27, 0xAE, 0x41, 0xE4, 0x64, 0x9B, 0x93, 0x4C, 0xA4, 0x95, 0x99, 0x1B, 0x78, 0x52, 0xB8, 0x55,
+    };
+    hash::hash_t digest;
+    TEST_ASSERT_TRUE(hash::start());
+    TEST_ASSERT_TRUE(hash::get_hash(digest));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, 32);
+  }
+
+  void test_abc()
+  {
+    const uint8_t expected[32] = {
+      0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+      0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD,
+    };
+    hash::hash_t digest;
+    TEST_ASSERT_TRUE(hash::start());
+    TEST_ASSERT_TRUE(hash::push_data(reinterpret_cast<const uint8_t *>("abc"), 3));
+    TEST_ASSERT_TRUE(hash::get_hash(digest));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, 32);
+  }
+
+  void test_padding_boundaries()
+  {
+    // 55 bytes leave room for the length in the last block, 56 don't, and 64 need a block of padding only
+    const uint8_t expected_55[32] = {
+      0xE7, 0x31, 0x3D, 0x33, 0x3C, 0x27, 0x2E, 0x63, 0x9F, 0x79, 0x09, 0x78, 0x28, 0x3F, 0x9E, 0xB3,
+      0x92, 0xE8, 0x43, 0xD0, 0xF2, 0x9B, 0x70, 0x16, 0x82, 0x8B, 0xB1, 0xDA, 0xA4, 0xAA, 0xC7, 0x0B,
+    };
+    const uint8_t expected_56[32] = {
+      0x43, 0x24, 0xD6, 0x5F, 0x3C, 0x10, 0x35, 0x67, 0xF5, 0x58, 0x9C, 0x71, 0x0B, 0xC0, 0x8F, 0x85,
+      0x23, 0xF9, 0x29, 0xA9, 0x27, 0x2E, 0x3A, 0xF3, 0x6F, 0xC9, 0x68, 0xE5, 0x2A, 0xBC, 0x6C, 0x27,
+    };
+    const uint8_t expected_64[32] = {
+      0x39, 0xE3, 0xD7, 0xB6, 0xB5, 0xD0, 0x75, 0xD3, 0x7D, 0x05, 0x3A, 0xD8, 0x9B, 0x24, 0xB4, 0x1B,
+      0xEF, 0x4F, 0x3C, 0x29, 0x76, 0x0C, 0x84, 0x44, 0x7C, 0xAB, 0x3F, 0x3B, 0xE1, 0x88, 0x22, 0x41,
+    };
+
+    hash::hash_t digest;
+    hash_pieces(55, 64, digest);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_55, digest, 32);
+    hash_pieces(56, 64, digest);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_56, digest, 32);
+    hash_pieces(64, 64, digest);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_64, digest, 32);
+  }
+
+  void test_same_hash_for_any_pieces()
+  {
+    // every byte is hashed, including the start of the first chunk
+    const uint8_t expected[32] = {
+      0x1E, 0x9B, 0xC3, 0x8C, 0xBF, 0x86, 0x0B, 0x9E, 0xC3, 0x19, 0x18, 0xB0, 0x65, 0xF9, 0xB5, 0x24,
+      0x76, 0xC5, 0x49, 0xA7, 0x82, 0xE0, 0xE7, 0x99, 0x0B, 0xED, 0x8C, 0xE3, 0x86, 0x8D, 0x23, 0x71,
+    };
+
+    const uint32_t pieces[] = { 64, 128, hash::chunk_size, sizeof(data) };
+    for (const uint32_t piece : pieces)
+    {
+      hash::hash_t digest;
+      hash_pieces(sizeof(data), piece, digest);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, 32);
+    }
+  }
+
+  void test_partial_push_must_be_last()
+  {
+    TEST_ASSERT_TRUE(hash::start());
+    TEST_ASSERT_TRUE(hash::push_data(data, 10));
+    TEST_ASSERT_FALSE(hash::push_data(data, 64));
+
+    hash::hash_t digest;
+    TEST_ASSERT_TRUE(hash::get_hash(digest));
+  }
+#endif
+
+int main()
+{
+  UNITY_BEGIN();
+  #if METADATA_HASH == HASH_SHA256
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+      data[i] = static_cast<uint8_t>((i * 7) + 3);
+    }
+
+    RUN_TEST(test_empty);
+    RUN_TEST(test_abc);
+    RUN_TEST(test_padding_boundaries);
+    RUN_TEST(test_same_hash_for_any_pieces);
+    RUN_TEST(test_partial_push_must_be_last);
+  #endif
+  return UNITY_END();
+}
@@ -0,0 +1,189 @@
+/**
+ * tests of the overflow accounting of the buffered host serial output. the buffer is only built with LOG_ASYNC, so
+ * these tests run with -D LOG_ASYNC=1 in PLATFORMIO_BUILD_FLAGS.
+ *
+ * the buffer is filled with interrupts disabled, so nothing is sent until it is full. the host serial output of the
+ * native build goes to stdout, which is redirected to a file while the buffer is filled and flushed.
+ */
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "modules/log.h"
+#include "modules/serial.h"
+
+void setUp() {}
+void tearDown() {}
+
+#if LOG_ASYNC == 1
+  /**
+   * @brief length of every message written, so the number of messages fitting the buffer is known
+   */
+  constexpr uint16_t message_length = 16;
+
+  /**
+   * @brief number of messages fitting the empty buffer, which keeps one byte free
+   */
+  constexpr int buffer_capacity = (LOG_BUFFER_SIZE - 1) / message_length;
+
+  namespace output
+  {
+    char path[] = "/tmp/log_output_XXXXXX";
+    int saved_stdout = -1;
+
+    /**
+     * @brief redirect stdout, and with it the host serial, to a file
+     */
+    void start()
+    {
+      strcpy(path, "/tmp/log_output_XXXXXX");
+      const int fd = mkstemp(path);
+      TEST_ASSERT_TRUE(fd >= 0);
+
+      fflush(stdout);
+      saved_stdout = dup(STDOUT_FILENO);
+      dup2(fd, STDOUT_FILENO);
+      close(fd);
+    }
+
+    /**
+     * @brief restore stdout
+     * @return everything the host serial sent since start()
+     */
+    std::string stop()
+    {
+      fflush(stdout);
+      dup2(saved_stdout, STDOUT_FILENO);
+      close(saved_stdout);
+
+      std::string sent;
+      FILE *file = fopen(path, "rb");
+      char chunk[256];
+      size_t length;
+      while ((length = fread(chunk, 1, sizeof(chunk), file)) != 0)
+      {
+        sent.append(chunk, length);
+      }
+      fclose(file);
+      unlink(path);
+      return sent;
+    }
+  } // namespace output
+
+  /**
+   * @brief write a numbered message to the buffer
+   */
+  void write_message(const char *name, const int number, const int level, const int overflow)
+  {
+    char message[message_length + 1];
+    snprintf(message, sizeof(message), "%-7s %07d\n", name, number);
+    logging::async::write(reinterpret_cast<const uint8_t *>(message), message_length, level, overflow);
+  }
+
+  bool was_sent(const std::string &sent, const char *name, const int number)
+  {
+    char message[message_length + 1];
+    snprintf(message, sizeof(message), "%-7s %07d\n", name, number);
+    return sent.find(message) != std::string::npos;
+  }
+
+  /**
+   * @brief write interleaved info and debug messages with interrupts disabled, then flush the buffer
+   * @return everything the host serial sent
+   */
+  std::string fill(const int info_count, const int debug_count, const int overflow)
+  {
+    output::start();
+    __disable_irq();
+    for (int i = 0; i < info_count || i < debug_count; i++)
+    {
+      if (i < info_count)
+      {
+        write_message("info", i, LOG_LEVEL_INFO, overflow);
+      }
+      if (i < debug_count)
+      {
+        write_message("debug", i, LOG_LEVEL_DEBUG, overflow);
+      }
+    }
+    __enable_irq();
+    logging::flush();
+    return output::stop();
+  }
+
+  void test_drop_keeps_first_messages()
+  {
+    constexpr int count = buffer_capacity + 37;
+    const std::string sent = fill(count, 0, LOG_OVERFLOW_DROP);
+
+    // the messages fitting the buffer are sent whole, the rest are counted
+    for (int i = 0; i < buffer_capacity; i++)
+    {
+      TEST_ASSERT_TRUE_MESSAGE(was_sent(sent, "info", i), "message fitting the buffer was dropped");
+    }
+    TEST_ASSERT_FALSE(was_sent(sent, "info", buffer_capacity));
+    TEST_ASSERT_EQUAL_UINT32(buffer_capacity * message_length + strlen("37 log messages dropped\n"), sent.size());
+    TEST_ASSERT_TRUE(sent.find("\n37 log messages dropped\n") != std::string::npos);
+  }
+
+  void test_drop_debug_keeps_info_messages()
+  {
+    constexpr int count = 2 * buffer_capacity;
+    const std::string sent = fill(count, count, LOG_OVERFLOW_DROP_DEBUG);
+
+    // info messages wait for space, debug messages are dropped when the buffer is full
+    int debug_sent = 0;
+    for (int i = 0; i < count; i++)
+    {
+      TEST_ASSERT_TRUE_MESSAGE(was_sent(sent, "info", i), "info message was dropped");
+      debug_sent += was_sent(sent, "debug", i) ? 1 : 0;
+    }
+    TEST_ASSERT_TRUE(debug_sent < count);
+
+    char dropped[32];
+    snprintf(dropped, sizeof(dropped), "\n%d log messages dropped\n", count - debug_sent);
+    TEST_ASSERT_TRUE_MESSAGE(sent.find(dropped) != std::string::npos, "dropped count doesn't match the missing messages");
+    TEST_ASSERT_EQUAL_UINT32((count + debug_sent) * message_length + strlen(dropped) - 1, sent.size());
+  }
+
+  void test_block_keeps_all_messages()
+  {
+    constexpr int count = 2 * buffer_capacity;
+    const std::string sent = fill(count, count, LOG_OVERFLOW_BLOCK);
+
+    for (int i = 0; i < count; i++)
+    {
+      TEST_ASSERT_TRUE(was_sent(sent, "info", i));
+      TEST_ASSERT_TRUE(was_sent(sent, "debug", i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(2 * count * message_length, sent.size());
+    TEST_ASSERT_TRUE(sent.find("dropped") == std::string::npos);
+  }
+
+  void test_dropped_count_reset_by_flush()
+  {
+    fill(buffer_capacity + 1, 0, LOG_OVERFLOW_DROP);
+
+    // the next flush has nothing to report
+    const std::string sent = fill(1, 0, LOG_OVERFLOW_DROP);
+    TEST_ASSERT_EQUAL_UINT32(message_length, sent.size());
+    TEST_ASSERT_TRUE(was_sent(sent, "info", 0));
+  }
+#endif
+
+int main()
+{
+  UNITY_BEGIN();
+  #if LOG_ASYNC == 1
+    hostSerial.init(HOST_SERIAL_BAUD);
+    logging::init();
+
+    RUN_TEST(test_drop_keeps_first_messages);
+    RUN_TEST(test_drop_debug_keeps_info_messages);
+    RUN_TEST(test_block_keeps_all_messages);
+    RUN_TEST(test_dropped_count_reset_by_flush);
+  #endif
+  return UNITY_END();
+}
@@ -0,0 +1,177 @@
+/**
+ * tests of the cooperative task scheduler, on the simulated core of the native build
+ */
+#include <unity.h>
+#include "modules/scheduler.h"
+#include "modules/timebase.h"
+
+/**
+ * @brief order the task steps ran in, as task ids
+ */
+char step_log[64];
+size_t step_count = 0;
+
+void log_step(const char id)
+{
+  if (step_count < sizeof(step_log) - 1)
+  {
+    step_log[step_count++] = id;
+    step_log[step_count] = '\0';
+  }
+}
+
+/**
+ * @brief a task yielding a number of times before it is done
+ */
+class counting_task : public scheduler::task
+{
+public:
+  counting_task(const char id, const int yields) : id(id), yields(yields) {}
+
+  scheduler::state step() override
+  {
+    TASK_BEGIN();
+    for (done_yields = 0; done_yields < yields; done_yields++)
+    {
+      log_step(id);
+      TASK_YIELD();
+    }
+    log_step(id);
+    TASK_END();
+  }
+
+private:
+  const char id;
+  const int yields;
+  int done_yields = 0;
+};
+
+/**
+ * @brief a task waiting for a deadline
+ */
+class sleeping_task : public scheduler::task
+{
+public:
+  explicit sleeping_task(const uint32_t us) : us(us) {}
+
+  scheduler::state step() override
+  {
+    TASK_BEGIN();
+    started_at = timebase::now();
+    TASK_WAIT_UNTIL(timebase::now() - started_at >= us);
+    woke_at = timebase::now();
+    TASK_END();
+  }
+
+  uint32_t started_at = 0;
+  uint32_t woke_at = 0;
+
+private:
+  const uint32_t us;
+};
+
+/**
+ * @brief a task failing on its second step
+ */
+class failing_task : public scheduler::task
+{
+public:
+  scheduler::state step() override
+  {
+    TASK_BEGIN();
+    log_step('f');
+    TASK_YIELD();
+    log_step('F');
+    return scheduler::state::failed;
+    TASK_END();
+  }
+};
+
+void setUp()
+{
+  timebase::init();
+  step_count = 0;
+  step_log[0] = '\0';
+}
+
+void tearDown()
+{
+  timebase::deinit();
+}
+
+void test_tasks_run_round_robin()
+{
+  counting_task a('a', 2);
+  counting_task b('b', 0);
+  counting_task c('c', 1);
+  scheduler::task *const tasks[] = { &a, &b, &c };
+
+  TEST_ASSERT_TRUE(scheduler::run(tasks, 3));
+  TEST_ASSERT_EQUAL_STRING("abcaca", step_log);
+}
+
+void test_task_can_run_again()
+{
+  counting_task a('a', 1);
+  scheduler::task *const tasks[] = { &a };
+
+  TEST_ASSERT_TRUE(scheduler::run(tasks, 1));
+  TEST_ASSERT_TRUE(scheduler::run(tasks, 1));
+  TEST_ASSERT_EQUAL_STRING("aaaa", step_log);
+}
+
+void test_failed_task_stops_all()
+{
+  counting_task a('a', 10);
+  failing_task f;
+  scheduler::task *const tasks[] = { &a, &f };
+
+  TEST_ASSERT_FALSE(scheduler::run(tasks, 2));
+  TEST_ASSERT_EQUAL_STRING("afaF", step_log);
+}
+
+void test_waiting_tasks_let_time_pass()
+{
+  sleeping_task short_sleep(300);
+  sleeping_task long_sleep(2000);
+  scheduler::task *const tasks[] = { &long_sleep, &short_sleep };
+
+  const uint32_t start = timebase::now();
+  TEST_ASSERT_TRUE(scheduler::run(tasks, 2));
+  const uint32_t elapsed = timebase::now() - start;
+
+  TEST_ASSERT_UINT32_WITHIN(10, 300, short_sleep.woke_at - short_sleep.started_at);
+  TEST_ASSERT_UINT32_WITHIN(10, 2000, long_sleep.woke_at - long_sleep.started_at);
+  TEST_ASSERT_UINT32_WITHIN(10, 2000, elapsed);
+}
+
+void test_all_32_tasks()
+{
+  counting_task *counting[32];
+  scheduler::task *tasks[32];
+  for (int i = 0; i < 32; i++)
+  {
+    counting[i] = new counting_task('0' + (i % 10), i % 2);
+    tasks[i] = counting[i];
+  }
+
+  TEST_ASSERT_TRUE(scheduler::run(tasks, 32));
+
+  // every task ran once, and the odd ones a second time
+  TEST_ASSERT_EQUAL_size_t(48, step_count);
+  for (int i = 0; i < 32; i++)
+  {
+    delete counting[i];
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_tasks_run_round_robin);
+  RUN_TEST(test_task_can_run_again);
+  RUN_TEST(test_failed_task_stops_all);
+  RUN_TEST(test_waiting_tasks_let_time_pass);
+  RUN_TEST(test_all_32_tasks);
+  return UNITY_END();
+}
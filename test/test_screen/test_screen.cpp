@@ -0,0 +1,139 @@
+/**
+ * tests of the DWIN screen output, counting the operations sent to the screen serial of the native build
+ */
+#include <unity.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "modules/screen.h"
+#include "modules/timebase.h"
+#include "modules/delay.h"
+#include "../usart_capture.h"
+
+/**
+ * @brief count the DWIN operations in the sent bytes
+ * @param sent the sent bytes
+ * @param command the command byte to count, or -1 to count all
+ */
+int count_operations(const std::vector<uint8_t> &sent, const int command = -1)
+{
+  int count = 0;
+  for (size_t i = 0; i + 1 < sent.size(); i++)
+  {
+    if (sent[i] != dwin::constants::head[0])
+    {
+      continue;
+    }
+
+    if (command == -1 || sent[i + 1] == command)
+    {
+      count++;
+    }
+
+    // skip to the tail of the frame
+    const uint8_t *tail = std::search(sent.data() + i, sent.data() + sent.size(),
+      dwin::constants::tail, dwin::constants::tail + sizeof(dwin::constants::tail));
+    i = (tail - sent.data()) + sizeof(dwin::constants::tail) - 1;
+  }
+  return count;
+}
+
+/**
+ * @brief were the given characters sent?
+ */
+bool contains(const std::vector<uint8_t> &sent, const char *text)
+{
+  return std::search(sent.begin(), sent.end(), text, text + strlen(text)) != sent.end();
+}
+
+/**
+ * @brief write a line, as logging::log() does
+ */
+void log_line(const char *format, const int number)
+{
+  char line[32];
+  snprintf(line, sizeof(line), format, number);
+  screen.write(line);
+  screen.flush();
+}
+
+constexpr uint8_t redraw_command = 0x3D;
+
+void setUp()
+{
+  // start outside of the frame interval, with nothing held back
+  delay::ms(100);
+  screen.flush_deferred();
+  take_sent();
+}
+
+void tearDown() {}
+
+void test_burst_is_rate_limited()
+{
+  constexpr int lines = 200;
+  const uint32_t start = timebase::now();
+  for (int i = 0; i < lines; i++)
+  {
+    log_line("burst line %d\n", i);
+
+    // the same line on the host serial takes about this long
+    delay::us(1500);
+  }
+  const uint32_t elapsed_ms = (timebase::now() - start) / 1000;
+
+  const std::vector<uint8_t> sent = take_sent();
+  const int flushes = count_operations(sent, redraw_command);
+  const int operations = count_operations(sent);
+  printf("%d lines in %u ms: %d flushes, %d DWIN operations, %u bytes\n",
+    lines, static_cast<unsigned>(elapsed_ms), flushes, operations, static_cast<unsigned>(sent.size()));
+
+  TEST_ASSERT_GREATER_THAN(0, flushes);
+  TEST_ASSERT_LESS_OR_EQUAL((elapsed_ms / 50) + 1, flushes);
+  TEST_ASSERT_LESS_THAN(lines, operations);
+}
+
+void test_deferred_flush_shows_last_line()
+{
+  for (int i = 0; i < 20; i++)
+  {
+    log_line("deferred line %d\n", i);
+  }
+  const std::vector<uint8_t> burst = take_sent();
+  TEST_ASSERT_FALSE(contains(burst, "deferred line 19"));
+
+  // within the frame interval, the held back line stays back
+  screen.flush_deferred();
+  TEST_ASSERT_EQUAL_size_t(0, take_sent().size());
+
+  delay::ms(60);
+  screen.flush_deferred();
+  TEST_ASSERT_TRUE(contains(take_sent(), "deferred line 19"));
+}
+
+void test_flush_deferred_without_changes_sends_nothing()
+{
+  log_line("single line %d\n", 1);
+  TEST_ASSERT_TRUE(contains(take_sent(), "single line 1"));
+
+  delay::ms(60);
+  screen.flush_deferred();
+  TEST_ASSERT_EQUAL_size_t(0, take_sent().size());
+}
+
+int main()
+{
+  start_capture(SCREEN_SERIAL);
+
+  timebase::init();
+  screen.init();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_burst_is_rate_limited);
+  RUN_TEST(test_deferred_flush_shows_last_line);
+  RUN_TEST(test_flush_deferred_without_changes_sends_nothing);
+  const int failures = UNITY_END();
+
+  stop_capture();
+  return failures;
+}
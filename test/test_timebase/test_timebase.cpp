@@ -0,0 +1,104 @@
+/**
+ * tests of the SysTick time base, on the simulated core of the native build
+ */
+#include <unity.h>
+#include "modules/timebase.h"
+#include "modules/delay.h"
+
+/**
+ * @brief number of on_tick calls
+ */
+volatile uint32_t tick_calls = 0;
+
+void count_tick()
+{
+  tick_calls = tick_calls + 1;
+}
+
+void setUp()
+{
+  timebase::init();
+  timebase::set_tick_handler(count_tick);
+  tick_calls = 0;
+}
+
+void tearDown()
+{
+  timebase::deinit();
+}
+
+void test_pending_tick_runs_handler_in_thread_mode()
+{
+  const uint32_t before = timebase::now();
+
+  // a tick that is pending while interrupts are enabled is taken by the tick handler, not counted by now()
+  SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+  const uint32_t after = timebase::now();
+
+  TEST_ASSERT_EQUAL_UINT32(1, tick_calls);
+  TEST_ASSERT_UINT32_WITHIN(10, 1000, after - before);
+}
+
+void test_pending_tick_counted_with_interrupts_disabled()
+{
+  const uint32_t before = timebase::now();
+
+  __disable_irq();
+  Ddl_Delay1us(900);
+  const uint32_t after = timebase::now();
+  __enable_irq();
+
+  // the tick handler couldn't run, so the tick is counted without calling on_tick
+  TEST_ASSERT_EQUAL_UINT32(0, tick_calls);
+  TEST_ASSERT_UINT32_WITHIN(10, 900, after - before);
+  TEST_ASSERT_UINT32_WITHIN(10, 900, timebase::now() - before);
+}
+
+void test_handler_runs_every_tick_while_polling()
+{
+  // delays poll now() in a loop, and every tick still reaches on_tick
+  const uint32_t before = timebase::now();
+  delay::ms(100);
+  const uint32_t elapsed = timebase::now() - before;
+
+  TEST_ASSERT_UINT32_WITHIN(1, elapsed / 1000, tick_calls);
+  TEST_ASSERT_UINT32_WITHIN(1, 100, tick_calls);
+}
+
+void test_now_is_monotonic()
+{
+  uint32_t last = timebase::now();
+  for (int i = 0; i < 5000; i++)
+  {
+    Ddl_Delay1us(7);
+    const uint32_t now = timebase::now();
+    TEST_ASSERT_TRUE(static_cast<int32_t>(now - last) >= 0);
+    last = now;
+  }
+}
+
+void test_deadline()
+{
+  const timebase::deadline deadline(2500);
+  TEST_ASSERT_FALSE(deadline.expired());
+  TEST_ASSERT_UINT32_WITHIN(1, 2500, deadline.remaining());
+
+  Ddl_Delay1us(2000);
+  TEST_ASSERT_FALSE(deadline.expired());
+  TEST_ASSERT_UINT32_WITHIN(1, 500, deadline.remaining());
+
+  Ddl_Delay1us(600);
+  TEST_ASSERT_TRUE(deadline.expired());
+  TEST_ASSERT_EQUAL_UINT32(0, deadline.remaining());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_pending_tick_runs_handler_in_thread_mode);
+  RUN_TEST(test_pending_tick_counted_with_interrupts_disabled);
+  RUN_TEST(test_handler_runs_every_tick_while_polling);
+  RUN_TEST(test_now_is_monotonic);
+  RUN_TEST(test_deadline);
+  return UNITY_END();
+}
@@ -0,0 +1,62 @@
+/**
+ * capture of the bytes the native build sends on a USART, for the unit tests.
+ * the native USART model writes them to the file NATIVE_USART<n> names
+ */
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief file the captured USART writes to
+ */
+inline char capture_path[] = "/tmp/usart_capture_XXXXXX";
+
+/**
+ * @brief bytes of the capture file already taken
+ */
+inline size_t capture_taken = 0;
+
+/**
+ * @brief send the output of a USART to the capture file
+ * @param usart the number of the USART, e.g. SCREEN_SERIAL
+ * @note call before the USART is initialized
+ */
+inline void start_capture(const int usart)
+{
+  close(mkstemp(capture_path));
+  char name[24];
+  snprintf(name, sizeof(name), "NATIVE_USART%d", usart);
+  setenv(name, capture_path, 1);
+}
+
+/**
+ * @brief remove the capture file
+ */
+inline void stop_capture()
+{
+  remove(capture_path);
+}
+
+/**
+ * @brief get the bytes sent since the last call
+ */
+inline std::vector<uint8_t> take_sent()
+{
+  fflush(nullptr);
+
+  std::vector<uint8_t> sent;
+  FILE *f = fopen(capture_path, "rb");
+  fseek(f, static_cast<long>(capture_taken), SEEK_SET);
+  int ch;
+  while ((ch = fgetc(f)) != EOF)
+  {
+    sent.push_back(static_cast<uint8_t>(ch));
+  }
+  fclose(f);
+
+  capture_taken += sent.size();
+  return sent;
+}